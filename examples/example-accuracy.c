@@ -0,0 +1,532 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ *
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+/*
+ * This example validates the accuracy of the approximate geometry kernels
+ * of the TURTLE library versus their speed. Random tracks are swept over a
+ * DEM, and approximate results are compared to exact ones for:
+ *
+ * - ECEF to geodetic transforms, checked by round trips,
+ * - map projections, checked by round trips,
+ * - elevation interpolation, versus the analytic synthetic topography,
+ * - stepper geographic coordinates, computed with local linear transforms
+ *   (see `turtle_stepper_range_set`) and with the stepper precision,
+ * - the location of the topography boundary by the stepper.
+ *
+ * The distributions of errors are reported together with the throughputs.
+ * Stepper throughputs are compared to an exact stepper, i.e. without local
+ * transforms and in double precision.
+ *
+ * By default a synthetic DEM is generated. Alternatively, the path to a map
+ * can be provided, e.g. the one created by `example-projection`. Usage:
+ *
+ *   example-accuracy [tracks] [range] [precision] [resolution] [map]
+ *
+ * where *tracks* and *resolution* are strictly positive, *range* is positive
+ * or null and *precision* is either `double` or `single`.
+ */
+
+/* Expose clock_gettime */
+#define _POSIX_C_SOURCE 199309L
+
+/* C89 standard library */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+/* POSIX clocks */
+#include <time.h>
+/* The TURTLE library */
+#include "turtle.h"
+
+#ifndef M_PI
+/* Define pi, if unknown */
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Parameters of the synthetic DEM, in UTM 31N */
+#define SYNTHETIC_X0 496000.
+#define SYNTHETIC_Y0 5067000.
+#define SYNTHETIC_HALF_WIDTH 5000.
+#define SYNTHETIC_N 401
+
+/* Approximate Earth radius, for converting angles to distances */
+#define EARTH_RADIUS 6371E+03
+
+/* Maximum number of steps per track */
+#define MAX_STEPS 100000
+
+/*
+ * The turtle objects are declared globally. This allows us to define a simple
+ * error handler with a gracefull exit to the OS.
+ */
+static struct turtle_map * map = NULL;
+static struct turtle_stepper * approximate = NULL;
+static struct turtle_stepper * exact = NULL;
+
+/* Clean all allocated data and exit to the OS. */
+void exit_gracefully(enum turtle_return rc)
+{
+        turtle_stepper_destroy(&approximate);
+        turtle_stepper_destroy(&exact);
+        turtle_map_destroy(&map);
+        exit(rc);
+}
+
+/* Handler for TURTLE library errors */
+void handle_error(enum turtle_return code, turtle_function_t * function,
+    const char * message)
+{
+        fprintf(stderr, "A TURTLE library error occurred:\n%s\n", message);
+        exit_gracefully(EXIT_FAILURE);
+}
+
+/* The analytic synthetic topography */
+static double synthetic_elevation(double x, double y)
+{
+        const double two_pi = 2. * M_PI;
+        return 1000. + 300. * sin(two_pi * (x - SYNTHETIC_X0) / 3000.) *
+            cos(two_pi * (y - SYNTHETIC_Y0) / 4000.);
+}
+
+/* Create the synthetic DEM */
+static void synthetic_create(void)
+{
+        const double w = SYNTHETIC_HALF_WIDTH;
+        struct turtle_map_info info = { SYNTHETIC_N, SYNTHETIC_N,
+                { SYNTHETIC_X0 - w, SYNTHETIC_X0 + w },
+                { SYNTHETIC_Y0 - w, SYNTHETIC_Y0 + w }, { 0., 2000. } };
+        turtle_map_create(&map, &info, "UTM 31N");
+
+        const double d = 2. * w / (SYNTHETIC_N - 1);
+        int i;
+        for (i = 0; i < SYNTHETIC_N; i++) {
+                int j;
+                for (j = 0; j < SYNTHETIC_N; j++) {
+                        const double z = synthetic_elevation(
+                            info.x[0] + i * d, info.y[0] + j * d);
+                        turtle_map_fill(map, i, j, z);
+                }
+        }
+}
+
+/* Get a uniform random number over [a, b] */
+static double uniform(double a, double b)
+{
+        return a + (b - a) * rand() / (double)RAND_MAX;
+}
+
+/* Get the wall clock time, in s */
+static double wall_time(void)
+{
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return t.tv_sec + 1E-09 * t.tv_nsec;
+}
+
+/* Container for a distribution of errors */
+struct errors {
+        int size;
+        int capacity;
+        double * values;
+};
+
+/* Append an error to a distribution */
+static void errors_add(struct errors * errors, double value)
+{
+        if (errors->size == errors->capacity) {
+                const int capacity =
+                    (errors->capacity == 0) ? 1024 : 2 * errors->capacity;
+                double * values =
+                    realloc(errors->values, capacity * sizeof(*values));
+                if (values == NULL) {
+                        fprintf(stderr, "could not allocate memory\n");
+                        exit_gracefully(EXIT_FAILURE);
+                }
+                errors->values = values;
+                errors->capacity = capacity;
+        }
+        errors->values[errors->size++] = fabs(value);
+}
+
+/* Comparison function for sorting errors */
+static int compare_errors(const void * a, const void * b)
+{
+        const double da = *(const double *)a, db = *(const double *)b;
+        return (da > db) - (da < db);
+}
+
+/* Print the header of the report */
+static void report_header(void)
+{
+        printf("%-24s %8s %10s %10s %10s %10s %10s\n", "# kernel", "samples",
+            "rms", "p50", "p99", "max", "Mcalls/s");
+}
+
+/* Print the statistics of a distribution of errors, and free it */
+static void report(const char * name, struct errors * errors, double rate)
+{
+        double rms = 0., p50 = 0., p99 = 0., max = 0.;
+        if (errors->size > 0) {
+                qsort(errors->values, errors->size, sizeof(*errors->values),
+                    &compare_errors);
+                int i;
+                for (i = 0; i < errors->size; i++)
+                        rms += errors->values[i] * errors->values[i];
+                rms = sqrt(rms / errors->size);
+                p50 = errors->values[errors->size / 2];
+                p99 = errors->values[(int)(0.99 * (errors->size - 1))];
+                max = errors->values[errors->size - 1];
+        }
+        printf("%-24s %8d %10.3e %10.3e %10.3e %10.3e", name, errors->size,
+            rms, p50, p99, max);
+        if (rate > 0.)
+                printf(" %10.3f\n", 1E-06 * rate);
+        else
+                printf(" %10s\n", "-");
+
+        free(errors->values);
+        memset(errors, 0x0, sizeof(*errors));
+}
+
+/* Map coordinates of a geodetic point */
+static void map_coordinates(const struct turtle_projection * projection,
+    double latitude, double longitude, double * x, double * y)
+{
+        if (projection == NULL) {
+                *x = longitude;
+                *y = latitude;
+        } else {
+                turtle_projection_project(
+                    projection, latitude, longitude, x, y);
+        }
+}
+
+/* Geodetic coordinates of a map point */
+static void map_geodetic(const struct turtle_projection * projection,
+    double x, double y, double * latitude, double * longitude)
+{
+        if (projection == NULL) {
+                *latitude = y;
+                *longitude = x;
+        } else {
+                turtle_projection_unproject(
+                    projection, x, y, latitude, longitude);
+        }
+}
+
+/* Exact ground elevation and altitude at an ECEF position */
+static int ground_exact(const struct turtle_projection * projection,
+    const double * position, double * altitude, double * elevation)
+{
+        double latitude, longitude, x, y;
+        turtle_ecef_to_geodetic(position, &latitude, &longitude, altitude);
+        map_coordinates(projection, latitude, longitude, &x, &y);
+        int inside;
+        turtle_map_elevation(map, x, y, elevation, &inside);
+        return inside;
+}
+
+/* Random track over the central part of the map */
+struct track {
+        double position[3];
+        double direction[3];
+};
+
+static void track_random(const struct turtle_projection * projection,
+    const struct turtle_map_info * info, struct track * track)
+{
+        const double wx = 0.3 * (info->x[1] - info->x[0]);
+        const double wy = 0.3 * (info->y[1] - info->y[0]);
+        const double x = uniform(info->x[0] + wx, info->x[1] - wx);
+        const double y = uniform(info->y[0] + wy, info->y[1] - wy);
+        double latitude, longitude, z;
+        map_geodetic(projection, x, y, &latitude, &longitude);
+        turtle_map_elevation(map, x, y, &z, NULL);
+        turtle_ecef_from_geodetic(
+            latitude, longitude, z + uniform(10., 500.), track->position);
+        turtle_ecef_from_horizontal(latitude, longitude, uniform(0., 360.),
+            uniform(-30., -2.), track->direction);
+}
+
+/* Step along a track until the topography is crossed. The number of steps
+ * is returned, or -1 if the track exited the map
+ */
+static int track_run(struct turtle_stepper * stepper,
+    const struct track * track, double * position, double * distance)
+{
+        memcpy(position, track->position, 3 * sizeof(*position));
+        int index[2];
+        turtle_stepper_step(stepper, position, NULL, NULL, NULL, NULL, NULL,
+            NULL, index);
+        const int medium = index[0];
+        *distance = 0.;
+        int i;
+        for (i = 0; i < MAX_STEPS; i++) {
+                double step;
+                turtle_stepper_step(stepper, position, track->direction, NULL,
+                    NULL, NULL, NULL, &step, index);
+                *distance += step;
+                if (index[0] < 0) return -1;
+                if (index[0] != medium) return i + 1;
+        }
+        return -1;
+}
+
+int main(int argc, char * argv[])
+{
+        /* Parse the arguments */
+        int n_tracks = 1000;
+        double range = 1., resolution = 1E-02;
+        enum turtle_stepper_precision precision =
+            TURTLE_STEPPER_PRECISION_DOUBLE;
+        const char * path = NULL;
+        int valid = 1;
+        if (argc && --argc) n_tracks = atoi(*++argv);
+        if (argc && --argc) range = atof(*++argv);
+        if (argc && --argc) {
+                if (strcmp(*++argv, "single") == 0)
+                        precision = TURTLE_STEPPER_PRECISION_SINGLE;
+                else if (strcmp(*argv, "double") != 0)
+                        valid = 0;
+        }
+        if (argc && --argc) resolution = atof(*++argv);
+        if (argc && --argc) path = *++argv;
+        if (!valid || (n_tracks <= 0) || !(range >= 0.) ||
+            !(resolution > 0.)) {
+                fprintf(stderr, "usage: example-accuracy [tracks] [range] "
+                                "[precision] [resolution] [map]\n");
+                exit(EXIT_FAILURE);
+        }
+
+        /* Set a custom error handler */
+        turtle_error_handler_set(&handle_error);
+
+        /* Get the DEM */
+        if (path == NULL)
+                synthetic_create();
+        else
+                turtle_map_load(&map, path);
+        struct turtle_map_info info;
+        turtle_map_meta(map, &info, NULL);
+        const struct turtle_projection * projection =
+            turtle_map_projection(map);
+        printf("# DEM: %s, %d tracks, range = %g m, precision = %s, "
+               "resolution = %g\n", (path == NULL) ? "synthetic" : path,
+            n_tracks, range,
+            (precision == TURTLE_STEPPER_PRECISION_SINGLE) ? "single" :
+                                                             "double",
+            resolution);
+
+        /* Create the approximate and the exact steppers */
+        turtle_stepper_create(&approximate);
+        turtle_stepper_range_set(approximate, range);
+        turtle_stepper_precision_set(approximate, precision);
+        turtle_stepper_resolution_set(approximate, resolution);
+        turtle_stepper_add_map(approximate, map, 0.);
+
+        turtle_stepper_create(&exact);
+        turtle_stepper_range_set(exact, 0.);
+        turtle_stepper_resolution_set(exact, resolution);
+        turtle_stepper_add_map(exact, map, 0.);
+
+        /* Draw the random tracks */
+        srand(0);
+        struct track * tracks = malloc(n_tracks * sizeof(*tracks));
+        if (tracks == NULL) {
+                fprintf(stderr, "could not allocate memory\n");
+                exit_gracefully(EXIT_FAILURE);
+        }
+        int i;
+        for (i = 0; i < n_tracks; i++)
+                track_random(projection, &info, tracks + i);
+
+        report_header();
+        struct errors errors = { 0, 0, NULL };
+        volatile double sink = 0.;
+
+        /* ECEF to geodetic transforms, checked by round trips */
+        double t0 = wall_time();
+        for (i = 0; i < n_tracks; i++) {
+                double latitude, longitude, altitude;
+                turtle_ecef_to_geodetic(tracks[i].position, &latitude,
+                    &longitude, &altitude);
+                sink += altitude;
+        }
+        double rate = n_tracks / (wall_time() - t0);
+        for (i = 0; i < n_tracks; i++) {
+                double latitude, longitude, altitude, r[3];
+                turtle_ecef_to_geodetic(tracks[i].position, &latitude,
+                    &longitude, &altitude);
+                turtle_ecef_from_geodetic(latitude, longitude, altitude, r);
+                const double * r0 = tracks[i].position;
+                errors_add(&errors, sqrt((r[0] - r0[0]) * (r[0] - r0[0]) +
+                    (r[1] - r0[1]) * (r[1] - r0[1]) +
+                    (r[2] - r0[2]) * (r[2] - r0[2])));
+        }
+        report("ecef_to_geodetic [m]", &errors, rate);
+
+        /* Map projections, checked by round trips */
+        if (projection != NULL) {
+                double (*points)[2] = malloc(n_tracks * sizeof(*points));
+                if (points == NULL) {
+                        fprintf(stderr, "could not allocate memory\n");
+                        exit_gracefully(EXIT_FAILURE);
+                }
+                for (i = 0; i < n_tracks; i++) {
+                        double altitude;
+                        turtle_ecef_to_geodetic(tracks[i].position,
+                            points[i], points[i] + 1, &altitude);
+                }
+                t0 = wall_time();
+                for (i = 0; i < n_tracks; i++) {
+                        double x, y, latitude, longitude;
+                        turtle_projection_project(projection, points[i][0],
+                            points[i][1], &x, &y);
+                        turtle_projection_unproject(
+                            projection, x, y, &latitude, &longitude);
+                        sink += latitude;
+                }
+                rate = n_tracks / (wall_time() - t0);
+                for (i = 0; i < n_tracks; i++) {
+                        double x, y, latitude, longitude;
+                        turtle_projection_project(projection, points[i][0],
+                            points[i][1], &x, &y);
+                        turtle_projection_unproject(
+                            projection, x, y, &latitude, &longitude);
+                        const double c = cos(points[i][0] * M_PI / 180.);
+                        const double dy = latitude - points[i][0];
+                        const double dx = c * (longitude - points[i][1]);
+                        errors_add(&errors,
+                            EARTH_RADIUS * M_PI / 180. * sqrt(dx * dx +
+                            dy * dy));
+                }
+                free(points);
+                report("projection [m]", &errors, rate);
+        }
+
+        /* Elevation interpolation, versus the analytic topography */
+        const double wx = info.x[1] - info.x[0], wy = info.y[1] - info.y[0];
+        t0 = wall_time();
+        for (i = 0; i < n_tracks; i++) {
+                double z;
+                turtle_map_elevation(map, info.x[0] + wx * (i + 0.5) /
+                    n_tracks, info.y[0] + wy * (i + 0.5) / n_tracks, &z,
+                    NULL);
+                sink += z;
+        }
+        rate = n_tracks / (wall_time() - t0);
+        if (path == NULL) {
+                for (i = 0; i < n_tracks; i++) {
+                        const double x = uniform(info.x[0], info.x[1]);
+                        const double y = uniform(info.y[0], info.y[1]);
+                        double z;
+                        turtle_map_elevation(map, x, y, &z, NULL);
+                        errors_add(&errors, z - synthetic_elevation(x, y));
+                }
+        }
+        report("interpolation [m]", &errors, rate);
+
+        /* Stepper throughputs, over full tracks */
+        double position[3], distance;
+        int steps = 0;
+        t0 = wall_time();
+        for (i = 0; i < n_tracks; i++) {
+                const int n = track_run(exact, tracks + i, position,
+                    &distance);
+                if (n > 0) steps += n;
+        }
+        const double rate_exact = steps / (wall_time() - t0);
+        steps = 0;
+        t0 = wall_time();
+        for (i = 0; i < n_tracks; i++) {
+                const int n = track_run(approximate, tracks + i, position,
+                    &distance);
+                if (n > 0) steps += n;
+        }
+        const double rate_approximate = steps / (wall_time() - t0);
+
+        /* Stepper geographic coordinates, step by step */
+        struct errors errors_altitude = { 0, 0, NULL };
+        struct errors errors_elevation = { 0, 0, NULL };
+        for (i = 0; i < n_tracks; i++) {
+                memcpy(position, tracks[i].position, sizeof(position));
+                double latitude, longitude, altitude, elevation[2];
+                int index[2];
+                turtle_stepper_step(approximate, position, NULL, NULL, NULL,
+                    NULL, NULL, NULL, index);
+                const int medium = index[0];
+                int j;
+                for (j = 0; j < MAX_STEPS; j++) {
+                        turtle_stepper_step(approximate, position,
+                            tracks[i].direction, &latitude, &longitude,
+                            &altitude, elevation, NULL, index);
+                        if (index[0] != medium) break;
+
+                        double latitude0, longitude0, altitude0, z0;
+                        turtle_ecef_to_geodetic(position, &latitude0,
+                            &longitude0, &altitude0);
+                        const double c = cos(latitude0 * M_PI / 180.);
+                        const double dy = latitude - latitude0;
+                        const double dx = c * (longitude - longitude0);
+                        errors_add(&errors, EARTH_RADIUS * M_PI / 180. *
+                            sqrt(dx * dx + dy * dy));
+                        errors_add(&errors_altitude, altitude - altitude0);
+                        if (ground_exact(projection, position, &altitude0,
+                            &z0))
+                                errors_add(&errors_elevation,
+                                    elevation[0] - z0);
+                }
+        }
+        report("step horizontal [m]", &errors, rate_approximate);
+        report("step altitude [m]", &errors_altitude, rate_approximate);
+        report("step elevation [m]", &errors_elevation, rate_approximate);
+
+        /* Location of the topography boundary */
+        struct errors errors_distance = { 0, 0, NULL };
+        for (i = 0; i < n_tracks; i++) {
+                double distance0, altitude, z;
+                if (track_run(exact, tracks + i, position, &distance0) < 0)
+                        continue;
+                if (ground_exact(projection, position, &altitude, &z))
+                        errors_add(&errors_altitude, altitude - z);
+                if (track_run(approximate, tracks + i, position, &distance) <
+                    0)
+                        continue;
+                if (ground_exact(projection, position, &altitude, &z))
+                        errors_add(&errors, altitude - z);
+                errors_add(&errors_distance, distance - distance0);
+        }
+        report("boundary exact [m]", &errors_altitude, rate_exact);
+        report("boundary [m]", &errors, rate_approximate);
+        report("boundary distance [m]", &errors_distance, 0.);
+
+        /* Free the memory and exit */
+        free(tracks);
+        (void)sink;
+        exit_gracefully(TURTLE_RETURN_SUCCESS);
+}
@@ -24,6 +24,9 @@
 extern "C" {
 #endif
 
+/* C99 standard library */
+#include <stdint.h>
+
 /* Prefix for TURTLE library functions */
 #ifndef TURTLE_API
 #define TURTLE_API
@@ -87,6 +90,11 @@ struct turtle_client;
  */
 struct turtle_stepper;
 
+/**
+ * Opaque structure for the stepping state of a track
+ */
+struct turtle_stepper_cursor;
+
 /**
  * Meta data for elevation maps
  */
@@ -105,6 +113,14 @@ struct turtle_map_info {
         const char * encoding;
 };
 
+/**
+ * Local frame of an observer, for converting directions
+ */
+struct turtle_ecef_frame {
+        /** The East, North and Up basis vectors, in ECEF */
+        double enu[3][3];
+};
+
 /**
  * Generic function pointer
  *
@@ -148,6 +164,277 @@ typedef void turtle_error_handler_t(enum turtle_return code,
  */
 typedef int turtle_stack_locker_t(void);
 
+/**
+ * Access modes for the critical sections of a stack
+ *
+ * A shared access only reads the stack content, e.g. when looking up an
+ * already loaded map or when updating its reference count. An exclusive
+ * access might modify the stack, e.g. when loading a new map or when evicting
+ * an unused one.
+ */
+enum turtle_stack_access {
+        /** Read only access, possibly concurrent with other shared ones */
+        TURTLE_STACK_ACCESS_SHARED = 0,
+        /** Read and write access, exclusive of any other access */
+        TURTLE_STACK_ACCESS_EXCLUSIVE
+};
+
+/**
+ * Floating point precision of the stepping computations
+ */
+enum turtle_stepper_precision {
+        /** All computations are done in double precision */
+        TURTLE_STEPPER_PRECISION_DOUBLE = 0,
+        /** Local transforms and map interpolations are done in float */
+        TURTLE_STEPPER_PRECISION_SINGLE
+};
+
+/**
+ * Events recorded by the tracing, see `turtle_trace_start`
+ */
+enum turtle_trace_event {
+        /** Loading of a stack tile, labelled by its path */
+        TURTLE_TRACE_TILE_LOAD = 0,
+        /** Eviction of a stack tile, labelled by its path */
+        TURTLE_TRACE_TILE_EVICT,
+        /** Wait for acquiring a stack lock, labelled by the access */
+        TURTLE_TRACE_LOCK_WAIT,
+        /** Holding of a stack lock, labelled by the access */
+        TURTLE_TRACE_LOCK_HOLD,
+        /** Rebuild of a local transform of a stepper, labelled by its name */
+        TURTLE_TRACE_TRANSFORM,
+        /** Bisection of a boundary by a stepper */
+        TURTLE_TRACE_BISECTION,
+        /** The number of trace events */
+        N_TURTLE_TRACE_EVENTS
+};
+
+/**
+ * Context aware callbacks for managing concurrent accesses to the stack
+ *
+ * @param context    The user supplied context
+ * @param access     The requested access mode
+ * @return `0` on success, any other value otherwise.
+ *
+ * Unlike `turtle_stack_locker_t` these callbacks are provided with a user
+ * context, e.g. a per stack mutex, and with the requested access mode. The
+ * `lock` callback must grant the requested *access*, e.g. with a
+ * reader/writer lock. Note that granting an exclusive access for a shared
+ * request is always valid.
+ *
+ * __Warnings__
+ *
+ * The callback *must* return `0` if the (un)lock was successful.
+ */
+typedef int turtle_stack_context_locker_t(
+    void * context, enum turtle_stack_access access);
+
+/**
+ * Callback for looking up the tiles of a custom provider
+ *
+ * @param context    The provider context
+ * @param ix         The longitude index of the tile
+ * @param iy         The latitude index of the tile
+ * @param info       The tile meta data
+ * @return `1` if there is a tile at (*ix*, *iy*), `0` otherwise
+ *
+ * If there is a tile, its meta data must be filled in the *info* structure,
+ * i.e. its number of nodes and its longitude (x), latitude (y) and
+ * elevation (z) ranges. A tile must span exactly one cell of the provider
+ * grid. The lookup must always return the same result for a given tile.
+ */
+typedef int turtle_stack_lookup_t(
+    void * context, int ix, int iy, struct turtle_map_info * info);
+
+/**
+ * Callback for filling the tiles of a custom provider
+ *
+ * @param context      The provider context
+ * @param ix           The longitude index of the tile
+ * @param iy           The latitude index of the tile
+ * @param info         The tile meta data, as returned by the lookup
+ * @param elevation    The elevation values of the tile nodes
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code
+ *
+ * The *elevation* buffer holds `info->nx * info->ny` values, for the node
+ * (i, j) at index `j * info->nx + i`, starting from the south-west corner.
+ * Elevation values must lie within the tile range, `info->z`.
+ */
+typedef enum turtle_return turtle_stack_filler_t(void * context, int ix,
+    int iy, const struct turtle_map_info * info, double * elevation);
+
+/**
+ * Custom provider of elevation data for a stack, e.g. a database or a
+ * procedural generator
+ */
+struct turtle_stack_provider {
+        /** Latitude of the south edge of the grid of tiles */
+        double latitude_0;
+        /** Latitude span of a tile */
+        double latitude_delta;
+        /** Number of tiles along latitude */
+        int latitude_n;
+        /** Longitude of the west edge of the grid of tiles */
+        double longitude_0;
+        /** Longitude span of a tile */
+        double longitude_delta;
+        /** Number of tiles along longitude */
+        int longitude_n;
+        /** Callback for looking up tiles */
+        turtle_stack_lookup_t * lookup;
+        /** Callback for filling tiles */
+        turtle_stack_filler_t * fill;
+        /** User supplied context for the callbacks */
+        void * context;
+};
+
+/**
+ * Callback for opening a file of a custom format
+ *
+ * @param context       The format context
+ * @param path          The path to the file
+ * @param mode          The opening mode, `"rb"` or `"wb+"`
+ * @param info          The map meta data
+ * @param projection    The name of the map projection, or `NULL`
+ * @param handle        The file handle
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code
+ *
+ * In read mode the callback must fill the *info* structure and it might set
+ * the map *projection*, which is initialised to `NULL`. In write mode both
+ * are inputs describing the map to be written. The returned *handle* is
+ * forwarded to the other callbacks of the format.
+ */
+typedef enum turtle_return turtle_io_format_opener_t(void * context,
+    const char * path, const char * mode, struct turtle_map_info * info,
+    const char ** projection, void ** handle);
+
+/**
+ * Callback for reading the data of a custom format
+ *
+ * @param handle    The file handle
+ * @param info      The map meta data, as returned when opening
+ * @param data      The encoded elevation values
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code
+ *
+ * The *data* buffer holds `info->nx * info->ny` values, for the node (i, j)
+ * at index `j * info->nx + i`, starting from the south-west corner. The
+ * elevation is encoded over 16 bits as `k` for
+ * `z = info->z[0] + k * (info->z[1] - info->z[0]) / 65535`. This is also
+ * the memory layout of TURTLE maps, such that the data are read in place.
+ */
+typedef enum turtle_return turtle_io_format_reader_t(
+    void * handle, const struct turtle_map_info * info, uint16_t * data);
+
+/**
+ * Callback for writing the data of a custom format
+ *
+ * @param handle    The file handle
+ * @param info      The map meta data
+ * @param data      The encoded elevation values
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code
+ *
+ * The *data* buffer has the same layout and encoding than for
+ * `turtle_io_format_reader_t`.
+ */
+typedef enum turtle_return turtle_io_format_writer_t(void * handle,
+    const struct turtle_map_info * info, const uint16_t * data);
+
+/**
+ * Callback for closing a file of a custom format
+ *
+ * @param handle    The file handle
+ */
+typedef void turtle_io_format_closer_t(void * handle);
+
+/**
+ * Reader and writer of a custom data format, e.g. for in-house archives
+ */
+struct turtle_io_format {
+        /** Callback for opening files and getting their meta data */
+        turtle_io_format_opener_t * open;
+        /** Callback for reading the elevation data */
+        turtle_io_format_reader_t * read;
+        /** Callback for writing the elevation data, or `NULL` */
+        turtle_io_format_writer_t * write;
+        /** Callback for closing files */
+        turtle_io_format_closer_t * close;
+        /** User supplied context for the open callback */
+        void * context;
+};
+
+/**
+ * Bounds and targets for the auto-tuning of a stepper
+ */
+struct turtle_stepper_tuning {
+        /** Tolerance on the linearisation error of local transforms, in m */
+        double tolerance;
+        /** Target fraction of steps overshooting a boundary */
+        double overshoot;
+        /** Bounds (min, max) on the local range, in m */
+        double range[2];
+        /** Bounds (min, max) on the slope factor */
+        double slope[2];
+        /** Bounds (min, max) on the resolution factor, in m */
+        double resolution[2];
+};
+
+/**
+ * Settings chosen by the auto-tuning of a stepper, and its statistics
+ */
+struct turtle_stepper_tuning_report {
+        /** The current local range, in m */
+        double range;
+        /** The current slope factor */
+        double slope;
+        /** The current resolution factor, in m */
+        double resolution;
+        /** The estimated linearisation error at the current range, in m */
+        double error;
+        /** The number of tuned steps */
+        long steps;
+        /** The number of steps which overshot a boundary */
+        long overshoots;
+        /** The number of rebuilds of local transforms */
+        long rebuilds;
+};
+
+/**
+ * Track stepped through the topography by `turtle_stepper_run`
+ */
+struct turtle_stepper_track {
+        /** The initial (final) position */
+        double position[3];
+        /** The direction, constant along the track */
+        double direction[3];
+        /** The maximum (travelled) length, or zero for no limit */
+        double length;
+        /** The final topography and meta-data indices */
+        int index[2];
+        /** The number of steps done */
+        int steps;
+};
+
+/**
+ * Callback for monitoring tracks stepped by `turtle_stepper_run`
+ *
+ * @param context        The user supplied context
+ * @param track          The index of the track
+ * @param thread         The index of the thread stepping the track
+ * @param position       The current position
+ * @param step_length    The length of the last step
+ * @param index          The current topography and meta-data indices
+ * @return `0` for continuing the track, or any other value for stopping it
+ *
+ * The callback might be called concurrently by several threads, for
+ * distinct tracks. Calls for a given track are sequential.
+ */
+typedef int turtle_stepper_monitor_t(void * context, int track, int thread,
+    const double * position, double step_length, const int * index);
+
 /**
  * Return a string describing a TURTLE library function
  *
@@ -372,6 +659,37 @@ TURTLE_API enum turtle_return turtle_map_create(struct turtle_map ** map,
  */
 TURTLE_API void turtle_map_destroy(struct turtle_map ** map);
 
+/**
+ * Create a view over a sub-grid of a map
+ *
+ * @param parent    The parent map
+ * @param ix0       The x index of the first node of the view
+ * @param iy0       The y index of the first node of the view
+ * @param nx        The number of nodes of the view along x
+ * @param ny        The number of nodes of the view along y
+ * @param view      The view object
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below
+ *
+ * Create a map spanning the `nx x ny` nodes of *parent* starting from
+ * (*ix0*, *iy0*). The elevation data are not copied but shared with the
+ * parent, e.g. filling a node of the view modifies the parent as well. The
+ * view can be used wherever a map is expected, e.g. with
+ * `turtle_stepper_add_map`. It must be destroyed with `turtle_map_destroy`.
+ * The parent data are reference counted, i.e. they remain valid until the
+ * parent and all of its views have been destroyed.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_BAD_ADDRESS     The parent is null or a tile of a stack
+ *
+ *    TURTLE_RETURN_DOMAIN_ERROR    The view is not contained in the parent
+ *
+ *    TURTLE_RETURN_MEMORY_ERROR    The view couldn't be allocated
+ */
+TURTLE_API enum turtle_return turtle_map_view(struct turtle_map * parent,
+    int ix0, int iy0, int nx, int ny, struct turtle_map ** view);
+
 /**
  * Load a map
  *
@@ -381,7 +699,11 @@ TURTLE_API void turtle_map_destroy(struct turtle_map ** map);
  * code is returned as detailed below
  *
  * Load a map from a file. The file format is guessed from the filename
- * extension.
+ * extension. GeoTIFF maps can also be read from an HTTP server, given a
+ * `http://` URL or a `.url` file containing one. The whole map is fetched,
+ * using range requests. See `turtle_stack_create` for fetching only parts
+ * of a large tiled GeoTIFF, and `turtle_remote_cache_set` for caching remote
+ * data locally.
  *
  * __Error codes__
  *
@@ -515,6 +837,108 @@ TURTLE_API const struct turtle_projection * turtle_map_projection(
 TURTLE_API void turtle_map_meta(const struct turtle_map * map,
     struct turtle_map_info * info, const char ** projection);
 
+/**
+ * Get statistics of the elevation over a window of a map
+ *
+ * @param map     The map object
+ * @param x0      The first X-coordinate of the window
+ * @param x1      The second X-coordinate of the window
+ * @param y0      The first Y-coordinate of the window
+ * @param y1      The second Y-coordinate of the window
+ * @param mean    The mean elevation, or `NULL`
+ * @param min     The minimum elevation, or `NULL`
+ * @param max     The maximum elevation, or `NULL`
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below
+ *
+ * Compute statistics over the map nodes within the window, bounds included.
+ * The window is clipped to the map. The *mean* is obtained in constant time
+ * from a summed-area table, which requires 8 bytes per node. The *min* and
+ * *max* values are obtained from sparse tables over rectangles of blocks of
+ * 32 x 32 nodes. The blocks fully within the window are covered with four
+ * lookups, while the nodes of the partial blocks along the window borders
+ * are scanned, i.e. at most 62 (w + h) nodes for a window of w x h nodes.
+ * The sparse tables require 8 Lx Ly / 1024 bytes per node, where Lx (Ly) is
+ * 1 + log2 of the number of blocks along x (y), e.g. 0.38 bytes per node for
+ * a 3601 x 3601 map. Extrema are stored in single precision. These tables
+ * are built on first use, in parallel for large maps, and they are kept
+ * until the map is destroyed or modified. Views share the tables of the map
+ * owning their data.
+ *
+ * __Warnings__
+ *
+ * This function is not thread safe w.r.t. `turtle_map_fill`.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_BAD_ADDRESS     The map is null
+ *
+ *    TURTLE_RETURN_DOMAIN_ERROR    The window contains no map node
+ *
+ *    TURTLE_RETURN_MEMORY_ERROR    Couldn't allocate memory
+ */
+TURTLE_API enum turtle_return turtle_map_window_stats(struct turtle_map * map,
+    double x0, double x1, double y0, double y1, double * mean, double * min,
+    double * max);
+
+/**
+ * Cache remote data in a local directory
+ *
+ * @param path    The path to the cache directory, or `NULL`
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below
+ *
+ * Remote maps, e.g. Cloud Optimised GeoTIFFs, are fetched by blocks of 64 kB
+ * over HTTP. If a cache directory is set, fetched blocks are stored in it and
+ * later reads are served from the local disk. The directory must exist.
+ * Cached blocks are never invalidated, i.e. remote files are assumed to be
+ * immutable. Providing a `NULL` *path* disables the cache, which is the
+ * default.
+ *
+ * __Warnings__
+ *
+ * This function is not thread safe. It must not be called while maps are
+ * being loaded.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_MEMORY_ERROR    Couldn't allocate memory
+ */
+TURTLE_API enum turtle_return turtle_remote_cache_set(const char * path);
+
+/**
+ * Register a custom data format
+ *
+ * @param extension    The file extension of the format, e.g. `"zst"`
+ * @param format       The reader and writer of the format
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below
+ *
+ * Register a reader, and optionally a writer, for files with the given
+ * *extension*. The format is then used by `turtle_map_load`,
+ * `turtle_map_dump` and by stacks of tiles. A copy of *format* is made, yet
+ * its *context* must remain valid as long as the format is used. A built-in
+ * format, or a previously registered one, can be superseded by registering
+ * the same extension again. Providing a `NULL` *format* unregisters a
+ * custom format and restores any built-in one.
+ *
+ * __Warnings__
+ *
+ * This function is not thread safe. It must not be called while maps are
+ * being loaded or dumped.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_BAD_ADDRESS      A callback of the format is `NULL`
+ *
+ *    TURTLE_RETURN_BAD_EXTENSION    The extension is empty or too long
+ *
+ *    TURTLE_RETURN_MEMORY_ERROR     Couldn't allocate memory, or too many
+ * formats are registered
+ */
+TURTLE_API enum turtle_return turtle_io_register(
+    const char * extension, const struct turtle_io_format * format);
+
 /**
  * Transform geodetic coordinates to Cartesian ECEF ones
  *
@@ -574,6 +998,87 @@ TURTLE_API void turtle_ecef_from_horizontal(double latitude, double longitude,
 TURTLE_API void turtle_ecef_to_horizontal(double latitude, double longitude,
     const double direction[3], double * azimuth, double * elevation);
 
+/**
+ * Configure the local frame of an observer
+ *
+ * @param frame        The frame object
+ * @param latitude     The geodetic latitude of the observer
+ * @param longitude    The geodetic longitude of the observer
+ *
+ * Compute the local East, North, Up (ENU) basis vectors at the observer
+ * location. The frame can then be used for converting many directions at
+ * once, without recomputing the basis.
+ */
+TURTLE_API void turtle_ecef_frame_configure(
+    struct turtle_ecef_frame * frame, double latitude, double longitude);
+
+/**
+ * Transform horizontal angles to Cartesian directions in ECEF, for an
+ * observer
+ *
+ * @param frame        The local frame of the observer
+ * @param n            The number of directions
+ * @param azimuth      The geographic azimuth angles
+ * @param elevation    The geographic elevation angles
+ * @param direction    The corresponding directions in ECEF coordinates
+ *
+ * This is a batched version of `turtle_ecef_from_horizontal`. The
+ * *direction* array must be of size 3 *n*.
+ */
+TURTLE_API void turtle_ecef_frame_from_horizontal(
+    const struct turtle_ecef_frame * frame, int n, const double * azimuth,
+    const double * elevation, double * direction);
+
+/**
+ * Transform Cartesian directions in ECEF to horizontal angles, for an
+ * observer
+ *
+ * @param frame        The local frame of the observer
+ * @param n            The number of directions
+ * @param direction    The directions in ECEF coordinates
+ * @param azimuth      The corresponding geographic azimuth angles, or `NULL`
+ * @param elevation    The corresponding geographic elevation angles, or
+ *                       `NULL`
+ *
+ * This is a batched version of `turtle_ecef_to_horizontal`. The *direction*
+ * array must be of size 3 *n*. As for the latter, the angles of null
+ * directions are left unchanged.
+ */
+TURTLE_API void turtle_ecef_frame_to_horizontal(
+    const struct turtle_ecef_frame * frame, int n, const double * direction,
+    double * azimuth, double * elevation);
+
+/**
+ * Transform local Cartesian directions to ECEF ones, for an observer
+ *
+ * @param frame        The local frame of the observer
+ * @param n            The number of directions
+ * @param local        The directions in the East, North, Up frame
+ * @param direction    The corresponding directions in ECEF coordinates
+ *
+ * Both arrays must be of size 3 *n*. Each direction is transformed with a
+ * single matrix-vector product, e.g. for directions sampled in the local
+ * frame.
+ */
+TURTLE_API void turtle_ecef_frame_from_local(
+    const struct turtle_ecef_frame * frame, int n, const double * local,
+    double * direction);
+
+/**
+ * Transform Cartesian directions in ECEF to local ones, for an observer
+ *
+ * @param frame        The local frame of the observer
+ * @param n            The number of directions
+ * @param direction    The directions in ECEF coordinates
+ * @param local        The corresponding directions in the East, North, Up
+ *                       frame
+ *
+ * Both arrays must be of size 3 *n*.
+ */
+TURTLE_API void turtle_ecef_frame_to_local(
+    const struct turtle_ecef_frame * frame, int n, const double * direction,
+    double * local);
+
 /**
  * Create a new stack of global topography data
  *
@@ -590,12 +1095,28 @@ TURTLE_API void turtle_ecef_to_horizontal(double latitude, double longitude,
  * initialised as empty. **Note** that providing a null or negative stack *size*
  * results in all maps being kept in memory.
  *
+ * The *path* can be a directory of elevation tiles or a pack of tiles, as
+ * produced by `turtle_stack_dump`. Packed tiles are loaded with a single read
+ * of the pack file. Within a directory, a `.url` file pointing to a remote
+ * GeoTIFF is loaded as a single tile.
+ *
+ * The *path* can also be the `http://` URL of a GeoTIFF. Then, the internal
+ * tiles of a tiled GeoTIFF, e.g. a Cloud Optimised GeoTIFF, are used as the
+ * stack tiles, such that only the needed ones are fetched. Since stack tiles
+ * share their borders, their size is the closest divisor of the map size to
+ * the size of internal tiles. Thus, a stack tile might overlap a few internal
+ * tiles. The GeoTIFF header is fetched again for each tile, unless a cache is
+ * set with `turtle_remote_cache_set`. A stripped GeoTIFF is used as a single
+ * stack tile.
+ *
  * __Warnings__
  *
  * For multi-threaded access to elevation data, using a `turtle_client` one must
  * provide both a `lock` and `unlock` callback, e.g. based on `sem_wait` and
  * `sem_post`. Otherwise they can be both set to `NULL`. Note that setting only
- * one to not `NULL` raises a `TURTLE_RETURN_BAD_FORMAT` error.
+ * one to not `NULL` raises a `TURTLE_RETURN_BAD_FORMAT` error. Context aware
+ * callbacks, or a built-in reader/writer lock, can be set instead with
+ * `turtle_stack_lock_set` or `turtle_stack_rwlock_enable`.
  *
  * __Error codes__
  *
@@ -606,11 +1127,47 @@ TURTLE_API void turtle_ecef_to_horizontal(double latitude, double longitude,
  * supported
  *
  *    TURTLE_RETURN_MEMORY_ERROR    The stack couldn't be allocated
+ *
+ *    TURTLE_RETURN_PATH_ERROR      The remote GeoTIFF couldn't be fetched
  */
 TURTLE_API enum turtle_return turtle_stack_create(struct turtle_stack ** stack,
     const char * path, int stack_size, turtle_stack_locker_t * lock,
     turtle_stack_locker_t * unlock);
 
+/**
+ * Create a stack over a custom provider of elevation data
+ *
+ * @param stack         The stack object
+ * @param provider      The provider of tiles
+ * @param stack_size    The maximum number of tiles kept in memory
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below
+ *
+ * Allocate memory for a new stack and initialise it, as `turtle_stack_create`.
+ * Instead of data files, tiles are obtained from the *provider* callbacks.
+ * The provider is copied. Its lookup callback is called for every tile of
+ * the grid, in order to map the stack coverage. The fill callback is called
+ * whenever a tile is loaded. Caching, eviction, pinning or spilling of tiles
+ * behave as for data files.
+ *
+ * __Warnings__
+ *
+ * The provider callbacks might be called concurrently from several threads,
+ * e.g. when loading tiles in bulk with `turtle_stack_load` or
+ * `turtle_stack_pin`.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_BAD_ADDRESS     A provider callback is missing
+ *
+ *    TURTLE_RETURN_DOMAIN_ERROR    The provider grid is not valid
+ *
+ *    TURTLE_RETURN_MEMORY_ERROR    The stack couldn't be allocated
+ */
+TURTLE_API enum turtle_return turtle_stack_create_provider(
+    struct turtle_stack ** stack,
+    const struct turtle_stack_provider * provider, int stack_size);
+
 /**
  * Destroy a stack of global topography data
  *
@@ -626,6 +1183,62 @@ TURTLE_API enum turtle_return turtle_stack_create(struct turtle_stack ** stack,
  */
 TURTLE_API void turtle_stack_destroy(struct turtle_stack ** stack);
 
+/**
+ * Set context aware callbacks for managing concurrent accesses to a stack
+ *
+ * @param stack      The stack object
+ * @param lock       A callback for locking critical sections, or `NULL`
+ * @param unlock     A callback for unlocking critical sections, or `NULL`
+ * @param context    A user context forwarded to the callbacks, or `NULL`
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below
+ *
+ * Replace any previous locking scheme of the stack with context aware
+ * callbacks. This allows several stacks to use distinct locks. The callbacks
+ * are provided with the requested access mode. Lookups and reference counts
+ * updates request a shared access while loads and evictions request an
+ * exclusive one. Setting both callbacks to `NULL` disables locking.
+ *
+ * __Warnings__
+ *
+ * This function is not thread safe. It must be called before any
+ * `turtle_client` of the stack is created.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_BAD_ADDRESS     The lock and unlock callbacks are
+ * inconsistent
+ */
+TURTLE_API enum turtle_return turtle_stack_lock_set(
+    struct turtle_stack * stack, turtle_stack_context_locker_t * lock,
+    turtle_stack_context_locker_t * unlock, void * context);
+
+/**
+ * Enable a built-in reader/writer lock for a stack
+ *
+ * @param stack      The stack object
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below
+ *
+ * Replace any previous locking scheme of the stack with a POSIX reader/writer
+ * lock owned by the stack. Shared accesses, e.g. lookups of already loaded
+ * maps, then proceed concurrently. Only loads and evictions are exclusive.
+ *
+ * __Warnings__
+ *
+ * This function is not thread safe. It must be called before any
+ * `turtle_client` of the stack is created.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_LIBRARY_ERROR    The library was built without pthread
+ * support or the lock could not be initialised
+ *
+ *    TURTLE_RETURN_MEMORY_ERROR     The lock couldn't be allocated
+ */
+TURTLE_API enum turtle_return turtle_stack_rwlock_enable(
+    struct turtle_stack * stack);
+
 /**
  * Clear the stack from topography data
  *
@@ -652,16 +1265,150 @@ TURTLE_API enum turtle_return turtle_stack_clear(struct turtle_stack * stack);
  * code is returned as detailed below
  *
  * Load the stack elevation data into memory, until the max stack size is
- * reached or all tiles have been loaded.
+ * reached or all tiles have been loaded. The tiles are read concurrently,
+ * using a pool of threads. The stack lock, if any, is not held while reading,
+ * such that clients are not blocked. Tiles that were successfully read are kept
+ * even if others failed, in which case the first error is returned.
  *
  * __Error codes__
  *
+ *    TURTLE_RETURN_BAD_FORMAT      A tile file format is not supported
+ *
+ *    TURTLE_RETURN_BAD_PATH        A tile file couldn't be found
+ *
  *    TURTLE_RETURN_LOCK_ERROR      The lock couldn't be acquired
  *
+ *    TURTLE_RETURN_MEMORY_ERROR    Couldn't allocate memory
+ *
  *    TURTLE_RETURN_UNLOCK_ERROR    The lock couldn't be released
  */
 TURTLE_API enum turtle_return turtle_stack_load(struct turtle_stack * stack);
 
+/**
+ * Spill evicted stack tiles to a local scratch directory
+ *
+ * @param stack    The stack object
+ * @param path     The path to a scratch directory, or `NULL`
+ * @param size     The maximum number of spilled tiles
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below
+ *
+ * Enable a second tier cache for the stack. Tiles evicted from memory are
+ * written to a private sub-directory of *path*, as decoded raw data. Reloading
+ * a spilled tile then requires a single read of a local file, instead of
+ * reading and decoding the original data. When more than *size* tiles are
+ * spilled, the least recently used ones are removed. Providing a `NULL`
+ * *path*, or a null *size*, disables the second tier cache. Spilled tiles are
+ * removed when the cache is disabled or when the stack is destroyed.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_LOCK_ERROR      The lock couldn't be acquired
+ *
+ *    TURTLE_RETURN_MEMORY_ERROR    Not enough memory
+ *
+ *    TURTLE_RETURN_PATH_ERROR      The scratch directory couldn't be created
+ *
+ *    TURTLE_RETURN_UNLOCK_ERROR    The lock couldn't be released
+ */
+TURTLE_API enum turtle_return turtle_stack_spill_set(
+    struct turtle_stack * stack, const char * path, int size);
+
+/**
+ * Pack the stack tiles to a single file
+ *
+ * @param stack          The stack object
+ * @param path           The path of the pack file
+ * @param compression    The zlib compression level, or `0`
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below
+ *
+ * Write all the tiles of the stack to a single indexed file, which can then
+ * be used as a *path* for `turtle_stack_create`. Tiles are stored with their
+ * original encoding and meta data, and are compressed with zlib if a
+ * *compression* level from 1 to 9 is provided. **Note** that packs use the
+ * native byte order. Thus, they are not portable between little and big
+ * endian systems.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_DOMAIN_ERROR     The compression level is not valid
+ *
+ *    TURTLE_RETURN_LIBRARY_ERROR    zlib is not available
+ *
+ *    TURTLE_RETURN_MEMORY_ERROR     Not enough memory
+ *
+ *    TURTLE_RETURN_PATH_ERROR       The pack file could not be written
+ *
+ *    TURTLE_RETURN_*                Any error raised when loading the tiles
+ */
+TURTLE_API enum turtle_return turtle_stack_dump(
+    struct turtle_stack * stack, const char * path, int compression);
+
+/**
+ * Pin the stack tiles overlapping a geodetic box
+ *
+ * @param stack          The stack object
+ * @param latitude_0     The lower latitude of the box
+ * @param latitude_1     The upper latitude of the box
+ * @param longitude_0    The lower longitude of the box
+ * @param longitude_1    The upper longitude of the box
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below
+ *
+ * Load the elevation data of all tiles overlapping the box, in parallel if
+ * the library was built with pthread support. Pinned tiles are never evicted
+ * from the stack and they do not count in its max size. In addition, they are
+ * read without acquiring the stack lock. Pinning a tile several times
+ * requires as many calls to `turtle_stack_unpin`.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_DOMAIN_ERROR    The box is not valid
+ *
+ *    TURTLE_RETURN_LOCK_ERROR      The lock couldn't be acquired
+ *
+ *    TURTLE_RETURN_MEMORY_ERROR    Not enough memory
+ *
+ *    TURTLE_RETURN_UNLOCK_ERROR    The lock couldn't be released
+ *
+ *    TURTLE_RETURN_*               Any error raised when loading the tiles
+ */
+TURTLE_API enum turtle_return turtle_stack_pin(struct turtle_stack * stack,
+    double latitude_0, double latitude_1, double longitude_0,
+    double longitude_1);
+
+/**
+ * Unpin the stack tiles overlapping a geodetic box
+ *
+ * @param stack          The stack object
+ * @param latitude_0     The lower latitude of the box
+ * @param latitude_1     The upper latitude of the box
+ * @param longitude_0    The lower longitude of the box
+ * @param longitude_1    The upper longitude of the box
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below
+ *
+ * Release tiles previously pinned with `turtle_stack_pin`. Once unpinned,
+ * tiles are managed as any other stack tile and they might be evicted.
+ *
+ * __Warnings__
+ *
+ * Since pinned tiles are read without any lock, this function must not be
+ * called while clients might be accessing the unpinned tiles.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_DOMAIN_ERROR    The box is not valid
+ *
+ *    TURTLE_RETURN_LOCK_ERROR      The lock couldn't be acquired
+ *
+ *    TURTLE_RETURN_UNLOCK_ERROR    The lock couldn't be released
+ */
+TURTLE_API enum turtle_return turtle_stack_unpin(struct turtle_stack * stack,
+    double latitude_0, double latitude_1, double longitude_0,
+    double longitude_1);
+
 /**
  * Get the elevation at geodetic coordinates
  *
@@ -753,6 +1500,44 @@ TURTLE_API enum turtle_return turtle_client_destroy(
 TURTLE_API enum turtle_return turtle_client_clear(
     struct turtle_client * client);
 
+/**
+ * Get the maximum number of maps booked by a client
+ *
+ * @param client    The client object
+ * @return The client's cache size
+ */
+TURTLE_API int turtle_client_cache_get(const struct turtle_client * client);
+
+/**
+ * Set the maximum number of maps booked by a client
+ *
+ * @param client    The client object
+ * @param size      The client's cache size
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below.
+ *
+ * A client books the maps that it uses to its master stack, such that they
+ * are not evicted. The *size* most recently used maps are kept booked, e.g.
+ * the current tile and its recent neighbours. Switching between booked maps
+ * does not require to lock the stack. By default a single map is booked.
+ *
+ * **Note** that booked maps are not counted in the stack size. Thus, the total
+ * number of maps in memory can be up to the stack size plus the sum of all
+ * clients cache sizes.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_DOMAIN_ERROR    The cache size is not strictly positive
+ *
+ *    TURTLE_RETURN_LOCK_ERROR      The lock couldn't be acquired
+ *
+ *    TURTLE_RETURN_MEMORY_ERROR    The cache couldn't be allocated
+ *
+ *    TURTLE_RETURN_UNLOCK_ERROR    The lock couldn't be released
+ */
+TURTLE_API enum turtle_return turtle_client_cache_set(
+    struct turtle_client * client, int size);
+
 /**
  * Thread safe access to the elevation data of a stack
  *
@@ -885,6 +1670,14 @@ TURTLE_API double turtle_stepper_slope_get(
  *
  * Setting a slope factor smaller than one allows to resolve stepper slopes
  * but at the cost of slowing down the stepping. The default value is 0.4.
+ *
+ * A null or negative *slope* factor enables automatic steps instead. Bounds,
+ * *L*, on the topography slopes are computed per block of 16x16 map nodes,
+ * on first use, and including neighbouring blocks. Steps are then
+ * *dh* / sqrt(1 + *L*^2), where *dh* is the vertical distance to the
+ * topography, limited to the horizontal extent of a block. Such steps cannot
+ * cross the topography of the sampled data. The default factor is used for
+ * data without bounds.
  */
 TURTLE_API void turtle_stepper_slope_set(
     struct turtle_stepper * stepper, double slope);
@@ -910,6 +1703,166 @@ TURTLE_API double turtle_stepper_resolution_get(
 TURTLE_API void turtle_stepper_resolution_set(
     struct turtle_stepper * stepper, double resolution);
 
+/**
+ * Enable the auto-tuning of the stepping settings
+ *
+ * @param stepper    The stepper object
+ * @param tuning     The bounds and targets of the tuning, or `NULL`
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below
+ *
+ * When enabled, the local range, the slope factor and the resolution factor
+ * are adapted while stepping, within the provided bounds. Current settings
+ * are first clipped to these bounds.
+ *
+ * The linearisation error of local transforms is estimated whenever
+ * geographic coordinates are computed exactly, beyond the local range, by
+ * comparing them to the extrapolated transform. The local range is then set
+ * such that the estimated error does not exceed the *tolerance*.
+ *
+ * A step overshoots a boundary if it crosses it while being longer than the
+ * resolution. The slope factor is decreased if the fraction of overshooting
+ * steps exceeds the *overshoot* target, and it is increased if none
+ * occurred. The resolution factor is increased if boundary crossings
+ * require many steps of minimum length, and it is decreased otherwise. Both
+ * factors are adapted once per window of 32 steps. Automatic steps, i.e. a
+ * null or negative slope factor, are left untouched.
+ *
+ * The adaptation restarts with each track. That is, tuned settings are
+ * saved with the state of a `turtle_stepper_cursor`, while fresh cursors,
+ * plain `turtle_stepper_step` calls following a cursor, and each track of
+ * `turtle_stepper_run` start from the initial settings. These are the
+ * clipped settings at the call, or the ones explicitly set afterwards. The
+ * initial settings are restored at the end of `turtle_stepper_run`.
+ *
+ * A `NULL` *tuning* disables the auto-tuning. The last tuned settings are
+ * kept.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_DOMAIN_ERROR    Some bounds are invalid
+ */
+TURTLE_API enum turtle_return turtle_stepper_tuning_set(
+    struct turtle_stepper * stepper,
+    const struct turtle_stepper_tuning * tuning);
+
+/**
+ * Report the settings chosen by the auto-tuning
+ *
+ * @param stepper    The stepper object
+ * @param report     The current settings and the tuning statistics
+ *
+ * Statistics are accumulated since the auto-tuning was enabled, including
+ * the tracks stepped by all threads of `turtle_stepper_run`. The reported
+ * settings are the current ones of the stepper, i.e. the tuned ones of the
+ * loaded track, or the initial ones after `turtle_stepper_run`. Only
+ * successful rebuilds of local transforms are counted.
+ */
+TURTLE_API void turtle_stepper_tuning_report(
+    const struct turtle_stepper * stepper,
+    struct turtle_stepper_tuning_report * report);
+
+/**
+ * Get the resolution of the footprint index of the stepper layers
+ *
+ * @param stepper    The stepper object
+ * @return The resolution of the index, in deg, or 0 if disabled
+ */
+TURTLE_API double turtle_stepper_footprint_get(
+    const struct turtle_stepper * stepper);
+
+/**
+ * Set the resolution of the footprint index of the stepper layers
+ *
+ * @param stepper       The stepper object
+ * @param resolution    The resolution of the index, in deg
+ *
+ * By default the data of a layer are evaluated in turn, from the last added
+ * one, until one contains the sample. If *resolution* is strictly positive, a
+ * coarse geodetic grid is built for each layer, indexing the first data
+ * whose bounding box overlaps each cell. The evaluation then starts from
+ * these data, such that a single data set is evaluated in cells that it
+ * fully covers. The index is built on first use, and it is rebuilt if data
+ * are added to the layer. It uses one byte per cell, over the union of the
+ * bounding boxes of the layer data. A null or negative *resolution* disables
+ * the index, which is the default.
+ */
+TURTLE_API void turtle_stepper_footprint_set(
+    struct turtle_stepper * stepper, double resolution);
+
+/**
+ * Get the projection of the stepper local frame
+ *
+ * @param stepper    The stepper object
+ * @return The projection of the local frame, or `NULL` for ECEF
+ */
+TURTLE_API const struct turtle_projection * turtle_stepper_frame_get(
+    const struct turtle_stepper * stepper);
+
+/**
+ * Set a local frame for the stepper positions
+ *
+ * @param stepper       The stepper object
+ * @param projection    The projection of the local frame, or `NULL`
+ * @param origin        The origin of a curved frame, or `NULL`
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below
+ *
+ * By default, positions and directions are given in ECEF. If a *projection*
+ * is provided, they are instead expressed in a local frame. The horizontal
+ * coordinates are the projected ones, and the vertical coordinate is the
+ * height above the topography vertical datum. Maps sharing the frame
+ * *projection* are then looked up directly, without any geodetic computation.
+ * Geodetic coordinates are only computed for other data, or if they are
+ * requested at output. Note that no geoid correction is applied in a local
+ * frame.
+ *
+ * If *origin* is `NULL`, the ground is flat. Otherwise *origin* must be a
+ * size 2 array with the projected coordinates of the tangent point of a
+ * Cartesian frame. Altitudes are then corrected for the Earth curvature,
+ * using the Gaussian radius at the *origin*. Providing a `NULL` *projection*
+ * restores ECEF positions. The projection is copied, thus it can be
+ * destroyed afterwards.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_BAD_PROJECTION    The projection is not configured
+ */
+TURTLE_API enum turtle_return turtle_stepper_frame_set(
+    struct turtle_stepper * stepper,
+    const struct turtle_projection * projection, const double * origin);
+
+/**
+ * Get the floating point precision of the stepping computations
+ *
+ * @param stepper    The stepper object
+ * @return The precision of the computations
+ */
+TURTLE_API enum turtle_stepper_precision turtle_stepper_precision_get(
+    const struct turtle_stepper * stepper);
+
+/**
+ * Set the floating point precision of the stepping computations
+ *
+ * @param stepper      The stepper object
+ * @param precision    The precision of the computations
+ *
+ * By default all computations are done in double precision. In single
+ * precision, the offsets w.r.t. local linear approximations, see
+ * `turtle_stepper_range_set`, and the transforms coefficients are stored as
+ * `float`, and map elevations are interpolated in `float`. Reference
+ * coordinates, the location of map cells and any computation beyond the
+ * local *range* remain in double precision.
+ *
+ * The additional error on local transforms is bounded by 5E-07 times the
+ * local *range*, in m for altitudes or in projected coordinates, and by
+ * 5E-12 deg per m of *range* for geodetic angles. The additional error on
+ * interpolated map elevations is bounded by 5E-07 times the largest
+ * absolute elevation of the interpolation cell, e.g. 5 mm at 10 km.
+ */
+TURTLE_API void turtle_stepper_precision_set(struct turtle_stepper * stepper,
+    enum turtle_stepper_precision precision);
+
 /**
  * Add a new topography layer for the stepper
  *
@@ -1046,7 +1999,9 @@ TURTLE_API enum turtle_return turtle_stepper_add_flat(
  *
  * Note that any of the output data can point to `NULL` if it is of no interest.
  * Note also that depending of the set local *range*, an approximation might be
- * used for computing geographic coordinates.
+ * used for computing geographic coordinates. If a local frame is set, see
+ * `turtle_stepper_frame_set`, *position* and *direction* are expressed in this
+ * frame instead of ECEF.
  *
  * __Error codes__
  *
@@ -1071,7 +2026,8 @@ enum turtle_return turtle_stepper_step(struct turtle_stepper * stepper,
  * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
  * code is returned as detailed below
  *
- * Inspect the stepper's geometry layer and provide the top most ECEF position.
+ * Inspect the stepper's geometry layer and provide the top most ECEF position,
+ * or the position in the local frame if set.
  * If no valid meta-data was found a negative *data_index* value is returned,
  * or an error is raised if *data_index* points to `NULL`.
  *
@@ -1084,6 +2040,178 @@ enum turtle_return turtle_stepper_position(struct turtle_stepper * stepper,
     double latitude, double longitude, double height, int layer_index,
     double * position, int * data_index);
 
+/**
+ * Create a cursor for stepping a track
+ *
+ * @param stepper   The stepper object
+ * @param cursor    A handle to the cursor
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below
+ *
+ * A cursor holds the stepping state of a track, i.e. the last sample and the
+ * local transforms of the stepper, see `turtle_stepper_range_set`. Thus,
+ * several tracks can be interleaved on a single stepper, e.g. by an event
+ * based engine, without losing their local frames. Switching between
+ * cursors only copies their states in and out of the stepper.
+ *
+ * **Note** that the cursor must be destroyed before its stepper. A cursor
+ * must not be used concurrently with its stepper, by different threads.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_MEMORY_ERROR    The cursor couldn't be allocated
+ */
+TURTLE_API enum turtle_return turtle_stepper_cursor_create(
+    struct turtle_stepper * stepper, struct turtle_stepper_cursor ** cursor);
+
+/**
+ * Destroy a stepper cursor
+ *
+ * @param cursor    A handle to the cursor
+ *
+ * Fully destroy a cursor previously created with
+ * `turtle_stepper_cursor_create`. On return `cursor` is set to `NULL`.
+ */
+TURTLE_API void turtle_stepper_cursor_destroy(
+    struct turtle_stepper_cursor ** cursor);
+
+/**
+ * Compute (or do) a step through the topography for the track of a cursor
+ *
+ * @param cursor               The cursor of the track
+ * @param position             The initial (final) ECEF position
+ * @param direction            The initial direction in ECEF, or `NULL`
+ * @param latitude             The initial (final) geodetic latitude
+ * @param longitude            The initial (final) geodetic longitude
+ * @param altitude             The initial (final) geodetic altitude
+ * @param elevation            The initial (final) topography elevation(s)
+ * @param step_length          The step length
+ * @param index                The initial (final) topography and/or meta-data
+ *                               indices
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below
+ *
+ * This function is equivalent to `turtle_stepper_step` but it uses the
+ * stepping state of the *cursor*. The state of the previously used cursor is
+ * saved beforehand. Calling `turtle_stepper_step` directly resumes from a
+ * fresh state. The saved states are discarded if the stepper settings are
+ * modified, or if data are added.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_DOMAIN_ERROR    The provided position is outside of all
+ * data
+ */
+TURTLE_API enum turtle_return turtle_stepper_cursor_step(
+    struct turtle_stepper_cursor * cursor, double * position,
+    const double * direction, double * latitude, double * longitude,
+    double * altitude, double * elevation, double * step_length, int * index);
+
+/**
+ * Step a batch of tracks through the topography, using several threads
+ *
+ * @param stepper     The stepper object
+ * @param n           The number of tracks
+ * @param tracks      The tracks
+ * @param threads     The number of threads
+ * @param monitor     A callback for monitoring the tracks, or `NULL`
+ * @param context     A user supplied context for the monitor
+ * @param crossings   Flag for monitoring only changes of topography layer
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below
+ *
+ * Each track is stepped along a straight line, starting from its initial
+ * *position* and *direction*, until it exits all data, its maximum *length*
+ * is reached or the *monitor* returns a non zero value. At return, the final
+ * *position*, the travelled *length*, the final *index* and the number of
+ * *steps* are filled in. Tracks starting outside of all data are left
+ * unchanged, with a negative `index[0]`. Tracks without a maximum *length*
+ * require a *monitor* for stopping them, since they might stay within the
+ * topography forever, e.g. going upwards above the top layer.
+ *
+ * The tracks are initially split among threads in contiguous ranges. Idle
+ * threads then steal half of the pending tracks of the most loaded thread.
+ * The calling thread uses the provided *stepper*, while other threads use
+ * private copies of it, with their own history and stack clients. Thus,
+ * stacks with a lock are shared among threads. If the stepper uses a stack
+ * without any lock, or if the library was built without pthreads, the tracks
+ * are stepped by the calling thread only. The history is reset at the start
+ * of each track, such that the results do not depend on the scheduling.
+ *
+ * If a *monitor* is provided, it is called after each step, or only when the
+ * topography layer changes if *crossings* is non zero.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_BAD_ADDRESS     The tracks are `NULL`
+ *
+ *    TURTLE_RETURN_DOMAIN_ERROR    A track has no maximum length and no
+ * monitor is provided
+ *
+ *    TURTLE_RETURN_MEMORY_ERROR    Some memory could not be allocated
+ *
+ * Any error raised by `turtle_stepper_step` might be returned as well. Then,
+ * all threads are stopped and the remaining tracks are left unfinished.
+ */
+TURTLE_API enum turtle_return turtle_stepper_run(
+    struct turtle_stepper * stepper, int n,
+    struct turtle_stepper_track * tracks, int threads,
+    turtle_stepper_monitor_t * monitor, void * context, int crossings);
+
+/**
+ * Start recording trace events
+ *
+ * @param capacity    The maximum number of events recorded per thread
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below
+ *
+ * Record timestamped events per thread, e.g. stack tile loads and lock
+ * waits, see `turtle_trace_event`. Events are written to a ring of
+ * *capacity* records per thread, without any lock. When a ring is full the
+ * oldest events are overwritten. Any previous record is discarded. A null
+ * *capacity* releases all records and leaves the tracing disabled, which is
+ * the default.
+ *
+ * **Warning** : this function must not be called concurrently with any
+ * traced operation.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_DOMAIN_ERROR    The capacity is negative
+ */
+TURTLE_API enum turtle_return turtle_trace_start(int capacity);
+
+/**
+ * Stop recording trace events
+ *
+ * The recorded events are kept, e.g. for a dump.
+ */
+TURTLE_API void turtle_trace_stop(void);
+
+/**
+ * Dump the recorded trace events to a file
+ *
+ * @param path    The path of the file
+ * @return On success `TURTLE_RETURN_SUCCESS` is returned otherwise an error
+ * code is returned as detailed below
+ *
+ * If *path* has a `.json` extension, events are exported in the Chrome trace
+ * format, with timestamps in micro seconds. Otherwise a compact binary format
+ * is used, in native byte order. It starts with a null terminated
+ * `TURTLE-TRACE-1` tag followed by the events. An event is given by its time
+ * in ns (`uint64_t`), its thread index (`int32_t`), its type (`uint8_t`),
+ * its phase (`B`, `E` or `i` char), the length of its label (`uint16_t`) and
+ * the label chars.
+ *
+ * **Warning** : the dump should be done once traced operations are done.
+ * Otherwise the latest events might be inconsistent.
+ *
+ * __Error codes__
+ *
+ *    TURTLE_RETURN_PATH_ERROR    The file could not be written
+ */
+TURTLE_API enum turtle_return turtle_trace_dump(const char * path);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2017 Université Clermont Auvergne, CNRS/IN2P3, LPC
+ * Author: Valentin NIESS (niess@in2p3.fr)
+ *
+ * Topographic Utilities for tRansporting parTicules over Long rangEs (TURTLE)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef TURTLE_INLINE_H
+#define TURTLE_INLINE_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* TURTLE library */
+#include "turtle.h"
+
+/**
+ * Encoding of the raw elevation values of a map
+ */
+enum turtle_map_encoding {
+        /** Unsigned 16 bit values, in host byte order */
+        TURTLE_MAP_ENCODING_UINT16 = 0,
+        /** Unsigned 16 bit values, in big endian byte order */
+        TURTLE_MAP_ENCODING_UINT16_BE,
+        /** Signed 16 bit values, in host byte order */
+        TURTLE_MAP_ENCODING_INT16,
+        /** Signed 16 bit values, in big endian byte order */
+        TURTLE_MAP_ENCODING_INT16_BE
+};
+
+/**
+ * Read-only access to the raw elevation data of a map
+ */
+struct turtle_map_data {
+        /** The raw value of the south-west node */
+        const uint16_t * data;
+        /** The offset between rows of nodes, which might be negative */
+        int stride;
+        /** Number of nodes along X */
+        int nx;
+        /** Number of nodes along Y */
+        int ny;
+        /** X coordinate of the south-west node */
+        double x0;
+        /** Y coordinate of the south-west node */
+        double y0;
+        /** Spacing of nodes along X */
+        double dx;
+        /** Spacing of nodes along Y */
+        double dy;
+        /** Elevation offset of decoded values */
+        double z0;
+        /** Elevation scale of decoded values */
+        double dz;
+        /** Encoding of raw values */
+        enum turtle_map_encoding encoding;
+};
+
+/**
+ * Get a read-only access to the raw elevation data of a map
+ *
+ * @param map     Handle to the map
+ * @param data    The raw elevation data
+ *
+ * The raw data can be used with the inline functions below, which can be
+ * fully inlined by the compiler, e.g. in hot loops. The elevation of node
+ * (ix, iy) is `data->z0 + data->dz * v` where `v` is the decoded raw value
+ * at index `iy * data->stride + ix`.
+ *
+ * **Warning** : the raw data are invalidated if the map is destroyed. They
+ * must not be used concurrently with `turtle_map_fill`. The raw data of a
+ * stack tile are only valid as long as the tile is reserved, e.g. by a
+ * stack client.
+ */
+TURTLE_API void turtle_map_data_get(
+    const struct turtle_map * map, struct turtle_map_data * data);
+
+/**
+ * Get the elevation of a node of the raw data of a map
+ *
+ * @param data    The raw elevation data
+ * @param ix      The node index along X
+ * @param iy      The node index along Y
+ * @return The elevation at the node
+ *
+ * No bound check is performed on the indices.
+ */
+static inline double turtle_map_data_node(
+    const struct turtle_map_data * data, int ix, int iy)
+{
+        const uint16_t * raw = data->data + iy * data->stride + ix;
+        const unsigned char * bytes = (const unsigned char *)raw;
+        switch (data->encoding) {
+        case TURTLE_MAP_ENCODING_UINT16_BE:
+                return data->z0 +
+                    (uint16_t)((bytes[0] << 8) | bytes[1]) * data->dz;
+        case TURTLE_MAP_ENCODING_INT16:
+                return data->z0 + (int16_t)(*raw) * data->dz;
+        case TURTLE_MAP_ENCODING_INT16_BE:
+                return data->z0 +
+                    (int16_t)((bytes[0] << 8) | bytes[1]) * data->dz;
+        default:
+                return data->z0 + (*raw) * data->dz;
+        }
+}
+
+/**
+ * Interpolate the elevation from the raw data of a map
+ *
+ * @param data    The raw elevation data
+ * @param x       The X-coordinate of the point
+ * @param y       The Y-coordinate of the point
+ * @param z       The interpolated elevation
+ * @return `1` if the point is inside the map, `0` otherwise
+ *
+ * Interpolate the elevation at the given map coordinates using a bilinear
+ * interpolation, as `turtle_map_elevation`. The results are identical.
+ */
+static inline int turtle_map_data_elevation(
+    const struct turtle_map_data * data, double x, double y, double * z)
+{
+        double hx = (x - data->x0) / data->dx;
+        double hy = (y - data->y0) / data->dy;
+        if ((hx > data->nx - 1) || (hx < 0) || (hy > data->ny - 1) ||
+            (hy < 0))
+                return 0;
+        int ix = (int)hx;
+        int iy = (int)hy;
+        if (ix == data->nx - 1) {
+                ix--;
+                hx = 1.;
+        } else
+                hx -= ix;
+        if (iy == data->ny - 1) {
+                iy--;
+                hy = 1.;
+        } else
+                hy -= iy;
+
+        const double z00 = turtle_map_data_node(data, ix, iy);
+        const double z10 = turtle_map_data_node(data, ix + 1, iy);
+        const double z01 = turtle_map_data_node(data, ix, iy + 1);
+        const double z11 = turtle_map_data_node(data, ix + 1, iy + 1);
+        *z = z00 * (1. - hx) * (1. - hy) + z01 * (1. - hx) * hy +
+            z10 * hx * (1. - hy) + z11 * hx * hy;
+        return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -23,6 +23,8 @@ extern "C" {
 #define     PLANARCONFIG_CONTIG         1       /* single image plane */
 #define TIFFTAG_RESOLUTIONUNIT          296     /* units of resolutions */
 #define     RESUNIT_NONE                1       /* no meaningful units */
+#define TIFFTAG_TILEWIDTH               322     /* !tile width in pixels */
+#define TIFFTAG_TILELENGTH              323     /* !tile height in pixels */
 
 typedef struct tiff TIFF;
 typedef void (*TIFFErrorHandler) (const char *, const char *, va_list);
@@ -59,6 +61,14 @@ typedef tstrile_t tstrip_t;     /* strip number */
 typedef tstrile_t ttile_t;      /* tile number */
 typedef tmsize_t tsize_t;       /* i/o size in bytes */
 typedef void * tdata_t;         /* image data ref */
+typedef void * thandle_t;       /* client data handle */
+
+typedef tmsize_t (*TIFFReadWriteProc)(thandle_t, void *, tmsize_t);
+typedef toff_t (*TIFFSeekProc)(thandle_t, toff_t, int);
+typedef int (*TIFFCloseProc)(thandle_t);
+typedef toff_t (*TIFFSizeProc)(thandle_t);
+typedef int (*TIFFMapFileProc)(thandle_t, void ** base, toff_t * size);
+typedef void (*TIFFUnmapFileProc)(thandle_t, void * base, toff_t size);
 
 typedef enum {
         TIFF_NOTYPE = 0,      /* placeholder */
@@ -22,7 +22,6 @@
  * Turtle client for multithreaded access to a elevation data handled by a
  * turtle_stack.
  */
-#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -33,7 +32,8 @@
 
 /* Management routine(s) */
 static enum turtle_return client_release(struct turtle_client * client,
-    int lock, struct turtle_error_context * error_);
+    int lock, enum turtle_stack_access access, int keep,
+    struct turtle_error_context * error_);
 
 /* Create a new stack client */
 enum turtle_return turtle_client_create(
@@ -47,7 +47,7 @@ enum turtle_return turtle_client_create(
                 return TURTLE_ERROR_MESSAGE(
                     TURTLE_RETURN_BAD_ADDRESS, "invalid null stack");
         }
-        else if (stack->lock == NULL) {
+        else if (!turtle_stack_has_lock_(stack)) {
                 return TURTLE_ERROR_MESSAGE(
                     TURTLE_RETURN_BAD_ADDRESS, "stack has no lock");
         }
@@ -55,10 +55,15 @@ enum turtle_return turtle_client_create(
         /* Allocate the new client and initialise it. */
         *client = malloc(sizeof(**client));
         if (*client == NULL) return TURTLE_ERROR_MEMORY();
+        (*client)->maps = malloc(sizeof(*(*client)->maps));
+        if ((*client)->maps == NULL) {
+                free(*client);
+                *client = NULL;
+                return TURTLE_ERROR_MEMORY();
+        }
         (*client)->stack = stack;
-        (*client)->map = NULL;
-        (*client)->index_la = INT_MIN;
-        (*client)->index_lo = INT_MIN;
+        (*client)->size = 0;
+        (*client)->cache_size = 1;
 
         return TURTLE_RETURN_SUCCESS;
 }
@@ -71,10 +76,12 @@ enum turtle_return turtle_client_destroy_(
         if ((client == NULL) || (*client == NULL)) return TURTLE_RETURN_SUCCESS;
 
         /* Release any active map */
-        if (client_release(*client, 1, error_) != TURTLE_RETURN_SUCCESS)
+        if (client_release(*client, 1, TURTLE_STACK_ACCESS_SHARED, 0,
+                error_) != TURTLE_RETURN_SUCCESS)
                 return TURTLE_ERROR_RAISE();
 
         /* Free the memory and return */
+        free((*client)->maps);
         free(*client);
         *client = NULL;
 
@@ -91,10 +98,41 @@ enum turtle_return turtle_client_destroy(struct turtle_client ** client)
 enum turtle_return turtle_client_clear(struct turtle_client * client)
 {
         TURTLE_ERROR_INITIALISE(&turtle_client_clear);
-        client_release(client, 1, error_);
+        client_release(client, 1, TURTLE_STACK_ACCESS_SHARED, 0, error_);
         return TURTLE_ERROR_RAISE();
 }
 
+/* Get the maximum number of maps booked by the client */
+int turtle_client_cache_get(const struct turtle_client * client)
+{
+        return client->cache_size;
+}
+
+/* Set the maximum number of maps booked by the client */
+enum turtle_return turtle_client_cache_set(
+    struct turtle_client * client, int size)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_client_cache_set);
+        if (size < 1) {
+                return TURTLE_ERROR_MESSAGE(
+                    TURTLE_RETURN_DOMAIN_ERROR, "invalid cache size");
+        }
+
+        /* Release the least recently used maps, if needed */
+        if ((client->size > size) && (client_release(client, 1,
+            TURTLE_STACK_ACCESS_SHARED, size, error_) != TURTLE_RETURN_SUCCESS))
+                return TURTLE_ERROR_RAISE();
+
+        /* Resize the cache */
+        struct turtle_map ** maps =
+            realloc(client->maps, size * sizeof(*client->maps));
+        if (maps == NULL) return TURTLE_ERROR_MEMORY();
+        client->maps = maps;
+        client->cache_size = size;
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
 /* Supervised access to the elevation data */
 enum turtle_return turtle_client_elevation(struct turtle_client * client,
     double latitude, double longitude, double * elevation, int * inside)
@@ -102,20 +140,31 @@ enum turtle_return turtle_client_elevation(struct turtle_client * client,
         TURTLE_ERROR_INITIALISE(&turtle_client_elevation);
         if (inside != NULL) *inside = 0;
 
-        /* Get the proper map */
-        struct turtle_map * current = client->map;
-        double hx = 0., hy = 0.; /* Patch a non relevant warning */
-
-        if (current != NULL) {
-                /* First let's check the current map */
+        /* First let's check the booked maps. No lock is needed since these
+         * maps cannot be evicted by the stack
+         */
+        struct turtle_map * current;
+        double hx, hy;
+        int i;
+        for (i = 0; i < client->size; i++) {
+                current = client->maps[i];
                 hx = (longitude - current->meta.x0) / current->meta.dx;
                 hy = (latitude - current->meta.y0) / current->meta.dy;
-
                 if ((hx >= 0.) && (hx < current->meta.nx - 1) && (hy >= 0.) &&
-                    (hy < current->meta.ny - 1))
+                    (hy < current->meta.ny - 1)) {
+                        /* Move the map to the top of the client's cache */
+                        if (i > 0) {
+                                memmove(client->maps + 1, client->maps,
+                                    i * sizeof(*client->maps));
+                                client->maps[0] = current;
+                        }
                         goto interpolate;
-        } else if (((int)latitude == client->index_la) &&
-            ((int)longitude == client->index_lo)) {
+                }
+        }
+
+        /* Check the stack coverage. No lock is needed for this */
+        struct turtle_stack * stack = client->stack;
+        if (!turtle_stack_covers_(stack, latitude, longitude)) {
                 if (inside != NULL) {
                         return TURTLE_RETURN_SUCCESS;
                 } else {
@@ -123,57 +172,77 @@ enum turtle_return turtle_client_elevation(struct turtle_client * client,
                 }
         }
 
-        /* Lock the stack */
-        struct turtle_stack * stack = client->stack;
-        if ((stack->lock != NULL) && (stack->lock() != 0))
+        /* Check the pinned maps. No lock is needed either since these maps
+         * are never evicted
+         */
+        current = turtle_stack_pinned_(stack, latitude, longitude);
+        if (current != NULL) {
+                hx = (longitude - current->meta.x0) / current->meta.dx;
+                hy = (latitude - current->meta.y0) / current->meta.dy;
+                if ((hx >= 0.) && (hx < current->meta.nx - 1) && (hy >= 0.) &&
+                    (hy < current->meta.ny - 1))
+                        goto interpolate;
+        }
+
+        /* Lock the stack. A shared access is requested first */
+        enum turtle_stack_access access = TURTLE_STACK_ACCESS_SHARED;
+lock:
+        if (turtle_stack_lock_(stack, access) != 0)
                 return TURTLE_ERROR_LOCK();
+        const int exclusive = turtle_stack_is_exclusive_(stack, access);
 
-        /* The requested coordinates are not in the current map. Let's check
+        /* The requested coordinates are not in the booked maps. Let's check
          * the full stack
          */
         current = stack->tiles.head;
         while (current != NULL) {
-                if (current == client->map) {
-                        current = current->element.next;
-                        continue;
-                }
                 hx = (longitude - current->meta.x0) / current->meta.dx;
                 hy = (latitude - current->meta.y0) / current->meta.dy;
                 if ((hx >= 0.) && (hx < current->meta.nx - 1) && (hy >= 0.) &&
                     (hy < current->meta.ny - 1)) {
-                        turtle_stack_touch_(stack, current);
+                        /* Reordering the stack requires an exclusive
+                         * access. Otherwise, the map is left in place
+                         */
+                        if (exclusive) turtle_stack_touch_(stack, current);
                         if (inside != NULL) *inside = 1;
                         goto update;
                 }
                 current = current->element.next;
         }
 
+        if (!exclusive) {
+                /* Loading a new map requires an exclusive access. Note that
+                 * another client might load the map in the meantime. Thus,
+                 * the stack is checked again
+                 */
+                if (turtle_stack_unlock_(stack, access) != 0)
+                        return TURTLE_ERROR_UNLOCK();
+                access = TURTLE_STACK_ACCESS_EXCLUSIVE;
+                goto lock;
+        }
+
         /* No valid map was found. Let's try to load it */
         if ((turtle_stack_load_(stack, latitude, longitude, inside, error_) !=
                 TURTLE_RETURN_SUCCESS) ||
-            ((inside != NULL) && (*inside == 0))) {
-                /* The requested map is not available. Let's record this */
-                client_release(client, 0, error_);
-                client->index_la = (int)latitude;
-                client->index_lo = (int)longitude;
+            ((inside != NULL) && (*inside == 0)))
                 goto unlock;
-        }
         current = stack->tiles.head;
-        hx = (longitude - current->meta.x0) / current->meta.dx;
-        hy = (latitude - current->meta.y0) / current->meta.dy;
 
 /* Update the client */
 update:
-        if (client_release(client, 0, error_) != TURTLE_RETURN_SUCCESS)
+        if ((client->size == client->cache_size) &&
+            (client_release(client, 0, access, client->size - 1, error_) !=
+                TURTLE_RETURN_SUCCESS))
                 goto unlock;
-        current->clients++;
-        client->map = current;
-        client->index_la = INT_MIN;
-        client->index_lo = INT_MIN;
+        __sync_fetch_and_add(&current->clients, 1);
+        memmove(client->maps + 1, client->maps,
+            client->size * sizeof(*client->maps));
+        client->maps[0] = current;
+        client->size++;
 
 /* Unlock the stack */
 unlock:
-        if ((stack->unlock != NULL) && (stack->unlock() != 0))
+        if (turtle_stack_unlock_(stack, access) != 0)
                 return TURTLE_ERROR_UNLOCK();
         if ((error_->code != TURTLE_RETURN_SUCCESS) ||
             ((inside != NULL) && (*inside == 0))) {
@@ -184,39 +253,48 @@ unlock:
 /* Interpolate the elevation */
 interpolate:
         return turtle_map_elevation_(
-            client->map, longitude, latitude, elevation, inside, error_);
+            current, longitude, latitude, elevation, inside, error_);
 }
 
-/* Release any active map */
+/* Release the least recently used maps, keeping only the `keep` first ones */
 static enum turtle_return client_release(struct turtle_client * client,
-    int lock, struct turtle_error_context * error_)
+    int lock, enum turtle_stack_access access, int keep,
+    struct turtle_error_context * error_)
 {
-        if (client->map == NULL) return TURTLE_RETURN_SUCCESS;
+        if (client->size <= keep) return TURTLE_RETURN_SUCCESS;
 
         /* Lock the stack */
         struct turtle_stack * stack = client->stack;
-        if (lock && (stack->lock != NULL) && (stack->lock() != 0))
+        if (lock && (turtle_stack_lock_(stack, access) != 0))
                 return TURTLE_ERROR_REGISTER(
                     TURTLE_RETURN_LOCK_ERROR, "could not acquire the lock");
 
-        /* Update the reference count */
-        struct turtle_map * map = client->map;
-        client->map = NULL;
-        map->clients--;
-        if (map->clients < 0) {
-                map->clients = 0;
-                TURTLE_ERROR_REGISTER(
-                    TURTLE_RETURN_LIBRARY_ERROR, "an unexpected error occured");
-                goto unlock;
-        }
+        while (client->size > keep) {
+                /* Update the reference count. Note that concurrent updates
+                 * might occur with a shared access
+                 */
+                struct turtle_map * map = client->maps[--client->size];
+                const int clients = __sync_sub_and_fetch(&map->clients, 1);
+                if (clients < 0) {
+                        __sync_fetch_and_add(&map->clients, 1);
+                        TURTLE_ERROR_REGISTER(TURTLE_RETURN_LIBRARY_ERROR,
+                            "an unexpected error occured");
+                        goto unlock;
+                }
 
-        /* Remove the map if it is unused and if there is a stack overflow */
-        if ((map->clients == 0) && (stack->tiles.size > stack->max_size))
-                turtle_map_destroy(&map);
+                /* Remove the map if it is unused and if there is a stack
+                 * overflow. This requires an exclusive access. Otherwise, the
+                 * map is left for a later eviction
+                 */
+                if ((clients == 0) && (map->pinned == 0) &&
+                    (stack->tiles.size - stack->pinned_n > stack->max_size) &&
+                    turtle_stack_is_exclusive_(stack, access))
+                        turtle_stack_drop_(stack, map);
+        }
 
 /* Unlock and return */
 unlock:
-        if (lock && (stack->unlock != NULL) && (stack->unlock() != 0))
+        if (lock && (turtle_stack_unlock_(stack, access) != 0))
                 return TURTLE_ERROR_REGISTER(
                     TURTLE_RETURN_UNLOCK_ERROR, "could not release the lock");
         return error_->code;
@@ -30,11 +30,10 @@
 
 /* Container for a stack client */
 struct turtle_client {
-        /* The currently used map */
-        struct turtle_map * map;
-
-        /* The last requested indices */
-        int index_la, index_lo;
+        /* The booked maps, from the most to the least recently used */
+        struct turtle_map ** maps;
+        int size;
+        int cache_size;
 
         /* The master stack */
         struct turtle_stack * stack;
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2017 Université Clermont Auvergne, CNRS/IN2P3, LPC
+ * Author: Valentin NIESS (niess@in2p3.fr)
+ *
+ * Topographic Utilities for tRansporting parTicules over Long rangEs (TURTLE)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/*
+ * Runtime binding to zlib for (de)compressing elevation data
+ */
+
+/* C89 standard library */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef TURTLE_NO_ZLIB
+#ifndef TURTLE_NO_LD
+/* Dynamic libraries */
+#include <dlfcn.h>
+#endif
+/* zlib library */
+#ifndef TURTLE_NO_LD
+#include "deps/zlib.h"
+#else
+#include <zlib.h>
+#endif
+#endif
+/* TURTLE library */
+#include "turtle/compress.h"
+
+#ifndef TURTLE_NO_ZLIB
+/* zlib API */
+static struct {
+        void * lib;
+
+        int (*compress2) (Bytef *, uLongf *, const Bytef *, uLong, int);
+        uLong (*compressBound) (uLong);
+        int (*uncompress) (Bytef *, uLongf *, const Bytef *, uLong);
+        int (*inflateInit2_) (z_streamp, int, const char *, int);
+        int (*inflate) (z_streamp, int);
+        int (*inflateEnd) (z_streamp);
+} api = { NULL };
+
+static enum turtle_return api_initialise(struct turtle_error_context * error_)
+{
+#ifndef TURTLE_NO_LD
+#ifdef __APPLE__
+#define SOEXT "dylib"
+#else
+#define SOEXT "so"
+#endif
+        if (api.lib != NULL)
+                return TURTLE_RETURN_SUCCESS;
+
+        api.lib = dlopen("libz." SOEXT, RTLD_LAZY);
+        if (api.lib == NULL) api.lib = dlopen("libz." SOEXT ".1", RTLD_LAZY);
+        if (api.lib == NULL) {
+                return TURTLE_ERROR_REGISTER(
+                    TURTLE_RETURN_PATH_ERROR, dlerror());
+        }
+
+#define LINK(NAME)                                                             \
+        if ((api. NAME = dlsym(api.lib, #NAME)) == NULL)                       \
+                goto error
+#else
+        static int initialised = 0;
+        if (initialised) return TURTLE_RETURN_SUCCESS;
+        initialised = 1;
+
+#define LINK(NAME) api. NAME = &NAME
+#endif
+
+        LINK(compress2);
+        LINK(compressBound);
+        LINK(uncompress);
+        LINK(inflateInit2_);
+        LINK(inflate);
+        LINK(inflateEnd);
+
+        return TURTLE_RETURN_SUCCESS;
+
+#ifndef TURTLE_NO_LD
+error:
+        dlclose(api.lib);
+        api.lib = NULL;
+        return TURTLE_ERROR_REGISTER(TURTLE_RETURN_BAD_FORMAT, dlerror());
+
+#undef LINK
+#undef SOEXT
+#endif
+}
+#endif
+
+/* Compress a buffer. The compressed data are allocated with `malloc` */
+enum turtle_return turtle_compress_(const void * src, unsigned long size,
+    int level, void ** dst, unsigned long * dst_size,
+    struct turtle_error_context * error_)
+{
+        *dst = NULL;
+        *dst_size = 0;
+#ifdef TURTLE_NO_ZLIB
+        return TURTLE_ERROR_REGISTER(
+            TURTLE_RETURN_LIBRARY_ERROR, "no zlib support");
+#else
+        if (api_initialise(error_) != TURTLE_RETURN_SUCCESS)
+                return error_->code;
+
+        uLongf n = api.compressBound(size);
+        *dst = malloc(n);
+        if (*dst == NULL) {
+                return TURTLE_ERROR_REGISTER(
+                    TURTLE_RETURN_MEMORY_ERROR, "could not allocate memory");
+        }
+        if (api.compress2(*dst, &n, src, size, level) != Z_OK) {
+                free(*dst);
+                *dst = NULL;
+                return TURTLE_ERROR_REGISTER(
+                    TURTLE_RETURN_LIBRARY_ERROR, "could not compress data");
+        }
+        *dst_size = n;
+
+        return TURTLE_RETURN_SUCCESS;
+#endif
+}
+
+/* Uncompress a buffer of known uncompressed size */
+enum turtle_return turtle_uncompress_(const void * src, unsigned long size,
+    void * dst, unsigned long dst_size, struct turtle_error_context * error_)
+{
+#ifdef TURTLE_NO_ZLIB
+        return TURTLE_ERROR_REGISTER(
+            TURTLE_RETURN_LIBRARY_ERROR, "no zlib support");
+#else
+        if (api_initialise(error_) != TURTLE_RETURN_SUCCESS)
+                return error_->code;
+
+        uLongf n = dst_size;
+        if ((api.uncompress(dst, &n, src, size) != Z_OK) || (n != dst_size)) {
+                return TURTLE_ERROR_REGISTER(
+                    TURTLE_RETURN_BAD_FORMAT, "corrupted compressed data");
+        }
+
+        return TURTLE_RETURN_SUCCESS;
+#endif
+}
+
+/* Inflate a raw deflate stream of known uncompressed size from a file. The
+ * data are read by chunks, such that no compressed copy is held in memory
+ */
+enum turtle_return turtle_inflate_(FILE * stream, unsigned long size,
+    void * dst, unsigned long dst_size, struct turtle_error_context * error_)
+{
+#ifdef TURTLE_NO_ZLIB
+        return TURTLE_ERROR_REGISTER(
+            TURTLE_RETURN_LIBRARY_ERROR, "no zlib support");
+#else
+        if (api_initialise(error_) != TURTLE_RETURN_SUCCESS)
+                return error_->code;
+
+        z_stream strm;
+        memset(&strm, 0x0, sizeof(strm));
+        if (api.inflateInit2_(&strm, -15, ZLIB_VERSION, (int)sizeof(strm)) !=
+            Z_OK) {
+                return TURTLE_ERROR_REGISTER(
+                    TURTLE_RETURN_LIBRARY_ERROR, "could not initialise zlib");
+        }
+        strm.next_out = dst;
+        strm.avail_out = dst_size;
+
+        unsigned char chunk[16384];
+        int rc = Z_OK;
+        while ((rc == Z_OK) && (size > 0)) {
+                const size_t n =
+                    (size > sizeof(chunk)) ? sizeof(chunk) : size;
+                if (fread(chunk, 1, n, stream) != n) break;
+                size -= n;
+                strm.next_in = chunk;
+                strm.avail_in = n;
+                rc = api.inflate(&strm, (size == 0) ? Z_FINISH : Z_NO_FLUSH);
+                if ((rc == Z_BUF_ERROR) && (strm.avail_out > 0)) rc = Z_OK;
+        }
+        api.inflateEnd(&strm);
+
+        if ((rc != Z_STREAM_END) || (strm.total_out != dst_size)) {
+                return TURTLE_ERROR_REGISTER(
+                    TURTLE_RETURN_BAD_FORMAT, "corrupted compressed data");
+        }
+
+        return TURTLE_RETURN_SUCCESS;
+#endif
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2017 Université Clermont Auvergne, CNRS/IN2P3, LPC
+ * Author: Valentin NIESS (niess@in2p3.fr)
+ *
+ * Topographic Utilities for tRansporting parTicules over Long rangEs (TURTLE)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/* Runtime binding to zlib for (de)compressing elevation data */
+#ifndef TURTLE_COMPRESS_H
+#define TURTLE_COMPRESS_H
+
+/* C89 standard library */
+#include <stdio.h>
+/* TURTLE library */
+#include "turtle.h"
+#include "turtle/error.h"
+
+/* Compress a buffer. The compressed data are allocated with `malloc` */
+enum turtle_return turtle_compress_(const void * src, unsigned long size,
+    int level, void ** dst, unsigned long * dst_size,
+    struct turtle_error_context * error_);
+
+/* Uncompress a buffer of known uncompressed size */
+enum turtle_return turtle_uncompress_(const void * src, unsigned long size,
+    void * dst, unsigned long dst_size, struct turtle_error_context * error_);
+
+/* Inflate a raw deflate stream of known uncompressed size from a file */
+enum turtle_return turtle_inflate_(FILE * stream, unsigned long size,
+    void * dst, unsigned long dst_size, struct turtle_error_context * error_);
+
+#endif
@@ -153,6 +153,47 @@ static inline void compute_enu(
         u[2] = sp;
 }
 
+/* Transform a direction from the E,N,U basis to ECEF */
+static inline void enu_to_ecef(const double e[3], const double n[3],
+    const double u[3], const double r[3], double direction[3])
+{
+        direction[0] = r[0] * e[0] + r[1] * n[0] + r[2] * u[0];
+        direction[1] = r[0] * e[1] + r[1] * n[1] + r[2] * u[1];
+        direction[2] = r[0] * e[2] + r[1] * n[2] + r[2] * u[2];
+}
+
+/* Transform a direction from ECEF to the E,N,U basis */
+static inline void ecef_to_enu(const double e[3], const double n[3],
+    const double u[3], const double direction[3], double r[3])
+{
+        r[0] = e[0] * direction[0] + e[1] * direction[1] + e[2] * direction[2];
+        r[1] = n[0] * direction[0] + n[1] * direction[1] + n[2] * direction[2];
+        r[2] = u[0] * direction[0] + u[1] * direction[1] + u[2] * direction[2];
+}
+
+/* Compute the local direction from horizontal angles */
+static inline void horizontal_to_enu(
+    double azimuth, double elevation, double r[3])
+{
+        const double az = azimuth * M_PI / 180.;
+        const double el = elevation * M_PI / 180.;
+        const double ce = cos(el);
+        r[0] = ce * sin(az);
+        r[1] = ce * cos(az);
+        r[2] = sin(el);
+}
+
+/* Compute the horizontal angles from a local direction */
+static inline void enu_to_horizontal(
+    const double r[3], double * azimuth, double * elevation)
+{
+        double norm = r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+        if (norm <= FLT_EPSILON) return;
+        norm = sqrt(norm);
+        if (azimuth != NULL) *azimuth = atan2(r[0], r[1]) * 180. / M_PI;
+        if (elevation != NULL) *elevation = asin(r[2] / norm) * 180. / M_PI;
+}
+
 /* Compute the direction vector in ECEF from the horizontal coordinates
  *
  * Reference: https://en.wikipedia.org/wiki/Horizontal_coordinate_system
@@ -165,14 +206,9 @@ void turtle_ecef_from_horizontal(double latitude, double longitude,
         compute_enu(latitude, longitude, e, n, u);
 
         /* Project on the E,N,U basis */
-        const double az = azimuth * M_PI / 180.;
-        const double el = elevation * M_PI / 180.;
-        const double ce = cos(el);
-        const double r[3] = { ce * sin(az), ce * cos(az), sin(el) };
-
-        direction[0] = r[0] * e[0] + r[1] * n[0] + r[2] * u[0];
-        direction[1] = r[0] * e[1] + r[1] * n[1] + r[2] * u[1];
-        direction[2] = r[0] * e[2] + r[1] * n[2] + r[2] * u[2];
+        double r[3];
+        horizontal_to_enu(azimuth, elevation, r);
+        enu_to_ecef(e, n, u, r, direction);
 }
 
 void turtle_ecef_to_horizontal(double latitude, double longitude,
@@ -183,16 +219,60 @@ void turtle_ecef_to_horizontal(double latitude, double longitude,
         compute_enu(latitude, longitude, e, n, u);
 
         /* Project on the E,N,U basis */
-        const double x =
-            e[0] * direction[0] + e[1] * direction[1] + e[2] * direction[2];
-        const double y =
-            n[0] * direction[0] + n[1] * direction[1] + n[2] * direction[2];
-        const double z =
-            u[0] * direction[0] + u[1] * direction[1] + u[2] * direction[2];
-        double r = direction[0] * direction[0] + direction[1] * direction[1] +
-            direction[2] * direction[2];
-        if (r <= FLT_EPSILON) return;
-        r = sqrt(r);
-        if (azimuth != NULL) *azimuth = atan2(x, y) * 180. / M_PI;
-        if (elevation != NULL) *elevation = asin(z / r) * 180. / M_PI;
+        double r[3];
+        ecef_to_enu(e, n, u, direction, r);
+        enu_to_horizontal(r, azimuth, elevation);
+}
+
+void turtle_ecef_frame_configure(
+    struct turtle_ecef_frame * frame, double latitude, double longitude)
+{
+        compute_enu(latitude, longitude, frame->enu[0], frame->enu[1],
+            frame->enu[2]);
+}
+
+void turtle_ecef_frame_from_horizontal(const struct turtle_ecef_frame * frame,
+    int n, const double * azimuth, const double * elevation,
+    double * direction)
+{
+        int i;
+        for (i = 0; i < n; i++) {
+                double r[3];
+                horizontal_to_enu(azimuth[i], elevation[i], r);
+                enu_to_ecef(frame->enu[0], frame->enu[1], frame->enu[2], r,
+                    direction + 3 * i);
+        }
+}
+
+void turtle_ecef_frame_to_horizontal(const struct turtle_ecef_frame * frame,
+    int n, const double * direction, double * azimuth, double * elevation)
+{
+        int i;
+        for (i = 0; i < n; i++) {
+                double r[3];
+                ecef_to_enu(frame->enu[0], frame->enu[1], frame->enu[2],
+                    direction + 3 * i, r);
+                enu_to_horizontal(r, (azimuth != NULL) ? azimuth + i : NULL,
+                    (elevation != NULL) ? elevation + i : NULL);
+        }
+}
+
+void turtle_ecef_frame_from_local(const struct turtle_ecef_frame * frame,
+    int n, const double * local, double * direction)
+{
+        int i;
+        for (i = 0; i < n; i++) {
+                enu_to_ecef(frame->enu[0], frame->enu[1], frame->enu[2],
+                    local + 3 * i, direction + 3 * i);
+        }
+}
+
+void turtle_ecef_frame_to_local(const struct turtle_ecef_frame * frame,
+    int n, const double * direction, double * local)
+{
+        int i;
+        for (i = 0; i < n; i++) {
+                ecef_to_enu(frame->enu[0], frame->enu[1], frame->enu[2],
+                    direction + 3 * i, local + 3 * i);
+        }
 }
@@ -19,6 +19,7 @@
  */
 
 #include "error.h"
+#include "turtle_inline.h"
 /* C89 standard library */
 #include <stdio.h>
 #include <stdlib.h>
@@ -137,17 +138,35 @@ enum turtle_return turtle_error_raise_(struct turtle_error_context * error_)
         return error_->code;
 }
 
+/* Utility function for discarding an error, e.g. a recovered one */
+void turtle_error_clear_(struct turtle_error_context * error_)
+{
+        if (error_->dynamic) {
+                free(error_->message);
+                error_->dynamic = 0;
+        }
+        error_->message = NULL;
+        error_->code = TURTLE_RETURN_SUCCESS;
+}
+
 /* Get a library function name as a string */
 const char * turtle_error_function(turtle_function_t * caller)
 {
 #define TOSTRING(function)                                                     \
         if (caller == (turtle_function_t *)function) return #function
 
+        TOSTRING(turtle_client_cache_get);
+        TOSTRING(turtle_client_cache_set);
         TOSTRING(turtle_client_clear);
         TOSTRING(turtle_client_create);
         TOSTRING(turtle_client_destroy);
         TOSTRING(turtle_client_elevation);
 
+        TOSTRING(turtle_ecef_frame_configure);
+        TOSTRING(turtle_ecef_frame_from_horizontal);
+        TOSTRING(turtle_ecef_frame_from_local);
+        TOSTRING(turtle_ecef_frame_to_horizontal);
+        TOSTRING(turtle_ecef_frame_to_local);
         TOSTRING(turtle_ecef_from_geodetic);
         TOSTRING(turtle_ecef_from_horizontal);
         TOSTRING(turtle_ecef_to_geodetic);
@@ -157,7 +176,10 @@ const char * turtle_error_function(turtle_function_t * caller)
         TOSTRING(turtle_error_handler_get);
         TOSTRING(turtle_error_handler_set);
 
+        TOSTRING(turtle_io_register);
+
         TOSTRING(turtle_map_create);
+        TOSTRING(turtle_map_data_get);
         TOSTRING(turtle_map_destroy);
         TOSTRING(turtle_map_dump);
         TOSTRING(turtle_map_elevation);
@@ -166,6 +188,8 @@ const char * turtle_error_function(turtle_function_t * caller)
         TOSTRING(turtle_map_meta);
         TOSTRING(turtle_map_node);
         TOSTRING(turtle_map_projection);
+        TOSTRING(turtle_map_view);
+        TOSTRING(turtle_map_window_stats);
 
         TOSTRING(turtle_projection_configure);
         TOSTRING(turtle_projection_create);
@@ -174,24 +198,47 @@ const char * turtle_error_function(turtle_function_t * caller)
         TOSTRING(turtle_projection_project);
         TOSTRING(turtle_projection_unproject);
 
+        TOSTRING(turtle_remote_cache_set);
+
         TOSTRING(turtle_stack_clear);
         TOSTRING(turtle_stack_create);
+        TOSTRING(turtle_stack_create_provider);
         TOSTRING(turtle_stack_destroy);
+        TOSTRING(turtle_stack_dump);
         TOSTRING(turtle_stack_elevation);
         TOSTRING(turtle_stack_load);
+        TOSTRING(turtle_stack_lock_set);
+        TOSTRING(turtle_stack_pin);
+        TOSTRING(turtle_stack_rwlock_enable);
+        TOSTRING(turtle_stack_spill_set);
+        TOSTRING(turtle_stack_unpin);
 
         TOSTRING(turtle_stepper_add_flat);
         TOSTRING(turtle_stepper_add_layer);
         TOSTRING(turtle_stepper_add_map);
         TOSTRING(turtle_stepper_add_stack);
         TOSTRING(turtle_stepper_create);
+        TOSTRING(turtle_stepper_cursor_create);
+        TOSTRING(turtle_stepper_cursor_destroy);
+        TOSTRING(turtle_stepper_cursor_step);
         TOSTRING(turtle_stepper_destroy);
+        TOSTRING(turtle_stepper_footprint_get);
+        TOSTRING(turtle_stepper_footprint_set);
+        TOSTRING(turtle_stepper_frame_get);
+        TOSTRING(turtle_stepper_frame_set);
         TOSTRING(turtle_stepper_geoid_get);
         TOSTRING(turtle_stepper_geoid_set);
         TOSTRING(turtle_stepper_range_get);
         TOSTRING(turtle_stepper_range_set);
+        TOSTRING(turtle_stepper_run);
         TOSTRING(turtle_stepper_position);
+        TOSTRING(turtle_stepper_precision_get);
+        TOSTRING(turtle_stepper_precision_set);
         TOSTRING(turtle_stepper_step);
+        TOSTRING(turtle_stepper_tuning_set);
+        TOSTRING(turtle_trace_dump);
+        TOSTRING(turtle_trace_start);
+        TOSTRING(turtle_trace_stop);
 
         return NULL;
 #undef TOSTRING
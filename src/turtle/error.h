@@ -118,4 +118,7 @@ enum turtle_return turtle_error_format_(struct turtle_error_context * error_,
 /* Generic function for handling an error */
 enum turtle_return turtle_error_raise_(struct turtle_error_context * error_);
 
+/* Generic function for discarding an error, e.g. a recovered one */
+void turtle_error_clear_(struct turtle_error_context * error_);
+
 #endif
@@ -21,6 +21,7 @@
 /* Generic read/write for the TURTLE library */
 
 /* C89 standard library */
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 /* TURTLE library */
@@ -31,8 +32,11 @@ typedef enum turtle_return io_creator_t(
     struct turtle_io ** io, struct turtle_error_context * error_);
 
 struct io_info {
-        const char * extension;
+        char extension[8];
         io_creator_t * create;
+
+        /* Custom format, used if create is NULL */
+        struct turtle_io_format format;
 };
 
 /* List of available formats */
@@ -73,8 +77,265 @@ static struct io_info info[] = {
 #ifndef TURTLE_NO_ASC
         { "asc", &turtle_io_asc_create_ },
 #endif
+#ifndef TURTLE_NO_HGT
+        { "zip", &turtle_io_hgt_create_ },
+#endif
+#ifndef TURTLE_NO_TIFF
+        { "url", &turtle_io_geotiff16_create_ },
+#endif
+        { "", NULL } /* Sentinel, for builds without any format */
 };
 
+/* Hash table of formats, indexed by extension, using linear probing */
+#define IO_TABLE_SIZE 64
+static struct io_info * table[IO_TABLE_SIZE];
+
+/* FNV-1a hash of an extension */
+static int io_hash(const char * extension)
+{
+        unsigned int h = 2166136261U;
+        for (; *extension != 0x0; extension++) {
+                h ^= (unsigned char)(*extension);
+                h *= 16777619U;
+        }
+        return h % IO_TABLE_SIZE;
+}
+
+/* Get the table slot of an extension, or of the empty slot where it would
+ * be inserted. Returns -1 if the table is full
+ */
+static int io_slot(const char * extension)
+{
+        const int h = io_hash(extension);
+        int i;
+        for (i = 0; i < IO_TABLE_SIZE; i++) {
+                const int j = (h + i) % IO_TABLE_SIZE;
+                if ((table[j] == NULL) ||
+                    (strcmp(table[j]->extension, extension) == 0))
+                        return j;
+        }
+        return -1;
+}
+
+/* Remove the entry at the given slot, shifting back the following entries
+ * of its cluster
+ */
+static void io_remove(int slot)
+{
+        table[slot] = NULL;
+        int i;
+        for (i = (slot + 1) % IO_TABLE_SIZE; table[i] != NULL;
+             i = (i + 1) % IO_TABLE_SIZE) {
+                struct io_info * entry = table[i];
+                table[i] = NULL;
+                table[io_slot(entry->extension)] = entry;
+        }
+}
+
+/* Get a built-in format given its extension */
+static struct io_info * io_builtin(const char * extension)
+{
+        const int n = sizeof(info) / sizeof(*info) - 1;
+        int i;
+        for (i = 0; i < n; i++) {
+                if (strcmp(info[i].extension, extension) == 0) return info + i;
+        }
+        return NULL;
+}
+
+/* Fill the table with the built-in formats, once */
+static void io_initialise(void)
+{
+        static volatile int state = 0; /* 0: empty, 1: busy, 2: ready */
+        if (state == 2) return;
+
+        if (__sync_bool_compare_and_swap(&state, 0, 1)) {
+                const int n = sizeof(info) / sizeof(*info) - 1;
+                int i;
+                for (i = 0; i < n; i++) {
+                        const int slot = io_slot(info[i].extension);
+                        if (table[slot] == NULL) table[slot] = info + i;
+                }
+                __sync_synchronize();
+                state = 2;
+        } else {
+                while (state != 2)
+                        ;
+        }
+}
+
+/* Data for accessing a file with a custom format */
+struct format_io {
+        /* Base io object */
+        struct turtle_io base;
+
+        /* The format callbacks and the file data */
+        struct turtle_io_format format;
+        struct turtle_map_info info;
+        void * handle;
+        const char * path;
+};
+
+static void format_close(struct turtle_io * io)
+{
+        struct format_io * f = (struct format_io *)io;
+        if (f->handle != NULL) {
+                f->format.close(f->handle);
+                f->handle = NULL;
+        }
+        f->path = NULL;
+}
+
+static enum turtle_return format_open(struct turtle_io * io,
+    const char * path, const char * mode, struct turtle_error_context * error_)
+{
+        struct format_io * f = (struct format_io *)io;
+        if (f->path != NULL) io->close(io);
+
+        if (mode[0] != 'r') {
+                if (f->format.write == NULL) {
+                        return TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
+                            "invalid write format for file `%s'", path);
+                }
+
+                /* The file is opened when writing, once the map is known */
+                f->path = path;
+                return TURTLE_RETURN_SUCCESS;
+        }
+
+        /* Open the file and get its meta data */
+        memset(&f->info, 0x0, sizeof(f->info));
+        const char * projection = NULL;
+        enum turtle_return rc = f->format.open(f->format.context, path, mode,
+            &f->info, &projection, &f->handle);
+        if (rc != TURTLE_RETURN_SUCCESS) {
+                f->handle = NULL;
+                return TURTLE_ERROR_VREGISTER(
+                    rc, "could not open file `%s'", path);
+        }
+        f->path = path;
+
+        const struct turtle_map_info * i = &f->info;
+        if ((i->nx <= 0) || (i->ny <= 0) || !(i->z[1] >= i->z[0])) {
+                io->close(io);
+                return TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
+                    "invalid meta data for file `%s'", path);
+        }
+        if (turtle_projection_configure_(
+                &io->meta.projection, projection, error_) !=
+            TURTLE_RETURN_SUCCESS) {
+                io->close(io);
+                return error_->code;
+        }
+
+        io->meta.nx = i->nx;
+        io->meta.ny = i->ny;
+        io->meta.x0 = i->x[0];
+        io->meta.y0 = i->y[0];
+        io->meta.z0 = i->z[0];
+        io->meta.dx = (i->nx > 1) ? (i->x[1] - i->x[0]) / (i->nx - 1) : 0.;
+        io->meta.dy = (i->ny > 1) ? (i->y[1] - i->y[0]) / (i->ny - 1) : 0.;
+        io->meta.dz = (i->z[1] - i->z[0]) / 65535;
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
+static enum turtle_return format_read(struct turtle_io * io,
+    struct turtle_map * map, struct turtle_error_context * error_)
+{
+        /* The data are read in place, since the encoding is the default
+         * one
+         */
+        struct format_io * f = (struct format_io *)io;
+        enum turtle_return rc = f->format.read(f->handle, &f->info, map->data);
+        if (rc != TURTLE_RETURN_SUCCESS) {
+                return TURTLE_ERROR_VREGISTER(
+                    rc, "could not read file `%s'", f->path);
+        }
+        return TURTLE_RETURN_SUCCESS;
+}
+
+static enum turtle_return format_write(struct turtle_io * io,
+    const struct turtle_map * map, struct turtle_error_context * error_)
+{
+        struct format_io * f = (struct format_io *)io;
+        const struct turtle_map_meta * meta = &map->meta;
+
+        /* Encode the data over 16 bits, since the map might use another
+         * encoding
+         */
+        const int n = meta->nx * meta->ny;
+        uint16_t * data = malloc(n * sizeof(*data));
+        if (data == NULL) {
+                return TURTLE_ERROR_VREGISTER(TURTLE_RETURN_MEMORY_ERROR,
+                    "could not allocate memory for file `%s'", f->path);
+        }
+        int ix, iy;
+        for (iy = 0; iy < meta->ny; iy++) {
+                for (ix = 0; ix < meta->nx; ix++) {
+                        const double z = meta->get_z(map, ix, iy);
+                        const double d = (meta->dz > 0.) ?
+                            round((z - meta->z0) / meta->dz) : 0.;
+                        data[iy * meta->nx + ix] = (uint16_t)d;
+                }
+        }
+
+        /* Open the file and dump the data */
+        f->info.nx = meta->nx;
+        f->info.ny = meta->ny;
+        f->info.x[0] = meta->x0;
+        f->info.x[1] = meta->x0 + (meta->nx - 1) * meta->dx;
+        f->info.y[0] = meta->y0;
+        f->info.y[1] = meta->y0 + (meta->ny - 1) * meta->dy;
+        f->info.z[0] = meta->z0;
+        f->info.z[1] = meta->z0 + 65535 * meta->dz;
+        f->info.encoding = io->meta.encoding;
+        const char * projection = turtle_projection_name(&meta->projection);
+
+        enum turtle_return rc = f->format.open(f->format.context, f->path,
+            "wb+", &f->info, &projection, &f->handle);
+        if (rc != TURTLE_RETURN_SUCCESS) {
+                f->handle = NULL;
+                TURTLE_ERROR_VREGISTER(
+                    rc, "could not open file `%s'", f->path);
+        } else if ((rc = f->format.write(f->handle, &f->info, data)) !=
+            TURTLE_RETURN_SUCCESS) {
+                TURTLE_ERROR_VREGISTER(
+                    rc, "could not write file `%s'", f->path);
+        }
+        free(data);
+
+        return error_->code;
+}
+
+/* Allocate an io for a custom format */
+static enum turtle_return format_create(struct turtle_io ** io,
+    const struct turtle_io_format * format,
+    struct turtle_error_context * error_)
+{
+        struct format_io * f = malloc(sizeof(*f));
+        if (f == NULL) {
+                return TURTLE_ERROR_REGISTER(TURTLE_RETURN_MEMORY_ERROR,
+                    "could not allocate memory for custom format");
+        }
+        *io = &f->base;
+
+        memset(f, 0x0, sizeof(*f));
+        memcpy(&f->format, format, sizeof(f->format));
+        f->handle = NULL;
+        f->path = NULL;
+        f->base.meta.projection.type = PROJECTION_NONE;
+
+        f->base.open = &format_open;
+        f->base.close = &format_close;
+        f->base.read = &format_read;
+        f->base.write = &format_write;
+
+        turtle_map_meta_default_(&f->base.meta);
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
 /* Generic io allocator, given a file name */
 enum turtle_return turtle_io_create_(struct turtle_io ** io, const char * path,
     struct turtle_error_context * error_)
@@ -86,19 +347,83 @@ enum turtle_return turtle_io_create_(struct turtle_io ** io, const char * path,
                 extension++;
         else
                 goto error;
+        if (strlen(extension) >= sizeof(info->extension)) goto error;
 
         /* Look for a reader */
-        const int n = sizeof(info) / sizeof(*info);
-        int i;
-        for (i = 0; i < n; i++) {
-                if (strcmp(info[i].extension, extension) == 0) {
-                        enum turtle_return rc = info[i].create(io, error_);
-                        if (rc == TURTLE_RETURN_SUCCESS)
-                                strcpy((*io)->meta.encoding, extension);
-                        return rc;
-                }
+        io_initialise();
+        const int slot = io_slot(extension);
+        if ((slot < 0) || (table[slot] == NULL)) goto error;
+
+        const struct io_info * entry = table[slot];
+#ifndef TURTLE_NO_HGT
+        /* Zip archives are only claimed for zipped HGT files */
+        if ((entry->create == &turtle_io_hgt_create_) &&
+            (strcmp(extension, "zip") == 0)) {
+                const size_t n = strlen(path);
+                if ((n < 8) || (strcmp(path + n - 8, ".hgt.zip") != 0))
+                        goto error;
         }
+#endif
+        enum turtle_return rc = (entry->create != NULL) ?
+            entry->create(io, error_) :
+            format_create(io, &entry->format, error_);
+        if (rc == TURTLE_RETURN_SUCCESS)
+                strcpy((*io)->meta.encoding, extension);
+        return rc;
 error:
         return TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_EXTENSION,
             "no valid format for file `%s'", path);
 }
+
+/* Register a custom format */
+enum turtle_return turtle_io_register(
+    const char * extension, const struct turtle_io_format * format)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_io_register);
+
+        if ((extension == NULL) || (extension[0] == 0x0) ||
+            (strlen(extension) >= sizeof(info->extension)) ||
+            (strchr(extension, '.') != NULL)) {
+                return TURTLE_ERROR_MESSAGE(TURTLE_RETURN_BAD_EXTENSION,
+                    "invalid extension");
+        } else if ((format != NULL) &&
+            ((format->open == NULL) || (format->read == NULL) ||
+                (format->close == NULL))) {
+                return TURTLE_ERROR_MESSAGE(
+                    TURTLE_RETURN_BAD_ADDRESS, "invalid format callback(s)");
+        }
+
+        io_initialise();
+        const int slot = io_slot(extension);
+        struct io_info * current = (slot >= 0) ? table[slot] : NULL;
+        struct io_info * builtin = io_builtin(extension);
+
+        if (format == NULL) {
+                /* Restore any built-in format */
+                if ((current == NULL) || (current->create != NULL))
+                        return TURTLE_RETURN_SUCCESS;
+                free(current);
+                if (builtin != NULL)
+                        table[slot] = builtin;
+                else
+                        io_remove(slot);
+                return TURTLE_RETURN_SUCCESS;
+        }
+
+        /* Supersede any previous format */
+        if (slot < 0) {
+                return TURTLE_ERROR_MESSAGE(TURTLE_RETURN_MEMORY_ERROR,
+                    "too many registered formats");
+        }
+        struct io_info * entry = current;
+        if ((entry == NULL) || (entry->create != NULL)) {
+                entry = malloc(sizeof(*entry));
+                if (entry == NULL) return TURTLE_ERROR_MEMORY();
+                strcpy(entry->extension, extension);
+                entry->create = NULL;
+        }
+        memcpy(&entry->format, format, sizeof(entry->format));
+        table[slot] = entry;
+
+        return TURTLE_RETURN_SUCCESS;
+}
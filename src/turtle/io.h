@@ -51,4 +51,31 @@ struct turtle_io {
 enum turtle_return turtle_io_create_(struct turtle_io ** io, const char * path,
     struct turtle_error_context * error_);
 
+/* Remote tiled GeoTIFF, e.g. a Cloud Optimised GeoTIFF, whose internal tiles
+ * are exposed as a grid of cells sharing their borders
+ */
+struct turtle_cog {
+        /* Grid of cells */
+        double latitude_0, latitude_delta;
+        double longitude_0, longitude_delta;
+        int latitude_n, longitude_n;
+
+        /* Number of map nodes, and size of the cells in nodes intervals */
+        int nx, ny;
+        int cell_nx, cell_ny;
+
+        char url[]; /* Placeholder for the URL */
+};
+
+/* Open a remote tiled GeoTIFF */
+enum turtle_return turtle_cog_open_(struct turtle_cog ** cog,
+    const char * url, struct turtle_error_context * error_);
+
+/* Close a remote tiled GeoTIFF */
+void turtle_cog_close_(struct turtle_cog ** cog);
+
+/* Load the map of a cell of a remote tiled GeoTIFF */
+enum turtle_return turtle_cog_load_(struct turtle_cog * cog, int ix, int iy,
+    struct turtle_map ** map, struct turtle_error_context * error_);
+
 #endif
@@ -125,14 +125,14 @@ static void asc_close(struct turtle_io * io)
 
 static double get_z(const struct turtle_map * map, int ix, int iy)
 {
-        const uint16_t iz = (uint16_t)map->data[iy * map->meta.nx + ix];
+        const uint16_t iz = (uint16_t)map->data[iy * map->stride + ix];
         return map->meta.z0 + iz * map->meta.dz;
 }
 
 static void set_z(struct turtle_map * map, int ix, int iy, double z)
 {
         const double d = round((z - map->meta.z0) / map->meta.dz);
-        map->data[iy * map->meta.nx + ix] = (uint16_t)d;
+        map->data[iy * map->stride + ix] = (uint16_t)d;
 }
 
 static enum turtle_return asc_read(struct turtle_io * io,
@@ -20,7 +20,8 @@
 
 /*
  * I/O's for geotiff files providing a reader for 16b data, e.g. ASTER-GDEM2
- * or SRTM tiles
+ * or SRTM tiles. Tiled files, e.g. Cloud Optimised GeoTIFFs, can be read from
+ * an HTTP server as well, possibly by parts for stacks
  */
 
 /* C89 standard library */
@@ -41,6 +42,7 @@
 #endif
 /* TURTLE library */
 #include "turtle/io.h"
+#include "turtle/remote.h"
 
 /* GEOTIFF tags */
 #define TIFFTAG_GEOPIXELSCALE 33550
@@ -78,6 +80,9 @@ static struct {
         void * lib;
 
         TIFF * (*Open) (const char *, const char *);
+        TIFF * (*ClientOpen) (const char *, const char *, thandle_t,
+            TIFFReadWriteProc, TIFFReadWriteProc, TIFFSeekProc, TIFFCloseProc,
+            TIFFSizeProc, TIFFMapFileProc, TIFFUnmapFileProc);
         TIFFErrorHandler (*SetErrorHandler) (TIFFErrorHandler);
         TIFFExtendProc (*SetTagExtender) (TIFFExtendProc);
         int (*GetField) (TIFF *, ttag_t, ...);
@@ -86,6 +91,10 @@ static struct {
         int (*SetField) (TIFF *, ttag_t, ...);
         int (*WriteScanline) (TIFF *, tdata_t, uint32, tsample_t);
         tsize_t (*ScanlineSize) (TIFF *);
+        int (*IsTiled) (TIFF *);
+        tsize_t (*TileSize) (TIFF *);
+        tsize_t (*ReadTile) (TIFF *, tdata_t, uint32, uint32, uint32,
+            tsample_t);
         void (*Close) (TIFF *);
 } api;
 
@@ -125,6 +134,7 @@ static enum turtle_return api_initialise(struct turtle_error_context * error_)
 #endif
 
         LINK(Open);
+        LINK(ClientOpen);
         LINK(SetErrorHandler);
         LINK(SetTagExtender);
         LINK(GetField);
@@ -133,6 +143,9 @@ static enum turtle_return api_initialise(struct turtle_error_context * error_)
         LINK(SetField);
         LINK(WriteScanline);
         LINK(ScanlineSize);
+        LINK(IsTiled);
+        LINK(TileSize);
+        LINK(ReadTile);
         LINK(Close);
 
         /* Register the tag extender to libtiff */
@@ -160,8 +173,91 @@ struct geotiff16_io {
         /* Internal data for the GEOTIFF format */
         TIFF * tiff;
         const char * path;
+
+        /* Remote file, if any, and its current position */
+        struct turtle_remote * remote;
+        toff_t position;
+        struct turtle_error_context * error_;
 };
 
+/* Client procedures for reading a remote file with libtiff */
+static tmsize_t remote_read(thandle_t handle, void * buffer, tmsize_t size)
+{
+        struct geotiff16_io * geotiff16 = handle;
+        struct turtle_remote * remote = geotiff16->remote;
+        if (geotiff16->position >= remote->size) return 0;
+        if (geotiff16->position + size > remote->size)
+                size = remote->size - geotiff16->position;
+        if (turtle_remote_read_(remote, geotiff16->position, buffer, size,
+                geotiff16->error_) != TURTLE_RETURN_SUCCESS)
+                return -1;
+        geotiff16->position += size;
+        return size;
+}
+
+static tmsize_t remote_write(thandle_t handle, void * buffer, tmsize_t size)
+{
+        return -1;
+}
+
+static toff_t remote_seek(thandle_t handle, toff_t offset, int whence)
+{
+        struct geotiff16_io * geotiff16 = handle;
+        if (whence == SEEK_CUR)
+                offset += geotiff16->position;
+        else if (whence == SEEK_END)
+                offset += geotiff16->remote->size;
+        geotiff16->position = offset;
+        return offset;
+}
+
+static int remote_close(thandle_t handle)
+{
+        return 0;
+}
+
+static toff_t remote_size(thandle_t handle)
+{
+        struct geotiff16_io * geotiff16 = handle;
+        return geotiff16->remote->size;
+}
+
+static int remote_map(thandle_t handle, void ** base, toff_t * size)
+{
+        return 0;
+}
+
+static void remote_unmap(thandle_t handle, void * base, toff_t size) {}
+
+/* Open a remote file, given its URL or a `.url` file containing it. Local
+ * files are left unopened
+ */
+static enum turtle_return remote_open(struct geotiff16_io * geotiff16,
+    const char * path, struct turtle_error_context * error_)
+{
+        geotiff16->remote = NULL;
+        geotiff16->position = 0;
+        if (turtle_remote_check_(path))
+                return turtle_remote_open_(&geotiff16->remote, path, error_);
+
+        const char * extension = strrchr(path, '.');
+        if ((extension == NULL) || (strcmp(extension, ".url") != 0))
+                return TURTLE_RETURN_SUCCESS;
+
+        FILE * stream = fopen(path, "r");
+        if (stream == NULL) {
+                return TURTLE_ERROR_VREGISTER(
+                    TURTLE_RETURN_PATH_ERROR, "could not open file `%s'", path);
+        }
+        char url[4096];
+        const int n = (fgets(url, sizeof(url), stream) == NULL) ?
+            0 : strcspn(url, " \t\r\n");
+        fclose(stream);
+        url[n] = 0x0;
+
+        return turtle_remote_open_(&geotiff16->remote, url, error_);
+}
+
 static enum turtle_return geotiff16_open(struct turtle_io * io,
     const char * path, const char * mode, struct turtle_error_context * error_)
 {
@@ -187,9 +283,19 @@ static enum turtle_return geotiff16_open(struct turtle_io * io,
         io->meta.dz = 1.;
         io->meta.projection.type = PROJECTION_NONE;
 
-        /* Open the TIFF file */
-        geotiff16->tiff = api.Open(path, "r");
+        /* Open the TIFF file, which might be remote */
+        if (remote_open(geotiff16, path, error_) != TURTLE_RETURN_SUCCESS)
+                return error_->code;
+        if (geotiff16->remote != NULL) {
+                geotiff16->error_ = error_;
+                geotiff16->tiff = api.ClientOpen(path, "rm", geotiff16,
+                    &remote_read, &remote_write, &remote_seek, &remote_close,
+                    &remote_size, &remote_map, &remote_unmap);
+        } else
+                geotiff16->tiff = api.Open(path, "r");
         if (geotiff16->tiff == NULL) {
+                turtle_remote_close_(&geotiff16->remote);
+                if (error_->code != TURTLE_RETURN_SUCCESS) return error_->code;
                 return TURTLE_ERROR_VREGISTER(
                     TURTLE_RETURN_PATH_ERROR, "could not open file `%s'", path);
         }
@@ -224,23 +330,87 @@ static void geotiff16_close(struct turtle_io * io)
                 api.Close(geotiff16->tiff);
                 geotiff16->tiff = NULL;
                 geotiff16->path = NULL;
+                turtle_remote_close_(&geotiff16->remote);
         }
 }
 
 static double get_z(const struct turtle_map * map, int ix, int iy)
 {
-        return (int16_t)map->data[iy * map->meta.nx + ix];
+        return (int16_t)map->data[iy * map->stride + ix];
 }
 
 static void set_z(struct turtle_map * map, int ix, int iy, double z)
 {
-        map->data[iy * map->meta.nx + ix] = (int16_t)z;
+        map->data[iy * map->stride + ix] = (int16_t)z;
+}
+
+/* Read a window of a tiled map, e.g. a Cloud Optimised GeoTIFF. The window
+ * has the size of the map, and it starts at column ix0 and row iy0 of the
+ * image, counted from the top. Only the tiles overlapping the window are read
+ */
+static enum turtle_return geotiff16_read_tiles(struct geotiff16_io * geotiff16,
+    struct turtle_map * map, int ix0, int iy0,
+    struct turtle_error_context * error_)
+{
+        uint32_t width = 0, length = 0;
+        api.GetField(geotiff16->tiff, TIFFTAG_TILEWIDTH, &width);
+        api.GetField(geotiff16->tiff, TIFFTAG_TILELENGTH, &length);
+        uint16_t * tile = malloc(api.TileSize(geotiff16->tiff));
+        if (tile == NULL) {
+                return TURTLE_ERROR_VREGISTER(TURTLE_RETURN_MEMORY_ERROR,
+                    "could not allocate memory when reading file `%s'",
+                    geotiff16->path);
+        }
+
+        const int nx = map->meta.nx, ny = map->meta.ny;
+        const int ix1 = ix0 + nx, iy1 = iy0 + ny;
+        int ix, iy;
+        for (iy = iy0 - iy0 % length; iy < iy1; iy += length) {
+                for (ix = ix0 - ix0 % width; ix < ix1; ix += width) {
+                        if (api.ReadTile(geotiff16->tiff, tile, ix, iy, 0, 0) <
+                            0) {
+                                free(tile);
+                                if (error_->code != TURTLE_RETURN_SUCCESS)
+                                        return error_->code;
+                                return TURTLE_ERROR_VREGISTER(
+                                    TURTLE_RETURN_BAD_FORMAT,
+                                    "a libtiff error occured when reading "
+                                    "file `%s'",
+                                    geotiff16->path);
+                        }
+
+                        /* Copy the tile rows within the window, bottom up */
+                        const int jx0 = (ix > ix0) ? ix : ix0;
+                        const int jx1 = (ix + (int)width < ix1) ?
+                            ix + (int)width : ix1;
+                        const int jy0 = (iy > iy0) ? iy : iy0;
+                        const int jy1 = (iy + (int)length < iy1) ?
+                            iy + (int)length : iy1;
+                        int k;
+                        for (k = jy0; k < jy1; k++) {
+                                memcpy(map->data + (iy1 - 1 - k) * nx + jx0 -
+                                        ix0,
+                                    tile + (k - iy) * width + jx0 - ix,
+                                    (jx1 - jx0) * sizeof(*tile));
+                        }
+                }
+        }
+        free(tile);
+
+        return TURTLE_RETURN_SUCCESS;
 }
 
 static enum turtle_return geotiff16_read(struct turtle_io * io,
     struct turtle_map * map, struct turtle_error_context * error_)
 {
         struct geotiff16_io * geotiff16 = (struct geotiff16_io *)io;
+        geotiff16->error_ = error_;
+
+        /* Unpack tiled data. Note that only the tiles are read, e.g. for
+         * remote files
+         */
+        if (api.IsTiled(geotiff16->tiff))
+                return geotiff16_read_tiles(geotiff16, map, 0, 0, error_);
 
         /* Unpack the data */
         uint16_t * buffer = map->data;
@@ -248,6 +418,8 @@ static enum turtle_return geotiff16_read(struct turtle_io * io,
         int i;
         for (i = 0; i < io->meta.ny; i++, buffer -= io->meta.nx) {
                 if (api.ReadScanline(geotiff16->tiff, buffer, i, 0) != 1) {
+                        if (error_->code != TURTLE_RETURN_SUCCESS)
+                                return error_->code;
                         return TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
                             "a libtiff error occured when reading file `%s'",
                             geotiff16->path);
@@ -344,6 +516,7 @@ enum turtle_return turtle_io_geotiff16_create_(
         memset(geotiff16, 0x0, sizeof(*geotiff16));
         geotiff16->tiff = NULL;
         geotiff16->path = NULL;
+        geotiff16->remote = NULL;
         geotiff16->base.meta.projection.type = PROJECTION_NONE;
 
         geotiff16->base.open = &geotiff16_open;
@@ -353,6 +526,157 @@ enum turtle_return turtle_io_geotiff16_create_(
 
         geotiff16->base.meta.get_z = &get_z;
         geotiff16->base.meta.set_z = &set_z;
+        geotiff16->base.meta.raw_encoding = TURTLE_MAP_ENCODING_INT16;
 
         return TURTLE_RETURN_SUCCESS;
 }
+
+/* Get the size of the cells of a remote tiled map, along one axis, in
+ * nodes intervals. Cells must tile the map exactly, with shared borders.
+ * Thus, the closest divisor of the map size to the size of internal tiles
+ * is used, in log scale
+ */
+static int cog_cell(int n, int tile)
+{
+        int cell = n, i;
+        double d = fabs(log((double)n / tile));
+        for (i = 1; i * i <= n; i++) {
+                if ((n % i) != 0) continue;
+                const int c[2] = { i, n / i };
+                int j;
+                for (j = 0; j < 2; j++) {
+                        const double dj = fabs(log((double)c[j] / tile));
+                        if (dj < d) {
+                                cell = c[j];
+                                d = dj;
+                        }
+                }
+        }
+        return cell;
+}
+
+/* Open a remote tiled GeoTIFF, mapping its internal tiles to a grid of
+ * cells
+ */
+enum turtle_return turtle_cog_open_(struct turtle_cog ** cog,
+    const char * url, struct turtle_error_context * error_)
+{
+        *cog = NULL;
+        struct turtle_io * io;
+        if (turtle_io_geotiff16_create_(&io, error_) != TURTLE_RETURN_SUCCESS)
+                return error_->code;
+        if (io->open(io, url, "rb", error_) != TURTLE_RETURN_SUCCESS)
+                goto exit;
+
+        const struct turtle_map_meta * meta = &io->meta;
+        if ((meta->nx < 2) || (meta->ny < 2) || !(meta->dx > 0.) ||
+            !(meta->dy > 0.)) {
+                TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
+                    "invalid grid for file `%s'", url);
+                goto close;
+        }
+
+        /* Stripped images are exposed as a single cell */
+        int cell_nx = meta->nx - 1, cell_ny = meta->ny - 1;
+        struct geotiff16_io * geotiff16 = (struct geotiff16_io *)io;
+        if (api.IsTiled(geotiff16->tiff)) {
+                uint32_t width = 0, length = 0;
+                api.GetField(geotiff16->tiff, TIFFTAG_TILEWIDTH, &width);
+                api.GetField(geotiff16->tiff, TIFFTAG_TILELENGTH, &length);
+                if ((width == 0) || (length == 0)) {
+                        TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
+                            "invalid tiles for file `%s'", url);
+                        goto close;
+                }
+                cell_nx = cog_cell(cell_nx, width);
+                cell_ny = cog_cell(cell_ny, length);
+        }
+
+        const int n = strlen(url) + 1;
+        *cog = malloc(sizeof(**cog) + n);
+        if (*cog == NULL) {
+                TURTLE_ERROR_REGISTER(
+                    TURTLE_RETURN_MEMORY_ERROR, "could not allocate memory");
+                goto close;
+        }
+        (*cog)->longitude_0 = meta->x0;
+        (*cog)->longitude_delta = cell_nx * meta->dx;
+        (*cog)->longitude_n = (meta->nx - 1) / cell_nx;
+        (*cog)->latitude_0 = meta->y0;
+        (*cog)->latitude_delta = cell_ny * meta->dy;
+        (*cog)->latitude_n = (meta->ny - 1) / cell_ny;
+        (*cog)->nx = meta->nx;
+        (*cog)->ny = meta->ny;
+        (*cog)->cell_nx = cell_nx;
+        (*cog)->cell_ny = cell_ny;
+        memcpy((*cog)->url, url, n);
+
+close:
+        io->close(io);
+exit:
+        free(io);
+        return error_->code;
+}
+
+/* Close a remote tiled GeoTIFF */
+void turtle_cog_close_(struct turtle_cog ** cog)
+{
+        if ((cog == NULL) || (*cog == NULL)) return;
+        free(*cog);
+        *cog = NULL;
+}
+
+/* Load the map of a cell of a remote tiled GeoTIFF. Only the overlapping
+ * internal tiles are fetched
+ */
+enum turtle_return turtle_cog_load_(struct turtle_cog * cog, int ix, int iy,
+    struct turtle_map ** map, struct turtle_error_context * error_)
+{
+        *map = NULL;
+        struct turtle_io * io;
+        if (turtle_io_geotiff16_create_(&io, error_) != TURTLE_RETURN_SUCCESS)
+                return error_->code;
+        if (io->open(io, cog->url, "rb", error_) != TURTLE_RETURN_SUCCESS)
+                goto exit;
+        if ((io->meta.nx != cog->nx) || (io->meta.ny != cog->ny)) {
+                TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
+                    "inconsistent grid for file `%s'", cog->url);
+                goto close;
+        }
+
+        /* Allocate the map */
+        const int nx = cog->cell_nx + 1, ny = cog->cell_ny + 1;
+        *map = turtle_map_allocate_(nx, ny);
+        if (*map == NULL) {
+                TURTLE_ERROR_VREGISTER(TURTLE_RETURN_MEMORY_ERROR,
+                    "could not allocate memory for map `%s'", cog->url);
+                goto close;
+        }
+
+        /* Initialise the map data, for the cell nodes */
+        const int ix0 = ix * cog->cell_nx, iy0 = iy * cog->cell_ny;
+        memcpy(&(*map)->meta, &io->meta, sizeof((*map)->meta));
+        (*map)->meta.nx = nx;
+        (*map)->meta.ny = ny;
+        (*map)->meta.x0 += ix0 * io->meta.dx;
+        (*map)->meta.y0 += iy0 * io->meta.dy;
+        strcpy((*map)->meta.encoding, "tif");
+
+        /* Load the topography data. Image rows are counted from the top */
+        struct geotiff16_io * geotiff16 = (struct geotiff16_io *)io;
+        geotiff16->error_ = error_;
+        const enum turtle_return rc = api.IsTiled(geotiff16->tiff) ?
+            geotiff16_read_tiles(
+                geotiff16, *map, ix0, cog->ny - ny - iy0, error_) :
+            io->read(io, *map, error_);
+        if (rc != TURTLE_RETURN_SUCCESS) {
+                free(*map);
+                *map = NULL;
+        }
+
+close:
+        io->close(io);
+exit:
+        free(io);
+        return error_->code;
+}
@@ -19,7 +19,8 @@
  */
 
 /*
- * I/O's for hgt files providing a reader for 16b data, e.g. SRTM tiles
+ * I/O's for hgt files providing a reader for 16b data, e.g. SRTM tiles. Zipped
+ * tiles, as distributed by NASA, are read as well
  */
 
 /* C89 standard library */
@@ -30,6 +31,7 @@
 /* Endianess utilities */
 #include <arpa/inet.h>
 /* TURTLE library */
+#include "turtle/compress.h"
 #include "turtle/io.h"
 
 /* Data for accessing an hgt file */
@@ -40,6 +42,7 @@ struct hgt_io {
         /* Internal data for the io */
         FILE * fid;
         const char * path;
+        int zipped;
 };
 
 static enum turtle_return hgt_open(struct turtle_io * io, const char * path,
@@ -90,9 +93,20 @@ static enum turtle_return hgt_open(struct turtle_io * io, const char * path,
                     TURTLE_RETURN_BAD_FORMAT, fmtmsg, path);
         }
 
-        const char * ext = NULL;
+        const char * ext = NULL, * previous = NULL;
         for (p = filename + 7; *p != 0x0; p++) {
-                if (*p == '.') ext = p + 1;
+                if (*p == '.') {
+                        previous = ext;
+                        ext = p + 1;
+                }
+        }
+        hgt->zipped = (ext != NULL) && (strcmp(ext, "zip") == 0);
+        if (hgt->zipped) {
+                if (previous == NULL) {
+                        return TURTLE_ERROR_VREGISTER(
+                            TURTLE_RETURN_BAD_FORMAT, fmtmsg, path);
+                }
+                ext = previous;
         }
 
         const int n = ext - filename - 8;
@@ -127,22 +141,129 @@ static void hgt_close(struct turtle_io * io)
 static double get_z(const struct turtle_map * map, int ix, int iy)
 {
         iy = map->meta.ny - 1 - iy;
-        return (int16_t)ntohs(map->data[iy * map->meta.nx + ix]);
+        return (int16_t)ntohs(map->data[iy * map->stride + ix]);
 }
 
 static void set_z(struct turtle_map * map, int ix, int iy, double z)
 {
         iy = map->meta.ny - 1 - iy;
-        map->data[iy * map->meta.nx + ix] = (int16_t)htons(z);
+        map->data[iy * map->stride + ix] = (int16_t)htons(z);
+}
+
+/* Little endian decoding of zip records */
+static unsigned long zip_u16(const unsigned char * p)
+{
+        return p[0] | (p[1] << 8);
+}
+
+static unsigned long zip_u32(const unsigned char * p)
+{
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+/* Locate the elevation data within a zip archive, using its central directory.
+ * On success, the file is positioned at the start of the data
+ */
+static enum turtle_return zip_locate(struct hgt_io * hgt, int * method,
+    unsigned long * size, struct turtle_error_context * error_)
+{
+        FILE * fid = hgt->fid;
+        const unsigned long expected =
+            hgt->base.meta.nx * hgt->base.meta.ny * sizeof(int16_t);
+
+        /* Look for the end of central directory record, which might be
+         * followed by a comment
+         */
+        if (fseek(fid, 0, SEEK_END) != 0) goto error;
+        const long file_size = ftell(fid);
+        const long tail = (file_size < 65557) ? file_size : 65557;
+        if (tail < 22) goto error;
+        unsigned char * buffer = malloc(tail);
+        if (buffer == NULL) {
+                return TURTLE_ERROR_REGISTER(TURTLE_RETURN_MEMORY_ERROR,
+                    "could not allocate memory for zip directory");
+        }
+        long i = -1;
+        if ((fseek(fid, file_size - tail, SEEK_SET) == 0) &&
+            (fread(buffer, 1, tail, fid) == tail)) {
+                for (i = tail - 22; i >= 0; i--) {
+                        if (zip_u32(buffer + i) == 0x06054b50) break;
+                }
+        }
+        unsigned long n_entries = 0, directory = 0;
+        if (i >= 0) {
+                n_entries = zip_u16(buffer + i + 10);
+                directory = zip_u32(buffer + i + 16);
+        }
+        free(buffer);
+        if ((i < 0) || (fseek(fid, directory, SEEK_SET) != 0)) goto error;
+
+        /* Scan the central directory for the hgt entry */
+        unsigned long k, local = 0;
+        for (k = 0; k < n_entries; k++) {
+                unsigned char header[46];
+                char name[1024];
+                if ((fread(header, 1, sizeof(header), fid) != sizeof(header)) ||
+                    (zip_u32(header) != 0x02014b50))
+                        goto error;
+                const unsigned long n_name = zip_u16(header + 28);
+                long skip = zip_u16(header + 30) + zip_u16(header + 32);
+                if (n_name < sizeof(name)) {
+                        if (fread(name, 1, n_name, fid) != n_name) goto error;
+                        name[n_name] = 0x0;
+                } else {
+                        name[0] = 0x0;
+                        skip += n_name;
+                }
+                if ((n_name > 4) && (n_name < sizeof(name)) &&
+                    (strcmp(name + n_name - 4, ".hgt") == 0)) {
+                        *method = zip_u16(header + 10);
+                        *size = zip_u32(header + 20);
+                        if ((zip_u32(header + 24) != expected) ||
+                            ((*method != 0) && (*method != 8)))
+                                goto error;
+                        local = zip_u32(header + 42);
+                        break;
+                }
+                if (fseek(fid, skip, SEEK_CUR) != 0) goto error;
+        }
+        if (k == n_entries) goto error;
+
+        /* Skip the local header */
+        unsigned char header[30];
+        if ((fseek(fid, local, SEEK_SET) != 0) ||
+            (fread(header, 1, sizeof(header), fid) != sizeof(header)) ||
+            (zip_u32(header) != 0x04034b50) ||
+            (fseek(fid, zip_u16(header + 26) + zip_u16(header + 28),
+                 SEEK_CUR) != 0))
+                goto error;
+
+        return TURTLE_RETURN_SUCCESS;
+error:
+        return TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
+            "invalid zip archive `%s'", hgt->path);
 }
 
 static enum turtle_return hgt_read(struct turtle_io * io,
     struct turtle_map * map, struct turtle_error_context * error_)
 {
         struct hgt_io * hgt = (struct hgt_io *)io;
+        const int n = io->meta.nx * io->meta.ny;
+
+        /* Inflate zipped data straight into the map */
+        if (hgt->zipped) {
+                int method;
+                unsigned long size;
+                if (zip_locate(hgt, &method, &size, error_) !=
+                    TURTLE_RETURN_SUCCESS)
+                        return error_->code;
+                if (method == 8) {
+                        return turtle_inflate_(hgt->fid, size, map->data,
+                            n * sizeof(*map->data), error_);
+                }
+        }
 
         /* Load the raw data from file */
-        const int n = io->meta.nx * io->meta.ny;
         if (fread(map->data, sizeof(*map->data), n, hgt->fid) != n) {
                 return TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
                     "missing data when reading file `%s'", hgt->path);
@@ -165,6 +286,7 @@ enum turtle_return turtle_io_hgt_create_(
         memset(hgt, 0x0, sizeof(*hgt));
         hgt->fid = NULL;
         hgt->path = NULL;
+        hgt->zipped = 0;
         hgt->base.meta.projection.type = PROJECTION_NONE;
 
         hgt->base.open = &hgt_open;
@@ -173,6 +295,8 @@ enum turtle_return turtle_io_hgt_create_(
         hgt->base.write = NULL;
 
         hgt->base.meta.get_z = &get_z;
+        hgt->base.meta.flipped = 1;
+        hgt->base.meta.raw_encoding = TURTLE_MAP_ENCODING_INT16_BE;
         hgt->base.meta.set_z = &set_z;
 
         return TURTLE_RETURN_SUCCESS;
@@ -405,7 +405,7 @@ static void png16_close(struct turtle_io * io)
 static double get_z(const struct turtle_map * map, int ix, int iy)
 {
         iy = map->meta.ny - 1 - iy;
-        const uint16_t iz = (uint16_t)ntohs(map->data[iy * map->meta.nx + ix]);
+        const uint16_t iz = (uint16_t)ntohs(map->data[iy * map->stride + ix]);
         return map->meta.z0 + iz * map->meta.dz;
 }
 
@@ -413,7 +413,7 @@ static void set_z(struct turtle_map * map, int ix, int iy, double z)
 {
         const double d = round((z - map->meta.z0) / map->meta.dz);
         iy = map->meta.ny - 1 - iy;
-        map->data[iy * map->meta.nx + ix] = (uint16_t)htons(d);
+        map->data[iy * map->stride + ix] = (uint16_t)htons(d);
 }
 
 static enum turtle_return png16_read(struct turtle_io * io,
@@ -573,6 +573,8 @@ enum turtle_return turtle_io_png16_create_(
         png16->base.write = &png16_write;
 
         png16->base.meta.get_z = &get_z;
+        png16->base.meta.flipped = 1;
+        png16->base.meta.raw_encoding = TURTLE_MAP_ENCODING_UINT16_BE;
         png16->base.meta.set_z = &set_z;
 
         return TURTLE_RETURN_SUCCESS;
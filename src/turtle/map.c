@@ -28,6 +28,10 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef TURTLE_NO_PTHREAD
+/* POSIX threads */
+#include <pthread.h>
+#endif
 /* TURTLE library */
 #include "turtle.h"
 #include "turtle/error.h"
@@ -37,40 +41,82 @@
 #include "turtle/projection.h"
 #include "turtle/stack.h"
 
+#ifndef M_PI
+/* Define pi, if unknown */
+#define M_PI 3.14159265358979323846
+#endif
+
 /* Default data getter */
 static double get_default_z(const struct turtle_map * map, int ix, int iy)
 {
-        return map->meta.z0 + map->data[iy * map->meta.nx + ix] * map->meta.dz;
+        return map->meta.z0 + map->data[iy * map->stride + ix] * map->meta.dz;
 }
 
 /* Default data setter */
 static void set_default_z(struct turtle_map * map, int ix, int iy, double z)
 {
         const double d = round((z - map->meta.z0) / map->meta.dz);
-        map->data[iy * map->meta.nx + ix] = (uint16_t)d;
+        map->data[iy * map->stride + ix] = (uint16_t)d;
+}
+
+/* Set the default getter and setter, i.e. for maps created in memory */
+void turtle_map_meta_default_(struct turtle_map_meta * meta)
+{
+        meta->get_z = &get_default_z;
+        meta->set_z = &set_default_z;
+        meta->flipped = 0;
+        meta->raw_encoding = TURTLE_MAP_ENCODING_UINT16;
+        strcpy(meta->encoding, "none");
+}
+
+/* Allocate a map owning its elevation data. The meta data are left
+ * uninitialised
+ */
+struct turtle_map * turtle_map_allocate_(int nx, int ny)
+{
+        struct turtle_map * map =
+            malloc(sizeof(*map) + nx * ny * sizeof(*map->data));
+        if (map == NULL) return NULL;
+
+        map->stack = NULL;
+        memset(&map->element, 0x0, sizeof(map->element));
+        map->clients = 0;
+        map->pinned = 0;
+        map->parent = NULL;
+        map->references = 1;
+        map->ix0 = map->iy0 = 0;
+        map->data = map->buffer;
+        map->stride = nx;
+        map->slopes = NULL;
+        map->sums = NULL;
+        map->extrema = NULL;
+
+        return map;
 }
 
 /* Create a handle to a new empty map */
-enum turtle_return turtle_map_create(struct turtle_map ** map,
-    const struct turtle_map_info * info, const char * projection)
+enum turtle_return turtle_map_create_(struct turtle_map ** map,
+    const struct turtle_map_info * info, const char * projection,
+    struct turtle_error_context * error_)
 {
-        TURTLE_ERROR_INITIALISE(&turtle_map_create);
         *map = NULL;
 
         /* Check the input arguments. */
         if ((info->nx <= 0) || (info->ny <= 0) || (info->z[0] == info->z[1]))
-                return TURTLE_ERROR_MESSAGE(
+                return TURTLE_ERROR_REGISTER(
                     TURTLE_RETURN_DOMAIN_ERROR, "invalid input parameter(s)");
 
         struct turtle_projection proj;
         if (turtle_projection_configure_(&proj, projection, error_) !=
             TURTLE_RETURN_SUCCESS)
-                return TURTLE_ERROR_RAISE();
+                return error_->code;
 
         /* Allocate the map memory */
-        *map =
-            malloc(sizeof(**map) + info->nx * info->ny * sizeof(*(*map)->data));
-        if (*map == NULL) return TURTLE_ERROR_MEMORY();
+        *map = turtle_map_allocate_(info->nx, info->ny);
+        if (*map == NULL) {
+                return TURTLE_ERROR_REGISTER(
+                    TURTLE_RETURN_MEMORY_ERROR, "could not allocate memory");
+        }
 
         /* Fill the identifiers */
         (*map)->meta.nx = info->nx;
@@ -86,16 +132,29 @@ enum turtle_return turtle_map_create(struct turtle_map ** map,
         memcpy(
             &(*map)->meta.projection, &proj, sizeof((*map)->meta.projection));
         memset((*map)->data, 0x0, sizeof(*(*map)->data) * info->nx * info->ny);
+        turtle_map_meta_default_(&(*map)->meta);
 
-        (*map)->meta.get_z = &get_default_z;
-        (*map)->meta.set_z = &set_default_z;
-        strcpy((*map)->meta.encoding, "none");
+        return TURTLE_RETURN_SUCCESS;
+}
 
-        (*map)->stack = NULL;
-        memset(&(*map)->element, 0x0, sizeof((*map)->element));
-        (*map)->clients = 0;
+enum turtle_return turtle_map_create(struct turtle_map ** map,
+    const struct turtle_map_info * info, const char * projection)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_map_create);
+        turtle_map_create_(map, info, projection, error_);
+        return TURTLE_ERROR_RAISE();
+}
 
-        return TURTLE_RETURN_SUCCESS;
+/* Release a reference to a map, and its memory if it was the last one */
+static void map_release(struct turtle_map * map)
+{
+        if (__sync_sub_and_fetch(&map->references, 1) > 0) return;
+        struct turtle_map * parent = map->parent;
+        free(map->slopes);
+        free(map->sums);
+        free(map->extrema);
+        free(map);
+        if (parent != NULL) map_release(parent);
 }
 
 /* Release the map memory and update any stack */
@@ -108,10 +167,61 @@ void turtle_map_destroy(struct turtle_map ** map)
                 turtle_list_remove_(&(*map)->stack->tiles, *map);
         }
 
-        free(*map);
+        map_release(*map);
         *map = NULL;
 }
 
+/* Create a view over a sub-grid of a map */
+enum turtle_return turtle_map_view(struct turtle_map * parent, int ix0,
+    int iy0, int nx, int ny, struct turtle_map ** view)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_map_view);
+        *view = NULL;
+
+        if (parent == NULL) {
+                return TURTLE_ERROR_MESSAGE(
+                    TURTLE_RETURN_BAD_ADDRESS, "invalid null map");
+        } else if ((nx <= 0) || (ny <= 0) || (ix0 < 0) || (iy0 < 0) ||
+            (ix0 + nx > parent->meta.nx) || (iy0 + ny > parent->meta.ny)) {
+                return TURTLE_ERROR_MESSAGE(
+                    TURTLE_RETURN_DOMAIN_ERROR, "invalid view bounds");
+        } else if (parent->stack != NULL) {
+                return TURTLE_ERROR_MESSAGE(TURTLE_RETURN_BAD_ADDRESS,
+                    "invalid view of a stack tile");
+        }
+
+        *view = malloc(sizeof(**view));
+        if (*view == NULL) return TURTLE_ERROR_MEMORY();
+
+        /* Reference the owner of the data, i.e. not a view */
+        struct turtle_map * owner =
+            (parent->parent != NULL) ? parent->parent : parent;
+        __sync_add_and_fetch(&owner->references, 1);
+
+        memcpy(&(*view)->meta, &parent->meta, sizeof((*view)->meta));
+        (*view)->meta.nx = nx;
+        (*view)->meta.ny = ny;
+        (*view)->meta.x0 = parent->meta.x0 + ix0 * parent->meta.dx;
+        (*view)->meta.y0 = parent->meta.y0 + iy0 * parent->meta.dy;
+        (*view)->stack = NULL;
+        memset(&(*view)->element, 0x0, sizeof((*view)->element));
+        (*view)->clients = 0;
+        (*view)->pinned = 0;
+        (*view)->parent = owner;
+        (*view)->ix0 = parent->ix0 + ix0;
+        (*view)->iy0 = parent->iy0 + iy0;
+        (*view)->references = 1;
+        const int row = parent->meta.flipped ?
+            parent->meta.ny - ny - iy0 : iy0;
+        (*view)->data = parent->data + row * parent->stride + ix0;
+        (*view)->stride = parent->stride;
+        (*view)->slopes = NULL;
+        (*view)->sums = NULL;
+        (*view)->extrema = NULL;
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
 /* Load a map from a data file */
 enum turtle_return turtle_map_load_(struct turtle_map ** map, const char * path,
     struct turtle_error_context * error_)
@@ -126,8 +236,7 @@ enum turtle_return turtle_map_load_(struct turtle_map ** map, const char * path,
                 goto exit;
 
         /* Allocate the map */
-        *map = malloc(
-            sizeof(**map) + io->meta.nx * io->meta.ny * sizeof(*(*map)->data));
+        *map = turtle_map_allocate_(io->meta.nx, io->meta.ny);
         if (*map == NULL) {
                 TURTLE_ERROR_VREGISTER(TURTLE_RETURN_MEMORY_ERROR,
                     "could not allocate memory for map `%s'", path);
@@ -136,9 +245,6 @@ enum turtle_return turtle_map_load_(struct turtle_map ** map, const char * path,
 
         /* Initialise the map data */
         memcpy(&(*map)->meta, &io->meta, sizeof((*map)->meta));
-        (*map)->stack = NULL;
-        memset(&(*map)->element, 0x0, sizeof((*map)->element));
-        (*map)->clients = 0;
 
         /* Load the topography data */
         if (io->read(io, *map, error_) != TURTLE_RETURN_SUCCESS) {
@@ -201,6 +307,17 @@ enum turtle_return turtle_map_fill(
                     "elevation is outside of map span");
         map->meta.set_z(map, ix, iy, elevation);
 
+        /* Invalidate any slope bounds or statistics tables. These are kept
+         * by the owner of the data, which views share
+         */
+        struct turtle_map * owner = (map->parent != NULL) ? map->parent : map;
+        free(owner->slopes);
+        owner->slopes = NULL;
+        free(owner->sums);
+        owner->sums = NULL;
+        free(owner->extrema);
+        owner->extrema = NULL;
+
         return TURTLE_RETURN_SUCCESS;
 }
 
@@ -225,10 +342,11 @@ enum turtle_return turtle_map_node(const struct turtle_map * map, int ix,
         return TURTLE_RETURN_SUCCESS;
 }
 
-/* Interpolate the elevation at a given location */
-enum turtle_return turtle_map_elevation_(const struct turtle_map * map,
-    double x, double y, double * z, int * inside,
-    struct turtle_error_context * error_)
+/* Locate the interpolation cell of a given location. Returns 0 if the
+ * location is outside of the map
+ */
+static int map_locate(const struct turtle_map * map, double x, double y,
+    int * ix_, int * iy_, double * hx_, double * hy_)
 {
         double hx = (x - map->meta.x0) / map->meta.dx;
         double hy = (y - map->meta.y0) / map->meta.dy;
@@ -236,14 +354,8 @@ enum turtle_return turtle_map_elevation_(const struct turtle_map * map,
         int iy = (int)hy;
 
         if ((hx > map->meta.nx - 1) || (hx < 0) ||
-            (hy > map->meta.ny - 1) || (hy < 0)) {
-                if (inside != NULL) {
-                        *inside = 0;
-                        return TURTLE_RETURN_SUCCESS;
-                } else {
-                        return TURTLE_ERROR_OUTSIDE_MAP();
-                }
-        }
+            (hy > map->meta.ny - 1) || (hy < 0))
+                return 0;
         if (ix == map->meta.nx - 1) {
                 ix--;
                 hx = 1.;
@@ -255,6 +367,29 @@ enum turtle_return turtle_map_elevation_(const struct turtle_map * map,
         } else
                 hy -= iy;
 
+        *ix_ = ix;
+        *iy_ = iy;
+        *hx_ = hx;
+        *hy_ = hy;
+        return 1;
+}
+
+/* Interpolate the elevation at a given location */
+enum turtle_return turtle_map_elevation_(const struct turtle_map * map,
+    double x, double y, double * z, int * inside,
+    struct turtle_error_context * error_)
+{
+        int ix, iy;
+        double hx, hy;
+        if (!map_locate(map, x, y, &ix, &iy, &hx, &hy)) {
+                if (inside != NULL) {
+                        *inside = 0;
+                        return TURTLE_RETURN_SUCCESS;
+                } else {
+                        return TURTLE_ERROR_OUTSIDE_MAP();
+                }
+        }
+
         turtle_map_getter_t * get_z = map->meta.get_z;
         const double z00 = get_z(map, ix, iy);
         const double z10 = get_z(map, ix + 1, iy);
@@ -267,6 +402,173 @@ enum turtle_return turtle_map_elevation_(const struct turtle_map * map,
         return TURTLE_RETURN_SUCCESS;
 }
 
+/* Interpolate the elevation at a given location, in single precision. The
+ * cell is located in double precision, thus the relative error on the
+ * elevation is of a few float epsilons only
+ */
+void turtle_map_elevation_single_(const struct turtle_map * map, double x,
+    double y, double * z, int * inside)
+{
+        int ix, iy;
+        double hx_, hy_;
+        if (!map_locate(map, x, y, &ix, &iy, &hx_, &hy_)) {
+                *inside = 0;
+                return;
+        }
+
+        turtle_map_getter_t * get_z = map->meta.get_z;
+        const float hx = (float)hx_, hy = (float)hy_;
+        const float z00 = (float)get_z(map, ix, iy);
+        const float z10 = (float)get_z(map, ix + 1, iy);
+        const float z01 = (float)get_z(map, ix, iy + 1);
+        const float z11 = (float)get_z(map, ix + 1, iy + 1);
+        const float z0 = z00 + (z10 - z00) * hx;
+        const float z1 = z01 + (z11 - z01) * hx;
+        *z = z0 + (z1 - z0) * hy;
+        *inside = 1;
+}
+
+/* Compute bounds on the slope of the bilinear interpolation, per block of
+ * nodes. The bound of a block covers its neighbours as well. Thus, it holds
+ * within the reach of the block, i.e. its smallest horizontal extent
+ */
+static float * map_slopes(const struct turtle_map * map)
+{
+        const int nx = (map->meta.nx > 1) ? map->meta.nx - 1 : 1;
+        const int ny = (map->meta.ny > 1) ? map->meta.ny - 1 : 1;
+        const int bx = (nx - 1) / TURTLE_MAP_BLOCK + 1;
+        const int by = (ny - 1) / TURTLE_MAP_BLOCK + 1;
+        float * slopes = malloc(2 * bx * by * sizeof(*slopes));
+        double * g = malloc(3 * bx * by * sizeof(*g));
+        if ((slopes == NULL) || (g == NULL)) {
+                free(slopes);
+                free(g);
+                return NULL;
+        }
+
+        /* Horizontal lengths, in m. For geodetic maps, lower bounds are
+         * used, i.e. the semi-major axis for the longitude and the meridian
+         * radius at the equator for the latitude
+         */
+        const int geodetic = (map->meta.projection.type == PROJECTION_NONE);
+        const double deg = M_PI / 180.;
+        const double dy = fabs(map->meta.dy) * (geodetic ?
+            6335439. * deg : 1.);
+
+        /* Bound the slopes per block, i.e. the x and y gradients and the
+         * reach
+         */
+        memset(g, 0x0, 2 * bx * by * sizeof(*g));
+        double * reach = g + 2 * bx * by;
+        int i;
+        for (i = 0; i < bx * by; i++) reach[i] = DBL_MAX;
+        turtle_map_getter_t * get_z = map->meta.get_z;
+        int iy;
+        for (iy = 0; iy < ny; iy++) {
+                const int iy1 = (map->meta.ny > 1) ? iy + 1 : iy;
+                double dx = fabs(map->meta.dx);
+                if (geodetic) {
+                        const double y0 = fabs(map->meta.y0 + iy *
+                            map->meta.dy);
+                        const double y1 = fabs(map->meta.y0 + iy1 *
+                            map->meta.dy);
+                        double c = cos(((y0 > y1) ? y0 : y1) * deg);
+                        if (c < 1E-03) c = 1E-03;
+                        dx *= 6378137. * deg * c;
+                }
+                const int row = (iy / TURTLE_MAP_BLOCK) * bx;
+                int ix;
+                for (ix = 0; ix < nx; ix++) {
+                        const int ix1 = (map->meta.nx > 1) ? ix + 1 : ix;
+                        const double z00 = get_z(map, ix, iy);
+                        const double z10 = get_z(map, ix1, iy);
+                        const double z01 = get_z(map, ix, iy1);
+                        const double z11 = get_z(map, ix1, iy1);
+                        double gx = fabs(z10 - z00);
+                        double t = fabs(z11 - z01);
+                        if (t > gx) gx = t;
+                        double gy = fabs(z01 - z00);
+                        t = fabs(z11 - z10);
+                        if (t > gy) gy = t;
+                        gx = (dx > 0.) ? gx / dx : 0.;
+                        gy = (dy > 0.) ? gy / dy : 0.;
+
+                        const int k = row + ix / TURTLE_MAP_BLOCK;
+                        if (gx > g[2 * k]) g[2 * k] = gx;
+                        if (gy > g[2 * k + 1]) g[2 * k + 1] = gy;
+                        const double r = TURTLE_MAP_BLOCK *
+                            ((dx < dy) ? dx : dy);
+                        if (r < reach[k]) reach[k] = r;
+                }
+        }
+
+        /* Dilate the bounds over the neighbouring blocks */
+        int jy;
+        for (jy = 0; jy < by; jy++) {
+                int jx;
+                for (jx = 0; jx < bx; jx++) {
+                        double gx = 0., gy = 0., r = DBL_MAX;
+                        int ky;
+                        for (ky = jy - 1; ky <= jy + 1; ky++) {
+                                if ((ky < 0) || (ky >= by)) continue;
+                                int kx;
+                                for (kx = jx - 1; kx <= jx + 1; kx++) {
+                                        if ((kx < 0) || (kx >= bx)) continue;
+                                        const int k = ky * bx + kx;
+                                        if (g[2 * k] > gx) gx = g[2 * k];
+                                        if (g[2 * k + 1] > gy)
+                                                gy = g[2 * k + 1];
+                                        if (reach[k] < r) r = reach[k];
+                                }
+                        }
+                        const int k = jy * bx + jx;
+                        slopes[2 * k] = (float)sqrt(gx * gx + gy * gy);
+                        slopes[2 * k + 1] = (float)r;
+                }
+        }
+        free(g);
+
+        return slopes;
+}
+
+/* Get a bound on the slope of the map around a given location, and the
+ * horizontal reach of this bound, in m
+ */
+int turtle_map_slope_(struct turtle_map * map, double x, double y,
+    double * slope, double * reach)
+{
+        int ix, iy;
+        double hx, hy;
+        if (!map_locate(map, x, y, &ix, &iy, &hx, &hy)) return EXIT_FAILURE;
+
+        /* Views use the bounds of the owner of their data, which are also
+         * valid over any sub-window
+         */
+        if (map->parent != NULL)
+                return turtle_map_slope_(map->parent, x, y, slope, reach);
+
+        float * slopes = map->slopes;
+        if (slopes == NULL) {
+                /* Build the bounds. Concurrent builds might occur, in which
+                 * case a single table is kept
+                 */
+                slopes = map_slopes(map);
+                if (slopes == NULL) return EXIT_FAILURE;
+                if (!__sync_bool_compare_and_swap(
+                    &map->slopes, NULL, slopes)) {
+                        free(slopes);
+                        slopes = map->slopes;
+                }
+        }
+
+        const int nx = (map->meta.nx > 1) ? map->meta.nx - 1 : 1;
+        const int bx = (nx - 1) / TURTLE_MAP_BLOCK + 1;
+        const int k = (iy / TURTLE_MAP_BLOCK) * bx + ix / TURTLE_MAP_BLOCK;
+        *slope = slopes[2 * k];
+        *reach = slopes[2 * k + 1];
+        return EXIT_SUCCESS;
+}
+
 enum turtle_return turtle_map_elevation(
     const struct turtle_map * map, double x, double y, double * z, int * inside)
 {
@@ -302,3 +604,427 @@ void turtle_map_meta(const struct turtle_map * map,
                 *projection = turtle_projection_name(&map->meta.projection);
         }
 }
+
+/* Get a read-only access to the raw elevation data */
+void turtle_map_data_get(
+    const struct turtle_map * map, struct turtle_map_data * data)
+{
+        const struct turtle_map_meta * meta = &map->meta;
+        if (meta->flipped) {
+                /* Rows are stored from north to south */
+                data->data = map->data + (meta->ny - 1) * map->stride;
+                data->stride = -map->stride;
+        } else {
+                data->data = map->data;
+                data->stride = map->stride;
+        }
+        data->nx = meta->nx;
+        data->ny = meta->ny;
+        data->x0 = meta->x0;
+        data->y0 = meta->y0;
+        data->dx = meta->dx;
+        data->dy = meta->dy;
+        data->encoding = meta->raw_encoding;
+        if ((data->encoding == TURTLE_MAP_ENCODING_INT16) ||
+            (data->encoding == TURTLE_MAP_ENCODING_INT16_BE)) {
+                /* Signed values are raw elevations, in m */
+                data->z0 = 0.;
+                data->dz = 1.;
+        } else {
+                data->z0 = meta->z0;
+                data->dz = meta->dz;
+        }
+}
+
+/* Number of threads for building statistics tables, and minimum number of
+ * map nodes for a parallel build
+ */
+#define STATS_THREADS 4
+#define STATS_PARALLEL_SIZE 262144
+
+/* Size of the blocks of nodes over which extrema are tabulated */
+#define EXTREMA_BLOCK 32
+
+/* Work item for building statistics tables, over a range of rows or of
+ * columns
+ */
+struct stats_job {
+        const struct turtle_map * map;
+        void (*run)(struct stats_job * job);
+        double * sums;
+        float * extrema;
+        int i0, i1;
+};
+
+/* Layout of the extrema tables, i.e. the number of blocks of nodes and the
+ * number of levels along x and y. Level (a, b) tabulates rectangles of
+ * 2^a x 2^b blocks, along y and x
+ */
+struct extrema_layout {
+        int nx, ny;
+        int lx, ly;
+};
+
+static void extrema_layout(
+    const struct turtle_map * map, struct extrema_layout * layout)
+{
+        layout->nx = (map->meta.nx - 1) / EXTREMA_BLOCK + 1;
+        layout->ny = (map->meta.ny - 1) / EXTREMA_BLOCK + 1;
+        layout->lx = 1;
+        while ((1 << layout->lx) <= layout->nx) layout->lx++;
+        layout->ly = 1;
+        while ((1 << layout->ly) <= layout->ny) layout->ly++;
+}
+
+/* Get the minimum values of a level. The maximum values follow */
+static float * extrema_level(
+    const struct extrema_layout * layout, float * extrema, int a, int b)
+{
+        const size_t n = (size_t)layout->nx * layout->ny;
+        return extrema + 2 * n * (size_t)(a * layout->lx + b);
+}
+
+/* Cumulate the elevations along rows */
+static void sums_rows(struct stats_job * job)
+{
+        const struct turtle_map * map = job->map;
+        const int nx = map->meta.nx;
+        int iy;
+        for (iy = job->i0; iy < job->i1; iy++) {
+                double * row = job->sums + (iy + 1) * (nx + 1);
+                row[0] = 0.;
+                int ix;
+                for (ix = 0; ix < nx; ix++)
+                        row[ix + 1] = row[ix] + map->meta.get_z(map, ix, iy);
+        }
+}
+
+/* Cumulate the row sums along columns */
+static void sums_columns(struct stats_job * job)
+{
+        const int nx = job->map->meta.nx, ny = job->map->meta.ny;
+        int iy;
+        for (iy = 1; iy <= ny; iy++) {
+                double * row = job->sums + iy * (nx + 1);
+                const double * previous = row - (nx + 1);
+                int ix;
+                for (ix = job->i0; ix < job->i1; ix++) row[ix] += previous[ix];
+        }
+}
+
+/* Compute the extrema over each block of nodes, for a range of block rows */
+static void extrema_blocks(struct stats_job * job)
+{
+        const struct turtle_map * map = job->map;
+        struct extrema_layout layout;
+        extrema_layout(map, &layout);
+        const size_t n = (size_t)layout.nx * layout.ny;
+        int jy;
+        for (jy = job->i0; jy < job->i1; jy++) {
+                const int iy0 = jy * EXTREMA_BLOCK;
+                const int iy1 = (iy0 + EXTREMA_BLOCK < map->meta.ny) ?
+                    iy0 + EXTREMA_BLOCK : map->meta.ny;
+                int jx;
+                for (jx = 0; jx < layout.nx; jx++) {
+                        const int ix0 = jx * EXTREMA_BLOCK;
+                        const int ix1 = (ix0 + EXTREMA_BLOCK < map->meta.nx) ?
+                            ix0 + EXTREMA_BLOCK : map->meta.nx;
+                        double zmin = DBL_MAX, zmax = -DBL_MAX;
+                        int iy;
+                        for (iy = iy0; iy < iy1; iy++) {
+                                int ix;
+                                for (ix = ix0; ix < ix1; ix++) {
+                                        const double z =
+                                            map->meta.get_z(map, ix, iy);
+                                        if (z < zmin) zmin = z;
+                                        if (z > zmax) zmax = z;
+                                }
+                        }
+                        const size_t k = (size_t)jy * layout.nx + jx;
+                        job->extrema[k] = (float)zmin;
+                        job->extrema[n + k] = (float)zmax;
+                }
+        }
+}
+
+/* Compute the extrema of level (a, b) by merging two rectangles of the
+ * previous level, along y if a > 0, otherwise along x
+ */
+static void extrema_merge(
+    const struct extrema_layout * layout, float * extrema, int a, int b)
+{
+        const size_t n = (size_t)layout->nx * layout->ny;
+        const float * t0 = (a > 0) ? extrema_level(layout, extrema, a - 1, b) :
+                                     extrema_level(layout, extrema, a, b - 1);
+        float * t1 = extrema_level(layout, extrema, a, b);
+        const size_t shift = (a > 0) ? (size_t)(1 << (a - 1)) * layout->nx :
+                                       (size_t)(1 << (b - 1));
+        const int ny = layout->ny - (1 << a) + 1;
+        const int nx = layout->nx - (1 << b) + 1;
+        int jy;
+        for (jy = 0; jy < ny; jy++) {
+                int jx;
+                for (jx = 0; jx < nx; jx++) {
+                        const size_t k = (size_t)jy * layout->nx + jx;
+                        const float * u = t0 + k, * v = t0 + k + shift;
+                        t1[k] = (*v < *u) ? *v : *u;
+                        t1[n + k] = (v[n] > u[n]) ? v[n] : u[n];
+                }
+        }
+}
+
+#ifndef TURTLE_NO_PTHREAD
+static void * stats_thread(void * arg)
+{
+        struct stats_job * job = arg;
+        job->run(job);
+        return NULL;
+}
+#endif
+
+/* Run a job over n rows or columns, using several threads for large maps */
+static void stats_run(struct stats_job * job, int n)
+{
+#ifndef TURTLE_NO_PTHREAD
+        if (job->map->meta.nx * job->map->meta.ny >= STATS_PARALLEL_SIZE) {
+                struct stats_job jobs[STATS_THREADS];
+                pthread_t threads[STATS_THREADS];
+                int started[STATS_THREADS], i;
+                for (i = 0; i < STATS_THREADS; i++) {
+                        memcpy(jobs + i, job, sizeof(*job));
+                        jobs[i].i0 = (i * n) / STATS_THREADS;
+                        jobs[i].i1 = ((i + 1) * n) / STATS_THREADS;
+                        started[i] = (i > 0) && (pthread_create(threads + i,
+                            NULL, &stats_thread, jobs + i) == 0);
+                }
+                for (i = 0; i < STATS_THREADS; i++) {
+                        if (!started[i]) job->run(jobs + i);
+                }
+                for (i = 1; i < STATS_THREADS; i++) {
+                        if (started[i]) pthread_join(threads[i], NULL);
+                }
+                return;
+        }
+#endif
+        job->i0 = 0;
+        job->i1 = n;
+        job->run(job);
+}
+
+/* Build the summed-area table of a map */
+static double * map_sums(const struct turtle_map * map)
+{
+        const int nx = map->meta.nx, ny = map->meta.ny;
+        const size_t n = (size_t)(nx + 1) * (ny + 1);
+        if (n > SIZE_MAX / sizeof(double)) return NULL;
+        double * sums = malloc(n * sizeof(*sums));
+        if (sums == NULL) return NULL;
+        memset(sums, 0x0, (nx + 1) * sizeof(*sums));
+
+        struct stats_job job = { map, &sums_rows, sums, NULL, 0, 0 };
+        stats_run(&job, ny);
+        job.run = &sums_columns;
+        stats_run(&job, nx + 1);
+
+        return sums;
+}
+
+/* Build the sparse tables of the elevation extrema of a map, over
+ * rectangles of 2^a x 2^b blocks of nodes
+ */
+static float * map_extrema(const struct turtle_map * map)
+{
+        struct extrema_layout layout;
+        extrema_layout(map, &layout);
+        const size_t n = (size_t)layout.nx * layout.ny;
+        const size_t m = 2 * (size_t)layout.lx * layout.ly;
+        if (n > SIZE_MAX / sizeof(float) / m) return NULL;
+        float * extrema = malloc(m * n * sizeof(*extrema));
+        if (extrema == NULL) return NULL;
+
+        struct stats_job job = { map, &extrema_blocks, NULL, extrema, 0, 0 };
+        stats_run(&job, layout.ny);
+        int a;
+        for (a = 0; a < layout.ly; a++) {
+                int b;
+                for (b = (a > 0) ? 0 : 1; b < layout.lx; b++)
+                        extrema_merge(&layout, extrema, a, b);
+        }
+
+        return extrema;
+}
+
+/* Update the extrema with the nodes of a range, bounds included */
+static void extrema_scan(const struct turtle_map * map, int ix0, int ix1,
+    int iy0, int iy1, double * zmin, double * zmax)
+{
+        int iy;
+        for (iy = iy0; iy <= iy1; iy++) {
+                int ix;
+                for (ix = ix0; ix <= ix1; ix++) {
+                        const double z = map->meta.get_z(map, ix, iy);
+                        if (z < *zmin) *zmin = z;
+                        if (z > *zmax) *zmax = z;
+                }
+        }
+}
+
+/* Get the base 2 logarithm of a positive integer, rounded down */
+static int extrema_log2(int n)
+{
+        int l = 0;
+        while ((2 << l) <= n) l++;
+        return l;
+}
+
+/* Get the range of nodes within a window along one axis. Returns 0 if there
+ * are none
+ */
+static int window_nodes(
+    int n, double u0, double du, double a, double b, int * i0, int * i1)
+{
+        if (n == 1) {
+                *i0 = *i1 = 0;
+                return (((a <= u0) && (u0 <= b)) || ((b <= u0) && (u0 <= a)));
+        }
+
+        double h0 = (a - u0) / du, h1 = (b - u0) / du;
+        if (h0 > h1) {
+                const double tmp = h0;
+                h0 = h1;
+                h1 = tmp;
+        }
+        if ((h1 < -1E-09) || (h0 > n - 1 + 1E-09)) return 0;
+        *i0 = (h0 <= 0.) ? 0 : (int)ceil(h0 - 1E-09);
+        *i1 = (h1 >= n - 1) ? n - 1 : (int)floor(h1 + 1E-09);
+        return (*i0 <= *i1);
+}
+
+/* Compute statistics of the elevation over a window of nodes */
+enum turtle_return turtle_map_window_stats(struct turtle_map * map,
+    double x0, double x1, double y0, double y1, double * mean, double * min,
+    double * max)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_map_window_stats);
+
+        if (map == NULL) {
+                return TURTLE_ERROR_MESSAGE(
+                    TURTLE_RETURN_BAD_ADDRESS, "invalid null map");
+        }
+        int ix0, ix1, iy0, iy1;
+        if (!window_nodes(map->meta.nx, map->meta.x0, map->meta.dx, x0, x1,
+                &ix0, &ix1) ||
+            !window_nodes(map->meta.ny, map->meta.y0, map->meta.dy, y0, y1,
+                &iy0, &iy1)) {
+                return TURTLE_ERROR_MESSAGE(
+                    TURTLE_RETURN_DOMAIN_ERROR, "empty window");
+        }
+
+        /* Views use the tables of the owner of their data. Thus, the window
+         * is translated to the nodes of the owner
+         */
+        if (map->parent != NULL) {
+                ix0 += map->ix0;
+                ix1 += map->ix0;
+                iy0 += map->iy0;
+                iy1 += map->iy0;
+                map = map->parent;
+        }
+
+        if (mean != NULL) {
+                /* Build the summed-area table, if not already done.
+                 * Concurrent builds might occur, in which case a single
+                 * table is kept
+                 */
+                double * sums = map->sums;
+                if (sums == NULL) {
+                        sums = map_sums(map);
+                        if (sums == NULL) return TURTLE_ERROR_MEMORY();
+                        if (!__sync_bool_compare_and_swap(
+                            &map->sums, NULL, sums)) {
+                                free(sums);
+                                sums = map->sums;
+                        }
+                }
+
+                const int stride = map->meta.nx + 1;
+                const double * r0 = sums + iy0 * stride;
+                const double * r1 = sums + (iy1 + 1) * stride;
+                const double s =
+                    r1[ix1 + 1] - r1[ix0] - r0[ix1 + 1] + r0[ix0];
+                *mean = s / ((ix1 - ix0 + 1) * (double)(iy1 - iy0 + 1));
+        }
+
+        if ((min != NULL) || (max != NULL)) {
+                /* Build the sparse tables, if not already done */
+                float * extrema = map->extrema;
+                if (extrema == NULL) {
+                        extrema = map_extrema(map);
+                        if (extrema == NULL) return TURTLE_ERROR_MEMORY();
+                        if (!__sync_bool_compare_and_swap(
+                            &map->extrema, NULL, extrema)) {
+                                free(extrema);
+                                extrema = map->extrema;
+                        }
+                }
+
+                /* Get the range of blocks fully within the window. The
+                 * last block might be partial, in which case it is within
+                 * the window if the latter extends to the map border
+                 */
+                const int bx0 = (ix0 + EXTREMA_BLOCK - 1) / EXTREMA_BLOCK;
+                const int bx1 = ((ix1 == map->meta.nx - 1) ?
+                    (ix1 / EXTREMA_BLOCK + 1) : (ix1 + 1) / EXTREMA_BLOCK) - 1;
+                const int by0 = (iy0 + EXTREMA_BLOCK - 1) / EXTREMA_BLOCK;
+                const int by1 = ((iy1 == map->meta.ny - 1) ?
+                    (iy1 / EXTREMA_BLOCK + 1) : (iy1 + 1) / EXTREMA_BLOCK) - 1;
+                double zmin = DBL_MAX, zmax = -DBL_MAX;
+                if ((bx0 > bx1) || (by0 > by1)) {
+                        extrema_scan(map, ix0, ix1, iy0, iy1, &zmin, &zmax);
+                } else {
+                        /* Cover the blocks with four overlapping rectangles
+                         * of the sparse tables
+                         */
+                        struct extrema_layout layout;
+                        extrema_layout(map, &layout);
+                        const size_t n = (size_t)layout.nx * layout.ny;
+                        const int a = extrema_log2(by1 - by0 + 1);
+                        const int b = extrema_log2(bx1 - bx0 + 1);
+                        const float * t =
+                            extrema_level(&layout, extrema, a, b);
+                        const int ky[2] = { by0, by1 - (1 << a) + 1 };
+                        const int kx[2] = { bx0, bx1 - (1 << b) + 1 };
+                        int i;
+                        for (i = 0; i < 4; i++) {
+                                const size_t k =
+                                    (size_t)ky[i / 2] * layout.nx + kx[i % 2];
+                                if (t[k] < zmin) zmin = t[k];
+                                if (t[n + k] > zmax) zmax = t[n + k];
+                        }
+
+                        /* Scan the nodes of partial blocks, along the
+                         * window borders
+                         */
+                        const int cx0 = bx0 * EXTREMA_BLOCK;
+                        const int cx1 = ((bx1 + 1) * EXTREMA_BLOCK <
+                            map->meta.nx) ? (bx1 + 1) * EXTREMA_BLOCK - 1 :
+                                            map->meta.nx - 1;
+                        const int cy0 = by0 * EXTREMA_BLOCK;
+                        const int cy1 = ((by1 + 1) * EXTREMA_BLOCK <
+                            map->meta.ny) ? (by1 + 1) * EXTREMA_BLOCK - 1 :
+                                            map->meta.ny - 1;
+                        extrema_scan(
+                            map, ix0, cx0 - 1, iy0, iy1, &zmin, &zmax);
+                        extrema_scan(
+                            map, cx1 + 1, ix1, iy0, iy1, &zmin, &zmax);
+                        extrema_scan(
+                            map, cx0, cx1, iy0, cy0 - 1, &zmin, &zmax);
+                        extrema_scan(
+                            map, cx0, cx1, cy1 + 1, iy1, &zmin, &zmax);
+                }
+                if (min != NULL) *min = zmin;
+                if (max != NULL) *max = zmax;
+        }
+
+        return TURTLE_RETURN_SUCCESS;
+}
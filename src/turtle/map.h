@@ -29,6 +29,10 @@
 /* Turtle library */
 #include "turtle/list.h"
 #include "turtle/projection.h"
+#include "turtle_inline.h"
+
+/* Size of the blocks of map nodes for slope bounds */
+#define TURTLE_MAP_BLOCK 16
 
 /* Callbacks for getting and setting elevation data */
 struct turtle_map;
@@ -48,6 +52,12 @@ struct turtle_map_meta {
         turtle_map_getter_t * get_z;
         turtle_map_setter_t * set_z;
 
+        /* Flag for data stored from north to south, e.g. for PNG */
+        int flipped;
+
+        /* Encoding of the raw data, as read by the getter */
+        enum turtle_map_encoding raw_encoding;
+
         /* Data encoding format */
         char encoding[8];
 
@@ -65,16 +75,57 @@ struct turtle_map {
         /* Stack data */
         struct turtle_stack * stack;
         int clients;
+        int pinned;
+
+        /* Owner of the elevation data, for views, and number of references
+         * to the data
+         */
+        struct turtle_map * parent;
+        int references;
+
+        /* Offset of a view in the nodes of its owner */
+        int ix0, iy0;
+
+        /* Raw elevation data, with rows of stride nodes */
+        uint16_t * data;
+        int stride;
+
+        /* Bounds on the slope and on the reach of these bounds, per block of
+         * nodes. They are computed on first use, otherwise NULL. Views have
+         * none, but use the ones of their parent
+         */
+        float * slopes;
 
-        /* Placeholder for raw elevation data */
-        uint16_t data[];
+        /* Summed-area table and sparse tables of the elevation, for window
+         * statistics. They are computed on first use, otherwise NULL. Views
+         * have none, but use the ones of their parent
+         */
+        double * sums;
+        float * extrema;
+
+        /* Placeholder for owned elevation data */
+        uint16_t buffer[];
 };
 
+struct turtle_map * turtle_map_allocate_(int nx, int ny);
+
+enum turtle_return turtle_map_create_(struct turtle_map ** map,
+    const struct turtle_map_info * info, const char * projection,
+    struct turtle_error_context * error_);
+
 enum turtle_return turtle_map_elevation_(const struct turtle_map * map,
     double x, double y, double * z, int * inside,
     struct turtle_error_context * error_);
 
+void turtle_map_elevation_single_(const struct turtle_map * map, double x,
+    double y, double * z, int * inside);
+
+int turtle_map_slope_(struct turtle_map * map, double x, double y,
+    double * slope, double * reach);
+
 enum turtle_return turtle_map_load_(struct turtle_map ** map, const char * path,
     struct turtle_error_context * error_);
 
+void turtle_map_meta_default_(struct turtle_map_meta * meta);
+
 #endif
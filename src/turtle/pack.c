@@ -0,0 +1,454 @@
+/*
+ * Copyright (C) 2017 Université Clermont Auvergne, CNRS/IN2P3, LPC
+ * Author: Valentin NIESS (niess@in2p3.fr)
+ *
+ * Topographic Utilities for tRansporting parTicules over Long rangEs (TURTLE)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/*
+ * Single file packs of elevation tiles for the TURTLE library. A pack starts
+ * with a header describing the grid of tiles, followed by an index of the
+ * packed tiles. The raw data of each tile are stored next, optionally
+ * compressed with zlib. Tiles are stored with their in memory encoding, and
+ * thus with the native byte order.
+ */
+
+/* Expose pread */
+#define _POSIX_C_SOURCE 200809L
+
+/* C89 standard library */
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+/* POSIX file descriptors */
+#include <fcntl.h>
+#include <unistd.h>
+/* TURTLE library */
+#include "turtle/compress.h"
+#include "turtle/io.h"
+#include "turtle/pack.h"
+#include "turtle/stack.h"
+
+#define PACK_MAGIC "TURTLEPK"
+#define PACK_VERSION 1
+#define PACK_ORDER 0x01020304
+
+/* On disk header of a pack */
+struct pack_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t order;
+        double latitude_0, latitude_delta;
+        double longitude_0, longitude_delta;
+        int32_t latitude_n, longitude_n;
+        int32_t size;
+        int32_t reserved;
+};
+
+/* On disk index entry of a packed tile */
+struct pack_entry {
+        int32_t index;
+        int32_t compressed;
+        int32_t nx, ny;
+        double x0, y0, z0;
+        double dx, dy, dz;
+        char encoding[8];
+        uint64_t offset;
+        uint64_t size;
+};
+
+/* Check if a file is a pack of tiles */
+int turtle_pack_check_(const char * path)
+{
+        FILE * fid = fopen(path, "rb");
+        if (fid == NULL) return 0;
+        char magic[8];
+        const size_t n = fread(magic, sizeof(magic), 1, fid);
+        fclose(fid);
+        return (n == 1) && (memcmp(magic, PACK_MAGIC, sizeof(magic)) == 0);
+}
+
+/* Read a range of bytes from a file descriptor. Interrupted and short reads
+ * are resumed
+ */
+static int pack_read(int fd, void * buffer, uint64_t size, uint64_t offset)
+{
+        char * cursor = buffer;
+        while (size > 0) {
+                const ssize_t n = pread(fd, cursor, size, offset);
+                if ((n < 0) && (errno == EINTR)) continue;
+                if (n <= 0) return -1;
+                cursor += n;
+                size -= n;
+                offset += n;
+        }
+        return 0;
+}
+
+/* Set the elevation getter and setter corresponding to an encoding */
+static enum turtle_return pack_encoding(struct turtle_map_meta * meta,
+    struct turtle_error_context * error_)
+{
+        if (strcmp(meta->encoding, "none") == 0) {
+                /* Tiles created in memory, e.g. by a provider */
+                turtle_map_meta_default_(meta);
+                return TURTLE_RETURN_SUCCESS;
+        }
+
+        char path[16];
+        sprintf(path, "tile.%.7s", meta->encoding);
+        struct turtle_io * io;
+        if (turtle_io_create_(&io, path, error_) != TURTLE_RETURN_SUCCESS)
+                return error_->code;
+        meta->get_z = io->meta.get_z;
+        meta->set_z = io->meta.set_z;
+        meta->flipped = io->meta.flipped;
+        meta->raw_encoding = io->meta.raw_encoding;
+        free(io);
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
+/* Open a pack of tiles, reading its index */
+enum turtle_return turtle_pack_open_(struct turtle_pack ** pack,
+    const char * path, struct turtle_error_context * error_)
+{
+        *pack = NULL;
+        struct pack_entry * entries = NULL;
+        const int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+                return TURTLE_ERROR_VREGISTER(TURTLE_RETURN_PATH_ERROR,
+                    "could not open file `%s'", path);
+        }
+
+        /* Read and check the header */
+        struct pack_header header;
+        if ((pack_read(fd, &header, sizeof(header), 0) != 0) ||
+            (memcmp(header.magic, PACK_MAGIC, sizeof(header.magic)) != 0)) {
+                TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
+                    "invalid pack `%s'", path);
+                goto error;
+        } else if (header.version != PACK_VERSION) {
+                TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
+                    "unsupported version for pack `%s'", path);
+                goto error;
+        } else if (header.order != PACK_ORDER) {
+                TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
+                    "incompatible byte order for pack `%s'", path);
+                goto error;
+        }
+
+        /* Check the grid dimensions before combining them, since the header
+         * is not trusted
+         */
+        const size_t cell_size =
+            sizeof(*(*pack)->tiles) + sizeof(*(*pack)->lookup);
+        if ((header.latitude_n < 0) || (header.longitude_n < 0) ||
+            ((int64_t)header.latitude_n * header.longitude_n > INT_MAX) ||
+            ((uint64_t)header.latitude_n * header.longitude_n >
+                (SIZE_MAX - sizeof(**pack)) / cell_size)) {
+                TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
+                    "invalid grid for pack `%s'", path);
+                goto error;
+        }
+        const int n_cells = header.latitude_n * header.longitude_n;
+        if ((header.size < 0) || (header.size > n_cells)) {
+                TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
+                    "invalid grid for pack `%s'", path);
+                goto error;
+        }
+
+        /* Read the index */
+        entries = malloc(header.size * sizeof(*entries) + 1);
+        *pack = malloc(sizeof(**pack) + header.size * sizeof(*(*pack)->tiles) +
+            n_cells * sizeof(*(*pack)->lookup));
+        if ((entries == NULL) || (*pack == NULL)) {
+                TURTLE_ERROR_REGISTER(
+                    TURTLE_RETURN_MEMORY_ERROR, "could not allocate memory");
+                goto error;
+        }
+        if (pack_read(fd, entries, header.size * sizeof(*entries),
+                sizeof(header)) != 0) {
+                TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
+                    "invalid pack `%s'", path);
+                goto error;
+        }
+
+        /* Build the pack object */
+        (*pack)->fd = fd;
+        (*pack)->latitude_0 = header.latitude_0;
+        (*pack)->latitude_delta = header.latitude_delta;
+        (*pack)->latitude_n = header.latitude_n;
+        (*pack)->longitude_0 = header.longitude_0;
+        (*pack)->longitude_delta = header.longitude_delta;
+        (*pack)->longitude_n = header.longitude_n;
+        (*pack)->lookup = (int *)((*pack)->tiles + header.size);
+        (*pack)->size = header.size;
+        int i;
+        for (i = 0; i < n_cells; i++) (*pack)->lookup[i] = -1;
+
+        struct turtle_map_meta * previous = NULL;
+        for (i = 0; i < header.size; i++) {
+                const struct pack_entry * entry = entries + i;
+                if ((entry->index < 0) || (entry->index >= n_cells) ||
+                    ((*pack)->lookup[entry->index] >= 0) ||
+                    (entry->nx < 2) || (entry->ny < 2) ||
+                    ((int64_t)entry->nx * entry->ny > INT_MAX)) {
+                        TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
+                            "invalid index for pack `%s'", path);
+                        goto error;
+                }
+
+                /* Tiles are stored compressed only if this reduces their
+                 * size
+                 */
+                const uint64_t size = (uint64_t)entry->nx * entry->ny *
+                    sizeof(uint16_t);
+                if (entry->compressed ?
+                        ((entry->size == 0) || (entry->size >= size)) :
+                        (entry->size != size)) {
+                        TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
+                            "invalid tile size in pack `%s'", path);
+                        goto error;
+                }
+                (*pack)->lookup[entry->index] = i;
+
+                struct turtle_pack_tile * tile = (*pack)->tiles + i;
+                struct turtle_map_meta * meta = &tile->meta;
+                memset(meta, 0x0, sizeof(*meta));
+                meta->nx = entry->nx;
+                meta->ny = entry->ny;
+                meta->x0 = entry->x0;
+                meta->y0 = entry->y0;
+                meta->z0 = entry->z0;
+                meta->dx = entry->dx;
+                meta->dy = entry->dy;
+                meta->dz = entry->dz;
+                memcpy(meta->encoding, entry->encoding, sizeof(meta->encoding));
+                meta->encoding[sizeof(meta->encoding) - 1] = 0x0;
+                meta->projection.type = PROJECTION_NONE;
+                tile->offset = entry->offset;
+                tile->size = entry->size;
+                tile->compressed = entry->compressed;
+
+                /* Tiles usually share the same encoding */
+                if ((previous != NULL) &&
+                    (strcmp(previous->encoding, meta->encoding) == 0)) {
+                        meta->get_z = previous->get_z;
+                        meta->set_z = previous->set_z;
+                        meta->flipped = previous->flipped;
+                        meta->raw_encoding = previous->raw_encoding;
+                } else if (pack_encoding(meta, error_) !=
+                    TURTLE_RETURN_SUCCESS)
+                        goto error;
+                previous = meta;
+        }
+        free(entries);
+
+        return TURTLE_RETURN_SUCCESS;
+
+error:
+        free(entries);
+        free(*pack);
+        *pack = NULL;
+        close(fd);
+        return error_->code;
+}
+
+/* Close a pack of tiles */
+void turtle_pack_close_(struct turtle_pack ** pack)
+{
+        if ((pack == NULL) || (*pack == NULL)) return;
+        close((*pack)->fd);
+        free(*pack);
+        *pack = NULL;
+}
+
+/* Load the map of a packed tile */
+enum turtle_return turtle_pack_load_(struct turtle_pack * pack, int tile,
+    struct turtle_map ** map, struct turtle_error_context * error_)
+{
+        /* Allocate the map */
+        const struct turtle_pack_tile * t = pack->tiles + tile;
+        const uint64_t size =
+            (uint64_t)t->meta.nx * t->meta.ny * sizeof(*(*map)->data);
+        *map = turtle_map_allocate_(t->meta.nx, t->meta.ny);
+        if (*map == NULL) {
+                return TURTLE_ERROR_REGISTER(TURTLE_RETURN_MEMORY_ERROR,
+                    "could not allocate memory for map");
+        }
+
+        /* Initialise the map data */
+        memcpy(&(*map)->meta, &t->meta, sizeof((*map)->meta));
+
+        /* Load the elevation data with a single range read */
+        void * buffer = (*map)->data;
+        if (t->compressed) {
+                buffer = malloc(t->size);
+                if (buffer == NULL) {
+                        TURTLE_ERROR_REGISTER(TURTLE_RETURN_MEMORY_ERROR,
+                            "could not allocate memory for map");
+                        goto error;
+                }
+        }
+        if (pack_read(pack->fd, buffer, t->size, t->offset) != 0) {
+                TURTLE_ERROR_REGISTER(
+                    TURTLE_RETURN_BAD_FORMAT, "could not read tile data");
+                goto error;
+        }
+        if (t->compressed) {
+                const enum turtle_return rc = turtle_uncompress_(
+                    buffer, t->size, (*map)->data, size, error_);
+                free(buffer);
+                if (rc != TURTLE_RETURN_SUCCESS) goto error;
+        }
+
+        return TURTLE_RETURN_SUCCESS;
+
+error:
+        if (buffer != (*map)->data) free(buffer);
+        free(*map);
+        *map = NULL;
+        return error_->code;
+}
+
+/* Write all the tiles of a stack to a pack */
+enum turtle_return turtle_pack_dump_(struct turtle_stack * stack,
+    const char * path, int compression, struct turtle_error_context * error_)
+{
+        /* Count the tiles */
+        const int n_cells = stack->latitude_n * stack->longitude_n;
+        int i, size = 0;
+        for (i = 0; i < n_cells; i++) {
+                if (stack->path[i] != NULL) size++;
+        }
+
+        /* The pack is written to a temporary file first, since the stack
+         * might be loaded from the same path
+         */
+        struct pack_entry * entries = calloc(size + 1, sizeof(*entries));
+        char * tmp_path = malloc(strlen(path) + 6);
+        if ((entries == NULL) || (tmp_path == NULL)) {
+                free(entries);
+                free(tmp_path);
+                return TURTLE_ERROR_REGISTER(
+                    TURTLE_RETURN_MEMORY_ERROR, "could not allocate memory");
+        }
+        sprintf(tmp_path, "%s.part", path);
+        FILE * fid = fopen(tmp_path, "wb");
+        if (fid == NULL) {
+                free(entries);
+                free(tmp_path);
+                return TURTLE_ERROR_VREGISTER(TURTLE_RETURN_PATH_ERROR,
+                    "could not open file `%s'", path);
+        }
+
+        /* Write the tiles data, after room for the header and the index */
+        struct pack_header header;
+        memset(&header, 0x0, sizeof(header));
+        memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+        header.version = PACK_VERSION;
+        header.order = PACK_ORDER;
+        header.latitude_0 = stack->latitude_0;
+        header.latitude_delta = stack->latitude_delta;
+        header.latitude_n = stack->latitude_n;
+        header.longitude_0 = stack->longitude_0;
+        header.longitude_delta = stack->longitude_delta;
+        header.longitude_n = stack->longitude_n;
+        header.size = size;
+
+        uint64_t offset = sizeof(header) + size * sizeof(*entries);
+        if (fseek(fid, offset, SEEK_SET) != 0) goto write_error;
+
+        struct pack_entry * entry = entries;
+        for (i = 0; i < n_cells; i++) {
+                if (stack->path[i] == NULL) continue;
+
+                struct turtle_map * map;
+                if (turtle_stack_tile_load_(stack, i, &map, error_) !=
+                    TURTLE_RETURN_SUCCESS)
+                        goto exit;
+                const struct turtle_map_meta * meta = &map->meta;
+                unsigned long n = meta->nx * meta->ny * sizeof(*map->data);
+
+                /* Compress the data, unless this does not help */
+                void * data = NULL;
+                if ((compression > 0) &&
+                    (turtle_compress_(map->data, n, compression, &data, &n,
+                         error_) != TURTLE_RETURN_SUCCESS)) {
+                        turtle_map_destroy(&map);
+                        goto exit;
+                }
+                if ((data != NULL) && (n >= meta->nx * meta->ny *
+                                                sizeof(*map->data))) {
+                        free(data);
+                        data = NULL;
+                        n = meta->nx * meta->ny * sizeof(*map->data);
+                }
+
+                entry->index = i;
+                entry->compressed = (data != NULL);
+                entry->nx = meta->nx;
+                entry->ny = meta->ny;
+                entry->x0 = meta->x0;
+                entry->y0 = meta->y0;
+                entry->z0 = meta->z0;
+                entry->dx = meta->dx;
+                entry->dy = meta->dy;
+                entry->dz = meta->dz;
+                memcpy(entry->encoding, meta->encoding,
+                    sizeof(entry->encoding));
+                entry->offset = offset;
+                entry->size = n;
+                entry++;
+                offset += n;
+
+                const size_t written = fwrite(
+                    (data != NULL) ? data : (void *)map->data, n, 1, fid);
+                free(data);
+                turtle_map_destroy(&map);
+                if (written != 1) goto write_error;
+        }
+
+        /* Write the header and the index */
+        if ((fseek(fid, 0, SEEK_SET) != 0) ||
+            (fwrite(&header, sizeof(header), 1, fid) != 1) ||
+            ((size > 0) && (fwrite(entries, size * sizeof(*entries), 1,
+                                fid) != 1)))
+                goto write_error;
+        goto exit;
+
+write_error:
+        TURTLE_ERROR_VREGISTER(
+            TURTLE_RETURN_PATH_ERROR, "could not write to `%s'", path);
+exit:
+        free(entries);
+        if ((fclose(fid) != 0) && (error_->code == TURTLE_RETURN_SUCCESS)) {
+                TURTLE_ERROR_VREGISTER(TURTLE_RETURN_PATH_ERROR,
+                    "could not write to `%s'", path);
+        }
+        if (error_->code != TURTLE_RETURN_SUCCESS)
+                remove(tmp_path);
+        else if (rename(tmp_path, path) != 0) {
+                remove(tmp_path);
+                TURTLE_ERROR_VREGISTER(TURTLE_RETURN_PATH_ERROR,
+                    "could not write to `%s'", path);
+        }
+        free(tmp_path);
+        return error_->code;
+}
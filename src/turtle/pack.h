@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2017 Université Clermont Auvergne, CNRS/IN2P3, LPC
+ * Author: Valentin NIESS (niess@in2p3.fr)
+ *
+ * Topographic Utilities for tRansporting parTicules over Long rangEs (TURTLE)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/* Single file packs of elevation tiles for the TURTLE library */
+#ifndef TURTLE_PACK_H
+#define TURTLE_PACK_H
+
+/* C89 standard library */
+#include <stdint.h>
+/* TURTLE library */
+#include "turtle.h"
+#include "turtle/error.h"
+#include "turtle/map.h"
+
+/* Index entry of a packed tile */
+struct turtle_pack_tile {
+        /* Meta data of the tile's map */
+        struct turtle_map_meta meta;
+
+        /* Location of the tile's data in the pack */
+        uint64_t offset;
+        uint64_t size;
+        int compressed;
+};
+
+/* Container for a pack of tiles */
+struct turtle_pack {
+        /* File descriptor for range reads */
+        int fd;
+
+        /* Grid of tiles, with a lookup from grid cells to packed tiles */
+        double latitude_0, latitude_delta;
+        double longitude_0, longitude_delta;
+        int latitude_n, longitude_n;
+        int * lookup;
+
+        /* Index of packed tiles */
+        int size;
+        struct turtle_pack_tile tiles[];
+};
+
+/* Check if a file is a pack of tiles */
+int turtle_pack_check_(const char * path);
+
+/* Open a pack of tiles, reading its index */
+enum turtle_return turtle_pack_open_(struct turtle_pack ** pack,
+    const char * path, struct turtle_error_context * error_);
+
+/* Close a pack of tiles */
+void turtle_pack_close_(struct turtle_pack ** pack);
+
+/* Load the map of a packed tile */
+enum turtle_return turtle_pack_load_(struct turtle_pack * pack, int tile,
+    struct turtle_map ** map, struct turtle_error_context * error_);
+
+/* Write all the tiles of a stack to a pack */
+struct turtle_stack;
+enum turtle_return turtle_pack_dump_(struct turtle_stack * stack,
+    const char * path, int compression, struct turtle_error_context * error_);
+
+#endif
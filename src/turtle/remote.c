@@ -0,0 +1,391 @@
+/*
+ * Copyright (C) 2017 Université Clermont Auvergne, CNRS/IN2P3, LPC
+ * Author: Valentin NIESS (niess@in2p3.fr)
+ *
+ * Topographic Utilities for tRansporting parTicules over Long rangEs (TURTLE)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/*
+ * Remote files, read over plain HTTP with range requests. Data are fetched by
+ * blocks, which are optionally cached on the local disk. Cached blocks are
+ * never invalidated, i.e. remote files are assumed to be immutable.
+ */
+
+/* Expose POSIX sockets, getaddrinfo and mkstemp */
+#define _POSIX_C_SOURCE 200809L
+
+/* C89 standard library */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+/* POSIX sockets */
+#include <netdb.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+/* TURTLE library */
+#include "turtle/remote.h"
+
+/* Size of the blocks of remote data */
+#define REMOTE_BLOCK_SIZE 65536
+
+/* Maximum size of HTTP requests and response headers */
+#define REMOTE_HEADER_SIZE 8192
+
+/* Local cache for remote data, or NULL */
+static char * cache_path = NULL;
+
+/* Set a local cache for remote data */
+enum turtle_return turtle_remote_cache_set(const char * path)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_remote_cache_set);
+
+        free(cache_path);
+        cache_path = NULL;
+        if (path == NULL) return TURTLE_RETURN_SUCCESS;
+
+        cache_path = malloc(strlen(path) + 1);
+        if (cache_path == NULL) return TURTLE_ERROR_MEMORY();
+        strcpy(cache_path, path);
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
+/* Load an item from the cache. The number of bytes read is returned */
+static unsigned long cache_load(const struct turtle_remote * remote,
+    const char * name, void * buffer, unsigned long size)
+{
+        if (cache_path == NULL) return 0;
+        char path[strlen(cache_path) + strlen(name) + 19];
+        sprintf(path, "%s/%016llx-%s", cache_path,
+            (unsigned long long)remote->key, name);
+        FILE * stream = fopen(path, "rb");
+        if (stream == NULL) return 0;
+        const unsigned long n = fread(buffer, 1, size, stream);
+        fclose(stream);
+        return n;
+}
+
+/* Store an item in the cache. The item is written to a temporary file first,
+ * such that concurrent readers never see partial data. Failures are not
+ * considered as errors
+ */
+static void cache_store(const struct turtle_remote * remote, const char * name,
+    const void * buffer, unsigned long size)
+{
+        if (cache_path == NULL) return;
+        char path[strlen(cache_path) + strlen(name) + 26];
+        const int n = sprintf(path, "%s/%016llx-%s", cache_path,
+            (unsigned long long)remote->key, name);
+        strcpy(path + n, ".XXXXXX");
+        const int fd = mkstemp(path);
+        if (fd < 0) return;
+        const int rc = (write(fd, buffer, size) == size);
+        close(fd);
+        if (rc) {
+                char final[n + 1];
+                memcpy(final, path, n);
+                final[n] = 0x0;
+                if (rename(path, final) == 0) return;
+        }
+        remove(path);
+}
+
+/* Send a full buffer over a socket */
+static int remote_send(int fd, const char * data, unsigned long size)
+{
+        while (size > 0) {
+                const ssize_t n = send(fd, data, size, 0);
+                if (n <= 0) return -1;
+                data += n;
+                size -= n;
+        }
+        return 0;
+}
+
+/* Fetch a range of bytes over HTTP. The number of bytes actually read and
+ * the total size of the remote file are returned as well
+ */
+static enum turtle_return remote_fetch(struct turtle_remote * remote,
+    unsigned long offset, unsigned long size, char * buffer,
+    unsigned long * read, unsigned long * total,
+    struct turtle_error_context * error_)
+{
+        /* Connect to the server */
+        struct addrinfo hints, * info;
+        memset(&hints, 0x0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(remote->host, remote->port, &hints, &info) != 0)
+                goto error;
+        int fd = -1;
+        struct addrinfo * p;
+        for (p = info; p != NULL; p = p->ai_next) {
+                fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+                if (fd < 0) continue;
+                if (connect(fd, p->ai_addr, p->ai_addrlen) == 0) break;
+                close(fd);
+                fd = -1;
+        }
+        freeaddrinfo(info);
+        if (fd < 0) goto error;
+        struct timeval timeout = { 30, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        /* Request the range of bytes */
+        char header[REMOTE_HEADER_SIZE];
+        int m = snprintf(header, sizeof(header),
+            "GET %s HTTP/1.1\r\nHost: %s\r\nRange: bytes=%lu-%lu\r\n"
+            "Connection: close\r\n\r\n",
+            remote->resource, remote->host, offset, offset + size - 1);
+        if ((m >= sizeof(header)) || (remote_send(fd, header, m) != 0))
+                goto close_error;
+
+        /* Read the response header */
+        char * body = NULL;
+        for (m = 0; m < sizeof(header) - 1;) {
+                const ssize_t n =
+                    recv(fd, header + m, sizeof(header) - 1 - m, 0);
+                if (n <= 0) break;
+                m += n;
+                header[m] = 0x0;
+                if ((body = strstr(header, "\r\n\r\n")) != NULL) break;
+        }
+        if (body == NULL) goto close_error;
+        *body = 0x0;
+        body += 4;
+
+        /* Parse the status and the size of the content */
+        int status;
+        if (sscanf(header, "HTTP/%*d.%*d %d", &status) != 1) goto close_error;
+        unsigned long length = 0, first = 0;
+        int has_range = 0, has_length = 0;
+        char * line;
+        for (line = strstr(header, "\r\n"); line != NULL;
+             line = strstr(line, "\r\n")) {
+                line += 2;
+                if (strncasecmp(line, "Content-Range:", 14) == 0) {
+                        unsigned long last;
+                        has_range = (sscanf(line + 14, " bytes %lu-%lu/%lu",
+                                         &first, &last, total) == 3);
+                } else if (strncasecmp(line, "Content-Length:", 15) == 0) {
+                        has_length = (sscanf(line + 15, " %lu", &length) == 1);
+                }
+        }
+
+        /* The server might ignore the range, in which case the leading bytes
+         * are skipped
+         */
+        unsigned long skip = 0;
+        if (status == 206) {
+                if (!has_range || (first != offset)) goto close_error;
+        } else if ((status == 200) && has_length) {
+                *total = length;
+                skip = offset;
+        } else
+                goto close_error;
+        unsigned long expected = (offset < *total) ? *total - offset : 0;
+        if (expected > size) expected = size;
+
+        /* Read the body */
+        *read = 0;
+        char * chunk = body;
+        long n = header + m - body;
+        for (;;) {
+                if (n > 0) {
+                        unsigned long d = (skip < n) ? skip : n;
+                        skip -= d;
+                        chunk += d;
+                        n -= d;
+                        d = (n < expected - *read) ? n : expected - *read;
+                        memcpy(buffer + *read, chunk, d);
+                        *read += d;
+                }
+                if (*read == expected) break;
+                n = recv(fd, header, sizeof(header), 0);
+                if (n <= 0) break;
+                chunk = header;
+        }
+        close(fd);
+        if (*read != expected) goto error;
+
+        return TURTLE_RETURN_SUCCESS;
+
+close_error:
+        close(fd);
+error:
+        return TURTLE_ERROR_VREGISTER(
+            TURTLE_RETURN_PATH_ERROR, "could not fetch `%s'", remote->url);
+}
+
+/* Check if a path is a remote URL */
+int turtle_remote_check_(const char * path)
+{
+        return strncmp(path, "http://", 7) == 0;
+}
+
+/* Open a remote file */
+enum turtle_return turtle_remote_open_(struct turtle_remote ** remote,
+    const char * url, struct turtle_error_context * error_)
+{
+        *remote = NULL;
+        if (!turtle_remote_check_(url)) {
+                return TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
+                    "unsupported URL `%s'", url);
+        }
+
+        /* Parse the URL */
+        const char * host = url + 7;
+        const char * resource = strchr(host, '/');
+        int host_size = (resource == NULL) ? strlen(host) : resource - host;
+        if (resource == NULL) resource = "/";
+        const char * port = memchr(host, ':', host_size);
+        int port_size = 2;
+        if (port != NULL) {
+                port_size = host_size - (port - host) - 1;
+                host_size = port - host;
+                port++;
+        } else
+                port = "80";
+        if ((host_size == 0) || (port_size == 0)) {
+                return TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
+                    "invalid URL `%s'", url);
+        }
+
+        /* Allocate the handle */
+        const int url_size = strlen(url) + 1;
+        const int resource_size = strlen(resource) + 1;
+        *remote = malloc(sizeof(**remote) + REMOTE_BLOCK_SIZE + url_size +
+            host_size + port_size + resource_size + 2);
+        if (*remote == NULL) {
+                return TURTLE_ERROR_REGISTER(
+                    TURTLE_RETURN_MEMORY_ERROR, "could not allocate memory");
+        }
+        struct turtle_remote * r = *remote;
+        r->block = r->data;
+        r->block_index = -1;
+        r->block_size = 0;
+        r->url = r->block + REMOTE_BLOCK_SIZE;
+        memcpy(r->url, url, url_size);
+        r->host = r->url + url_size;
+        memcpy(r->host, host, host_size);
+        r->host[host_size] = 0x0;
+        r->port = r->host + host_size + 1;
+        memcpy(r->port, port, port_size);
+        r->port[port_size] = 0x0;
+        r->resource = r->port + port_size + 1;
+        memcpy(r->resource, resource, resource_size);
+
+        /* Hash the URL for naming cached items (FNV-1a) */
+        r->key = 0xcbf29ce484222325ULL;
+        const char * c;
+        for (c = url; *c != 0x0; c++) {
+                r->key ^= (unsigned char)*c;
+                r->key *= 0x100000001b3ULL;
+        }
+
+        /* Get the size of the remote file, from the cache or by fetching the
+         * first block
+         */
+        char text[32];
+        const unsigned long n = cache_load(r, "size", text, sizeof(text) - 1);
+        text[n] = 0x0;
+        if ((n == 0) || (sscanf(text, "%lu", &r->size) != 1)) {
+                if (remote_fetch(r, 0, REMOTE_BLOCK_SIZE, r->block,
+                        &r->block_size, &r->size,
+                        error_) != TURTLE_RETURN_SUCCESS) {
+                        turtle_remote_close_(remote);
+                        return error_->code;
+                }
+                r->block_index = 0;
+                cache_store(r, "0", r->block, r->block_size);
+                const int m = sprintf(text, "%lu", r->size);
+                cache_store(r, "size", text, m);
+        }
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
+/* Close a remote file */
+void turtle_remote_close_(struct turtle_remote ** remote)
+{
+        if ((remote == NULL) || (*remote == NULL)) return;
+        free(*remote);
+        *remote = NULL;
+}
+
+/* Load a block of remote data, from the cache if available */
+static enum turtle_return remote_block(struct turtle_remote * remote,
+    long index, struct turtle_error_context * error_)
+{
+        if (index == remote->block_index) return TURTLE_RETURN_SUCCESS;
+
+        const unsigned long offset = index * (unsigned long)REMOTE_BLOCK_SIZE;
+        unsigned long size = remote->size - offset;
+        if (size > REMOTE_BLOCK_SIZE) size = REMOTE_BLOCK_SIZE;
+        char name[32];
+        sprintf(name, "%ld", index);
+
+        remote->block_index = -1;
+        if (cache_load(remote, name, remote->block, size) != size) {
+                unsigned long n, total;
+                if (remote_fetch(remote, offset, size, remote->block, &n,
+                        &total, error_) != TURTLE_RETURN_SUCCESS)
+                        return error_->code;
+                cache_store(remote, name, remote->block, size);
+        }
+        remote->block_index = index;
+        remote->block_size = size;
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
+/* Read a range of bytes from a remote file */
+enum turtle_return turtle_remote_read_(struct turtle_remote * remote,
+    unsigned long offset, void * buffer, unsigned long size,
+    struct turtle_error_context * error_)
+{
+        if (offset + size > remote->size) {
+                return TURTLE_ERROR_VREGISTER(TURTLE_RETURN_BAD_FORMAT,
+                    "unexpected end of file `%s'", remote->url);
+        }
+
+        /* Without any cache, large ranges are fetched with a single request */
+        char * dst = buffer;
+        if ((cache_path == NULL) && (size > REMOTE_BLOCK_SIZE)) {
+                unsigned long n, total;
+                return remote_fetch(
+                    remote, offset, size, dst, &n, &total, error_);
+        }
+
+        /* Otherwise, let us proceed by blocks */
+        while (size > 0) {
+                const long index = offset / REMOTE_BLOCK_SIZE;
+                if (remote_block(remote, index, error_) !=
+                    TURTLE_RETURN_SUCCESS)
+                        return error_->code;
+                const unsigned long start = offset - index * REMOTE_BLOCK_SIZE;
+                unsigned long n = remote->block_size - start;
+                if (n > size) n = size;
+                memcpy(dst, remote->block + start, n);
+                dst += n;
+                offset += n;
+                size -= n;
+        }
+
+        return TURTLE_RETURN_SUCCESS;
+}
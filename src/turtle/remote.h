@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2017 Université Clermont Auvergne, CNRS/IN2P3, LPC
+ * Author: Valentin NIESS (niess@in2p3.fr)
+ *
+ * Topographic Utilities for tRansporting parTicules over Long rangEs (TURTLE)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/* Remote files, read over HTTP with range requests */
+#ifndef TURTLE_REMOTE_H
+#define TURTLE_REMOTE_H
+
+/* C99 standard library */
+#include <stdint.h>
+/* TURTLE library */
+#include "turtle.h"
+#include "turtle/error.h"
+
+/* Handle for a remote file */
+struct turtle_remote {
+        /* Total size of the remote file, in bytes */
+        unsigned long size;
+
+        /* Current block of data */
+        long block_index;
+        unsigned long block_size;
+        char * block;
+
+        /* Lookup data for the remote file */
+        char * url;
+        char * host;
+        char * port;
+        char * resource;
+        uint64_t key;
+
+        char data[]; /* Placeholder for data */
+};
+
+/* Check if a path is a remote URL */
+int turtle_remote_check_(const char * path);
+
+/* Open a remote file */
+enum turtle_return turtle_remote_open_(struct turtle_remote ** remote,
+    const char * url, struct turtle_error_context * error_);
+
+/* Close a remote file */
+void turtle_remote_close_(struct turtle_remote ** remote);
+
+/* Read a range of bytes from a remote file */
+enum turtle_return turtle_remote_read_(struct turtle_remote * remote,
+    unsigned long offset, void * buffer, unsigned long size,
+    struct turtle_error_context * error_);
+
+#endif
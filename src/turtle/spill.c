@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2017 Université Clermont Auvergne, CNRS/IN2P3, LPC
+ * Author: Valentin NIESS (niess@in2p3.fr)
+ *
+ * Topographic Utilities for tRansporting parTicules over Long rangEs (TURTLE)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/*
+ * Spill of decoded stack tiles to a local scratch directory. Tiles are stored
+ * raw, i.e. as in memory, such that they are reloaded with a single read and
+ * no decoding. Note that spilled tiles are private to the process, including
+ * the meta data callbacks.
+ */
+
+/* Expose mkdtemp */
+#define _POSIX_C_SOURCE 200809L
+
+/* C89 standard library */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+/* POSIX directories */
+#include <unistd.h>
+/* TURTLE library */
+#include "turtle/spill.h"
+
+/* Get the path of a spilled tile */
+static void spill_path(
+    const struct turtle_spill * spill, int index, char * path)
+{
+        sprintf(path, "%s/%d.tile", spill->root, index);
+}
+
+/* Create a spill in a scratch directory */
+enum turtle_return turtle_spill_create_(struct turtle_spill ** spill,
+    const char * path, int size, int n, struct turtle_error_context * error_)
+{
+        const char * tail = "/turtle-XXXXXX";
+        const int root_size = strlen(path) + strlen(tail) + 1;
+        *spill = malloc(sizeof(**spill) + n * sizeof(*(*spill)->entries) +
+            root_size);
+        if (*spill == NULL) {
+                return TURTLE_ERROR_REGISTER(
+                    TURTLE_RETURN_MEMORY_ERROR, "could not allocate memory");
+        }
+        (*spill)->root = (char *)((*spill)->entries + n);
+        sprintf((*spill)->root, "%s%s", path, tail);
+        if (mkdtemp((*spill)->root) == NULL) {
+                free(*spill);
+                *spill = NULL;
+                return TURTLE_ERROR_VREGISTER(TURTLE_RETURN_PATH_ERROR,
+                    "could not create a scratch directory in `%s'", path);
+        }
+
+        (*spill)->max_size = size;
+        (*spill)->size = 0;
+        (*spill)->clock = 0;
+        (*spill)->n = n;
+        memset((*spill)->entries, 0x0, n * sizeof(*(*spill)->entries));
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
+/* Remove a spilled tile */
+static void spill_remove(struct turtle_spill * spill, int index)
+{
+        char path[strlen(spill->root) + 32];
+        spill_path(spill, index, path);
+        remove(path);
+        spill->entries[index].stored = 0;
+        spill->size--;
+}
+
+/* Destroy a spill, removing any spilled tile */
+void turtle_spill_destroy_(struct turtle_spill ** spill)
+{
+        if ((spill == NULL) || (*spill == NULL)) return;
+
+        int i;
+        for (i = 0; i < (*spill)->n; i++) {
+                if ((*spill)->entries[i].stored) spill_remove(*spill, i);
+        }
+        rmdir((*spill)->root);
+        free(*spill);
+        *spill = NULL;
+}
+
+/* Load a spilled tile, if any. Otherwise `map` is set to `NULL` */
+enum turtle_return turtle_spill_load_(struct turtle_spill * spill,
+    int index, struct turtle_map ** map, struct turtle_error_context * error_)
+{
+        *map = NULL;
+        struct turtle_spill_entry * entry = spill->entries + index;
+        if (!entry->stored) return TURTLE_RETURN_SUCCESS;
+
+        char path[strlen(spill->root) + 32];
+        spill_path(spill, index, path);
+        FILE * fid = fopen(path, "rb");
+        if (fid == NULL) goto error;
+
+        /* Read the meta data and then the elevation data */
+        struct turtle_map_meta meta;
+        if (fread(&meta, sizeof(meta), 1, fid) != 1) goto error;
+        const size_t size = meta.nx * meta.ny * sizeof(*(*map)->data);
+        *map = turtle_map_allocate_(meta.nx, meta.ny);
+        if (*map == NULL) {
+                fclose(fid);
+                return TURTLE_ERROR_REGISTER(TURTLE_RETURN_MEMORY_ERROR,
+                    "could not allocate memory for map");
+        }
+        if (fread((*map)->data, size, 1, fid) != 1) goto error;
+        fclose(fid);
+
+        memcpy(&(*map)->meta, &meta, sizeof(meta));
+        entry->stamp = __sync_add_and_fetch(&spill->clock, 1);
+
+        return TURTLE_RETURN_SUCCESS;
+
+error:
+        /* The spilled tile is not valid. It is ignored */
+        if (fid != NULL) fclose(fid);
+        free(*map);
+        *map = NULL;
+        return TURTLE_RETURN_SUCCESS;
+}
+
+/* Spill a tile. Failures are not considered as errors */
+void turtle_spill_store_(
+    struct turtle_spill * spill, int index, const struct turtle_map * map)
+{
+        struct turtle_spill_entry * entry = spill->entries + index;
+        entry->stamp = __sync_add_and_fetch(&spill->clock, 1);
+        if (entry->stored) return; /* Tiles are immutable */
+
+        /* Make room for the new tile, if needed */
+        while ((spill->size > 0) && (spill->size >= spill->max_size)) {
+                int i, lru = -1;
+                for (i = 0; i < spill->n; i++) {
+                        if (spill->entries[i].stored &&
+                            ((lru < 0) || (spill->entries[i].stamp <
+                                              spill->entries[lru].stamp)))
+                                lru = i;
+                }
+                spill_remove(spill, lru);
+        }
+        if (spill->max_size <= 0) return;
+
+        /* Write the meta data and the elevation data */
+        char path[strlen(spill->root) + 32];
+        spill_path(spill, index, path);
+        FILE * fid = fopen(path, "wb");
+        if (fid == NULL) return;
+        const size_t size = map->meta.nx * map->meta.ny * sizeof(*map->data);
+        const int ok = (fwrite(&map->meta, sizeof(map->meta), 1, fid) == 1) &&
+            (fwrite(map->data, size, 1, fid) == 1);
+        if ((fclose(fid) != 0) || !ok) {
+                remove(path);
+                return;
+        }
+        entry->stored = 1;
+        spill->size++;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2017 Université Clermont Auvergne, CNRS/IN2P3, LPC
+ * Author: Valentin NIESS (niess@in2p3.fr)
+ *
+ * Topographic Utilities for tRansporting parTicules over Long rangEs (TURTLE)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/* Spill of decoded stack tiles to a local scratch directory */
+#ifndef TURTLE_SPILL_H
+#define TURTLE_SPILL_H
+
+/* TURTLE library */
+#include "turtle.h"
+#include "turtle/error.h"
+#include "turtle/map.h"
+
+/* Status of a spilled tile */
+struct turtle_spill_entry {
+        int stored;
+        unsigned long stamp;
+};
+
+/* Container for spilled tiles */
+struct turtle_spill {
+        /* Private scratch directory */
+        char * root;
+
+        /* Maximum and current number of spilled tiles */
+        int max_size;
+        int size;
+
+        /* Clock for the least recently used policy */
+        unsigned long clock;
+
+        /* Status of spilled tiles, indexed by tile */
+        int n;
+        struct turtle_spill_entry entries[];
+};
+
+/* Create a spill in a scratch directory */
+enum turtle_return turtle_spill_create_(struct turtle_spill ** spill,
+    const char * path, int size, int n, struct turtle_error_context * error_);
+
+/* Destroy a spill, removing any spilled tile */
+void turtle_spill_destroy_(struct turtle_spill ** spill);
+
+/* Load a spilled tile, if any. Otherwise `map` is set to `NULL` */
+enum turtle_return turtle_spill_load_(struct turtle_spill * spill,
+    int index, struct turtle_map ** map, struct turtle_error_context * error_);
+
+/* Spill a tile. Failures are not considered as errors */
+void turtle_spill_store_(
+    struct turtle_spill * spill, int index, const struct turtle_map * map);
+
+#endif
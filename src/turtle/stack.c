@@ -22,12 +22,21 @@
  * Turtle handle for accessing world-wide elevation data.
  */
 
+#ifndef TURTLE_NO_PTHREAD
+/* Expose POSIX reader/writer locks */
+#define _POSIX_C_SOURCE 200112L
+#endif
+
 /* C89 standard library */
 #include <float.h>
 #include <limits.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef TURTLE_NO_PTHREAD
+/* POSIX threads */
+#include <pthread.h>
+#endif
 /* TinyDir library */
 #include "deps/tinydir.h"
 /* TURTLE library */
@@ -35,13 +44,72 @@
 #include "turtle/error.h"
 #include "turtle/io.h"
 #include "turtle/list.h"
+#include "turtle/remote.h"
 #include "turtle/stack.h"
+#include "turtle/trace.h"
 
 #ifndef M_PI
 /* Define pi, if unknown. */
 #define M_PI 3.14159265358979323846
 #endif
 
+/* Allocate and initialise a stack handle for a grid of tiles. Extra data are
+ * reserved after the lookup tables
+ */
+static enum turtle_return stack_allocate(struct turtle_stack ** stack,
+    const char * root, double lat_0, double lat_delta, int lat_n,
+    double long_0, double long_delta, int long_n, int size, int extra,
+    char ** data, struct turtle_error_context * error_)
+{
+        const int root_size = strlen(root) + 1;
+        const int path_size = lat_n * long_n * sizeof(char *);
+        const int coverage_size = (lat_n * long_n + 7) / 8;
+        *stack = malloc(sizeof(**stack) + root_size + 2 * path_size +
+            coverage_size + extra);
+        if (*stack == NULL) {
+                return TURTLE_ERROR_REGISTER(
+                    TURTLE_RETURN_MEMORY_ERROR, "could not allocate memory");
+        }
+
+        /* Initialise the handle */
+        memset(&(*stack)->tiles, 0x0, sizeof((*stack)->tiles));
+        (*stack)->max_size = (size > 0) ? size : INT_MAX;
+        (*stack)->pinned_n = 0;
+        (*stack)->lock = NULL;
+        (*stack)->unlock = NULL;
+        (*stack)->context_lock = NULL;
+        (*stack)->context_unlock = NULL;
+        (*stack)->lock_context = NULL;
+        (*stack)->rwlock = NULL;
+        (*stack)->pack = NULL;
+        (*stack)->cog = NULL;
+        memset(&(*stack)->provider, 0x0, sizeof((*stack)->provider));
+        (*stack)->spill = NULL;
+        (*stack)->latitude_0 = lat_0;
+        (*stack)->longitude_0 = long_0;
+        (*stack)->latitude_delta = lat_delta;
+        (*stack)->longitude_delta = long_delta;
+        (*stack)->latitude_n = lat_n;
+        (*stack)->longitude_n = long_n;
+        (*stack)->root = (char *)((*stack)->data);
+        memcpy((*stack)->root, root, root_size);
+        (*stack)->path = (char **)((*stack)->data + root_size);
+        (*stack)->pinned =
+            (struct turtle_map **)((char *)((*stack)->path) + path_size);
+        (*stack)->coverage = (unsigned char *)((*stack)->pinned) + path_size;
+        *data = (char *)((*stack)->coverage) + coverage_size;
+
+        /* Initialise the lookup data */
+        int i;
+        for (i = 0; i < lat_n * long_n; i++) {
+                (*stack)->path[i] = NULL;
+                (*stack)->pinned[i] = NULL;
+        }
+        memset((*stack)->coverage, 0x0, coverage_size);
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
 /* Create a new stack of maps */
 enum turtle_return turtle_stack_create(struct turtle_stack ** stack,
     const char * path, int size, turtle_stack_locker_t * lock,
@@ -60,7 +128,42 @@ enum turtle_return turtle_stack_create(struct turtle_stack ** stack,
         double lat_min = DBL_MAX, long_min = DBL_MAX;
         double lat_max = -DBL_MAX, long_max = -DBL_MAX;
         double lat_delta = 0., long_delta = 0.;
-        int data_size = strlen(path) + 1;
+        int data_size = 0;
+        int lat_n = 0, long_n = 0;
+
+        /* Check for a pack of tiles. Its index provides the lookup data */
+        struct turtle_pack * pack = NULL;
+        struct turtle_cog * cog = NULL;
+        if (turtle_pack_check_(path)) {
+                if (turtle_pack_open_(&pack, path, error_) !=
+                    TURTLE_RETURN_SUCCESS)
+                        return TURTLE_ERROR_RAISE();
+                lat_min = pack->latitude_0;
+                lat_delta = pack->latitude_delta;
+                lat_n = pack->latitude_n;
+                long_min = pack->longitude_0;
+                long_delta = pack->longitude_delta;
+                long_n = pack->longitude_n;
+                goto allocate;
+        }
+
+        /* Check for a remote tiled GeoTIFF. Its internal tiles provide the
+         * lookup data, such that only the needed ones are fetched
+         */
+#ifndef TURTLE_NO_TIFF
+        if (turtle_remote_check_(path)) {
+                if (turtle_cog_open_(&cog, path, error_) !=
+                    TURTLE_RETURN_SUCCESS)
+                        return TURTLE_ERROR_RAISE();
+                lat_min = cog->latitude_0;
+                lat_delta = cog->latitude_delta;
+                lat_n = cog->latitude_n;
+                long_min = cog->longitude_0;
+                long_delta = cog->longitude_delta;
+                long_n = cog->longitude_n;
+                goto allocate;
+        }
+#endif
 
         int rc;
         tinydir_dir dir;
@@ -75,13 +178,23 @@ enum turtle_return turtle_stack_create(struct turtle_stack ** stack,
                 struct turtle_io * io;
                 if ((trc = turtle_io_create_(&io, file.path, error_)) ==
                     TURTLE_RETURN_BAD_EXTENSION) {
-                        error_->code = TURTLE_RETURN_SUCCESS;
+                        turtle_error_clear_(error_);
                         continue;
                 } else if (trc != TURTLE_RETURN_SUCCESS)
                         goto error;
                 if (io->open(io, file.path, "rb", error_) !=
-                    TURTLE_RETURN_SUCCESS)
-                        goto error;
+                    TURTLE_RETURN_SUCCESS) {
+                        if (error_->code != TURTLE_RETURN_BAD_FORMAT)
+                                goto error;
+
+                        /* Skip files which do not hold elevation data, e.g.
+                         * stray archives or shortcuts
+                         */
+                        turtle_error_clear_(error_);
+                        io->close(io);
+                        free(io);
+                        continue;
+                }
 
                 /* Update the lookup data */
                 const double dx = io->meta.dx * (io->meta.nx - 1);
@@ -122,7 +235,6 @@ enum turtle_return turtle_stack_create(struct turtle_stack ** stack,
         if (rc == 0) tinydir_close(&dir);
 
         /* Check the grid size */
-        int lat_n = 0, long_n = 0;
         if ((lat_delta > 0.) && (long_delta > 0.)) {
                 const double dx = (long_max - long_min) / long_delta;
                 long_n = (int)(dx + FLT_EPSILON);
@@ -137,34 +249,34 @@ enum turtle_return turtle_stack_create(struct turtle_stack ** stack,
         }
 
         /* Allocate the new stack handle */
-        const int path_size = lat_n * long_n * sizeof(char *);
-        data_size += path_size;
-        *stack = malloc(sizeof(**stack) + data_size);
-        if (*stack == NULL) return TURTLE_ERROR_MEMORY();
-
-        /* Initialise the handle */
-        memset(&(*stack)->tiles, 0x0, sizeof((*stack)->tiles));
-        (*stack)->max_size = (size > 0) ? size : INT_MAX;
+allocate:;
+        char * cursor;
+        if (stack_allocate(stack, path, lat_min, lat_delta, lat_n, long_min,
+                long_delta, long_n, size, data_size, &cursor,
+                error_) != TURTLE_RETURN_SUCCESS) {
+                turtle_pack_close_(&pack);
+#ifndef TURTLE_NO_TIFF
+                turtle_cog_close_(&cog);
+#endif
+                return TURTLE_ERROR_RAISE();
+        }
         (*stack)->lock = lock;
         (*stack)->unlock = unlock;
-        (*stack)->latitude_0 = lat_min;
-        (*stack)->longitude_0 = long_min;
-        (*stack)->latitude_delta = lat_delta;
-        (*stack)->longitude_delta = long_delta;
-        (*stack)->latitude_n = lat_n;
-        (*stack)->longitude_n = long_n;
-        const int root_size = strlen(path) + 1;
-        (*stack)->root = (char *)((*stack)->data);
-        memcpy((*stack)->root, path, root_size);
-        (*stack)->path = (char **)((*stack)->data + root_size);
-
+        (*stack)->pack = pack;
+        (*stack)->cog = cog;
         if ((lat_n == 0) || (long_n == 0)) return TURTLE_RETURN_SUCCESS;
 
-        /* Build the lookup data */
         int i;
-        for (i = 0; i < lat_n * long_n; i++) (*stack)->path[i] = NULL;
+        if ((pack != NULL) || (cog != NULL)) {
+                /* Packed or remote tiles are identified by the stack path */
+                for (i = 0; i < lat_n * long_n; i++) {
+                        if ((pack != NULL) && (pack->lookup[i] < 0)) continue;
+                        (*stack)->path[i] = (*stack)->root;
+                        (*stack)->coverage[i / 8] |= 1 << (i % 8);
+                }
+                return TURTLE_RETURN_SUCCESS;
+        }
 
-        char * cursor = (char *)((*stack)->path) + path_size;
         for (tinydir_open(&dir, path); dir.has_next; tinydir_next(&dir)) {
                 tinydir_file file;
                 tinydir_readfile(&dir, &file);
@@ -174,10 +286,16 @@ enum turtle_return turtle_stack_create(struct turtle_stack ** stack,
                 struct turtle_io * io;
                 if (turtle_io_create_(&io, file.path, error_) !=
                     TURTLE_RETURN_SUCCESS) {
-                        error_->code = TURTLE_RETURN_SUCCESS;
+                        turtle_error_clear_(error_);
+                        continue;
+                }
+                if (io->open(io, file.path, "rb", error_) !=
+                    TURTLE_RETURN_SUCCESS) {
+                        turtle_error_clear_(error_);
+                        io->close(io);
+                        free(io);
                         continue;
                 }
-                io->open(io, file.path, "rb", error_);
 
                 /* Compute the lookup index */
                 const int ix = (int)((io->meta.x0 - long_min) / long_delta);
@@ -190,6 +308,7 @@ enum turtle_return turtle_stack_create(struct turtle_stack ** stack,
                 const int n = strlen(file.path) + 1;
                 memcpy(cursor, file.path, n);
                 (*stack)->path[i] = cursor;
+                (*stack)->coverage[i / 8] |= 1 << (i % 8);
                 cursor += n;
         }
         tinydir_close(&dir);
@@ -197,18 +316,74 @@ enum turtle_return turtle_stack_create(struct turtle_stack ** stack,
         return TURTLE_RETURN_SUCCESS;
 }
 
+/* Create a stack over a custom provider of tiles */
+enum turtle_return turtle_stack_create_provider(struct turtle_stack ** stack,
+    const struct turtle_stack_provider * provider, int size)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_stack_create_provider);
+        *stack = NULL;
+
+        /* Check the provider */
+        if ((provider->lookup == NULL) || (provider->fill == NULL))
+                return TURTLE_ERROR_MESSAGE(
+                    TURTLE_RETURN_BAD_ADDRESS, "missing provider callback(s)");
+        if ((provider->latitude_n < 0) || (provider->longitude_n < 0) ||
+            !(provider->latitude_delta > 0.) ||
+            !(provider->longitude_delta > 0.))
+                return TURTLE_ERROR_MESSAGE(
+                    TURTLE_RETURN_DOMAIN_ERROR, "invalid provider grid");
+
+        /* Allocate the new stack handle */
+        char * data;
+        if (stack_allocate(stack, "provider", provider->latitude_0,
+                provider->latitude_delta, provider->latitude_n,
+                provider->longitude_0, provider->longitude_delta,
+                provider->longitude_n, size, 0, &data,
+                error_) != TURTLE_RETURN_SUCCESS)
+                return TURTLE_ERROR_RAISE();
+        memcpy(&(*stack)->provider, provider, sizeof(*provider));
+
+        /* Lookup the provided tiles. These are identified by the stack root */
+        int ix, iy;
+        for (iy = 0; iy < provider->latitude_n; iy++) {
+                for (ix = 0; ix < provider->longitude_n; ix++) {
+                        struct turtle_map_info info;
+                        if (!provider->lookup(provider->context, ix, iy, &info))
+                                continue;
+                        const int i = iy * provider->longitude_n + ix;
+                        (*stack)->path[i] = (*stack)->root;
+                        (*stack)->coverage[i / 8] |= 1 << (i % 8);
+                }
+        }
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
 /* Low level routine for cleaning the stack */
 static void stack_clear(struct turtle_stack * stack, int force)
 {
         struct turtle_map * map = stack->tiles.head;
         while (map != NULL) {
                 struct turtle_map * next = map->element.next;
-                if ((force != 0) || (map->clients == 0))
+                if (force != 0)
                         turtle_map_destroy(&map);
+                else if ((map->clients == 0) && (map->pinned == 0))
+                        turtle_stack_drop_(stack, map);
                 map = next;
         }
 }
 
+/* Release any built-in lock */
+static void stack_rwlock_destroy(struct turtle_stack * stack)
+{
+        if (stack->rwlock == NULL) return;
+#ifndef TURTLE_NO_PTHREAD
+        pthread_rwlock_destroy(stack->rwlock);
+#endif
+        free(stack->rwlock);
+        stack->rwlock = NULL;
+}
+
 /* Destroy a stack and all its loaded maps */
 void turtle_stack_destroy(struct turtle_stack ** stack)
 {
@@ -216,6 +391,12 @@ void turtle_stack_destroy(struct turtle_stack ** stack)
 
         /* Force the stack cleaning */
         stack_clear(*stack, 1);
+        stack_rwlock_destroy(*stack);
+        turtle_pack_close_(&(*stack)->pack);
+#ifndef TURTLE_NO_TIFF
+        turtle_cog_close_(&(*stack)->cog);
+#endif
+        turtle_spill_destroy_(&(*stack)->spill);
 
         /* Delete the stack and return */
         free(*stack);
@@ -226,18 +407,403 @@ void turtle_stack_destroy(struct turtle_stack ** stack)
 enum turtle_return turtle_stack_clear(struct turtle_stack * stack)
 {
         TURTLE_ERROR_INITIALISE(&turtle_stack_clear);
-        if ((stack->lock != NULL) && (stack->lock() != 0))
+        if (turtle_stack_lock_(stack, TURTLE_STACK_ACCESS_EXCLUSIVE) != 0)
                 return TURTLE_ERROR_LOCK();
 
         /* Soft clean of the stack */
         stack_clear(stack, 0);
 
-        if ((stack->unlock != NULL) && (stack->unlock() != 0))
+        if (turtle_stack_unlock_(stack, TURTLE_STACK_ACCESS_EXCLUSIVE) != 0)
                 return TURTLE_ERROR_UNLOCK();
         else
                 return TURTLE_RETURN_SUCCESS;
 }
 
+/* Set a second tier cache for evicted tiles */
+enum turtle_return turtle_stack_spill_set(
+    struct turtle_stack * stack, const char * path, int size)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_stack_spill_set);
+        if (turtle_stack_lock_(stack, TURTLE_STACK_ACCESS_EXCLUSIVE) != 0)
+                return TURTLE_ERROR_LOCK();
+
+        turtle_spill_destroy_(&stack->spill);
+        if ((path != NULL) && (size > 0)) {
+                turtle_spill_create_(&stack->spill, path, size,
+                    stack->latitude_n * stack->longitude_n, error_);
+        }
+
+        if (turtle_stack_unlock_(stack, TURTLE_STACK_ACCESS_EXCLUSIVE) != 0)
+                return TURTLE_ERROR_UNLOCK();
+        else
+                return TURTLE_ERROR_RAISE();
+}
+
+/* Write the stack tiles to a single file */
+enum turtle_return turtle_stack_dump(
+    struct turtle_stack * stack, const char * path, int compression)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_stack_dump);
+        if ((compression < 0) || (compression > 9)) {
+                return TURTLE_ERROR_MESSAGE(
+                    TURTLE_RETURN_DOMAIN_ERROR, "invalid compression level");
+        }
+        turtle_pack_dump_(stack, path, compression, error_);
+        return TURTLE_ERROR_RAISE();
+}
+
+/* Set context aware callbacks for the locks */
+enum turtle_return turtle_stack_lock_set(struct turtle_stack * stack,
+    turtle_stack_context_locker_t * lock,
+    turtle_stack_context_locker_t * unlock, void * context)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_stack_lock_set);
+
+        /* Check the lock and unlock consistency. */
+        if (((lock == NULL) && (unlock != NULL)) ||
+            ((unlock == NULL) && (lock != NULL)))
+                return TURTLE_ERROR_MESSAGE(
+                    TURTLE_RETURN_BAD_ADDRESS, "inconsistent lock & unlock");
+
+        /* Override any previous locking scheme */
+        stack_rwlock_destroy(stack);
+        stack->lock = NULL;
+        stack->unlock = NULL;
+        stack->context_lock = lock;
+        stack->context_unlock = unlock;
+        stack->lock_context = (lock == NULL) ? NULL : context;
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
+#ifndef TURTLE_NO_PTHREAD
+/* Callbacks for the built-in reader/writer lock */
+static int rwlock_lock(void * context, enum turtle_stack_access access)
+{
+        pthread_rwlock_t * rwlock = context;
+        if (access == TURTLE_STACK_ACCESS_SHARED)
+                return pthread_rwlock_rdlock(rwlock);
+        else
+                return pthread_rwlock_wrlock(rwlock);
+}
+
+static int rwlock_unlock(void * context, enum turtle_stack_access access)
+{
+        return pthread_rwlock_unlock(context);
+}
+#endif
+
+/* Enable the built-in reader/writer lock */
+enum turtle_return turtle_stack_rwlock_enable(struct turtle_stack * stack)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_stack_rwlock_enable);
+#ifdef TURTLE_NO_PTHREAD
+        return TURTLE_ERROR_MESSAGE(
+            TURTLE_RETURN_LIBRARY_ERROR, "no pthread support");
+#else
+        pthread_rwlock_t * rwlock = malloc(sizeof(*rwlock));
+        if (rwlock == NULL) return TURTLE_ERROR_MEMORY();
+        if (pthread_rwlock_init(rwlock, NULL) != 0) {
+                free(rwlock);
+                return TURTLE_ERROR_MESSAGE(TURTLE_RETURN_LIBRARY_ERROR,
+                    "could not initialise the lock");
+        }
+
+        turtle_stack_lock_set(stack, &rwlock_lock, &rwlock_unlock, rwlock);
+        stack->rwlock = rwlock;
+
+        return TURTLE_RETURN_SUCCESS;
+#endif
+}
+
+/* Check if the stack has any lock */
+int turtle_stack_has_lock_(const struct turtle_stack * stack)
+{
+        return (stack->context_lock != NULL) || (stack->lock != NULL);
+}
+
+/* Check if a granted access excludes any other one */
+int turtle_stack_is_exclusive_(
+    const struct turtle_stack * stack, enum turtle_stack_access access)
+{
+        /* Legacy callbacks always provide an exclusive access */
+        return (access == TURTLE_STACK_ACCESS_EXCLUSIVE) ||
+            (stack->context_lock == NULL);
+}
+
+/* Label of lock events */
+static const char * access_label(enum turtle_stack_access access)
+{
+        return (access == TURTLE_STACK_ACCESS_EXCLUSIVE) ? "exclusive" :
+                                                           "shared";
+}
+
+/* Acquire the stack lock, if any */
+int turtle_stack_lock_(
+    struct turtle_stack * stack, enum turtle_stack_access access)
+{
+        if (!turtle_stack_has_lock_(stack)) return 0;
+
+        const char * label = access_label(access);
+        turtle_trace_(TURTLE_TRACE_LOCK_WAIT, TURTLE_TRACE_BEGIN, label);
+        const int rc = (stack->context_lock != NULL) ?
+            stack->context_lock(stack->lock_context, access) :
+            stack->lock();
+        turtle_trace_(TURTLE_TRACE_LOCK_WAIT, TURTLE_TRACE_END, label);
+        if (rc == 0)
+                turtle_trace_(
+                    TURTLE_TRACE_LOCK_HOLD, TURTLE_TRACE_BEGIN, label);
+        return rc;
+}
+
+/* Release the stack lock, if any */
+int turtle_stack_unlock_(
+    struct turtle_stack * stack, enum turtle_stack_access access)
+{
+        if (!turtle_stack_has_lock_(stack)) return 0;
+
+        turtle_trace_(
+            TURTLE_TRACE_LOCK_HOLD, TURTLE_TRACE_END, access_label(access));
+        if (stack->context_unlock != NULL)
+                return stack->context_unlock(stack->lock_context, access);
+        else if (stack->unlock != NULL)
+                return stack->unlock();
+        else
+                return 0;
+}
+
+/* Remove the least recently used maps, until at most `size` unpinned maps
+ * remain. Maps in use by clients are spared
+ */
+static void stack_evict(struct turtle_stack * stack, int size)
+{
+        struct turtle_map * m = stack->tiles.tail;
+        while ((m != NULL) && (stack->tiles.size - stack->pinned_n > size)) {
+                struct turtle_map * previous = m->element.previous;
+                if ((m->clients == 0) && (m->pinned == 0))
+                        turtle_stack_drop_(stack, m);
+                m = previous;
+        }
+}
+
+/* Find a loaded map containing the given geodetic coordinates */
+static struct turtle_map * stack_find(
+    struct turtle_stack * stack, double latitude, double longitude)
+{
+        struct turtle_map * map = stack->tiles.head;
+        while (map != NULL) {
+                const double hx = (longitude - map->meta.x0) / map->meta.dx;
+                const double hy = (latitude - map->meta.y0) / map->meta.dy;
+                if ((hx >= 0.) && (hx < map->meta.nx - 1) && (hy >= 0.) &&
+                    (hy < map->meta.ny - 1))
+                        return map;
+                map = map->element.next;
+        }
+        return NULL;
+}
+
+/* Get the range of tile indices overlapping a geodetic box. Returns zero if
+ * the box does not overlap the stack grid
+ */
+static int stack_range(const struct turtle_stack * stack, double latitude_0,
+    double latitude_1, double longitude_0, double longitude_1, int range[4])
+{
+        if ((stack->latitude_n == 0) || (stack->longitude_n == 0)) return 0;
+
+        const double hx0 =
+            (longitude_0 - stack->longitude_0) / stack->longitude_delta;
+        const double hx1 =
+            (longitude_1 - stack->longitude_0) / stack->longitude_delta;
+        const double hy0 =
+            (latitude_0 - stack->latitude_0) / stack->latitude_delta;
+        const double hy1 =
+            (latitude_1 - stack->latitude_0) / stack->latitude_delta;
+
+        /* Upper bounds lying on a tile edge do not overlap the next tile */
+        int ix0 = (int)floor(hx0);
+        int ix1 = (hx1 > hx0) ? (int)ceil(hx1) - 1 : ix0;
+        int iy0 = (int)floor(hy0);
+        int iy1 = (hy1 > hy0) ? (int)ceil(hy1) - 1 : iy0;
+
+        if (ix0 < 0) ix0 = 0;
+        if (ix1 >= stack->longitude_n) ix1 = stack->longitude_n - 1;
+        if (iy0 < 0) iy0 = 0;
+        if (iy1 >= stack->latitude_n) iy1 = stack->latitude_n - 1;
+        range[0] = ix0;
+        range[1] = ix1;
+        range[2] = iy0;
+        range[3] = iy1;
+
+        return (ix0 <= ix1) && (iy0 <= iy1);
+}
+
+/* Find the loaded map of a tile, given its index */
+static struct turtle_map * stack_tile_find(
+    struct turtle_stack * stack, int index)
+{
+        if (stack->pinned[index] != NULL) return stack->pinned[index];
+        const int ix = index % stack->longitude_n;
+        const int iy = index / stack->longitude_n;
+        const double x =
+            stack->longitude_0 + (ix + 0.5) * stack->longitude_delta;
+        const double y =
+            stack->latitude_0 + (iy + 0.5) * stack->latitude_delta;
+        return stack_find(stack, y, x);
+}
+
+/* Work item for loading a tile */
+struct batch_item {
+        int index;
+        int load;
+        struct turtle_map * map;
+        struct turtle_error_context error;
+};
+
+/* Shared state of the tile loaders */
+struct batch_job {
+        struct turtle_stack * stack;
+        struct batch_item * items;
+        int n;
+        int next;
+};
+
+/* Initialise a work item */
+static void batch_item_initialise(
+    struct batch_item * item, int index, turtle_function_t * function)
+{
+        item->index = index;
+        item->load = 1;
+        item->map = NULL;
+        memset(&item->error, 0x0, sizeof(item->error));
+        item->error.code = TURTLE_RETURN_SUCCESS;
+        item->error.function = function;
+}
+
+/* Load tiles until the job is exhausted */
+static void * batch_worker(void * arg)
+{
+        struct batch_job * job = arg;
+        for (;;) {
+                const int i = __sync_fetch_and_add(&job->next, 1);
+                if (i >= job->n) break;
+                struct batch_item * item = job->items + i;
+                if (!item->load || (item->map != NULL) ||
+                    (item->error.code != TURTLE_RETURN_SUCCESS))
+                        continue; /* Already processed */
+                turtle_stack_tile_load_(
+                    job->stack, item->index, &item->map, &item->error);
+        }
+        return NULL;
+}
+
+/* Maximum number of threads used for loading a batch of tiles */
+#define BATCH_MAX_THREADS 8
+
+/* Maximum number of distinct tile formats initialised serially */
+#define BATCH_MAX_FORMATS 8
+
+/* Get the format of a tile, i.e. its file extension. Packed and provided
+ * tiles do not depend on any IO library, while the one of remote tiles is
+ * initialised with the stack
+ */
+static const char * stack_tile_format(
+    const struct turtle_stack * stack, int index)
+{
+        if ((stack->pack != NULL) || (stack->cog != NULL) ||
+            (stack->provider.fill != NULL))
+                return "";
+        const char * extension = strrchr(stack->path[index], '.');
+        return (extension == NULL) ? "" : extension;
+}
+
+/* Load the maps of a batch. Reads are independent, thus many of them are kept
+ * in flight using a pool of threads. Errors are reported per item.
+ *
+ * Note that the stack must not be locked by the caller. The loaded maps are
+ * private to the batch until they are stacked
+ */
+static void stack_load_batch(
+    struct turtle_stack * stack, struct batch_item * items, int n)
+{
+        int i, n_load = 0;
+        for (i = 0; i < n; i++)
+                if (items[i].load) n_load++;
+        if (n_load == 0) return;
+
+        /* The first map of each format is loaded alone, such that the
+         * corresponding IO library is initialised before going parallel
+         */
+        struct batch_job job = { stack, items, n, 0 };
+        const char * formats[BATCH_MAX_FORMATS];
+        int n_formats = 0;
+        for (i = 0; (i < n) && (n_formats < BATCH_MAX_FORMATS); i++) {
+                struct batch_item * item = items + i;
+                if (!item->load) continue;
+                const char * format = stack_tile_format(stack, item->index);
+                int j;
+                for (j = 0; j < n_formats; j++)
+                        if (strcmp(formats[j], format) == 0) break;
+                if (j < n_formats) continue;
+                formats[n_formats++] = format;
+                turtle_stack_tile_load_(
+                    stack, item->index, &item->map, &item->error);
+                n_load--;
+        }
+#ifndef TURTLE_NO_PTHREAD
+        /* The calling thread is a worker as well. Thus, one extra thread is
+         * spawned per remaining map but one, up to the pool size
+         */
+        pthread_t threads[BATCH_MAX_THREADS - 1];
+        int n_threads = 0;
+        while ((n_threads < BATCH_MAX_THREADS - 1) &&
+            (n_threads < n_load - 1)) {
+                if (pthread_create(threads + n_threads, NULL, &batch_worker,
+                        &job) != 0)
+                        break;
+                n_threads++;
+        }
+#endif
+        batch_worker(&job);
+#ifndef TURTLE_NO_PTHREAD
+        for (i = 0; i < n_threads; i++) pthread_join(threads[i], NULL);
+#endif
+}
+
+/* Release the maps of a batch that were not stacked */
+static void stack_batch_release(struct batch_item * items, int n)
+{
+        int i;
+        for (i = 0; i < n; i++) {
+                struct turtle_map * map = items[i].map;
+                if ((map != NULL) && (map->stack == NULL))
+                        turtle_map_destroy(&items[i].map);
+        }
+}
+
+/* Forward the first error of a batch, if any, and release the others */
+static void stack_batch_error(struct batch_item * items, int n,
+    struct turtle_error_context * error_)
+{
+        int i;
+        for (i = 0; i < n; i++) {
+                struct batch_item * item = items + i;
+                if (item->error.code == TURTLE_RETURN_SUCCESS) continue;
+                if (error_->code == TURTLE_RETURN_SUCCESS)
+                        memcpy(error_, &item->error, sizeof(*error_));
+                else if (item->error.dynamic)
+                        free(item->error.message);
+        }
+}
+
+/* Get the room left in the stack for unpinned maps */
+static int stack_room(const struct turtle_stack * stack)
+{
+        const int room =
+            stack->max_size - (stack->tiles.size - stack->pinned_n);
+        const int n = stack->latitude_n * stack->longitude_n;
+        return (room > n) ? n : room;
+}
+
 /* Load the stack elevation data into memory */
 enum turtle_return turtle_stack_load(struct turtle_stack * stack)
 {
@@ -245,52 +811,208 @@ enum turtle_return turtle_stack_load(struct turtle_stack * stack)
         if ((stack->latitude_n == 0) || (stack->longitude_n == 0))
                 return TURTLE_RETURN_SUCCESS;
 
-        if ((stack->lock != NULL) && (stack->lock() != 0))
+        if (turtle_stack_lock_(stack, TURTLE_STACK_ACCESS_EXCLUSIVE) != 0)
                 return TURTLE_ERROR_LOCK();
 
-        double x = stack->longitude_0 + 0.5 * stack->longitude_delta;
-        double y = stack->latitude_0 + 0.5 * stack->latitude_delta;
-        struct turtle_map * head = stack->tiles.head;
-
-        while (stack->tiles.size < stack->max_size) {
-                /* First, let us check the initial stack */
-                int load = 1;
-                struct turtle_map * map = head;
-                while (map != NULL) {
-                        const double hx = (x - map->meta.x0) / map->meta.dx;
-                        const double hy = (y - map->meta.y0) / map->meta.dy;
-
-                        if ((hx >= 0.) && (hx <= map->meta.nx) && (hy >= 0.) &&
-                            (hy <= map->meta.ny)) {
-                                load = 0;
-                                break;
-                        }
-                        map = map->element.next;
+        /* List the missing maps, in grid order, within the room left in the
+         * stack
+         */
+        const int room = stack_room(stack);
+        struct batch_item * items = NULL;
+        int n = 0;
+        if (room > 0) {
+                items = malloc(room * sizeof(*items));
+                if (items == NULL) {
+                        turtle_stack_unlock_(
+                            stack, TURTLE_STACK_ACCESS_EXCLUSIVE);
+                        return TURTLE_ERROR_MEMORY();
                 }
+                int index;
+                const int n_tiles = stack->latitude_n * stack->longitude_n;
+                for (index = 0; (index < n_tiles) && (n < room); index++) {
+                        if ((stack->path[index] == NULL) ||
+                            (stack_tile_find(stack, index) != NULL))
+                                continue;
+                        batch_item_initialise(items + n++, index,
+                            (turtle_function_t *)&turtle_stack_load);
+                }
+        }
+        if (turtle_stack_unlock_(stack, TURTLE_STACK_ACCESS_EXCLUSIVE) != 0) {
+                free(items);
+                return TURTLE_ERROR_UNLOCK();
+        }
+        if (n == 0) {
+                free(items);
+                return TURTLE_RETURN_SUCCESS;
+        }
+
+        /* Load them all at once, without holding the lock such that clients
+         * are not blocked meanwhile
+         */
+        stack_load_batch(stack, items, n);
 
-                if (load) {
-                        int inside;
-                        if (turtle_stack_load_(stack, y, x, &inside, error_) !=
-                            TURTLE_RETURN_SUCCESS)
-                                break;
+        /* Stack the successful ones. Since the lock was released, the same
+         * maps might have been loaded by clients meanwhile, or the room taken
+         */
+        if (turtle_stack_lock_(stack, TURTLE_STACK_ACCESS_EXCLUSIVE) != 0) {
+                stack_batch_release(items, n);
+                stack_batch_error(items, n, error_);
+                free(items);
+                return TURTLE_ERROR_LOCK();
+        }
+        int i, left = stack_room(stack);
+        for (i = 0; i < n; i++) {
+                struct turtle_map * map = items[i].map;
+                if ((map == NULL) || (left <= 0) ||
+                    (stack_tile_find(stack, items[i].index) != NULL))
+                        continue;
+                map->stack = stack;
+                turtle_list_insert_(&stack->tiles, map, 0);
+                left--;
+        }
+        stack_batch_release(items, n);
+        stack_batch_error(items, n, error_);
+        free(items);
+
+        if (turtle_stack_unlock_(stack, TURTLE_STACK_ACCESS_EXCLUSIVE) != 0)
+                return TURTLE_ERROR_UNLOCK();
+        else
+                return TURTLE_ERROR_RAISE();
+}
+
+/* Pin the maps overlapping a geodetic box */
+enum turtle_return turtle_stack_pin(struct turtle_stack * stack,
+    double latitude_0, double latitude_1, double longitude_0,
+    double longitude_1)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_stack_pin);
+
+        if (!(latitude_1 >= latitude_0) || !(longitude_1 >= longitude_0))
+                return TURTLE_ERROR_BOX();
+        int range[4];
+        if (!stack_range(stack, latitude_0, latitude_1, longitude_0,
+                longitude_1, range))
+                return TURTLE_RETURN_SUCCESS;
+
+        const int n = (range[1] - range[0] + 1) * (range[3] - range[2] + 1);
+        struct batch_item * items = malloc(n * sizeof(*items));
+        if (items == NULL) return TURTLE_ERROR_MEMORY();
+
+        if (turtle_stack_lock_(stack, TURTLE_STACK_ACCESS_EXCLUSIVE) != 0) {
+                free(items);
+                return TURTLE_ERROR_LOCK();
+        }
+
+        /* List the maps to pin, flagging the ones to load */
+        int m = 0, ix, iy;
+        for (iy = range[2]; iy <= range[3]; iy++) {
+                for (ix = range[0]; ix <= range[1]; ix++) {
+                        const int index = iy * stack->longitude_n + ix;
+                        if (stack->path[index] == NULL) continue;
+                        struct batch_item * item = items + m++;
+                        batch_item_initialise(item, index,
+                            (turtle_function_t *)&turtle_stack_pin);
+                        item->load = (stack_tile_find(stack, index) == NULL);
+                }
+        }
+        if (turtle_stack_unlock_(stack, TURTLE_STACK_ACCESS_EXCLUSIVE) != 0) {
+                free(items);
+                return TURTLE_ERROR_UNLOCK();
+        }
+
+        /* Load the missing maps, without holding the lock */
+        stack_load_batch(stack, items, m);
+
+        if (turtle_stack_lock_(stack, TURTLE_STACK_ACCESS_EXCLUSIVE) != 0) {
+                stack_batch_release(items, m);
+                stack_batch_error(items, m, error_);
+                free(items);
+                return TURTLE_ERROR_LOCK();
+        }
+
+        /* Resolve the maps to pin. Maps stacked meanwhile by clients take
+         * precedence over the loaded ones. Maps evicted meanwhile are
+         * reloaded
+         */
+        stack_batch_error(items, m, error_);
+        int i;
+        for (i = 0; (i < m) && (error_->code == TURTLE_RETURN_SUCCESS); i++) {
+                struct batch_item * item = items + i;
+                struct turtle_map * map = stack_tile_find(stack, item->index);
+                if (map != NULL) {
+                        if (item->map != NULL) turtle_map_destroy(&item->map);
+                        item->map = map;
+                } else if (item->map == NULL) {
+                        turtle_stack_tile_load_(
+                            stack, item->index, &item->map, error_);
                 }
+        }
+        if (error_->code != TURTLE_RETURN_SUCCESS) {
+                stack_batch_release(items, m);
+                goto exit;
+        }
 
-                /* Update the coordinates and check for termination */
-                x += stack->longitude_delta;
-                if (x > stack->longitude_0 +
-                        stack->longitude_n * stack->longitude_delta) {
-                        y += stack->latitude_delta;
-                        if (y > stack->latitude_0 +
-                                stack->latitude_n * stack->latitude_delta)
-                                break;
-                        x = stack->longitude_0 + 0.5 * stack->longitude_delta;
+        /* Register the pinned maps. Note that a map is published only once
+         * it is fully initialised, since it might be read without any lock
+         */
+        for (i = 0; i < m; i++) {
+                struct turtle_map * map = items[i].map;
+                if (map->pinned > 0) {
+                        map->pinned++;
+                        continue;
                 }
+                if (map->stack == NULL) {
+                        map->stack = stack;
+                        turtle_list_insert_(&stack->tiles, map, 0);
+                }
+                map->pinned = 1;
+                stack->pinned_n++;
+                __sync_synchronize();
+                stack->pinned[items[i].index] = map;
         }
 
-        if ((stack->unlock != NULL) && (stack->unlock() != 0))
+exit:
+        free(items);
+        if (turtle_stack_unlock_(stack, TURTLE_STACK_ACCESS_EXCLUSIVE) != 0)
+                return TURTLE_ERROR_UNLOCK();
+        return TURTLE_ERROR_RAISE();
+}
+
+/* Unpin the maps overlapping a geodetic box */
+enum turtle_return turtle_stack_unpin(struct turtle_stack * stack,
+    double latitude_0, double latitude_1, double longitude_0,
+    double longitude_1)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_stack_unpin);
+
+        if (!(latitude_1 >= latitude_0) || !(longitude_1 >= longitude_0))
+                return TURTLE_ERROR_BOX();
+        int range[4];
+        if (!stack_range(stack, latitude_0, latitude_1, longitude_0,
+                longitude_1, range))
+                return TURTLE_RETURN_SUCCESS;
+
+        if (turtle_stack_lock_(stack, TURTLE_STACK_ACCESS_EXCLUSIVE) != 0)
+                return TURTLE_ERROR_LOCK();
+
+        int ix, iy;
+        for (iy = range[2]; iy <= range[3]; iy++) {
+                for (ix = range[0]; ix <= range[1]; ix++) {
+                        const int index = iy * stack->longitude_n + ix;
+                        struct turtle_map * map = stack->pinned[index];
+                        if ((map == NULL) || (--map->pinned > 0)) continue;
+                        stack->pinned[index] = NULL;
+                        stack->pinned_n--;
+                }
+        }
+
+        /* The unpinned maps are now subject to eviction */
+        stack_evict(stack, stack->max_size);
+
+        if (turtle_stack_unlock_(stack, TURTLE_STACK_ACCESS_EXCLUSIVE) != 0)
                 return TURTLE_ERROR_UNLOCK();
         else
-                return TURTLE_ERROR_RAISE();
+                return TURTLE_RETURN_SUCCESS;
 }
 
 /* Get the elevation at the given geodetic coordinates */
@@ -300,6 +1022,23 @@ enum turtle_return turtle_stack_elevation(struct turtle_stack * stack,
         TURTLE_ERROR_INITIALISE(&turtle_stack_elevation);
         if (inside != NULL) *inside = 0;
 
+        /* Check that there are some data at the requested location */
+        if (!turtle_stack_covers_(stack, latitude, longitude)) {
+                *elevation = 0.;
+                if (inside != NULL)
+                        return TURTLE_RETURN_SUCCESS;
+                else
+                        return TURTLE_ERROR_MISSING_DATA(stack);
+        }
+
+        /* Check the pinned maps */
+        struct turtle_map * pinned =
+            turtle_stack_pinned_(stack, latitude, longitude);
+        if (pinned != NULL) {
+                return turtle_map_elevation_(
+                    pinned, longitude, latitude, elevation, inside, error_);
+        }
+
         /* Get the proper map */
         double hx, hy;
         int load = 1;
@@ -362,6 +1101,114 @@ void turtle_stack_touch_(struct turtle_stack * stack, struct turtle_map * map)
         turtle_list_insert_(&stack->tiles, map, 0);
 }
 
+/* Load a tile from a custom provider */
+static enum turtle_return stack_provide(struct turtle_stack * stack, int index,
+    struct turtle_map ** map, struct turtle_error_context * error_)
+{
+        const struct turtle_stack_provider * provider = &stack->provider;
+        const int ix = index % stack->longitude_n;
+        const int iy = index / stack->longitude_n;
+        struct turtle_map_info info;
+        *map = NULL;
+        if (!provider->lookup(provider->context, ix, iy, &info))
+                return TURTLE_ERROR_REGISTER_MISSING_DATA(stack);
+        if (turtle_map_create_(map, &info, NULL, error_) !=
+            TURTLE_RETURN_SUCCESS)
+                return error_->code;
+
+        /* Get the elevation values and encode them */
+        const int n = info.nx * info.ny;
+        double * elevation = malloc(n * sizeof(*elevation));
+        if (elevation == NULL) {
+                TURTLE_ERROR_REGISTER(
+                    TURTLE_RETURN_MEMORY_ERROR, "could not allocate memory");
+                goto error;
+        }
+        enum turtle_return rc =
+            provider->fill(provider->context, ix, iy, &info, elevation);
+        if (rc != TURTLE_RETURN_SUCCESS) {
+                TURTLE_ERROR_VREGISTER(
+                    rc, "could not fill tile (%d, %d)", ix, iy);
+                goto error;
+        }
+        const double z0 = (info.z[0] < info.z[1]) ? info.z[0] : info.z[1];
+        const double z1 = (info.z[0] < info.z[1]) ? info.z[1] : info.z[0];
+        int i;
+        for (i = 0; i < n; i++) {
+                const double z = elevation[i];
+                if (!(z >= z0) || !(z <= z1)) {
+                        TURTLE_ERROR_VREGISTER(TURTLE_RETURN_DOMAIN_ERROR,
+                            "elevation is outside of tile (%d, %d) span", ix,
+                            iy);
+                        goto error;
+                }
+                (*map)->meta.set_z(*map, i % info.nx, i / info.nx, z);
+        }
+        free(elevation);
+
+        return TURTLE_RETURN_SUCCESS;
+error:
+        free(elevation);
+        turtle_map_destroy(map);
+        return error_->code;
+}
+
+/* Load the map of a tile, given its lookup index */
+static enum turtle_return stack_tile_load(struct turtle_stack * stack,
+    int index, struct turtle_map ** map, struct turtle_error_context * error_)
+{
+        if (stack->spill != NULL) {
+                /* Check the second tier cache first */
+                if (turtle_spill_load_(stack->spill, index, map, error_) !=
+                    TURTLE_RETURN_SUCCESS)
+                        return error_->code;
+                if (*map != NULL) return TURTLE_RETURN_SUCCESS;
+        }
+
+        if (stack->pack != NULL) {
+                return turtle_pack_load_(
+                    stack->pack, stack->pack->lookup[index], map, error_);
+        }
+#ifndef TURTLE_NO_TIFF
+        if (stack->cog != NULL) {
+                return turtle_cog_load_(stack->cog,
+                    index % stack->longitude_n, index / stack->longitude_n,
+                    map, error_);
+        }
+#endif
+        if (stack->provider.fill != NULL)
+                return stack_provide(stack, index, map, error_);
+        else
+                return turtle_map_load_(map, stack->path[index], error_);
+}
+
+/* Load the map of a tile, given its lookup index, and trace it */
+enum turtle_return turtle_stack_tile_load_(struct turtle_stack * stack,
+    int index, struct turtle_map ** map, struct turtle_error_context * error_)
+{
+        const char * path = stack->path[index];
+        turtle_trace_(TURTLE_TRACE_TILE_LOAD, TURTLE_TRACE_BEGIN, path);
+        const enum turtle_return rc =
+            stack_tile_load(stack, index, map, error_);
+        turtle_trace_(TURTLE_TRACE_TILE_LOAD, TURTLE_TRACE_END, path);
+        return rc;
+}
+
+/* Remove a map from the stack, spilling it if enabled */
+void turtle_stack_drop_(struct turtle_stack * stack, struct turtle_map * map)
+{
+        if ((stack->spill != NULL) || turtle_trace_enabled_) {
+                const int index = turtle_stack_index_(stack,
+                    map->meta.y0 + 0.5 * (map->meta.ny - 1) * map->meta.dy,
+                    map->meta.x0 + 0.5 * (map->meta.nx - 1) * map->meta.dx);
+                turtle_trace_(TURTLE_TRACE_TILE_EVICT, TURTLE_TRACE_INSTANT,
+                    (index >= 0) ? stack->path[index] : NULL);
+                if ((stack->spill != NULL) && (index >= 0))
+                        turtle_spill_store_(stack->spill, index, map);
+        }
+        turtle_map_destroy(&map);
+}
+
 /* Load a new map and manage the stack */
 enum turtle_return turtle_stack_load_(struct turtle_stack * stack,
     double latitude, double longitude, int * inside,
@@ -379,34 +1226,18 @@ enum turtle_return turtle_stack_load_(struct turtle_stack * stack,
 
         /* Lookup the requested file */
         if (inside != NULL) *inside = 0;
-        if ((longitude < stack->longitude_0) || (latitude < stack->latitude_0))
-                RETURN_OR_RAISE()
-        const int ix =
-            (int)((longitude - stack->longitude_0) / stack->longitude_delta);
-        if (ix >= stack->longitude_n) RETURN_OR_RAISE()
-        const int iy =
-            (int)((latitude - stack->latitude_0) / stack->latitude_delta);
-        if (iy >= stack->latitude_n) RETURN_OR_RAISE()
-        const int index = iy * stack->longitude_n + ix;
-        if (stack->path[index] == NULL) RETURN_OR_RAISE()
+        const int index = turtle_stack_index_(stack, latitude, longitude);
+        if ((index < 0) || (stack->path[index] == NULL)) RETURN_OR_RAISE()
 #undef RETURN_OR_RAISE
 
         /* Load the map data according to the format */
         struct turtle_map * map;
-        if (turtle_map_load_(&map, stack->path[index], error_) !=
+        if (turtle_stack_tile_load_(stack, index, &map, error_) !=
             TURTLE_RETURN_SUCCESS)
                 return error_->code;
 
         /* Make room for the new map, if needed */
-        if (stack->tiles.size >= stack->max_size) {
-                struct turtle_map * m = stack->tiles.tail;
-                while ((m != NULL) && (stack->tiles.size >= stack->max_size)) {
-                        struct turtle_map * previous = m->element.previous;
-                        if (m->clients == 0)
-                                turtle_map_destroy(&m);
-                        m = previous;
-                }
-        }
+        stack_evict(stack, stack->max_size - 1);
 
         /* Append the new map at the head of the stack */
         map->stack = stack;
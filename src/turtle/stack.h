@@ -24,9 +24,14 @@
 #ifndef TURTLE_STACK_H
 #define TURTLE_STACK_H
 
+/* C89 standard library */
+#include <stddef.h>
+/* Turtle library */
 #include "turtle.h"
 #include "turtle/list.h"
 #include "turtle/map.h"
+#include "turtle/pack.h"
+#include "turtle/spill.h"
 
 /* Container for a stack of global topography data */
 struct turtle_stack {
@@ -34,10 +39,22 @@ struct turtle_stack {
         struct turtle_list tiles;
         int max_size;
 
+        /* Pinned maps, indexed by tile, and their number */
+        struct turtle_map ** pinned;
+        int pinned_n;
+
         /* Callbacks for managing concurent accesses to the stack */
         turtle_stack_locker_t * lock;
         turtle_stack_locker_t * unlock;
 
+        /* Context aware callbacks, superseding the previous ones if set */
+        turtle_stack_context_locker_t * context_lock;
+        turtle_stack_context_locker_t * context_unlock;
+        void * lock_context;
+
+        /* Built-in reader/writer lock, owned by the stack */
+        void * rwlock;
+
         /* Lookup data for tile's file names */
         double latitude_0, latitude_delta;
         double longitude_0, longitude_delta;
@@ -45,12 +62,76 @@ struct turtle_stack {
         char * root;
         char ** path;
 
+        /* Pack of tiles, if the stack is loaded from a single file */
+        struct turtle_pack * pack;
+
+        /* Remote tiled GeoTIFF, if the stack is loaded from a URL */
+        struct turtle_cog * cog;
+
+        /* Custom provider of tiles, if its fill callback is not NULL */
+        struct turtle_stack_provider provider;
+
+        /* Second tier cache for evicted tiles, or NULL */
+        struct turtle_spill * spill;
+
+        /* Immutable bitmap of the tiles with data */
+        unsigned char * coverage;
+
         char data[]; /* Placeholder for data */
 };
 
+/* Get the index of the tile containing the given geodetic coordinates, or
+ * -1 if outside of the stack grid
+ */
+static inline int turtle_stack_index_(
+    const struct turtle_stack * stack, double latitude, double longitude)
+{
+        const double hx =
+            (longitude - stack->longitude_0) / stack->longitude_delta;
+        const double hy =
+            (latitude - stack->latitude_0) / stack->latitude_delta;
+        if (!(hx >= 0.) || (hx >= stack->longitude_n) || !(hy >= 0.) ||
+            (hy >= stack->latitude_n))
+                return -1;
+        return (int)hy * stack->longitude_n + (int)hx;
+}
+
+/* Check if there are some data at the given geodetic coordinates. This does
+ * not require any lock since the coverage is immutable
+ */
+static inline int turtle_stack_covers_(
+    const struct turtle_stack * stack, double latitude, double longitude)
+{
+        const int index = turtle_stack_index_(stack, latitude, longitude);
+        return (index >= 0) &&
+            (stack->coverage[index / 8] & (1 << (index % 8)));
+}
+
+/* Get the pinned map for the given geodetic coordinates, if any. This does
+ * not require any lock since pinned maps are never evicted
+ */
+static inline struct turtle_map * turtle_stack_pinned_(
+    const struct turtle_stack * stack, double latitude, double longitude)
+{
+        const int index = turtle_stack_index_(stack, latitude, longitude);
+        return (index >= 0) ? stack->pinned[index] : NULL;
+}
+
+/* Concurrent accesses management routines */
+int turtle_stack_has_lock_(const struct turtle_stack * stack);
+int turtle_stack_is_exclusive_(
+    const struct turtle_stack * stack, enum turtle_stack_access access);
+int turtle_stack_lock_(
+    struct turtle_stack * stack, enum turtle_stack_access access);
+int turtle_stack_unlock_(
+    struct turtle_stack * stack, enum turtle_stack_access access);
+
 /* Map management routines */
 void turtle_stack_touch_(struct turtle_stack * stack, struct turtle_map * map);
+void turtle_stack_drop_(struct turtle_stack * stack, struct turtle_map * map);
 struct turtle_error_context;
+enum turtle_return turtle_stack_tile_load_(struct turtle_stack * stack,
+    int index, struct turtle_map ** map, struct turtle_error_context * error_);
 enum turtle_return turtle_stack_load_(struct turtle_stack * stack,
     double latitude, double longitude, int * inside,
     struct turtle_error_context * error_);
@@ -27,16 +27,80 @@
 #include "map.h"
 #include "projection.h"
 #include "stack.h"
+#include "trace.h"
 #include "turtle.h"
 /* C89 standard library */
 #include "float.h"
 #include "math.h"
+#include "stdint.h"
 #include "stdlib.h"
 #include "string.h"
+#ifndef TURTLE_NO_PTHREAD
+/* POSIX threads */
+#include <pthread.h>
+#endif
+
+#ifndef M_PI
+/* Define pi, if unknown */
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Default slope factor for the stepping algorithm */
+#define DEFAULT_SLOPE 0.4
+
+/* WGS84 ellipsoid parameters, for the curvature of local frames */
+#define WGS84_A 6378137.
+#define WGS84_E 0.081819190842622
+
+/* Parameters of the auto-tuning: the number of steps per adaptation of the
+ * slope and resolution factors, the maximum number of steps of minimum
+ * length per crossing and the length of a degree, for converting
+ * linearisation errors
+ */
+#define TUNE_WINDOW 32
+#define TUNE_FLOORS 8
+#define TUNE_DEGREE (WGS84_A * M_PI / 180.)
+
+static inline int frame_is_local(const struct turtle_stepper * stepper)
+{
+        return stepper->frame.projection.type != PROJECTION_NONE;
+}
+
+/* Get the altitude of a position in the local frame. If the frame is curved,
+ * heights are w.r.t. the tangent plane at the frame origin
+ */
+static double frame_altitude(
+    const struct turtle_stepper * stepper, const double * position)
+{
+        if (!stepper->frame.curved) return position[2];
+        const double dx = position[0] - stepper->frame.origin[0];
+        const double dy = position[1] - stepper->frame.origin[1];
+        const double r = stepper->frame.radius + position[2];
+        return sqrt(r * r + dx * dx + dy * dy) - stepper->frame.radius;
+}
 
-static void ecef_to_geodetic(struct turtle_stepper * stepper,
+/* Check if a map shares the projection of the local frame */
+static int frame_native(
+    const struct turtle_stepper * stepper, const struct turtle_map * map)
+{
+        if (!frame_is_local(stepper)) return 0;
+        const char * name =
+            turtle_projection_name(turtle_map_projection(map));
+        return (name != NULL) &&
+            (strcmp(name, stepper->frame.projection.tag) == 0);
+}
+
+static void position_to_geodetic(struct turtle_stepper * stepper,
     const double * position, double * geographic)
 {
+        if (frame_is_local(stepper)) {
+                /* No geoid correction is applied in a local frame */
+                turtle_projection_unproject(&stepper->frame.projection,
+                    position[0], position[1], geographic, geographic + 1);
+                geographic[2] = frame_altitude(stepper, position);
+                return;
+        }
+
         turtle_ecef_to_geodetic(
             position, geographic, geographic + 1, geographic + 2);
         if (stepper->geoid != NULL) {
@@ -58,7 +122,7 @@ static enum turtle_return compute_geodetic(struct turtle_stepper * stepper,
     struct turtle_stepper_data * data, const double * position, int n0,
     double * geographic)
 {
-        ecef_to_geodetic(stepper, position, geographic);
+        position_to_geodetic(stepper, position, geographic);
         return TURTLE_RETURN_SUCCESS;
 }
 
@@ -67,7 +131,7 @@ static enum turtle_return compute_geomap(struct turtle_stepper * stepper,
     double * geographic)
 {
         if (n0 == 0) {
-                ecef_to_geodetic(stepper, position, geographic);
+                position_to_geodetic(stepper, position, geographic);
         }
         struct turtle_map * map = data->a.map;
         const struct turtle_projection * projection =
@@ -82,12 +146,135 @@ static enum turtle_return compute_geomap(struct turtle_stepper * stepper,
         }
 }
 
-static enum turtle_return get_geographic(struct turtle_stepper * stepper,
+/* Clip a tuned setting to its bounds */
+static double tune_clip(double value, const double * bounds)
+{
+        if (value < bounds[0])
+                return bounds[0];
+        else if (value > bounds[1])
+                return bounds[1];
+        else
+                return value;
+}
+
+/* Estimate the linearisation error of a local transform from exact
+ * geographic coordinates beyond its range, and adapt the local range
+ * accordingly. The error is the one of the extrapolated geodetic
+ * coordinates, at the given range
+ */
+static void tune_transform(struct turtle_stepper * stepper,
+    const struct turtle_stepper_transform * transform, const double * position,
+    int n0, int n1, const double * geographic, double range)
+{
+        if (n1 > 3) n1 = 3;
+        if ((n0 >= n1) || (transform->reference_ecef[0] == DBL_MAX) ||
+            (range <= 0.))
+                return;
+
+        double error = 0.;
+        int j;
+        for (j = n0; j < n1; j++) {
+                double d = transform->reference_geographic[j] - geographic[j];
+                int i;
+                for (i = 0; i < 3; i++) {
+                        d += transform->data[j][i] *
+                            (position[i] - transform->reference_ecef[i]);
+                }
+                if (j == 0)
+                        d *= TUNE_DEGREE;
+                else if (j == 1)
+                        d *= TUNE_DEGREE * cos(geographic[0] * M_PI / 180.);
+                error += d * d;
+        }
+        error = sqrt(error);
+
+        /* The error scales as the squared range. Estimates decrease slowly,
+         * for robustness
+         */
+        struct turtle_stepper_tune_state * state = &stepper->tuning.state;
+        const double curvature = error / (range * range);
+        if (curvature > 0.5 * state->curvature)
+                state->curvature = curvature;
+        else
+                state->curvature *= 0.5;
+
+        const double * bounds = stepper->tuning.bounds.range;
+        stepper->local_range = (state->curvature > 0.) ?
+            tune_clip(sqrt(stepper->tuning.bounds.tolerance /
+                state->curvature), bounds) :
+            bounds[1];
+}
+
+/* Update the stepping statistics, and adapt the slope and resolution factors
+ * once per window of steps
+ */
+static void tune_step(
+    struct turtle_stepper * stepper, int minimal, int crossed)
+{
+        struct turtle_stepper_tune_state * state = &stepper->tuning.state;
+        const int overshoot = crossed && !minimal;
+        state->steps++;
+        state->overshoots += overshoot;
+        state->floors += minimal;
+        state->crossings += crossed;
+        stepper->tuning.report.steps++;
+        stepper->tuning.report.overshoots += overshoot;
+        if (state->steps < TUNE_WINDOW) return;
+
+        const struct turtle_stepper_tuning * bounds = &stepper->tuning.bounds;
+        if (stepper->slope_factor > 0.) {
+                if (state->overshoots > bounds->overshoot * state->steps) {
+                        stepper->slope_factor = tune_clip(
+                            0.8 * stepper->slope_factor, bounds->slope);
+                } else if (state->overshoots == 0) {
+                        stepper->slope_factor = tune_clip(
+                            1.05 * stepper->slope_factor, bounds->slope);
+                }
+        }
+
+        const int crossings = (state->crossings > 0) ? state->crossings : 1;
+        if (state->floors > TUNE_FLOORS * crossings) {
+                stepper->resolution_factor = tune_clip(
+                    1.25 * stepper->resolution_factor, bounds->resolution);
+        } else if ((state->crossings > 0) &&
+            (state->floors < 2 * state->crossings)) {
+                stepper->resolution_factor = tune_clip(
+                    0.8 * stepper->resolution_factor, bounds->resolution);
+        }
+
+        state->steps = 0;
+        state->overshoots = 0;
+        state->floors = 0;
+        state->crossings = 0;
+}
+
+/* Save the tuned settings of the stepper, with the tuning state */
+static void tune_save(const struct turtle_stepper * stepper,
+    struct turtle_stepper_tune_state * state)
+{
+        memcpy(state, &stepper->tuning.state, sizeof(*state));
+        state->local_range = stepper->local_range;
+        state->slope_factor = stepper->slope_factor;
+        state->resolution_factor = stepper->resolution_factor;
+}
+
+/* Restore saved tuned settings, and the tuning state */
+static void tune_load(struct turtle_stepper * stepper,
+    const struct turtle_stepper_tune_state * state)
+{
+        memcpy(&stepper->tuning.state, state, sizeof(*state));
+        stepper->local_range = state->local_range;
+        stepper->slope_factor = state->slope_factor;
+        stepper->resolution_factor = state->resolution_factor;
+}
+
+static enum turtle_return transform_geographic(
+    struct turtle_stepper * stepper,
+    struct turtle_stepper_transform * transform,
     struct turtle_stepper_data * data, const double * position, int n0,
     int n1, geographic_computer_t * compute_geographic, double * geographic)
 {
         /* Let us check if this transform has already been processed */
-        struct turtle_stepper_transform * transform = data->transform;
         if (transform->history.updated) {
                 memcpy(geographic + n0, transform->history.geographic + n0,
                     (n1 - n0) * sizeof(double));
@@ -115,7 +302,20 @@ static enum turtle_return get_geographic(struct turtle_stepper * stepper,
                 if (r > range) range = r;
         }
 
-        if (range < stepper->local_range) {
+        if ((range < stepper->local_range) &&
+            (stepper->precision == TURTLE_STEPPER_PRECISION_SINGLE)) {
+                /* Apply the local transform in single precision */
+                const float local_single[3] = { (float)local[0],
+                        (float)local[1], (float)local[2] };
+                for (i = n0; i < n1; i++) {
+                        const float * const d = transform->data_single[i];
+                        const float delta = d[0] * local_single[0] +
+                            d[1] * local_single[1] + d[2] * local_single[2];
+                        geographic[i] =
+                            transform->reference_geographic[i] + delta;
+                }
+                goto backup_and_exit;
+        } else if (range < stepper->local_range) {
                 /* Apply the local transform */
                 for (i = n0; i < n1; i++) {
                         geographic[i] = transform->reference_geographic[i];
@@ -131,6 +331,10 @@ static enum turtle_return get_geographic(struct turtle_stepper * stepper,
         enum turtle_return rc =
             compute_geographic(stepper, data, position, n0, geographic);
         if (rc != TURTLE_RETURN_SUCCESS) return rc;
+        if (stepper->tuning.enabled) {
+                tune_transform(stepper, transform, position, n0, n1,
+                    geographic, range);
+        }
 
         /* Let us compute the step length in order to check if it is worth
          * computing a local transform or not.
@@ -143,6 +347,8 @@ static enum turtle_return get_geographic(struct turtle_stepper * stepper,
 
         if (step < 0.33 * stepper->local_range) {
                 /* Update the local transform */
+                turtle_trace_(TURTLE_TRACE_TRANSFORM, TURTLE_TRACE_BEGIN,
+                    transform->name);
                 memcpy(transform->reference_ecef, position,
                     sizeof(transform->reference_ecef));
                 memcpy(transform->reference_geographic + n0, geographic + n0,
@@ -152,13 +358,20 @@ static enum turtle_return get_geographic(struct turtle_stepper * stepper,
                         r[i] += 10.;
                         double geographic1[5];
                         rc = compute_geographic(
-                            stepper, data, r, n0, geographic1);
-                        if (rc != TURTLE_RETURN_SUCCESS) return rc;
+                            stepper, data, r, 0, geographic1);
+                        if (rc != TURTLE_RETURN_SUCCESS) break;
                         int j;
-                        for (j = n0; j < n1; j++)
+                        for (j = n0; j < n1; j++) {
                                 transform->data[j][i] =
                                     0.1 * (geographic1[j] - geographic[j]);
+                                transform->data_single[j][i] =
+                                    (float)transform->data[j][i];
+                        }
                 }
+                turtle_trace_(TURTLE_TRACE_TRANSFORM, TURTLE_TRACE_END,
+                    transform->name);
+                if (rc != TURTLE_RETURN_SUCCESS) return rc;
+                if (stepper->tuning.enabled) stepper->tuning.report.rebuilds++;
         }
 
         /* Backup the transform result in case that it is called again */
@@ -170,41 +383,59 @@ backup_and_exit:
         return TURTLE_RETURN_SUCCESS;
 }
 
-static enum turtle_return stepper_step(struct turtle_stepper * stepper,
-    struct turtle_stepper_data * data, const double * position,
-    int has_geodetic, double * geographic, double * elevation, int * inside)
+static enum turtle_return get_geographic(struct turtle_stepper * stepper,
+    struct turtle_stepper_data * data, const double * position, int n0,
+    int n1, geographic_computer_t * compute_geographic, double * geographic)
 {
-        if (data->history.updated) {
-                memcpy(geographic, data->history.geographic,
-                    sizeof(data->history.geographic));
-                *elevation = data->history.elevation;
-                *inside = data->history.inside;
-        } else {
-                enum turtle_return rc;
-                rc = data->step(stepper, data, position, has_geodetic,
-                    geographic, elevation, inside);
-                if (rc != TURTLE_RETURN_SUCCESS)
-                        return rc;
+        return transform_geographic(stepper, data->transform, data, position,
+            n0, n1, compute_geographic, geographic);
+}
 
-                data->history.updated = 1;
-                memcpy(data->history.geographic, geographic,
-                    sizeof(data->history.geographic));
-                data->history.elevation = *elevation;
-                data->history.inside = *inside;
+/* Check if a sample is outside of the bounding volumes of some data. The
+ * geodetic box is used if the geodetic coordinates are known, otherwise the
+ * ECEF cone
+ */
+static int stepper_reject(const struct turtle_stepper * stepper,
+    const struct turtle_stepper_data * data, const double * position,
+    int has_geodetic, const double * geographic)
+{
+        if (!data->bounded) return 0;
+
+        if (has_geodetic) {
+                return (geographic[0] < data->box[0]) ||
+                    (geographic[0] > data->box[1]) ||
+                    (geographic[1] < data->box[2]) ||
+                    (geographic[1] > data->box[3]);
+        } else if ((data->cone[3] > 0.) && !frame_is_local(stepper)) {
+                const double d = position[0] * data->cone[0] +
+                    position[1] * data->cone[1] + position[2] * data->cone[2];
+                if (d <= 0.) return 1;
+                const double r2 = position[0] * position[0] +
+                    position[1] * position[1] + position[2] * position[2];
+                return d * d < r2 * data->cone[3] * data->cone[3];
+        } else {
+                return 0;
         }
-
-        return TURTLE_RETURN_SUCCESS;
 }
 
 static enum turtle_return stepper_step_client(struct turtle_stepper * stepper,
     struct turtle_stepper_data * data, const double * position,
-    int has_geodetic, double * geographic, double * elevation, int * inside)
+    int * has_geodetic, double * geographic, double * elevation, int * inside)
 {
         *inside = 0;
-        if (!has_geodetic) {
+        *elevation = 0.;
+        if (!*has_geodetic) {
+                if (stepper_reject(stepper, data, position, 0, geographic))
+                        return TURTLE_RETURN_SUCCESS;
                 enum turtle_return rc = get_geographic(stepper, data, position,
                     0, 3, &compute_geodetic, geographic);
                 if (rc != TURTLE_RETURN_SUCCESS) return rc;
+                *has_geodetic = 1;
+        }
+        if (!turtle_stack_covers_(
+            data->a.client->stack, geographic[0], geographic[1])) {
+                /* No data here. Let's skip the lookup */
+                return TURTLE_RETURN_SUCCESS;
         }
         return turtle_client_elevation(data->a.client, geographic[0],
             geographic[1], elevation, inside);
@@ -212,45 +443,163 @@ static enum turtle_return stepper_step_client(struct turtle_stepper * stepper,
 
 static enum turtle_return stepper_step_stack(struct turtle_stepper * stepper,
     struct turtle_stepper_data * data, const double * position,
-    int has_geodetic, double * geographic, double * elevation, int * inside)
+    int * has_geodetic, double * geographic, double * elevation, int * inside)
 {
         *inside = 0;
-        if (!has_geodetic) {
+        *elevation = 0.;
+        if (!*has_geodetic) {
+                if (stepper_reject(stepper, data, position, 0, geographic))
+                        return TURTLE_RETURN_SUCCESS;
                 enum turtle_return rc = get_geographic(stepper, data, position,
                     0, 3, &compute_geodetic, geographic);
                 if (rc != TURTLE_RETURN_SUCCESS) return rc;
+                *has_geodetic = 1;
+        }
+        if (!turtle_stack_covers_(
+            data->a.stack, geographic[0], geographic[1])) {
+                /* No data here. Let's skip the lookup */
+                return TURTLE_RETURN_SUCCESS;
         }
         return turtle_stack_elevation(data->a.stack, geographic[0],
             geographic[1], elevation, inside);
 }
 
+/* Interpolate a map elevation with the stepper precision */
+static enum turtle_return map_elevation(struct turtle_stepper * stepper,
+    struct turtle_map * map, double x, double y, double * elevation,
+    int * inside)
+{
+        if (stepper->precision == TURTLE_STEPPER_PRECISION_SINGLE) {
+                turtle_map_elevation_single_(map, x, y, elevation, inside);
+                return TURTLE_RETURN_SUCCESS;
+        } else {
+                return turtle_map_elevation(map, x, y, elevation, inside);
+        }
+}
+
 static enum turtle_return stepper_step_map(struct turtle_stepper * stepper,
     struct turtle_stepper_data * data, const double * position,
-    int has_geodetic, double * geographic, double * elevation, int * inside)
+    int * has_geodetic, double * geographic, double * elevation, int * inside)
 {
         *inside = 0;
-        const int n0 = has_geodetic ? 3 : 0;
+        *elevation = 0.;
+        if (data->native) {
+                /* The map shares the projection of the local frame */
+                return map_elevation(stepper, data->a.map, position[0],
+                    position[1], elevation, inside);
+        }
+        if (stepper_reject(
+            stepper, data, position, *has_geodetic, geographic)) {
+                /* The sample is outside of the map. Let's skip the
+                 * projection
+                 */
+                return TURTLE_RETURN_SUCCESS;
+        }
+        const int n0 = *has_geodetic ? 3 : 0;
         enum turtle_return rc = get_geographic(
             stepper, data, position, n0, 5, &compute_geomap, geographic);
         if (rc != TURTLE_RETURN_SUCCESS) return rc;
-        return turtle_map_elevation(data->a.map, geographic[3], geographic[4],
-            elevation, inside);
+        *has_geodetic = 1;
+        return map_elevation(stepper, data->a.map, geographic[3],
+            geographic[4], elevation, inside);
 }
 
 static enum turtle_return stepper_step_flat(struct turtle_stepper * stepper,
     struct turtle_stepper_data * data, const double * position,
-    int has_geodetic, double * geographic, double * elevation, int * inside)
+    int * has_geodetic, double * geographic, double * elevation, int * inside)
 {
         *inside = 1;
-        if (!has_geodetic) {
+        if (!*has_geodetic) {
                 enum turtle_return rc = get_geographic(stepper, data, position,
                     0, 3, &compute_geodetic, geographic);
                 if (rc != TURTLE_RETURN_SUCCESS) return rc;
+                *has_geodetic = 1;
         }
         *elevation = 0.;
         return TURTLE_RETURN_SUCCESS;
 }
 
+/* Get a bound on the slope of some data around a sample, and the reach of
+ * this bound. A negative slope is returned if no bound is available
+ */
+static void data_slope(struct turtle_stepper * stepper,
+    struct turtle_stepper_data * data, const double * position,
+    const double * geographic, double * slope)
+{
+        struct turtle_map * map = NULL;
+        double x = geographic[1], y = geographic[0];
+        if (data->step == &stepper_step_flat) {
+                slope[0] = 0.;
+                slope[1] = DBL_MAX;
+                return;
+        } else if (data->step == &stepper_step_map) {
+                map = data->a.map;
+                if (data->native) {
+                        x = position[0];
+                        y = position[1];
+                } else {
+                        x = geographic[3];
+                        y = geographic[4];
+                }
+        } else {
+                /* Get the tile that was used for the elevation */
+                const int client = (data->step == &stepper_step_client);
+                struct turtle_stack * stack =
+                    client ? data->a.client->stack : data->a.stack;
+                map = turtle_stack_pinned_(stack, y, x);
+                if (map == NULL) {
+                        map = client ? ((data->a.client->size > 0) ?
+                            data->a.client->maps[0] : NULL) :
+                            stack->tiles.head;
+                }
+        }
+
+        if ((map == NULL) ||
+            (turtle_map_slope_(map, x, y, slope, slope + 1) != EXIT_SUCCESS))
+                slope[0] = -1.;
+}
+
+static enum turtle_return stepper_step(struct turtle_stepper * stepper,
+    struct turtle_stepper_data * data, const double * position,
+    int * has_geodetic, double * geographic, double * elevation,
+    double * slope, int * inside)
+{
+        if (data->history.updated) {
+                if (data->history.has_geodetic) {
+                        memcpy(geographic, data->history.geographic,
+                            sizeof(data->history.geographic));
+                        *has_geodetic = 1;
+                }
+                *elevation = data->history.elevation;
+                slope[0] = data->history.slope[0];
+                slope[1] = data->history.slope[1];
+                *inside = data->history.inside;
+        } else {
+                enum turtle_return rc;
+                rc = data->step(stepper, data, position, has_geodetic,
+                    geographic, elevation, inside);
+                if (rc != TURTLE_RETURN_SUCCESS)
+                        return rc;
+                if (*inside && (stepper->slope_factor <= 0.)) {
+                        data_slope(stepper, data, position, geographic,
+                            slope);
+                } else {
+                        slope[0] = -1.;
+                }
+
+                data->history.updated = 1;
+                data->history.has_geodetic = *has_geodetic;
+                memcpy(data->history.geographic, geographic,
+                    sizeof(data->history.geographic));
+                data->history.elevation = *elevation;
+                data->history.slope[0] = slope[0];
+                data->history.slope[1] = slope[1];
+                data->history.inside = *inside;
+        }
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
 static void stepper_elevation(struct turtle_stepper * stepper,
     struct turtle_stepper_data * data, double latitude, double longitude,
     double * elevation, int * inside)
@@ -272,6 +621,10 @@ static void stepper_elevation_stack(struct turtle_stepper * stepper,
     double * elevation, int * inside)
 {
         *inside = 0;
+        if (!turtle_stack_covers_(data->a.stack, latitude, longitude)) {
+                *elevation = 0.;
+                return;
+        }
         turtle_stack_elevation(
             data->a.stack, latitude, longitude, elevation, inside);
 }
@@ -281,6 +634,10 @@ static void stepper_elevation_client(struct turtle_stepper * stepper,
     double * elevation, int * inside)
 {
         *inside = 0;
+        if (!turtle_stack_covers_(data->a.client->stack, latitude, longitude)) {
+                *elevation = 0.;
+                return;
+        }
         turtle_client_elevation(
             data->a.client, latitude, longitude, elevation, inside);
 }
@@ -311,36 +668,302 @@ static void stepper_elevation_flat(struct turtle_stepper * stepper,
         *elevation = 0.;
 }
 
-static enum turtle_return stepper_clean_client(
-    struct turtle_stepper_data * data, struct turtle_error_context * error_)
-{
-        return turtle_client_destroy_(&data->a.client, error_);
-}
-
-static enum turtle_return add_data(struct turtle_stepper * stepper,
-    struct turtle_stepper_data * data, const char * name)
+static struct turtle_stepper_transform * get_transform(
+    struct turtle_stepper * stepper, const char * name)
 {
         /* Look for an existing transform */
         struct turtle_stepper_transform * transform;
         for (transform = stepper->transforms.head; transform != NULL;
             transform = transform->element.next) {
-                if (strcmp(transform->name, name) == 0) break;
+                if (strcmp(transform->name, name) == 0) return transform;
         }
 
-        if (transform == NULL) {
-                /* Create the new transform */
-                const int n = strlen(name) + 1;
-                transform = malloc(sizeof(*data->transform) + n);
-                if (transform == NULL)
-                        return TURTLE_RETURN_MEMORY_ERROR;
+        /* Create the new transform */
+        const int n = strlen(name) + 1;
+        transform = malloc(sizeof(*transform) + n);
+        if (transform == NULL) return NULL;
 
-                transform->reference_ecef[0] = DBL_MAX;
-                transform->reference_ecef[1] = DBL_MAX;
-                transform->reference_ecef[2] = DBL_MAX;
-                memcpy(transform->name, name, n);
+        transform->reference_ecef[0] = DBL_MAX;
+        transform->reference_ecef[1] = DBL_MAX;
+        transform->reference_ecef[2] = DBL_MAX;
+        transform->history.updated = 0;
+        memcpy(transform->name, name, n);
+
+        turtle_list_append_(&stepper->transforms, transform);
+        return transform;
+}
+
+/* Get a conservative geodetic bounding box of some data, as latitude and
+ * longitude ranges. Returns 0 if the data are not bounded, e.g. flat ones
+ */
+static int data_box(const struct turtle_stepper_data * data, double box[4])
+{
+        if (data->step == &stepper_step_flat) return 0;
+
+        if ((data->step == &stepper_step_stack) ||
+            (data->step == &stepper_step_client)) {
+                const struct turtle_stack * stack =
+                    (data->step == &stepper_step_client) ?
+                    data->a.client->stack : data->a.stack;
+                box[0] = stack->latitude_0;
+                box[1] = stack->latitude_0 +
+                    stack->latitude_n * stack->latitude_delta;
+                box[2] = stack->longitude_0;
+                box[3] = stack->longitude_0 +
+                    stack->longitude_n * stack->longitude_delta;
+                return 1;
+        }
+
+        const struct turtle_map * map = data->a.map;
+        const double x0 = map->meta.x0;
+        const double x1 = x0 + (map->meta.nx - 1) * map->meta.dx;
+        const double y0 = map->meta.y0;
+        const double y1 = y0 + (map->meta.ny - 1) * map->meta.dy;
+        const struct turtle_projection * projection =
+            turtle_map_projection(map);
+        if (projection == NULL) {
+                box[0] = (y0 < y1) ? y0 : y1;
+                box[1] = (y0 < y1) ? y1 : y0;
+                box[2] = (x0 < x1) ? x0 : x1;
+                box[3] = (x0 < x1) ? x1 : x0;
+                return 1;
+        }
+
+        /* Unproject samples of the map edges. Since the projection is
+         * regular, the extrema lie on the edges
+         */
+        const int n = 16;
+        box[0] = box[2] = DBL_MAX;
+        box[1] = box[3] = -DBL_MAX;
+        int i;
+        for (i = 0; i <= n; i++) {
+                const double u = i / (double)n;
+                const double x[4] = { x0 + u * (x1 - x0), x0 + u * (x1 - x0),
+                        x0, x1 };
+                const double y[4] = { y0, y1, y0 + u * (y1 - y0),
+                        y0 + u * (y1 - y0) };
+                int j;
+                for (j = 0; j < 4; j++) {
+                        double latitude, longitude;
+                        turtle_projection_unproject(
+                            projection, x[j], y[j], &latitude, &longitude);
+                        if (latitude < box[0]) box[0] = latitude;
+                        if (latitude > box[1]) box[1] = latitude;
+                        if (longitude < box[2]) box[2] = longitude;
+                        if (longitude > box[3]) box[3] = longitude;
+                }
+        }
+
+        /* Maps crossing the antimeridian are not bounded */
+        if (box[3] - box[2] > 180.) return 0;
+
+        /* Widen the box since edges are curved in between samples */
+        const double dlat = (box[1] - box[0]) / n;
+        const double dlon = (box[3] - box[2]) / n;
+        box[0] -= dlat;
+        box[1] += dlat;
+        box[2] -= dlon;
+        box[3] += dlon;
+        return 1;
+}
+
+/* Compute the bounding volumes of some data */
+static void data_bound(struct turtle_stepper_data * data)
+{
+        data->cone[3] = -1.;
+        data->bounded = data_box(data, data->box);
+        if (!data->bounded) return;
+
+        /* Sample the directions of the surface points and of the vertical
+         * within the box, since the direction of a point moves from the
+         * former to the latter with its altitude
+         */
+        const int n = 8;
+        const double deg = M_PI / 180.;
+        double lat0 = data->box[0], lat1 = data->box[1];
+        if (lat0 < -90.) lat0 = -90.;
+        if (lat1 > 90.) lat1 = 90.;
+        const double dlat = (lat1 - lat0) / n;
+        const double dlon = (data->box[3] - data->box[2]) / n;
+        double directions[2 * (n + 1) * (n + 1)][3];
+        double axis[3] = { 0., 0., 0. };
+        int i, k;
+        for (i = 0, k = 0; i <= n; i++) {
+                const double latitude = lat0 + i * dlat;
+                int j;
+                for (j = 0; j <= n; j++, k += 2) {
+                        const double longitude = data->box[2] + j * dlon;
+                        double * u = directions[k];
+                        turtle_ecef_from_geodetic(latitude, longitude, 0., u);
+                        double * v = directions[k + 1];
+                        const double c = cos(latitude * deg);
+                        v[0] = c * cos(longitude * deg);
+                        v[1] = c * sin(longitude * deg);
+                        v[2] = sin(latitude * deg);
+
+                        const double r =
+                            sqrt(u[0] * u[0] + u[1] * u[1] + u[2] * u[2]);
+                        int l;
+                        for (l = 0; l < 3; l++) {
+                                u[l] /= r;
+                                axis[l] += u[l] + v[l];
+                        }
+                }
+        }
+        const double r =
+            sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        if (r <= 0.) return;
+        for (i = 0; i < 3; i++) axis[i] /= r;
 
-                turtle_list_append_(&stepper->transforms, transform);
+        /* Get the aperture, with a margin for the sampling and for points
+         * below the surface
+         */
+        double cmin = 1.;
+        for (i = 0; i < k; i++) {
+                const double * u = directions[i];
+                const double c = u[0] * axis[0] + u[1] * axis[1] +
+                    u[2] * axis[2];
+                if (c < cmin) cmin = c;
         }
+        const double aperture = acos((cmin < 1.) ? cmin : 1.) +
+            (fabs(dlat) + fabs(dlon)) * deg + 1E-03;
+        if (aperture >= 0.5 * M_PI) return;
+
+        memcpy(data->cone, axis, sizeof(axis));
+        data->cone[3] = cos(aperture);
+}
+
+/* Cell value for data with a large index, i.e. all data are evaluated */
+#define FOOTPRINT_ANY 255
+
+/* Build the footprint index of a layer */
+static enum turtle_return footprint_build(struct turtle_stepper * stepper,
+    struct turtle_stepper_layer * layer, struct turtle_error_context * error_)
+{
+        /* Get the bounding boxes of the data, in evaluation order, up to
+         * the first unbounded data
+         */
+        double (*boxes)[4] = NULL;
+        if (layer->meta.size > 0) {
+                boxes = malloc(layer->meta.size * sizeof(*boxes));
+                if (boxes == NULL) goto memory_error;
+        }
+        double box[4] = { DBL_MAX, -DBL_MAX, DBL_MAX, -DBL_MAX };
+        struct turtle_stepper_meta * meta;
+        int outside;
+        for (meta = layer->meta.tail, outside = 0; meta != NULL;
+            meta = meta->element.previous, outside++) {
+                double * b = boxes[outside];
+                if (!meta->data->bounded) break;
+                memcpy(b, meta->data->box, sizeof(meta->data->box));
+                if (b[0] < box[0]) box[0] = b[0];
+                if (b[1] > box[1]) box[1] = b[1];
+                if (b[2] < box[2]) box[2] = b[2];
+                if (b[3] > box[3]) box[3] = b[3];
+        }
+
+        /* Allocate the grid over the union of the bounding boxes */
+        const double resolution = stepper->footprint_resolution;
+        int latitude_n = 0, longitude_n = 0;
+        if (outside > 0) {
+                latitude_n = (int)((box[1] - box[0]) / resolution) + 1;
+                longitude_n = (int)((box[3] - box[2]) / resolution) + 1;
+        }
+        const size_t size = latitude_n * (size_t)longitude_n;
+        struct turtle_stepper_footprint * footprint =
+            malloc(sizeof(*footprint) + size);
+        if (footprint == NULL) goto memory_error;
+        footprint->outside = outside;
+        footprint->latitude_0 = box[0];
+        footprint->longitude_0 = box[2];
+        footprint->resolution = resolution;
+        footprint->latitude_n = latitude_n;
+        footprint->longitude_n = longitude_n;
+        memset(footprint->cells,
+            (outside < FOOTPRINT_ANY) ? outside : FOOTPRINT_ANY, size);
+
+        /* Paint the cells overlapped by each data, such that the first data
+         * in evaluation order prevail
+         */
+        int k;
+        for (k = outside - 1; k >= 0; k--) {
+                const double * b = boxes[k];
+                int iy0 = (int)((b[0] - box[0]) / resolution);
+                int iy1 = (int)((b[1] - box[0]) / resolution);
+                int ix0 = (int)((b[2] - box[2]) / resolution);
+                int ix1 = (int)((b[3] - box[2]) / resolution);
+                if (iy0 < 0) iy0 = 0;
+                if (iy1 >= latitude_n) iy1 = latitude_n - 1;
+                if (ix0 < 0) ix0 = 0;
+                if (ix1 >= longitude_n) ix1 = longitude_n - 1;
+                const unsigned char value =
+                    (k < FOOTPRINT_ANY) ? k : FOOTPRINT_ANY;
+                int iy;
+                for (iy = iy0; iy <= iy1; iy++) {
+                        memset(footprint->cells + iy * (size_t)longitude_n +
+                            ix0, value, ix1 - ix0 + 1);
+                }
+        }
+        free(boxes);
+
+        /* Get a dedicated local transform for computing the geodetic
+         * coordinates of samples
+         */
+        footprint->transform = get_transform(stepper, "footprint");
+        if (footprint->transform == NULL) {
+                free(footprint);
+                boxes = NULL;
+                goto memory_error;
+        }
+
+        layer->footprint = footprint;
+        return TURTLE_RETURN_SUCCESS;
+
+memory_error:
+        free(boxes);
+        return TURTLE_ERROR_REGISTER(TURTLE_RETURN_MEMORY_ERROR,
+            "could not allocate memory for footprint index");
+}
+
+/* Get the index of the first data to evaluate at the given location */
+static int footprint_start(const struct turtle_stepper_footprint * footprint,
+    double latitude, double longitude)
+{
+        const double hx = (longitude - footprint->longitude_0) /
+            footprint->resolution;
+        const double hy = (latitude - footprint->latitude_0) /
+            footprint->resolution;
+        if (!(hx >= 0.) || (hx >= footprint->longitude_n) || !(hy >= 0.) ||
+            (hy >= footprint->latitude_n))
+                return footprint->outside;
+        const int value =
+            footprint->cells[(int)hy * footprint->longitude_n + (int)hx];
+        return (value == FOOTPRINT_ANY) ? 0 : value;
+}
+
+/* Release the footprint indices of all layers */
+static void footprint_clear(struct turtle_stepper * stepper)
+{
+        struct turtle_stepper_layer * layer;
+        for (layer = stepper->layers.head; layer != NULL;
+            layer = layer->element.next) {
+                free(layer->footprint);
+                layer->footprint = NULL;
+        }
+}
+
+static enum turtle_return stepper_clean_client(
+    struct turtle_stepper_data * data, struct turtle_error_context * error_)
+{
+        return turtle_client_destroy_(&data->a.client, error_);
+}
+
+static enum turtle_return add_data(struct turtle_stepper * stepper,
+    struct turtle_stepper_data * data, const char * name)
+{
+        struct turtle_stepper_transform * transform =
+            get_transform(stepper, name);
+        if (transform == NULL) return TURTLE_RETURN_MEMORY_ERROR;
 
         /* Append the data to the stack */
         data->transform = transform;
@@ -349,21 +972,26 @@ static enum turtle_return add_data(struct turtle_stepper * stepper,
         return TURTLE_RETURN_SUCCESS;
 }
 
-static enum turtle_return stepper_add_layer(struct turtle_stepper * stepper)
+static enum turtle_return layer_append(struct turtle_stepper * stepper)
 {
-        struct turtle_stepper_layer * layer = stepper->layers.tail;
-        if ((layer != NULL) && (layer->meta.size == 0))
-                return TURTLE_RETURN_SUCCESS;
-
-        layer = malloc(sizeof(*layer));
+        struct turtle_stepper_layer * layer = malloc(sizeof(*layer));
         if (layer == NULL)
                 return TURTLE_RETURN_MEMORY_ERROR;
         memset(&layer->meta, 0x0, sizeof(layer->meta));
+        layer->footprint = NULL;
         turtle_list_append_(&stepper->layers, layer);
 
         return TURTLE_RETURN_SUCCESS;
 }
 
+static enum turtle_return stepper_add_layer(struct turtle_stepper * stepper)
+{
+        struct turtle_stepper_layer * layer = stepper->layers.tail;
+        if ((layer != NULL) && (layer->meta.size == 0))
+                return TURTLE_RETURN_SUCCESS;
+        return layer_append(stepper);
+}
+
 enum turtle_return turtle_stepper_add_layer(struct turtle_stepper * stepper)
 {
         TURTLE_ERROR_INITIALISE(&turtle_stepper_add_layer);
@@ -393,6 +1021,10 @@ static enum turtle_return add_meta(struct turtle_stepper * stepper,
         struct turtle_stepper_layer * layer = stepper->layers.tail;
         turtle_list_append_(&layer->meta, meta);
 
+        /* The footprint index of the layer is outdated */
+        free(layer->footprint);
+        layer->footprint = NULL;
+
         return TURTLE_RETURN_SUCCESS;
 }
 
@@ -405,7 +1037,7 @@ enum turtle_return turtle_stepper_add_stack(
         struct turtle_stepper_data * data;
         for (data = stepper->data.head; data != NULL;
             data = data->element.next) {
-                if ((stack->lock != NULL) &&
+                if (turtle_stack_has_lock_(stack) &&
                     (data->clean == &stepper_clean_client) &&
                     (data->a.client->stack == stack))
                         break;
@@ -417,7 +1049,7 @@ enum turtle_return turtle_stepper_add_stack(
         if (data == NULL) {
                 /* Allocate an encapsulation of the new data */
                 enum turtle_return rc;
-                if (stack->lock != NULL) {
+                if (turtle_stack_has_lock_(stack)) {
                         /* Get a new client for the stack */
                         rc = turtle_client_create(&client, stack);
                         if (rc != TURTLE_RETURN_SUCCESS) return rc;
@@ -438,6 +1070,8 @@ enum turtle_return turtle_stepper_add_stack(
                         data->clean = NULL;
                         data->a.stack = stack;
                 }
+                data->native = 0;
+                data_bound(data);
 
                 /* Add the data to the stepper's stack */
                 if (add_data(stepper, data, "geodetic") !=
@@ -477,6 +1111,8 @@ enum turtle_return turtle_stepper_add_map(struct turtle_stepper * stepper,
                 data->elevation = &stepper_elevation_map;
                 data->clean = NULL;
                 data->a.map = map;
+                data->native = frame_native(stepper, map);
+                data_bound(data);
 
                 /* Add the data to the stepper's stack */
                 const struct turtle_projection * projection =
@@ -516,6 +1152,9 @@ enum turtle_return turtle_stepper_add_flat(
                 data->elevation = &stepper_elevation_flat;
                 data->clean = NULL;
                 data->a.map = NULL;
+                data->native = 0;
+                data->bounded = 0;
+                data->cone[3] = -1.;
 
                 /* Add the data to the stepper's stack */
                 if (add_data(stepper, data, "geodetic") !=
@@ -544,8 +1183,14 @@ enum turtle_return turtle_stepper_create(struct turtle_stepper ** stepper_)
         memset(&stepper->layers, 0x0, sizeof(stepper->layers));
         stepper->geoid = NULL;
         stepper->local_range = 1.;
-        stepper->slope_factor = 0.4;
+        stepper->slope_factor = DEFAULT_SLOPE;
         stepper->resolution_factor = 1E-02;
+        stepper->footprint_resolution = 0.;
+        stepper->precision = TURTLE_STEPPER_PRECISION_DOUBLE;
+        memset(&stepper->tuning, 0x0, sizeof(stepper->tuning));
+        stepper->frame.projection.type = PROJECTION_NONE;
+        stepper->frame.curved = 0;
+        stepper->last.has_geodetic = 0;
         stepper->last.index[0] = -1;
         stepper->last.index[1] = -1;
         stepper->last.elevation[0] = 0;
@@ -553,6 +1198,8 @@ enum turtle_return turtle_stepper_create(struct turtle_stepper ** stepper_)
         stepper->last.position[0] = DBL_MAX;
         stepper->last.position[1] = DBL_MAX;
         stepper->last.position[2] = DBL_MAX;
+        stepper->cursor = NULL;
+        stepper->generation = 0;
 
         return TURTLE_RETURN_SUCCESS;
 }
@@ -578,6 +1225,7 @@ enum turtle_return turtle_stepper_destroy(struct turtle_stepper ** stepper)
         struct turtle_stepper_layer * layer;
         while ((layer = turtle_list_pop_(&(*stepper)->layers)) != NULL) {
                 turtle_list_clear_(&layer->meta);
+                free(layer->footprint);
                 free(layer);
         }
 
@@ -587,19 +1235,41 @@ enum turtle_return turtle_stepper_destroy(struct turtle_stepper ** stepper)
         return TURTLE_RETURN_SUCCESS;
 }
 
-static void reset_history(struct turtle_stepper * stepper)
+static void clear_history(struct turtle_stepper * stepper)
 {
         stepper->last.position[0] = DBL_MAX;
         stepper->last.position[1] = DBL_MAX;
         stepper->last.position[2] = DBL_MAX;
 
-        struct turtle_stepper_data * data;
-        for (data = stepper->data.head; data != NULL;
-             data = data->element.next) {
-                data->transform->reference_ecef[0] = DBL_MAX;
-                data->transform->reference_ecef[1] = DBL_MAX;
-                data->transform->reference_ecef[2] = DBL_MAX;
+        struct turtle_stepper_transform * transform;
+        for (transform = stepper->transforms.head; transform != NULL;
+             transform = transform->element.next) {
+                transform->reference_ecef[0] = DBL_MAX;
+                transform->reference_ecef[1] = DBL_MAX;
+                transform->reference_ecef[2] = DBL_MAX;
         }
+
+        /* Tuning statistics restart as well */
+        struct turtle_stepper_tune_state * state = &stepper->tuning.state;
+        state->steps = 0;
+        state->overshoots = 0;
+        state->floors = 0;
+        state->crossings = 0;
+}
+
+/* Start a fresh track, from the initial tuning if enabled */
+static void restart_history(struct turtle_stepper * stepper)
+{
+        clear_history(stepper);
+        if (stepper->tuning.enabled)
+                tune_load(stepper, &stepper->tuning.initial);
+}
+
+static void reset_history(struct turtle_stepper * stepper)
+{
+        /* Saved states of cursors are outdated as well */
+        clear_history(stepper);
+        stepper->generation++;
 }
 
 void turtle_stepper_geoid_set(
@@ -625,8 +1295,9 @@ double turtle_stepper_range_get(const struct turtle_stepper * stepper)
 
 void turtle_stepper_range_set(struct turtle_stepper * stepper, double range)
 {
-        /* Set the range */
+        /* Set the range, which is also the initial one of tuned tracks */
         stepper->local_range = range;
+        stepper->tuning.initial.local_range = range;
 
         /* Reset the stepping history */
         reset_history(stepper);
@@ -640,6 +1311,7 @@ double turtle_stepper_slope_get(const struct turtle_stepper * stepper)
 void turtle_stepper_slope_set(struct turtle_stepper * stepper, double slope)
 {
         stepper->slope_factor = slope;
+        stepper->tuning.initial.slope_factor = slope;
 }
 
 double turtle_stepper_resolution_get(const struct turtle_stepper * stepper)
@@ -651,6 +1323,135 @@ void turtle_stepper_resolution_set(
     struct turtle_stepper * stepper, double resolution)
 {
         stepper->resolution_factor = resolution;
+        stepper->tuning.initial.resolution_factor = resolution;
+}
+
+enum turtle_return turtle_stepper_tuning_set(struct turtle_stepper * stepper,
+    const struct turtle_stepper_tuning * tuning)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_stepper_tuning_set);
+
+        if (tuning == NULL) {
+                stepper->tuning.enabled = 0;
+                return TURTLE_RETURN_SUCCESS;
+        }
+
+        /* Check the bounds */
+        if ((tuning->tolerance <= 0.) || (tuning->overshoot <= 0.) ||
+            (tuning->overshoot >= 1.) || (tuning->range[0] <= 0.) ||
+            (tuning->range[0] > tuning->range[1]) ||
+            (tuning->slope[0] <= 0.) ||
+            (tuning->slope[0] > tuning->slope[1]) ||
+            (tuning->resolution[0] <= 0.) ||
+            (tuning->resolution[0] > tuning->resolution[1])) {
+                return TURTLE_ERROR_MESSAGE(
+                    TURTLE_RETURN_DOMAIN_ERROR, "invalid tuning bounds");
+        }
+
+        /* Clip the current settings and restart the tuning */
+        memcpy(&stepper->tuning.bounds, tuning, sizeof(*tuning));
+        memset(&stepper->tuning.state, 0x0, sizeof(stepper->tuning.state));
+        memset(&stepper->tuning.report, 0x0, sizeof(stepper->tuning.report));
+        stepper->local_range = tune_clip(stepper->local_range, tuning->range);
+        if (stepper->slope_factor > 0.) {
+                stepper->slope_factor =
+                    tune_clip(stepper->slope_factor, tuning->slope);
+        }
+        stepper->resolution_factor =
+            tune_clip(stepper->resolution_factor, tuning->resolution);
+        tune_save(stepper, &stepper->tuning.initial);
+        stepper->tuning.enabled = 1;
+
+        /* Reset the stepping history */
+        reset_history(stepper);
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
+void turtle_stepper_tuning_report(const struct turtle_stepper * stepper,
+    struct turtle_stepper_tuning_report * report)
+{
+        memcpy(report, &stepper->tuning.report, sizeof(*report));
+        report->range = stepper->local_range;
+        report->slope = stepper->slope_factor;
+        report->resolution = stepper->resolution_factor;
+        report->error = stepper->tuning.state.curvature *
+            stepper->local_range * stepper->local_range;
+}
+
+double turtle_stepper_footprint_get(const struct turtle_stepper * stepper)
+{
+        return stepper->footprint_resolution;
+}
+
+void turtle_stepper_footprint_set(
+    struct turtle_stepper * stepper, double resolution)
+{
+        stepper->footprint_resolution = (resolution > 0.) ? resolution : 0.;
+        footprint_clear(stepper);
+}
+
+enum turtle_stepper_precision turtle_stepper_precision_get(
+    const struct turtle_stepper * stepper)
+{
+        return stepper->precision;
+}
+
+void turtle_stepper_precision_set(struct turtle_stepper * stepper,
+    enum turtle_stepper_precision precision)
+{
+        stepper->precision = precision;
+}
+
+const struct turtle_projection * turtle_stepper_frame_get(
+    const struct turtle_stepper * stepper)
+{
+        return frame_is_local(stepper) ? &stepper->frame.projection : NULL;
+}
+
+enum turtle_return turtle_stepper_frame_set(struct turtle_stepper * stepper,
+    const struct turtle_projection * projection, const double * origin)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_stepper_frame_set);
+
+        if ((projection != NULL) && (projection->type == PROJECTION_NONE)) {
+                return TURTLE_ERROR_MESSAGE(
+                    TURTLE_RETURN_BAD_PROJECTION, "invalid projection");
+        }
+
+        /* Set the frame */
+        if (projection == NULL) {
+                stepper->frame.projection.type = PROJECTION_NONE;
+        } else {
+                memcpy(&stepper->frame.projection, projection,
+                    sizeof(stepper->frame.projection));
+        }
+        stepper->frame.curved = (projection != NULL) && (origin != NULL);
+        if (stepper->frame.curved) {
+                /* Use the Gaussian radius of curvature at the origin */
+                stepper->frame.origin[0] = origin[0];
+                stepper->frame.origin[1] = origin[1];
+                double latitude, longitude;
+                turtle_projection_unproject(projection, origin[0], origin[1],
+                    &latitude, &longitude);
+                const double s = sin(latitude * M_PI / 180.);
+                const double e2 = WGS84_E * WGS84_E;
+                stepper->frame.radius =
+                    WGS84_A * sqrt(1. - e2) / (1. - e2 * s * s);
+        }
+
+        /* Flag the maps that can be looked up directly */
+        struct turtle_stepper_data * data;
+        for (data = stepper->data.head; data != NULL;
+            data = data->element.next) {
+                data->native = (data->step == &stepper_step_map) ?
+                    frame_native(stepper, data->a.map) : 0;
+        }
+
+        /* Reset the stepping history */
+        reset_history(stepper);
+
+        return TURTLE_RETURN_SUCCESS;
 }
 
 static void reset_data_and_transforms(struct turtle_stepper * stepper)
@@ -666,22 +1467,131 @@ static void reset_data_and_transforms(struct turtle_stepper * stepper)
                 data->history.updated = 0;
 }
 
+/* Save the stepping state of the stepper to a cursor. On failure, the
+ * cursor simply starts from a fresh history when loaded back
+ */
+static void cursor_save(
+    struct turtle_stepper * stepper, struct turtle_stepper_cursor * cursor)
+{
+        const int n = stepper->transforms.size;
+        if (n > cursor->references_size) {
+                struct turtle_stepper_reference * references = realloc(
+                    cursor->references, n * sizeof(*references));
+                if (references == NULL) {
+                        cursor->saved = 0;
+                        return;
+                }
+                cursor->references = references;
+                cursor->references_size = n;
+        }
+
+        struct turtle_stepper_reference * reference = cursor->references;
+        const struct turtle_stepper_transform * transform;
+        for (transform = stepper->transforms.head; transform != NULL;
+            transform = transform->element.next, reference++) {
+                memcpy(reference->ecef, transform->reference_ecef,
+                    sizeof(reference->ecef));
+                memcpy(reference->geographic, transform->reference_geographic,
+                    sizeof(reference->geographic));
+                memcpy(reference->data, transform->data,
+                    sizeof(reference->data));
+                memcpy(reference->data_single, transform->data_single,
+                    sizeof(reference->data_single));
+        }
+        memcpy(&cursor->last, &stepper->last, sizeof(cursor->last));
+        if (stepper->tuning.enabled) tune_save(stepper, &cursor->tune);
+        cursor->saved = 1;
+        cursor->generation = stepper->generation;
+        cursor->data_size = stepper->data.size;
+}
+
+/* Load the stepping state of a cursor, or a fresh state for `NULL`, after
+ * saving the one of the current cursor
+ */
+static void cursor_load(
+    struct turtle_stepper * stepper, struct turtle_stepper_cursor * cursor)
+{
+        if (cursor == stepper->cursor) return;
+        if (stepper->cursor != NULL) cursor_save(stepper, stepper->cursor);
+        stepper->cursor = cursor;
+
+        /* The state is outdated if the settings or the data changed */
+        if ((cursor == NULL) || !cursor->saved ||
+            (cursor->generation != stepper->generation) ||
+            (cursor->data_size != stepper->data.size)) {
+                restart_history(stepper);
+                return;
+        }
+
+        /* Transforms added since the save start from a fresh state */
+        const struct turtle_stepper_reference * reference =
+            cursor->references;
+        struct turtle_stepper_transform * transform;
+        int i;
+        for (transform = stepper->transforms.head, i = 0; transform != NULL;
+            transform = transform->element.next, i++, reference++) {
+                if (i >= cursor->references_size) {
+                        transform->reference_ecef[0] = DBL_MAX;
+                        transform->reference_ecef[1] = DBL_MAX;
+                        transform->reference_ecef[2] = DBL_MAX;
+                        continue;
+                }
+                memcpy(transform->reference_ecef, reference->ecef,
+                    sizeof(reference->ecef));
+                memcpy(transform->reference_geographic, reference->geographic,
+                    sizeof(reference->geographic));
+                memcpy(transform->data, reference->data,
+                    sizeof(reference->data));
+                memcpy(transform->data_single, reference->data_single,
+                    sizeof(reference->data_single));
+        }
+        memcpy(&stepper->last, &cursor->last, sizeof(stepper->last));
+        if (stepper->tuning.enabled) tune_load(stepper, &cursor->tune);
+
+        /* Per sample caches refer to the previous cursor */
+        reset_data_and_transforms(stepper);
+}
+
 static int check_layer(struct turtle_stepper * stepper,
-    struct turtle_stepper_sample * sample, int index[2], double elevation)
+    struct turtle_stepper_sample * sample, int index[2], double elevation,
+    const double * slope)
 {
         if (elevation >= sample->geographic[2]) {
                 sample->index[0] = index[0];
                 sample->index[1] = index[1];
                 sample->elevation[1] = elevation;
+                memcpy(sample->slope[1], slope, sizeof(sample->slope[1]));
                 return EXIT_SUCCESS;
         } else {
                 sample->index[0] = index[0] + 1;
                 sample->index[1] = index[1];
                 sample->elevation[0] = elevation;
+                memcpy(sample->slope[0], slope, sizeof(sample->slope[0]));
                 return EXIT_FAILURE;
         }
 }
 
+/* Get the footprint index of a layer, and the geodetic coordinates of the
+ * sample if not already known
+ */
+static enum turtle_return footprint_geodetic(struct turtle_stepper * stepper,
+    struct turtle_stepper_layer * layer, const double * position,
+    int * has_geodetic, double * geographic,
+    struct turtle_error_context * error_)
+{
+        if ((layer->footprint == NULL) &&
+            (footprint_build(stepper, layer, error_) != TURTLE_RETURN_SUCCESS))
+                return error_->code;
+        if (*has_geodetic) return TURTLE_RETURN_SUCCESS;
+
+        enum turtle_return rc = transform_geographic(stepper,
+            layer->footprint->transform, NULL, position, 0, 3,
+            &compute_geodetic, geographic);
+        if (rc != TURTLE_RETURN_SUCCESS) return rc;
+        *has_geodetic = 1;
+        return TURTLE_RETURN_SUCCESS;
+}
+
 static enum turtle_return stepper_sample(struct turtle_stepper * stepper,
     const double * position, struct turtle_stepper_sample * sample,
     int check_bounds, struct turtle_error_context * error_)
@@ -696,34 +1606,65 @@ static enum turtle_return stepper_sample(struct turtle_stepper * stepper,
                 sample->index[1] = -1;
                 sample->elevation[0] = -DBL_MAX;
                 sample->elevation[1] = DBL_MAX;
-                int index[2], has_geodetic = 0;
+                int index[2];
+                int * has_geodetic = &sample->has_geodetic;
+                *has_geodetic = 0;
+                if (frame_is_local(stepper)) {
+                        /* The altitude is known without the geodetic
+                         * coordinates in a local frame
+                         */
+                        sample->geographic[2] =
+                            frame_altitude(stepper, position);
+                }
                 struct turtle_stepper_layer * layer;
                 for (layer = stepper->layers.head, index[0] = 0; layer != NULL;
                     layer = layer->element.next, index[0]++) {
-                        struct turtle_stepper_meta * meta;
-                        for (meta = layer->meta.tail, index[1] = 0;
-                            meta != NULL; meta = meta->element.previous,
+                        struct turtle_stepper_meta * meta = layer->meta.tail;
+                        index[1] = 0;
+                        if (stepper->footprint_resolution > 0.) {
+                                /* Skip the data not overlapping the sample */
+                                if (footprint_geodetic(stepper, layer,
+                                    position, has_geodetic, sample->geographic,
+                                    error_) != TURTLE_RETURN_SUCCESS)
+                                        return error_->code;
+                                const int start = footprint_start(
+                                    layer->footprint, sample->geographic[0],
+                                    sample->geographic[1]);
+                                for (; (meta != NULL) && (index[1] < start);
+                                    meta = meta->element.previous, index[1]++)
+                                        ;
+                        }
+                        for (; meta != NULL; meta = meta->element.previous,
                             index[1]++) {
                                 int inside;
-                                double elevation;
-                                enum turtle_return rc = stepper_step(
-                                    stepper, meta->data, position, has_geodetic,
-                                    sample->geographic, &elevation, &inside);
+                                double elevation, slope[2];
+                                enum turtle_return rc = stepper_step(stepper,
+                                    meta->data, position, has_geodetic,
+                                    sample->geographic, &elevation, slope,
+                                    &inside);
                                 if (sample == &stepper->last) {
                                         memcpy(stepper->last.position, position,
                                             sizeof(stepper->last.position));
                                 }
                                 if (rc != TURTLE_RETURN_SUCCESS) return rc;
-                                has_geodetic = 1;
                                 if (inside) {
                                         elevation += meta->offset;
                                         if (check_layer(stepper, sample, index,
-                                            elevation) == EXIT_SUCCESS)
+                                            elevation, slope) == EXIT_SUCCESS)
                                                 return TURTLE_RETURN_SUCCESS;
                                         break;
                                 }
                         }
                 }
+
+                /* All data might have been rejected by their bounding
+                 * volumes, without computing the geodetic coordinates
+                 */
+                if (!*has_geodetic && !frame_is_local(stepper)) {
+                        position_to_geodetic(
+                            stepper, position, sample->geographic);
+                        *has_geodetic = 1;
+                }
         } else {
                 if (sample != &stepper->last)
                         memcpy(sample, &stepper->last, sizeof(*sample));
@@ -737,10 +1678,18 @@ static enum turtle_return stepper_sample(struct turtle_stepper * stepper,
         return TURTLE_RETURN_SUCCESS;
 }
 
-static void sample_publish(struct turtle_stepper * stepper, double * latitude,
-    double * longitude, double * altitude, double * elevation,
-    int * index)
+static void sample_publish(struct turtle_stepper * stepper,
+    const double * position, double * latitude, double * longitude,
+    double * altitude, double * elevation, int * index)
 {
+        if (((latitude != NULL) || (longitude != NULL)) &&
+            !stepper->last.has_geodetic) {
+                /* Convert from the local frame, on request */
+                turtle_projection_unproject(&stepper->frame.projection,
+                    position[0], position[1], stepper->last.geographic,
+                    stepper->last.geographic + 1);
+                stepper->last.has_geodetic = 1;
+        }
         if (latitude != NULL) *latitude = stepper->last.geographic[0];
         if (longitude != NULL) *longitude = stepper->last.geographic[1];
         if (altitude != NULL) *altitude = stepper->last.geographic[2];
@@ -759,21 +1708,22 @@ static void sample_publish(struct turtle_stepper * stepper, double * latitude,
         }
 }
 
-enum turtle_return turtle_stepper_step(struct turtle_stepper * stepper,
+/* Sample the stepper at the given position, or do a step if a direction is
+ * provided. The step length is always returned
+ */
+static enum turtle_return stepper_advance(struct turtle_stepper * stepper,
     double * position, const double * direction, double * latitude,
     double * longitude, double * altitude, double * elevation,
-    double * step_length, int * index)
+    double * step_length, int * index, struct turtle_error_context * error_)
 {
-        TURTLE_ERROR_INITIALISE(&turtle_stepper_step);
-
         /* Compute the initial geodetic coordinates, or fetch the last ones */
         if (stepper_sample(stepper, position, &stepper->last, index
             != NULL, error_) != TURTLE_RETURN_SUCCESS)
-                return TURTLE_ERROR_RAISE();
+                return error_->code;
         if (stepper->last.index[0] < 0) {
-                sample_publish(stepper, latitude, longitude, altitude,
-                    elevation, index);
-                if (step_length != NULL) *step_length = 0;
+                sample_publish(stepper, position, latitude, longitude,
+                    altitude, elevation, index);
+                *step_length = 0;
                 return TURTLE_RETURN_SUCCESS;
         }
 
@@ -787,18 +1737,32 @@ enum turtle_return turtle_stepper_step(struct turtle_stepper * stepper,
                     stepper->layers.size) && (i == 1))
                         break;
 
-                const double dsi = fabs(stepper->last.geographic[2] -
+                double dsi = fabs(stepper->last.geographic[2] -
                     stepper->last.elevation[i]);
+                const double * slope = stepper->last.slope[i];
+                if (stepper->slope_factor > 0.) {
+                        dsi *= stepper->slope_factor;
+                } else if (slope[0] >= 0.) {
+                        /* Take a safe step w.r.t. the slope bound, with a
+                         * margin for rounding and projection distortions
+                         */
+                        const double s = 1.01 * slope[0];
+                        dsi /= sqrt(1. + s * s);
+                        const double reach = 0.99 * slope[1];
+                        if (dsi > reach) dsi = reach;
+                } else {
+                        dsi *= DEFAULT_SLOPE;
+                }
                 if ((dsi < ds) || (ds <= 0.)) ds = dsi;
         }
-        ds *= stepper->slope_factor;
-        if (ds < stepper->resolution_factor) ds = stepper->resolution_factor;
+        const int minimal = (ds < stepper->resolution_factor);
+        if (minimal) ds = stepper->resolution_factor;
 
         /* Return the results if no stepping is requested */
         if (direction == NULL) {
-                sample_publish(stepper, latitude, longitude, altitude,
-                    elevation, index);
-                if (step_length != NULL) *step_length = ds;
+                sample_publish(stepper, position, latitude, longitude,
+                    altitude, elevation, index);
+                *step_length = ds;
                 return TURTLE_RETURN_SUCCESS;
         }
 
@@ -808,7 +1772,7 @@ enum turtle_return turtle_stepper_step(struct turtle_stepper * stepper,
         const int medium0 = stepper->last.index[0];
         if (stepper_sample(stepper, position, &stepper->last, 1, error_) !=
             TURTLE_RETURN_SUCCESS)
-                return TURTLE_ERROR_RAISE();
+                return error_->code;
         int medium1 = stepper->last.index[0];
 
         if (medium0 != medium1) {
@@ -818,6 +1782,8 @@ enum turtle_return turtle_stepper_step(struct turtle_stepper * stepper,
                 double ds0 = -ds, ds1 = 0.;
                 struct turtle_stepper_sample sample2;
                 memcpy(&sample2, &stepper->last, sizeof(sample2));
+                turtle_trace_(
+                    TURTLE_TRACE_BISECTION, TURTLE_TRACE_BEGIN, NULL);
                 while (ds1 - ds0 > 1E-08) {
                         const double ds2 = 0.5 * (ds0 + ds1);
                         double position2[3] = {
@@ -825,8 +1791,11 @@ enum turtle_return turtle_stepper_step(struct turtle_stepper * stepper,
                                 position[1] + direction[1] * ds2,
                                 position[2] + direction[2] * ds2 };
                         if (stepper_sample(stepper, position2, &sample2, 1,
-                            error_) != TURTLE_RETURN_SUCCESS)
-                                return TURTLE_ERROR_RAISE();
+                            error_) != TURTLE_RETURN_SUCCESS) {
+                                turtle_trace_(TURTLE_TRACE_BISECTION,
+                                    TURTLE_TRACE_END, NULL);
+                                return error_->code;
+                        }
                         const int medium2 = sample2.index[0];
                         if (medium2 == medium0) {
                                 ds0 = ds2;
@@ -840,22 +1809,104 @@ enum turtle_return turtle_stepper_step(struct turtle_stepper * stepper,
                                     sizeof(stepper->last));
                         }
                 }
+                turtle_trace_(TURTLE_TRACE_BISECTION, TURTLE_TRACE_END, NULL);
                 ds += ds1;
                 for (i = 0; i < 3; i++)
                         position[i] += direction[i] * ds1;
         }
+        if (stepper->tuning.enabled)
+                tune_step(stepper, minimal, medium0 != medium1);
 
-        sample_publish(stepper, latitude, longitude, altitude,
+        sample_publish(stepper, position, latitude, longitude, altitude,
             elevation, index);
+        *step_length = ds;
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
+/* Do a step with the public semantics, i.e. raising errors */
+static enum turtle_return stepper_do_step(struct turtle_stepper * stepper,
+    double * position, const double * direction, double * latitude,
+    double * longitude, double * altitude, double * elevation,
+    double * step_length, int * index, struct turtle_error_context * error_)
+{
+        double ds;
+        if (stepper_advance(stepper, position, direction, latitude,
+            longitude, altitude, elevation, &ds, index, error_) !=
+            TURTLE_RETURN_SUCCESS)
+                return TURTLE_ERROR_RAISE();
         if (step_length != NULL) *step_length = ds;
 
-        if ((stepper->last.index[0] < 0) && (index == NULL)) {
+        /* Check if a step exited all data. A null step length indicates that
+         * the initial position was already outside
+         */
+        if ((direction != NULL) && (ds > 0.) &&
+            (stepper->last.index[0] < 0) && (index == NULL)) {
                 return TURTLE_ERROR_REGISTER(
                     TURTLE_RETURN_DOMAIN_ERROR, "no valid data");
         }
         return TURTLE_RETURN_SUCCESS;
 }
 
+enum turtle_return turtle_stepper_step(struct turtle_stepper * stepper,
+    double * position, const double * direction, double * latitude,
+    double * longitude, double * altitude, double * elevation,
+    double * step_length, int * index)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_stepper_step);
+
+        cursor_load(stepper, NULL);
+        return stepper_do_step(stepper, position, direction, latitude,
+            longitude, altitude, elevation, step_length, index, error_);
+}
+
+enum turtle_return turtle_stepper_cursor_create(
+    struct turtle_stepper * stepper, struct turtle_stepper_cursor ** cursor_)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_stepper_cursor_create);
+
+        struct turtle_stepper_cursor * cursor = malloc(sizeof(*cursor));
+        if (cursor == NULL) {
+                *cursor_ = NULL;
+                return TURTLE_ERROR_MEMORY();
+        }
+        cursor->stepper = stepper;
+        cursor->saved = 0;
+        cursor->generation = 0;
+        cursor->data_size = 0;
+        cursor->references_size = 0;
+        cursor->references = NULL;
+        *cursor_ = cursor;
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
+void turtle_stepper_cursor_destroy(struct turtle_stepper_cursor ** cursor)
+{
+        if ((cursor == NULL) || (*cursor == NULL)) return;
+
+        /* The loaded state remains with the stepper, without any owner */
+        struct turtle_stepper * stepper = (*cursor)->stepper;
+        if (stepper->cursor == *cursor) stepper->cursor = NULL;
+
+        free((*cursor)->references);
+        free(*cursor);
+        *cursor = NULL;
+}
+
+enum turtle_return turtle_stepper_cursor_step(
+    struct turtle_stepper_cursor * cursor, double * position,
+    const double * direction, double * latitude, double * longitude,
+    double * altitude, double * elevation, double * step_length, int * index)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_stepper_cursor_step);
+
+        struct turtle_stepper * stepper = cursor->stepper;
+        cursor_load(stepper, cursor);
+        return stepper_do_step(stepper, position, direction, latitude,
+            longitude, altitude, elevation, step_length, index, error_);
+}
+
 enum turtle_return turtle_stepper_position(struct turtle_stepper * stepper,
     double latitude, double longitude, double height, int layer_index,
     double * position, int * data_index)
@@ -873,17 +1924,48 @@ enum turtle_return turtle_stepper_position(struct turtle_stepper * stepper,
 
         /* Loop over data and locate the proper set */
         reset_data_and_transforms(stepper);
-        int index;
+        int index = 0;
         double elevation = 0.;
-        struct turtle_stepper_meta * meta;
-        for (meta = layer->meta.tail, index = 0; meta != NULL;
-            meta = meta->element.previous, index++) {
+        struct turtle_stepper_meta * meta = layer->meta.tail;
+        if (stepper->footprint_resolution > 0.) {
+                /* Skip the data not overlapping the location */
+                if ((layer->footprint == NULL) &&
+                    (footprint_build(stepper, layer, error_) !=
+                        TURTLE_RETURN_SUCCESS))
+                        return TURTLE_ERROR_RAISE();
+                const int start =
+                    footprint_start(layer->footprint, latitude, longitude);
+                for (; (meta != NULL) && (index < start);
+                    meta = meta->element.previous, index++)
+                        ;
+        }
+        for (; meta != NULL; meta = meta->element.previous, index++) {
                 int inside;
                 stepper_elevation(stepper, meta->data, latitude, longitude,
                     &elevation, &inside);
                 if (inside) {
                         elevation += meta->offset;
 
+                        if (frame_is_local(stepper)) {
+                                /* Compute the position in the local frame */
+                                turtle_projection_project(
+                                    &stepper->frame.projection, latitude,
+                                    longitude, position, position + 1);
+                                position[2] = elevation + height;
+                                if (stepper->frame.curved) {
+                                        const double dx = position[0] -
+                                            stepper->frame.origin[0];
+                                        const double dy = position[1] -
+                                            stepper->frame.origin[1];
+                                        const double r =
+                                            stepper->frame.radius + position[2];
+                                        position[2] = sqrt(r * r - dx * dx -
+                                            dy * dy) - stepper->frame.radius;
+                                }
+                                if (data_index != NULL) *data_index = index;
+                                return TURTLE_RETURN_SUCCESS;
+                        }
+
                         if (stepper->geoid != NULL) {
                                 /* Correct from the geoid */
                                 int inside_;
@@ -911,3 +1993,393 @@ enum turtle_return turtle_stepper_position(struct turtle_stepper * stepper,
                     TURTLE_RETURN_DOMAIN_ERROR, "no valid data");
         }
 }
+
+/* Add data to the current layer of a clone, shared with the master stepper.
+ * Stacks with a lock get a new client, owned by the clone
+ */
+static enum turtle_return clone_meta(struct turtle_stepper * clone,
+    const struct turtle_stepper_meta * meta)
+{
+        const struct turtle_stepper_data * data = meta->data;
+        if (data->step == &stepper_step_flat) {
+                return turtle_stepper_add_flat(clone, meta->offset);
+        } else if (data->step == &stepper_step_map) {
+                return turtle_stepper_add_map(
+                    clone, data->a.map, meta->offset);
+        } else {
+                struct turtle_stack * stack = (data->clean ==
+                    &stepper_clean_client) ? data->a.client->stack :
+                                             data->a.stack;
+                return turtle_stepper_add_stack(clone, stack, meta->offset);
+        }
+}
+
+/* Create a private copy of a stepper, for a worker thread */
+static enum turtle_return stepper_clone(const struct turtle_stepper * stepper,
+    struct turtle_stepper ** clone_, struct turtle_error_context * error_)
+{
+        enum turtle_return rc = turtle_stepper_create(clone_);
+        if (rc != TURTLE_RETURN_SUCCESS) return rc;
+        struct turtle_stepper * clone = *clone_;
+
+        /* Copy the settings. The frame must be set before adding maps */
+        clone->geoid = stepper->geoid;
+        clone->local_range = stepper->local_range;
+        clone->slope_factor = stepper->slope_factor;
+        clone->resolution_factor = stepper->resolution_factor;
+        clone->footprint_resolution = stepper->footprint_resolution;
+        clone->precision = stepper->precision;
+        clone->tuning.enabled = stepper->tuning.enabled;
+        memcpy(&clone->tuning.bounds, &stepper->tuning.bounds,
+            sizeof(clone->tuning.bounds));
+        memcpy(&clone->tuning.initial, &stepper->tuning.initial,
+            sizeof(clone->tuning.initial));
+        memcpy(&clone->tuning.state, &stepper->tuning.state,
+            sizeof(clone->tuning.state));
+        memcpy(&clone->frame, &stepper->frame, sizeof(clone->frame));
+
+        /* Replicate the layers and their meta data */
+        const struct turtle_stepper_layer * layer;
+        for (layer = stepper->layers.head; layer != NULL;
+            layer = layer->element.next) {
+                if (layer_append(clone) != TURTLE_RETURN_SUCCESS) {
+                        turtle_stepper_destroy(clone_);
+                        return TURTLE_ERROR_REGISTER(
+                            TURTLE_RETURN_MEMORY_ERROR,
+                            "could not allocate memory");
+                }
+                const struct turtle_stepper_meta * meta;
+                for (meta = layer->meta.head; meta != NULL;
+                    meta = meta->element.next) {
+                        rc = clone_meta(clone, meta);
+                        if (rc != TURTLE_RETURN_SUCCESS) {
+                                turtle_stepper_destroy(clone_);
+                                return rc;
+                        }
+                }
+        }
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
+/* Pack and unpack a range of tracks, for atomic updates */
+#define RANGE_PACK(begin, end) (((uint64_t)(begin) << 32) | (uint32_t)(end))
+#define RANGE_BEGIN(range) ((int)((range) >> 32))
+#define RANGE_END(range) ((int)((range)&0xFFFFFFFF))
+
+/* Shared settings of a run */
+struct run_job {
+        struct turtle_stepper_track * tracks;
+        turtle_stepper_monitor_t * monitor;
+        void * context;
+        int crossings;
+        int n_workers;
+        struct run_worker * workers;
+        volatile int abort;
+};
+
+/* Private state of a worker, with its pending range of tracks */
+struct run_worker {
+        struct run_job * job;
+        struct turtle_stepper * stepper;
+        int thread;
+        volatile uint64_t range;
+        enum turtle_return rc;
+        struct turtle_error_context error;
+};
+
+/* Pop the next track from the front of the worker's own range */
+static int run_pop(struct run_worker * worker, int * track)
+{
+        for (;;) {
+                const uint64_t range = worker->range;
+                const int begin = RANGE_BEGIN(range);
+                const int end = RANGE_END(range);
+                if (begin >= end) return 0;
+                if (__sync_bool_compare_and_swap(&worker->range, range,
+                    RANGE_PACK(begin + 1, end))) {
+                        *track = begin;
+                        return 1;
+                }
+        }
+}
+
+/* Steal half of the pending tracks of the most loaded worker, from the back
+ * of its range. The worker's own range must be empty
+ */
+static int run_steal(struct run_worker * worker)
+{
+        struct run_job * job = worker->job;
+        for (;;) {
+                struct run_worker * victim = NULL;
+                uint64_t range = 0;
+                int i, pending = 0;
+                for (i = 0; i < job->n_workers; i++) {
+                        const uint64_t r = job->workers[i].range;
+                        const int n = RANGE_END(r) - RANGE_BEGIN(r);
+                        if (n > pending) {
+                                victim = job->workers + i;
+                                range = r;
+                                pending = n;
+                        }
+                }
+                if (victim == NULL) return 0;
+
+                const int begin = RANGE_BEGIN(range);
+                const int end = RANGE_END(range);
+                const int middle = end - (pending + 1) / 2;
+                if (__sync_bool_compare_and_swap(&victim->range, range,
+                    RANGE_PACK(begin, middle))) {
+                        /* Other workers never modify an empty range */
+                        worker->range = RANGE_PACK(middle, end);
+                        __sync_synchronize();
+                        return 1;
+                }
+        }
+}
+
+/* Step a single track until it exits all data, reaches its maximum length or
+ * is stopped by the monitor
+ */
+static enum turtle_return run_track(struct run_worker * worker, int itrack,
+    struct turtle_error_context * error_)
+{
+        struct run_job * job = worker->job;
+        struct turtle_stepper * stepper = worker->stepper;
+        struct turtle_stepper_track * track = job->tracks + itrack;
+        double * position = track->position;
+        const double * direction = track->direction;
+        const double length = track->length;
+
+        /* Start from a fresh history, and from the initial tuning, for
+         * reproducible results
+         */
+        restart_history(stepper);
+        double ds;
+        if (stepper_advance(stepper, position, NULL, NULL, NULL, NULL, NULL,
+            &ds, track->index, error_) != TURTLE_RETURN_SUCCESS)
+                return error_->code;
+        if (track->index[0] < 0) return TURTLE_RETURN_SUCCESS;
+        track->length = 0.;
+        track->steps = 0;
+
+        while ((track->index[0] >= 0) && !job->abort) {
+                const int index0 = track->index[0];
+                if (stepper_advance(stepper, position, direction, NULL,
+                    NULL, NULL, NULL, &ds, track->index, error_) !=
+                    TURTLE_RETURN_SUCCESS)
+                        return error_->code;
+                track->steps++;
+                track->length += ds;
+
+                int done = 0;
+                if ((length > 0.) && (track->length >= length)) {
+                        /* Move back to the end of the track */
+                        const double excess = track->length - length;
+                        if (excess > 0.) {
+                                int i;
+                                for (i = 0; i < 3; i++)
+                                        position[i] -= direction[i] * excess;
+                                ds -= excess;
+                                track->length = length;
+                                double tmp;
+                                if (stepper_advance(stepper, position, NULL,
+                                    NULL, NULL, NULL, NULL, &tmp, track->index,
+                                    error_) != TURTLE_RETURN_SUCCESS)
+                                        return error_->code;
+                        }
+                        done = 1;
+                }
+
+                if ((job->monitor != NULL) &&
+                    (!job->crossings || (track->index[0] != index0))) {
+                        if (job->monitor(job->context, itrack, worker->thread,
+                            position, ds, track->index) != 0)
+                                done = 1;
+                }
+                if (done) break;
+        }
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
+/* Process tracks, from the worker's own range and then by stealing work from
+ * other workers
+ */
+static void * run_thread(void * arg)
+{
+        struct run_worker * worker = arg;
+        struct run_job * job = worker->job;
+        struct turtle_error_context * error_ = &worker->error;
+
+        for (;;) {
+                int track;
+                if (!run_pop(worker, &track) &&
+                    (!run_steal(worker) || !run_pop(worker, &track)))
+                        break;
+                if (job->abort) break;
+                worker->rc = run_track(worker, track, error_);
+                if (worker->rc != TURTLE_RETURN_SUCCESS) {
+                        job->abort = 1;
+                        break;
+                }
+        }
+        return NULL;
+}
+
+#ifndef TURTLE_NO_PTHREAD
+/* Check if the stepper can be shared by several threads, i.e. if all
+ * stacks are protected by a lock
+ */
+static int stepper_is_shareable(const struct turtle_stepper * stepper)
+{
+        const struct turtle_stepper_data * data;
+        for (data = stepper->data.head; data != NULL;
+            data = data->element.next) {
+                if (data->step == &stepper_step_stack) return 0;
+        }
+        return 1;
+}
+#endif
+
+enum turtle_return turtle_stepper_run(struct turtle_stepper * stepper,
+    int n, struct turtle_stepper_track * tracks, int threads,
+    turtle_stepper_monitor_t * monitor, void * context, int crossings)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_stepper_run);
+
+        if (n <= 0) return TURTLE_RETURN_SUCCESS;
+        if (tracks == NULL) {
+                return TURTLE_ERROR_MESSAGE(
+                    TURTLE_RETURN_BAD_ADDRESS, "invalid tracks (null)");
+        }
+
+        /* Check that all tracks have an end. Otherwise, tracks staying
+         * within the topography, e.g. going upwards, would never stop
+         */
+        int i;
+        if (monitor == NULL) {
+                for (i = 0; i < n; i++) {
+                        if (!(tracks[i].length > 0.)) {
+                                return TURTLE_ERROR_MESSAGE(
+                                    TURTLE_RETURN_DOMAIN_ERROR,
+                                    "unlimited track without monitor");
+                        }
+                }
+        }
+
+        /* Save the state of any loaded cursor */
+        cursor_load(stepper, NULL);
+
+#ifdef TURTLE_NO_PTHREAD
+        threads = 1;
+#else
+        if (threads > n) threads = n;
+        if ((threads < 1) || !stepper_is_shareable(stepper)) threads = 1;
+#endif
+
+        struct run_job job;
+        memset(&job, 0x0, sizeof(job));
+        job.tracks = tracks;
+        job.monitor = monitor;
+        job.context = context;
+        job.crossings = crossings;
+        job.n_workers = threads;
+        job.workers = malloc(threads * sizeof(*job.workers));
+        if (job.workers == NULL) return TURTLE_ERROR_MEMORY();
+
+        /* Initialise the workers with contiguous ranges of tracks. The
+         * calling thread uses the master stepper
+         */
+        int n_workers;
+        enum turtle_return rc = TURTLE_RETURN_SUCCESS;
+        for (i = 0; i < threads; i++) {
+                struct run_worker * worker = job.workers + i;
+                worker->job = &job;
+                worker->thread = i;
+                worker->range = RANGE_PACK(
+                    ((int64_t)i * n) / threads,
+                    ((int64_t)(i + 1) * n) / threads);
+                worker->rc = TURTLE_RETURN_SUCCESS;
+                memcpy(&worker->error, error_, sizeof(worker->error));
+                if (i == 0) {
+                        worker->stepper = stepper;
+                } else {
+                        rc = stepper_clone(
+                            stepper, &worker->stepper, error_);
+                        if (rc != TURTLE_RETURN_SUCCESS) break;
+                }
+        }
+        n_workers = i;
+
+        if (rc == TURTLE_RETURN_SUCCESS) {
+#ifndef TURTLE_NO_PTHREAD
+                pthread_t * handles = NULL;
+                int * started = NULL;
+                if (threads > 1) {
+                        handles = malloc(threads * sizeof(*handles));
+                        started = calloc(threads, sizeof(*started));
+                }
+                if ((handles != NULL) && (started != NULL)) {
+                        for (i = 1; i < threads; i++) {
+                                started[i] = (pthread_create(handles + i,
+                                    NULL, &run_thread, job.workers + i) == 0);
+                        }
+                }
+                run_thread(job.workers);
+                if ((handles != NULL) && (started != NULL)) {
+                        for (i = 1; i < threads; i++) {
+                                if (started[i])
+                                        pthread_join(handles[i], NULL);
+                        }
+                }
+                free(handles);
+                free(started);
+#else
+                run_thread(job.workers);
+#endif
+        }
+
+        /* Gather the tuning statistics and release the clones */
+        for (i = 1; i < n_workers; i++) {
+                struct turtle_stepper_tuning_report * report =
+                    &job.workers[i].stepper->tuning.report;
+                stepper->tuning.report.steps += report->steps;
+                stepper->tuning.report.overshoots += report->overshoots;
+                stepper->tuning.report.rebuilds += report->rebuilds;
+                turtle_stepper_destroy(&job.workers[i].stepper);
+        }
+
+        /* Tuned settings depend on the last track of the calling thread.
+         * Thus, the initial ones are restored
+         */
+        restart_history(stepper);
+        if (rc != TURTLE_RETURN_SUCCESS) {
+                free(job.workers);
+                turtle_error_raise_(error_);
+                return rc;
+        }
+
+        /* Report the first error of the workers, if any */
+        int failed = -1;
+        for (i = 0; i < threads; i++) {
+                struct run_worker * worker = job.workers + i;
+                if (worker->rc == TURTLE_RETURN_SUCCESS) continue;
+                if (failed < 0) {
+                        failed = i;
+                } else if (worker->error.dynamic) {
+                        free(worker->error.message);
+                }
+        }
+        if (failed >= 0) {
+                struct run_worker * worker = job.workers + failed;
+                rc = worker->rc;
+                memcpy(error_, &worker->error, sizeof(*error_));
+                free(job.workers);
+                turtle_error_raise_(error_);
+                return rc;
+        }
+
+        free(job.workers);
+        return TURTLE_RETURN_SUCCESS;
+}
@@ -26,11 +26,12 @@
 
 #include "turtle.h"
 #include "turtle/list.h"
+#include "turtle/projection.h"
 
 struct turtle_stepper_data;
 typedef enum turtle_return turtle_stepper_stepper_t(
     struct turtle_stepper * stepper, struct turtle_stepper_data * data,
-    const double * position, int has_geodetic, double * geographic,
+    const double * position, int * has_geodetic, double * geographic,
     double * data_elevation, int * inside);
 
 typedef void turtle_stepper_elevator_t(struct turtle_stepper * stepper,
@@ -48,6 +49,7 @@ struct turtle_stepper_transform {
         double reference_ecef[3];
         double reference_geographic[5];
         double data[5][3];
+        float data_single[5][3];
 
         struct {
                 int updated;
@@ -70,10 +72,23 @@ struct turtle_stepper_data {
         } a;
         struct turtle_stepper_transform * transform;
 
+        /* Flag for maps sharing the projection of the stepper's local frame */
+        int native;
+
+        /* Conservative bounding volumes of the data, i.e. a geodetic box of
+         * latitude and longitude ranges, and an ECEF cone given by its axis
+         * and the cosine of its aperture
+         */
+        int bounded;
+        double box[4];
+        double cone[4];
+
         struct {
                 int updated;
+                int has_geodetic;
                 double geographic[5];
                 double elevation;
+                double slope[2];
                 int inside;
         } history;
 };
@@ -85,18 +100,74 @@ struct turtle_stepper_meta {
         double offset;
 };
 
+/* Coarse geodetic grid indexing the first data overlapping each cell */
+struct turtle_stepper_footprint {
+        /* Index of the first data for samples outside of the grid */
+        int outside;
+
+        /* Local transform for the geodetic coordinates of samples */
+        struct turtle_stepper_transform * transform;
+
+        double latitude_0, longitude_0, resolution;
+        int latitude_n, longitude_n;
+        unsigned char cells[];
+};
+
 struct turtle_stepper_layer {
         struct turtle_list_element element;
         struct turtle_list meta;
+        struct turtle_stepper_footprint * footprint;
 };
 
 struct turtle_stepper_sample {
         double position[3];
+        int has_geodetic;
         double geographic[5];
         double elevation[2];
+        double slope[2][2];
         int index[2];
 };
 
+/* Local linearisation of a transform, as saved by cursors */
+struct turtle_stepper_reference {
+        double ecef[3];
+        double geographic[5];
+        double data[5][3];
+        float data_single[5][3];
+};
+
+/* Adaptive state of the auto-tuning, restarted with each track */
+struct turtle_stepper_tune_state {
+        /* The tuned settings */
+        double local_range;
+        double slope_factor;
+        double resolution_factor;
+
+        /* Estimated coefficient of the linearisation error, in m^-1 */
+        double curvature;
+
+        /* Statistics over the current window of steps */
+        int steps;
+        int overshoots;
+        int floors;
+        int crossings;
+};
+
+/* Stepping state of a track, swapped in and out of the stepper */
+struct turtle_stepper_cursor {
+        struct turtle_stepper * stepper;
+
+        /* Flag for a saved state, and the stepper settings it refers to */
+        int saved;
+        unsigned int generation;
+        int data_size;
+
+        struct turtle_stepper_sample last;
+        struct turtle_stepper_tune_state tune;
+        int references_size;
+        struct turtle_stepper_reference * references;
+};
+
 /* Container for an ECEF stepper */
 struct turtle_stepper {
         struct turtle_list data;
@@ -106,7 +177,39 @@ struct turtle_stepper {
         double local_range;
         double slope_factor;
         double resolution_factor;
+        double footprint_resolution;
+        enum turtle_stepper_precision precision;
+
+        /* Local frame of positions, used instead of ECEF if its projection
+         * type is not PROJECTION_NONE
+         */
+        struct {
+                struct turtle_projection projection;
+                int curved;
+                double origin[2];
+                double radius;
+        } frame;
+
         struct turtle_stepper_sample last;
+
+        /* The cursor whose state is loaded, if any, and the generation of
+         * the stepping settings, incremented when the history is reset
+         */
+        struct turtle_stepper_cursor * cursor;
+        unsigned int generation;
+
+        /* Auto-tuning of the stepping settings. The tuned settings are
+         * applied directly to the stepper, the ones of the state being
+         * only used for saving them. Fresh tracks start from the initial
+         * state
+         */
+        struct {
+                int enabled;
+                struct turtle_stepper_tuning bounds;
+                struct turtle_stepper_tune_state initial;
+                struct turtle_stepper_tune_state state;
+                struct turtle_stepper_tuning_report report;
+        } tuning;
 };
 
 #endif
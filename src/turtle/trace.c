@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2017 Université Clermont Auvergne, CNRS/IN2P3, LPC
+ * Author: Valentin NIESS (niess@in2p3.fr)
+ *
+ * Topographic Utilities for tRansporting parTicules over Long rangEs (TURTLE)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/*
+ * Recording of timestamped events, for the offline analysis of latencies.
+ * Each thread writes to its own ring of records, without any lock. Rings are
+ * chained in a global list, for exporting their records.
+ */
+
+/* Expose clock_gettime */
+#define _POSIX_C_SOURCE 200112L
+
+/* C89 standard library */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+/* POSIX clocks */
+#include <time.h>
+/* TURTLE library */
+#include "turtle/error.h"
+#include "turtle/trace.h"
+
+/* Size of the labels of records, including the terminating null char */
+#define TRACE_LABEL_SIZE 52
+
+/* Magic tag of binary trace files */
+#define TRACE_MAGIC "TURTLE-TRACE-1"
+
+/* Record of an event */
+struct trace_record {
+        uint64_t time;
+        unsigned char event;
+        char phase;
+        char label[TRACE_LABEL_SIZE];
+};
+
+/* Ring of records of a thread */
+struct trace_ring {
+        struct trace_ring * next;
+        int thread;
+        int capacity;
+
+        /* Total number of records written so far */
+        volatile uint64_t head;
+
+        struct trace_record records[];
+};
+
+/* Flag for enabled tracing */
+volatile int turtle_trace_enabled_ = 0;
+
+/* Global state of the tracing */
+static struct trace_ring * volatile trace_rings = NULL;
+static volatile unsigned int trace_generation = 0;
+static int trace_capacity = 0;
+static int trace_threads = 0;
+static struct timespec trace_origin;
+
+/* Ring of the calling thread, valid for the given generation only */
+#ifndef TURTLE_NO_PTHREAD
+static __thread struct trace_ring * local_ring = NULL;
+static __thread unsigned int local_generation = 0;
+#else
+static struct trace_ring * local_ring = NULL;
+static unsigned int local_generation = 0;
+#endif
+
+/* Names of events, in the exported traces */
+static const char * trace_names[N_TURTLE_TRACE_EVENTS] = { "tile_load",
+        "tile_evict", "lock_wait", "lock_hold", "transform", "bisection" };
+
+/* Get the time elapsed since the start of the tracing, in ns */
+static uint64_t trace_clock(void)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint64_t)(now.tv_sec - trace_origin.tv_sec) * 1000000000 +
+            now.tv_nsec - trace_origin.tv_nsec;
+}
+
+/* Allocate a ring for the calling thread and chain it */
+static struct trace_ring * ring_create(void)
+{
+        const int capacity = trace_capacity;
+        struct trace_ring * ring =
+            malloc(sizeof(*ring) + capacity * sizeof(*ring->records));
+        if (ring == NULL) return NULL;
+        ring->thread = __sync_fetch_and_add(&trace_threads, 1);
+        ring->capacity = capacity;
+        ring->head = 0;
+
+        struct trace_ring * next;
+        do {
+                next = trace_rings;
+                ring->next = next;
+        } while (!__sync_bool_compare_and_swap(&trace_rings, next, ring));
+
+        return ring;
+}
+
+/* Record an event to the ring of the calling thread */
+void turtle_trace_record_(
+    enum turtle_trace_event event, char phase, const char * label)
+{
+        const unsigned int generation = trace_generation;
+        if ((local_ring == NULL) || (local_generation != generation)) {
+                local_ring = ring_create();
+                local_generation = generation;
+                if (local_ring == NULL) return;
+        }
+        struct trace_ring * ring = local_ring;
+
+        const uint64_t head = ring->head;
+        struct trace_record * record = ring->records + head % ring->capacity;
+        record->time = trace_clock();
+        record->event = (unsigned char)event;
+        record->phase = phase;
+        if (label == NULL) {
+                record->label[0] = 0x0;
+        } else {
+                /* Keep the tail of long labels, e.g. of paths */
+                const int n = strlen(label);
+                const int offset =
+                    (n >= TRACE_LABEL_SIZE) ? n - TRACE_LABEL_SIZE + 1 : 0;
+                memcpy(record->label, label + offset, n - offset + 1);
+        }
+
+        /* Publish the record */
+        __sync_synchronize();
+        ring->head = head + 1;
+}
+
+enum turtle_return turtle_trace_start(int capacity)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_trace_start);
+
+        if (capacity < 0) {
+                return TURTLE_ERROR_MESSAGE(
+                    TURTLE_RETURN_DOMAIN_ERROR, "invalid capacity");
+        }
+
+        /* Discard any previous record */
+        turtle_trace_enabled_ = 0;
+        struct trace_ring * ring = trace_rings;
+        while (ring != NULL) {
+                struct trace_ring * next = ring->next;
+                free(ring);
+                ring = next;
+        }
+        trace_rings = NULL;
+        trace_generation++;
+        trace_threads = 0;
+        if (capacity == 0) return TURTLE_RETURN_SUCCESS;
+
+        /* Start the recording */
+        trace_capacity = capacity;
+        clock_gettime(CLOCK_MONOTONIC, &trace_origin);
+        __sync_synchronize();
+        turtle_trace_enabled_ = 1;
+
+        return TURTLE_RETURN_SUCCESS;
+}
+
+void turtle_trace_stop(void) { turtle_trace_enabled_ = 0; }
+
+/* Write a label as a JSON string */
+static void json_label(FILE * stream, const char * label)
+{
+        fputc('"', stream);
+        for (; *label != 0x0; label++) {
+                const unsigned char c = *label;
+                if ((c == '"') || (c == '\\'))
+                        fprintf(stream, "\\%c", c);
+                else if (c < 0x20)
+                        fprintf(stream, "\\u%04x", c);
+                else
+                        fputc(c, stream);
+        }
+        fputc('"', stream);
+}
+
+/* Export the records in the Chrome trace format */
+static void dump_json(FILE * stream)
+{
+        fputs("{\"traceEvents\":[", stream);
+        const struct trace_ring * ring;
+        int first = 1;
+        for (ring = trace_rings; ring != NULL; ring = ring->next) {
+                const uint64_t head = ring->head;
+                uint64_t i = (head > (uint64_t)ring->capacity) ?
+                    head - ring->capacity : 0;
+                for (; i < head; i++) {
+                        const struct trace_record * record =
+                            ring->records + i % ring->capacity;
+                        fprintf(stream,
+                            "%s\n{\"name\":\"%s\",\"cat\":\"turtle\","
+                            "\"ph\":\"%c\",\"ts\":%.3f,\"pid\":0,"
+                            "\"tid\":%d",
+                            first ? "" : ",", trace_names[record->event],
+                            record->phase, 1E-03 * record->time,
+                            ring->thread);
+                        if (record->phase == TURTLE_TRACE_INSTANT)
+                                fputs(",\"s\":\"t\"", stream);
+                        if (record->label[0] != 0x0) {
+                                fputs(",\"args\":{\"label\":", stream);
+                                json_label(stream, record->label);
+                                fputc('}', stream);
+                        }
+                        fputc('}', stream);
+                        first = 0;
+                }
+        }
+        fputs("\n],\"displayTimeUnit\":\"ms\"}\n", stream);
+}
+
+/* Export the records in a compact binary format */
+static void dump_binary(FILE * stream)
+{
+        fwrite(TRACE_MAGIC, sizeof(TRACE_MAGIC), 1, stream);
+        const struct trace_ring * ring;
+        for (ring = trace_rings; ring != NULL; ring = ring->next) {
+                const uint64_t head = ring->head;
+                uint64_t i = (head > (uint64_t)ring->capacity) ?
+                    head - ring->capacity : 0;
+                for (; i < head; i++) {
+                        const struct trace_record * record =
+                            ring->records + i % ring->capacity;
+                        const int32_t thread = ring->thread;
+                        const uint16_t n = strlen(record->label);
+                        fwrite(&record->time, sizeof(record->time), 1,
+                            stream);
+                        fwrite(&thread, sizeof(thread), 1, stream);
+                        fputc(record->event, stream);
+                        fputc(record->phase, stream);
+                        fwrite(&n, sizeof(n), 1, stream);
+                        fwrite(record->label, 1, n, stream);
+                }
+        }
+}
+
+enum turtle_return turtle_trace_dump(const char * path)
+{
+        TURTLE_ERROR_INITIALISE(&turtle_trace_dump);
+
+        FILE * stream = fopen(path, "wb");
+        if (stream == NULL) {
+                return TURTLE_ERROR_FORMAT(TURTLE_RETURN_PATH_ERROR,
+                    "could not open file `%s'", path);
+        }
+
+        const char * extension = strrchr(path, '.');
+        if ((extension != NULL) && (strcmp(extension, ".json") == 0))
+                dump_json(stream);
+        else
+                dump_binary(stream);
+
+        const int failed = ferror(stream);
+        fclose(stream);
+        if (failed) {
+                return TURTLE_ERROR_FORMAT(TURTLE_RETURN_PATH_ERROR,
+                    "could not write file `%s'", path);
+        }
+
+        return TURTLE_RETURN_SUCCESS;
+}
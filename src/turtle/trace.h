@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2017 Université Clermont Auvergne, CNRS/IN2P3, LPC
+ * Author: Valentin NIESS (niess@in2p3.fr)
+ *
+ * Topographic Utilities for tRansporting parTicules over Long rangEs (TURTLE)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/* Recording of timestamped events, for the offline analysis of latencies */
+#ifndef TURTLE_TRACE_H
+#define TURTLE_TRACE_H
+
+/* TURTLE library */
+#include "turtle.h"
+
+/* Phases of events, as in the Chrome trace format */
+#define TURTLE_TRACE_BEGIN 'B'
+#define TURTLE_TRACE_END 'E'
+#define TURTLE_TRACE_INSTANT 'i'
+
+/* Flag for enabled tracing, checked before recording any event */
+extern volatile int turtle_trace_enabled_;
+
+/* Record an event to the ring of the calling thread */
+void turtle_trace_record_(
+    enum turtle_trace_event event, char phase, const char * label);
+
+/* Record an event if tracing is enabled. The label might be `NULL` */
+static inline void turtle_trace_(
+    enum turtle_trace_event event, char phase, const char * label)
+{
+        if (turtle_trace_enabled_) turtle_trace_record_(event, phase, label);
+}
+
+#endif
@@ -22,6 +22,9 @@
  * Unit tests for the Turtle C library
  */
 
+/* Expose POSIX sockets and processes, for serving remote data */
+#define _POSIX_C_SOURCE 200809L
+
 /* C89 standard library */
 #include <float.h>
 #include <math.h>
@@ -31,6 +34,13 @@
 #include <string.h>
 /* POSIX regular expressions */
 #include <regex.h> 
+/* POSIX sockets and processes */
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 /* The Check library */
 #include "check.h"
 /* Endianess utilities */
@@ -41,10 +51,14 @@
 #endif
 /* The TURTLE library */
 #include "turtle.h"
+#include "turtle_inline.h"
 /* Opaque TURTLE data */
+#include "../src/turtle/client.h"
+#include "../src/turtle/compress.h"
 #include "../src/turtle/list.h"
 #include "../src/turtle/stack.h"
 #include "../src/turtle/stepper.h"
+#include "../src/turtle/trace.h"
 
 
 /* Shortcut(s) for checking internal type(s) */
@@ -513,6 +527,321 @@ START_TEST (test_map)
 END_TEST
 
 
+/* Test the views over maps */
+START_TEST (test_map_view)
+{
+        const double x0 = 496000, y0 = 5067000;
+
+        /* Create a view and check its meta data */
+        struct turtle_map * map, * view;
+        turtle_map_load(&map, MAP_PATH);
+        const int ix0 = 50, iy0 = 60, nx1 = 101, ny1 = 81;
+        ck_assert_int_eq(turtle_map_view(map, ix0, iy0, nx1, ny1, &view),
+            TURTLE_RETURN_SUCCESS);
+
+        struct turtle_map_info info;
+        const char * projection;
+        turtle_map_meta(view, &info, &projection);
+        ck_assert_int_eq(info.nx, nx1);
+        ck_assert_int_eq(info.ny, ny1);
+        ck_assert_double_eq_tol(info.x[0], x0 - 1000 + ix0 * 10, 1E-06);
+        ck_assert_double_eq_tol(info.y[1], y0 - 1000 + (iy0 + ny1 - 1) * 10,
+            1E-06);
+        ck_assert_str_eq(projection, "UTM 31N");
+
+        /* Check that the data are shared */
+        int ix, iy;
+        for (iy = 0; iy < ny1; iy++) {
+                for (ix = 0; ix < nx1; ix++) {
+                        double x, y, z, x1, y1, z1;
+                        turtle_map_node(map, ix + ix0, iy + iy0, &x, &y, &z);
+                        turtle_map_node(view, ix, iy, &x1, &y1, &z1);
+                        ck_assert_double_eq_tol(x1, x, 1E-06);
+                        ck_assert_double_eq_tol(y1, y, 1E-06);
+                        ck_assert_double_eq(z1, z);
+                }
+        }
+        turtle_map_fill(view, 1, 2, 500.);
+        double z;
+        turtle_map_node(map, ix0 + 1, iy0 + 2, NULL, NULL, &z);
+        ck_assert_double_eq_tol(z, 500., 1E-02);
+
+        /* Check the stepping over a view */
+        const double latitude = 45.756546, longitude = 2.9485671;
+        double elevation[2][2];
+        struct turtle_map * maps[2] = { map, view };
+        int i;
+        for (i = 0; i < 2; i++) {
+                struct turtle_stepper * stepper;
+                turtle_stepper_create(&stepper);
+                turtle_stepper_add_map(stepper, maps[i], 0.);
+                double position[3];
+                int index[2];
+                turtle_stepper_position(stepper, latitude, longitude, 0., 0,
+                    position, index);
+                turtle_stepper_step(stepper, position, NULL, NULL, NULL, NULL,
+                    elevation[i], NULL, index);
+                ck_assert_int_eq(index[0], 0);
+                turtle_stepper_destroy(&stepper);
+        }
+        ck_assert_double_eq(elevation[1][0], elevation[0][0]);
+
+        /* Check that the data outlive the parent, including for a view of a
+         * view
+         */
+        struct turtle_map * subview;
+        turtle_map_view(view, 1, 2, 3, 3, &subview);
+        turtle_map_destroy(&map);
+        turtle_map_destroy(&view);
+        turtle_map_node(subview, 0, 0, NULL, NULL, &z);
+        ck_assert_double_eq_tol(z, 500., 1E-02);
+        turtle_map_destroy(&subview);
+
+        /* Check the errors */
+        turtle_error_handler_t * handler = turtle_error_handler_get();
+        turtle_error_handler_set(&catch_error);
+        turtle_map_load(&map, MAP_PATH);
+        ck_assert_int_eq(turtle_map_view(map, 150, 0, 60, 10, &view),
+            TURTLE_RETURN_DOMAIN_ERROR);
+        ck_assert_ptr_null(view);
+        ck_assert_int_eq(turtle_map_view(NULL, 0, 0, 10, 10, &view),
+            TURTLE_RETURN_BAD_ADDRESS);
+        ck_assert_ptr_null(view);
+        turtle_map_destroy(&map);
+        turtle_error_handler_set(handler);
+}
+END_TEST
+
+/* Check the window statistics of a map against a loop over its nodes */
+static void check_window_stats(struct turtle_map * map, double x0,
+    double x1, double y0, double y1)
+{
+        double mean, min, max;
+        ck_assert_int_eq(turtle_map_window_stats(map, x0, x1, y0, y1,
+            &mean, &min, &max), TURTLE_RETURN_SUCCESS);
+
+        if (y0 > y1) {
+                const double tmp = y0;
+                y0 = y1;
+                y1 = tmp;
+        }
+        struct turtle_map_info info;
+        turtle_map_meta(map, &info, NULL);
+        double sum = 0., zmin = DBL_MAX, zmax = -DBL_MAX;
+        int ix, n = 0;
+        for (ix = 0; ix < info.nx; ix++) {
+                int iy;
+                for (iy = 0; iy < info.ny; iy++) {
+                        double x, y, z;
+                        turtle_map_node(map, ix, iy, &x, &y, &z);
+                        if ((x < x0 - 1E-06) || (x > x1 + 1E-06) ||
+                            (y < y0 - 1E-06) || (y > y1 + 1E-06))
+                                continue;
+                        sum += z;
+                        n++;
+                        if (z < zmin) zmin = z;
+                        if (z > zmax) zmax = z;
+                }
+        }
+        ck_assert_int_gt(n, 0);
+        ck_assert_double_eq_tol(mean, sum / n, 1E-06);
+        ck_assert_double_eq_tol(min, zmin, 1E-03);
+        ck_assert_double_eq_tol(max, zmax, 1E-03);
+}
+
+
+START_TEST (test_map_stats)
+{
+        /* Create a large map with pseudo random data */
+        const int nx = 701, ny = 401;
+        struct turtle_map_info info = { nx, ny, { 0., 7000. }, { 0., 4000. },
+                { 0., 1000. } };
+        struct turtle_map * map;
+        turtle_map_create(&map, &info, NULL);
+        unsigned int seed = 1;
+        int ix;
+        for (ix = 0; ix < nx; ix++) {
+                int iy;
+                for (iy = 0; iy < ny; iy++) {
+                        seed = seed * 1103515245 + 12345;
+                        turtle_map_fill(map, ix, iy,
+                            ((seed >> 16) % 1000) + 0.1 * (ix % 10));
+                }
+        }
+
+        /* Check some windows */
+        check_window_stats(map, 0., 7000., 0., 4000.);
+        check_window_stats(map, 1230., 1230., 560., 560.);
+        check_window_stats(map, 1005., 1795., 2000., 2090.);
+        check_window_stats(map, -500., 300., 3950., 4500.);
+        check_window_stats(map, 1234., 6543., 321., 3987.);
+        check_window_stats(map, 15., 6995., 3105., 3195.);
+        int i;
+        for (i = 0; i < 20; i++) {
+                seed = seed * 1103515245 + 12345;
+                const double x0 = (seed >> 16) % 6000;
+                seed = seed * 1103515245 + 12345;
+                const double y0 = (seed >> 16) % 3000;
+                seed = seed * 1103515245 + 12345;
+                const double w = 20. + (seed >> 16) % 1000;
+                check_window_stats(map, x0, x0 + w, y0 + 0.5 * w, y0);
+        }
+
+        /* Check that modifying the map invalidates the tables */
+        ck_assert_ptr_nonnull(map->sums);
+        ck_assert_ptr_nonnull(map->extrema);
+        turtle_map_fill(map, 0, 0, 1000.);
+        ck_assert_ptr_null(map->sums);
+        ck_assert_ptr_null(map->extrema);
+        check_window_stats(map, 0., 100., 0., 100.);
+
+        /* Check that views share the tables of their parent */
+        struct turtle_map * view;
+        turtle_map_view(map, 100, 50, 300, 200, &view);
+        check_window_stats(view, 1000., 4000., 500., 2500.);
+        check_window_stats(view, 1205., 1995., 700., 1590.);
+        ck_assert_ptr_null(view->sums);
+        ck_assert_ptr_null(view->extrema);
+
+        /* Check that filling the parent invalidates the tables of a view */
+        for (ix = 0; ix < nx; ix++) {
+                int iy;
+                for (iy = 0; iy < ny; iy++) turtle_map_fill(map, ix, iy, 50.);
+        }
+        double mean, min, max;
+        turtle_map_window_stats(
+            view, 1000., 4000., 500., 2500., &mean, &min, &max);
+        const double dz = 1000. / 65535.;
+        ck_assert_double_eq_tol(mean, 50., dz);
+        ck_assert_double_eq_tol(min, 50., dz);
+        ck_assert_double_eq_tol(max, 50., dz);
+
+        /* Check that filling a view invalidates the tables of its parent */
+        turtle_map_window_stats(
+            map, 0., 7000., 0., 4000., &mean, &min, &max);
+        turtle_map_fill(view, 10, 20, 900.);
+        ck_assert_ptr_null(map->sums);
+        ck_assert_ptr_null(map->extrema);
+        check_window_stats(map, 1000., 1200., 600., 800.);
+        check_window_stats(view, 1000., 4000., 500., 2500.);
+        turtle_map_destroy(&view);
+        turtle_map_destroy(&map);
+
+        /* Check a map with rows stored from north to south, and a view */
+        turtle_map_load(&map, MAP_PATH);
+        check_window_stats(map, 495000., 495100., 5066000., 5066040.);
+        check_window_stats(map, 496990., 497500., 5067990., 5068500.);
+        turtle_map_view(map, 10, 20, 50, 60, &view);
+        struct turtle_map_info info1;
+        turtle_map_meta(view, &info1, NULL);
+        check_window_stats(view, info1.x[0], info1.x[1], info1.y[0],
+            info1.y[1]);
+        check_window_stats(view, info1.x[0] + 105., info1.x[0] + 310.,
+            info1.y[0] + 55., info1.y[0] + 380.);
+        turtle_map_destroy(&view);
+
+        /* Check the errors */
+        turtle_error_handler_t * handler = turtle_error_handler_get();
+        turtle_error_handler_set(&catch_error);
+        ck_assert_int_eq(turtle_map_window_stats(map, 0., 1., 0., 1., &mean,
+            NULL, NULL), TURTLE_RETURN_DOMAIN_ERROR);
+        ck_assert_int_eq(turtle_map_window_stats(map, 495001., 495009.,
+            5066000., 5066040., &mean, NULL, NULL),
+            TURTLE_RETURN_DOMAIN_ERROR);
+        ck_assert_int_eq(turtle_map_window_stats(NULL, 0., 1., 0., 1., &mean,
+            NULL, NULL), TURTLE_RETURN_BAD_ADDRESS);
+        turtle_error_handler_set(handler);
+
+        turtle_map_destroy(&map);
+}
+END_TEST
+
+
+/* Check the inline interpolation against the library one, over and around
+ * a map
+ */
+static void check_map_data(const struct turtle_map * map)
+{
+        struct turtle_map_data data;
+        turtle_map_data_get(map, &data);
+        struct turtle_map_info info;
+        turtle_map_meta(map, &info, NULL);
+        const double hx = (info.x[1] - info.x[0]) / 40.;
+        const double hy = (info.y[1] - info.y[0]) / 40.;
+        int i;
+        for (i = 0; i < 45 * 45; i++) {
+                const double x = info.x[0] + ((i % 45) - 2) * hx * 1.01;
+                const double y = info.y[0] + ((i / 45) - 2) * hy * 1.01;
+                double z0 = 0., z1 = 0.;
+                int inside;
+                turtle_map_elevation(map, x, y, &z0, &inside);
+                ck_assert_int_eq(
+                    turtle_map_data_elevation(&data, x, y, &z1), inside);
+                ck_assert_double_eq(z1, z0);
+        }
+}
+
+START_TEST (test_map_data)
+{
+        /* Check a map with big endian data, stored from north to south */
+        struct turtle_map * map;
+        turtle_map_load(&map, MAP_PATH);
+        struct turtle_map_data data;
+        turtle_map_data_get(map, &data);
+        ck_assert_int_eq(data.encoding, TURTLE_MAP_ENCODING_UINT16_BE);
+        ck_assert_int_lt(data.stride, 0);
+        check_map_data(map);
+
+        /* Check a view of the map */
+        struct turtle_map * view;
+        turtle_map_view(map, 10, 20, 50, 60, &view);
+        check_map_data(view);
+        turtle_map_destroy(&view);
+        turtle_map_destroy(&map);
+
+        /* Check a map created in memory */
+        struct turtle_map_info info = { 51, 41, { 0., 500. }, { 0., 400. },
+                { -100., 2000. } };
+        turtle_map_create(&map, &info, NULL);
+        int i, j;
+        for (i = 0; i < info.ny; i++) {
+                for (j = 0; j < info.nx; j++) {
+                        turtle_map_fill(
+                            map, j, i, ((j * 37 + i * 101) % 2000) - 99.);
+                }
+        }
+        turtle_map_data_get(map, &data);
+        ck_assert_int_eq(data.encoding, TURTLE_MAP_ENCODING_UINT16);
+        ck_assert_int_gt(data.stride, 0);
+        ck_assert_double_eq_tol(turtle_map_data_node(&data, 3, 2),
+            ((3 * 37 + 2 * 101) % 2000) - 99., data.dz);
+        check_map_data(map);
+
+#ifndef TURTLE_NO_TIFF
+        /* Check a map with signed data */
+        turtle_map_destroy(&map);
+        info.z[0] = -32767.;
+        info.z[1] = 32768.;
+        turtle_map_create(&map, &info, NULL);
+        for (i = 0; i < info.ny; i++) {
+                for (j = 0; j < info.nx; j++) {
+                        turtle_map_fill(
+                            map, j, i, ((j * 37 + i * 101) % 2000) - 99.);
+                }
+        }
+        const char * path = "tests/map-data.tif";
+        turtle_map_dump(map, path);
+        turtle_map_destroy(&map);
+        turtle_map_load(&map, path);
+        turtle_map_data_get(map, &data);
+        ck_assert_int_eq(data.encoding, TURTLE_MAP_ENCODING_INT16);
+        check_map_data(map);
+#endif
+        turtle_map_destroy(&map);
+}
+END_TEST
+
+
 START_TEST (test_projection)
 {
         /* Check the no projection case */
@@ -603,6 +932,35 @@ START_TEST (test_ecef)
         ck_assert_double_eq_tol(angle[0], azimuth, 1E-08);
         ck_assert_double_eq_tol(angle[1], elevation, 1E-08);
 
+        /* Convert directions with the frame of an observer */
+        struct turtle_ecef_frame frame;
+        turtle_ecef_frame_configure(&frame, latitude, longitude);
+        const double azimuths[3] = { azimuth, -120., 10. };
+        const double elevations[3] = { elevation, -45., 89. };
+        double directions[3][3], angles[2][3], local[3][3];
+        turtle_ecef_frame_from_horizontal(
+            &frame, 3, azimuths, elevations, directions[0]);
+        turtle_ecef_frame_to_horizontal(
+            &frame, 3, directions[0], angles[0], angles[1]);
+        turtle_ecef_frame_to_local(&frame, 3, directions[0], local[0]);
+        int i;
+        for (i = 0; i < 3; i++) {
+                double d[3];
+                turtle_ecef_from_horizontal(
+                    latitude, longitude, azimuths[i], elevations[i], d);
+                int j;
+                for (j = 0; j < 3; j++)
+                        ck_assert_double_eq_tol(directions[i][j], d[j], 1E-12);
+                ck_assert_double_eq_tol(angles[0][i], azimuths[i], 1E-08);
+                ck_assert_double_eq_tol(angles[1][i], elevations[i], 1E-08);
+                ck_assert_double_eq_tol(local[i][2],
+                    sin(elevations[i] * 3.14159265358979323846 / 180.), 1E-12);
+        }
+        double back[3][3];
+        turtle_ecef_frame_from_local(&frame, 3, local[0], back[0]);
+        for (i = 0; i < 9; i++)
+                ck_assert_double_eq_tol(back[0][i], directions[0][i], 1E-12);
+
         /* Check the boundary cases */
         turtle_ecef_from_geodetic(90, 0, altitude, position);
         turtle_ecef_to_geodetic(position, lla, lla + 1, lla + 2);
@@ -632,6 +990,15 @@ START_TEST (test_stack)
         turtle_stack_create(&stack, STACK_PATH, 3, NULL, NULL);
         ck_assert_int_eq(stack->tiles.size, 0);
 
+        /* Check the coverage */
+        ck_assert_int_eq(turtle_stack_covers_(stack, 45.5, 2.5), 1);
+        ck_assert_int_eq(turtle_stack_covers_(stack, 46.5, 3.5), 1);
+        ck_assert_int_eq(turtle_stack_covers_(stack, 44.5, 2.5), 0);
+        ck_assert_int_eq(turtle_stack_covers_(stack, 45.5, 1.5), 0);
+        ck_assert_int_eq(turtle_stack_covers_(stack, 47.5, 3.5), 0);
+        ck_assert_int_eq(turtle_stack_covers_(stack, 45.5, 4.5), 0);
+        ck_assert_int_eq(turtle_stack_covers_(stack, NAN, 2.5), 0);
+
         /* Check some elevation values */
         double z;
         turtle_stack_elevation(stack, 45.5, 3.5, &z, NULL);
@@ -694,6 +1061,172 @@ END_TEST
 static int nothing(void) { return 0; }
 
 
+START_TEST (test_stack_coverage)
+{
+        /* Create two tiles at negative latitudes and longitudes, on a
+         * diagonal
+         */
+        mkdir(STACK_PATH "/southwest", 0755);
+        int k;
+        for (k = 0; k < 2; k++) {
+                const int n = 11;
+                const double c0 = (k == 0) ? -1. : 0.;
+                struct turtle_map * map;
+                struct turtle_map_info info = { n, n, { c0, c0 + 1. },
+                        { c0, c0 + 1. }, { 0., 100. } };
+                turtle_map_create(&map, &info, NULL);
+                int i;
+                for (i = 0; i < n; i++) {
+                        int j;
+                        for (j = 0; j < n; j++)
+                                turtle_map_fill(map, i, j, 10. * (k + 1));
+                }
+                turtle_map_dump(map, (k == 0) ?
+                    STACK_PATH "/southwest/01S_001W.png" :
+                    STACK_PATH "/southwest/00N_000E.png");
+                turtle_map_destroy(&map);
+        }
+        struct turtle_stack * stack;
+        turtle_stack_create(
+            &stack, STACK_PATH "/southwest", 0, NULL, NULL);
+        ck_assert_double_eq(stack->latitude_0, -1.);
+        ck_assert_double_eq(stack->longitude_0, -1.);
+
+        /* Check the coverage of the grid */
+        ck_assert_int_eq(turtle_stack_covers_(stack, -0.5, -0.5), 1);
+        ck_assert_int_eq(turtle_stack_covers_(stack, 0.5, 0.5), 1);
+        ck_assert_int_eq(turtle_stack_covers_(stack, -0.5, 0.5), 0);
+        ck_assert_int_eq(turtle_stack_covers_(stack, 0.5, -0.5), 0);
+        ck_assert_int_eq(turtle_stack_index_(stack, -1E-09, -1E-09), 0);
+        ck_assert_int_eq(turtle_stack_index_(stack, 1E-09, 1E-09), 3);
+
+        /* Offsets slightly below the grid origin are not folded into the
+         * first tile
+         */
+        ck_assert_int_eq(turtle_stack_index_(stack, -1. - 1E-09, -0.5), -1);
+        ck_assert_int_eq(turtle_stack_index_(stack, -0.5, -1. - 1E-09), -1);
+        ck_assert_int_eq(turtle_stack_covers_(stack, -1. - 1E-09, -0.5), 0);
+        ck_assert_int_eq(turtle_stack_covers_(stack, -0.5, -1. - 1E-09), 0);
+
+        /* Check the elevation values, with and without data */
+        double z;
+        int inside;
+        turtle_stack_elevation(stack, -0.5, -0.5, &z, &inside);
+        ck_assert_int_eq(inside, 1);
+        ck_assert_double_eq_tol(z, 10., 1E-02);
+        turtle_stack_rwlock_enable(stack);
+        struct turtle_client * client;
+        turtle_client_create(&client, stack);
+        turtle_client_elevation(client, 0.5, 0.5, &z, &inside);
+        ck_assert_int_eq(inside, 1);
+        ck_assert_double_eq_tol(z, 20., 1E-02);
+        turtle_client_elevation(client, -0.5, 0.5, &z, &inside);
+        ck_assert_int_eq(inside, 0);
+        turtle_client_elevation(client, -1. - 1E-09, -0.5, &z, &inside);
+        ck_assert_int_eq(inside, 0);
+        turtle_client_destroy(&client);
+        ck_assert_int_eq(stack->tiles.size, 2);
+
+        turtle_stack_destroy(&stack);
+}
+END_TEST
+
+
+START_TEST (test_stack_batch)
+{
+        /* Create a 2x2 grid of tiles, mixing formats */
+        mkdir(STACK_PATH "/batch", 0755);
+        const char * paths[4] = { STACK_PATH "/batch/10N_020E.png",
+                STACK_PATH "/batch/10N_021E.tif",
+                STACK_PATH "/batch/11N_020E.tif",
+                STACK_PATH "/batch/11N_021E.png" };
+        int k;
+        for (k = 0; k < 4; k++) {
+                const int n = 11;
+                const double x0 = 20. + (k % 2), y0 = 10. + (k / 2);
+                struct turtle_map * map;
+                struct turtle_map_info info = { n, n, { x0, x0 + 1. },
+                        { y0, y0 + 1. }, { -32767., 32768. } };
+                turtle_map_create(&map, &info, NULL);
+                int i;
+                for (i = 0; i < n; i++) {
+                        int j;
+                        for (j = 0; j < n; j++)
+                                turtle_map_fill(map, i, j, 10. * (k + 1));
+                }
+                turtle_map_dump(map, paths[k]);
+                turtle_map_destroy(&map);
+        }
+
+        /* Add stray files, which must be skipped when scanning the stack */
+        FILE * stray = fopen(STACK_PATH "/batch/notes.zip", "wb");
+        fputs("PK not elevation data", stray);
+        fclose(stray);
+        stray = fopen(STACK_PATH "/batch/link.url", "w");
+        fputs("[InternetShortcut]\nURL=https://example.com\n", stray);
+        fclose(stray);
+
+        /* Load a partial batch, with a tile already in memory */
+        struct turtle_stack * stack;
+        ck_assert_int_eq(turtle_stack_create(&stack, STACK_PATH "/batch", 3,
+            NULL, NULL), TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(stack->latitude_n, 2);
+        ck_assert_int_eq(stack->longitude_n, 2);
+        double z;
+        int inside;
+        turtle_stack_elevation(stack, 10.5, 20.5, &z, &inside);
+        ck_assert_int_eq(stack->tiles.size, 1);
+        enum turtle_return rc = turtle_stack_load(stack);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(stack->tiles.size, 3);
+        rc = turtle_stack_load(stack);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(stack->tiles.size, 3);
+        turtle_stack_destroy(&stack);
+
+        /* Load a complete batch, with a tile already in memory */
+        turtle_stack_create(&stack, STACK_PATH "/batch", 0, NULL, NULL);
+        turtle_stack_elevation(stack, 11.5, 21.5, &z, &inside);
+        ck_assert_int_eq(stack->tiles.size, 1);
+        rc = turtle_stack_load(stack);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(stack->tiles.size, 4);
+        for (k = 0; k < 4; k++) {
+                turtle_stack_elevation(stack, 10.5 + (k / 2),
+                    20.5 + (k % 2), &z, &inside);
+                ck_assert_int_eq(inside, 1);
+                ck_assert_double_eq_tol(z, 10. * (k + 1), 1E-02);
+        }
+        ck_assert_int_eq(stack->tiles.size, 4);
+        turtle_stack_destroy(&stack);
+
+        /* Check that a failed tile does not discard the others */
+        turtle_error_handler_t * handler = turtle_error_handler_get();
+        turtle_error_handler_set(&catch_error);
+
+        turtle_stack_create(&stack, STACK_PATH "/batch", 0, NULL, NULL);
+        turtle_stack_elevation(stack, 10.5, 20.5, &z, &inside);
+        remove(paths[2]);
+        rc = turtle_stack_load(stack);
+        ck_assert_int_ne(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(stack->tiles.size, 3);
+
+        /* Pinning fails as a whole */
+        rc = turtle_stack_pin(stack, 10., 12., 20., 22.);
+        ck_assert_int_ne(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(stack->pinned_n, 0);
+        ck_assert_int_eq(stack->tiles.size, 3);
+        rc = turtle_stack_pin(stack, 10., 10.9, 20., 22.);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(stack->pinned_n, 2);
+        ck_assert_int_eq(stack->tiles.size, 3);
+
+        turtle_error_handler_set(handler);
+        turtle_stack_destroy(&stack);
+}
+END_TEST
+
+
 START_TEST (test_client)
 {
         /* Create a stack and its client */
@@ -727,9 +1260,37 @@ START_TEST (test_client)
 
         /* Check the clear function */
         turtle_client_clear(client);
+        ck_assert_int_eq(client->size, 0);
         turtle_client_elevation(client, 45.5, 3.5, &z, NULL);
         ck_assert_double_eq(z, 0);
 
+        /* Check the client's cache */
+        ck_assert_int_eq(turtle_client_cache_get(client), 1);
+        turtle_client_cache_set(client, 2);
+        ck_assert_int_eq(turtle_client_cache_get(client), 2);
+        ck_assert_int_eq(client->size, 1);
+        struct turtle_map * map0 = client->maps[0];
+        turtle_client_elevation(client, 45.5, 2.5, &z, NULL);
+        ck_assert_int_eq(client->size, 2);
+        struct turtle_map * map1 = client->maps[0];
+        ck_assert_ptr_eq(client->maps[1], map0);
+        ck_assert_int_eq(map0->clients, 1);
+        ck_assert_int_eq(map1->clients, 1);
+
+        turtle_client_elevation(client, 45.5, 3.5, &z, NULL);
+        ck_assert_ptr_eq(client->maps[0], map0);
+        ck_assert_ptr_eq(client->maps[1], map1);
+        turtle_client_elevation(client, 46.5, 3.5, &z, NULL);
+        ck_assert_int_eq(client->size, 2);
+        ck_assert_ptr_eq(client->maps[1], map0);
+        ck_assert_int_eq(map0->clients, 1);
+
+        /* The released map is evicted, since the stack overflows */
+        turtle_client_cache_set(client, 1);
+        ck_assert_int_eq(client->size, 1);
+        ck_assert_ptr_ne(client->maps[0], map0);
+        ck_assert_int_eq(stack->tiles.size, 1);
+
         /* Clean the memory */
         turtle_client_destroy(&client);
         turtle_stack_destroy(&stack);
@@ -759,10 +1320,12 @@ START_TEST (test_client)
 
         turtle_stack_create(&stack, STACK_PATH, 1, &nothing, &nothing);
         turtle_client_create(&client, stack);
+        rc = turtle_client_cache_set(client, 0);
+        ck_assert_int_eq(rc, TURTLE_RETURN_DOMAIN_ERROR);
         rc = turtle_client_elevation(client, 45.5, 4.5, &z, NULL);
         ck_assert_int_eq(rc, TURTLE_RETURN_PATH_ERROR);
         regcomp(&regex, "{ turtle_client_elevation \\[#[0-9]*\\], "
-            "src/turtle/stack.c:[0-9]* } missing elevation data in "
+            "src/turtle/client.c:[0-9]* } missing elevation data in "
             "`" STACK_PATH  "'", 0);
         ck_assert_int_eq(regexec(&regex, error_buffer, 0, NULL, 0), 0);
         regfree(&regex);
@@ -775,83 +1338,512 @@ START_TEST (test_client)
 END_TEST
 
 
-START_TEST (test_stepper)
+/* Context aware lock / unlock emulation, counting the accesses */
+struct lock_counter {
+        int lock[2];
+        int unlock[2];
+};
+
+static int count_lock(void * context, enum turtle_stack_access access)
 {
-        /* Create the stepper */
-        struct turtle_stack * stack;
-        turtle_stack_create(&stack, STACK_PATH, 0, NULL, NULL);
-        struct turtle_map * map;
-        turtle_map_load(&map, MAP_PATH);
-        struct turtle_map * geoid;
-        turtle_map_load(&geoid, GEOID_PATH);
-        struct turtle_stepper * stepper;
-        turtle_stepper_create(&stepper);
+        struct lock_counter * counter = context;
+        counter->lock[access]++;
+        return 0;
+}
 
-        /* Configure the stepper */
-        turtle_stepper_geoid_set(stepper, geoid);
-        turtle_stepper_add_flat(stepper, 10);
-        turtle_stepper_add_stack(stepper, stack, 0.);
-        turtle_stepper_add_map(stepper, map, 0.);
-        turtle_stepper_add_stack(stepper, stack, 0.);
-        turtle_stepper_add_map(stepper, map, 0.);
+static int count_unlock(void * context, enum turtle_stack_access access)
+{
+        struct lock_counter * counter = context;
+        counter->unlock[access]++;
+        return 0;
+}
 
-        ck_assert_int_eq(stepper->data.size, 3);
-        struct turtle_stepper_layer * current_layer = stepper->layers.tail;
-        ck_assert_int_eq(current_layer->meta.size, 5);
-        ck_assert_int_eq(stepper->transforms.size, 2);
 
-        int i;
-        for (i = 0; i < 2; i++) {
-                /* Set the approximation range */
-                if (i) turtle_stepper_range_set(stepper, 100);
+START_TEST (test_stack_lock)
+{
+        /* Create a stack with context aware locks */
+        struct turtle_stack * stack;
+        turtle_stack_create(&stack, STACK_PATH, 2, &nothing, &nothing);
+        struct lock_counter counter = { { 0, 0 }, { 0, 0 } };
+        turtle_stack_lock_set(stack, &count_lock, &count_unlock, &counter);
+        ck_assert_ptr_eq(stack->lock, NULL);
+        ck_assert_ptr_eq(stack->lock_context, &counter);
 
-                /* Get the initial position and direction in ECEF */
-                const double latitude = 45.5, longitude = 2.5;
-                const double azimuth = 0, elevation = 0;
-                const double height = -0.5, altitude_max = 1.5E+03;
-                double position[3], direction[3];
-                int layer;
-                turtle_stepper_position(
-                    stepper, latitude, longitude, height, 0, position, &layer);
-                turtle_ecef_from_horizontal(
-                    latitude, longitude, azimuth, elevation, direction);
+        struct turtle_client * client0, * client1;
+        turtle_client_create(&client0, stack);
+        turtle_client_create(&client1, stack);
 
-                /* Do some dummy stepping */
-                for (;;) {
-                        /* Update the step data */
-                        double altitude, ground_elevation, la, lo;
-                        turtle_stepper_step(stepper, position, NULL, &la, &lo,
-                            &altitude, &ground_elevation, NULL, &layer);
-                        if (altitude >= altitude_max) break;
+        /* A new map requires an exclusive access */
+        double z;
+        turtle_client_elevation(client0, 45.5, 2.5, &z, NULL);
+        ck_assert_double_eq(z, 0);
+        ck_assert_int_eq(counter.lock[TURTLE_STACK_ACCESS_SHARED], 1);
+        ck_assert_int_eq(counter.lock[TURTLE_STACK_ACCESS_EXCLUSIVE], 1);
+        ck_assert_int_eq(stack->tiles.size, 1);
 
-                        double altitude1, ground_elevation1, la1, lo1;
-                        double step_length;
-                        int layer1;
-                        turtle_stepper_step(stepper, position, NULL, &la1, &lo1,
-                            &altitude1, &ground_elevation1, &step_length,
-                            &layer1);
-                        ck_assert_double_eq(altitude1, altitude);
-                        ck_assert_double_eq(
-                            ground_elevation1, ground_elevation);
-                        ck_assert_double_eq(la1, la);
-                        ck_assert_double_eq(lo1, lo);
-                        ck_assert_double_eq(layer1, layer);
+        /* A loaded map only requires a shared access */
+        turtle_client_elevation(client1, 45.5, 2.5, &z, NULL);
+        ck_assert_double_eq(z, 0);
+        ck_assert_int_eq(counter.lock[TURTLE_STACK_ACCESS_SHARED], 2);
+        ck_assert_int_eq(counter.lock[TURTLE_STACK_ACCESS_EXCLUSIVE], 1);
+        struct turtle_map * map = stack->tiles.head;
+        ck_assert_int_eq(map->clients, 2);
+
+        turtle_client_elevation(client1, 46.5, 3.5, &z, NULL);
+        ck_assert_int_eq(counter.lock[TURTLE_STACK_ACCESS_SHARED], 3);
+        ck_assert_int_eq(counter.lock[TURTLE_STACK_ACCESS_EXCLUSIVE], 2);
+        ck_assert_int_eq(map->clients, 1);
+        ck_assert_int_eq(stack->tiles.size, 2);
 
-                        /* Update the position */
-                        turtle_stepper_step(stepper, position, direction, &la,
-                            &lo, &altitude, &ground_elevation, NULL, &layer);
-                        if (altitude >= altitude_max) break;
-                }
-        }
+        /* Releasing the maps only requires a shared access */
+        turtle_client_destroy(&client0);
+        turtle_client_destroy(&client1);
+        ck_assert_int_eq(counter.lock[TURTLE_STACK_ACCESS_SHARED], 5);
+        ck_assert_int_eq(counter.lock[TURTLE_STACK_ACCESS_EXCLUSIVE], 2);
+        ck_assert_int_eq(counter.lock[0], counter.unlock[0]);
+        ck_assert_int_eq(counter.lock[1], counter.unlock[1]);
+        ck_assert_int_eq(map->clients, 0);
+
+        /* Check the built-in reader / writer lock */
+        ck_assert_int_eq(
+            turtle_stack_rwlock_enable(stack), TURTLE_RETURN_SUCCESS);
+        ck_assert_ptr_ne(stack->rwlock, NULL);
+        ck_assert_ptr_eq(stack->lock_context, stack->rwlock);
+        turtle_client_create(&client0, stack);
+        turtle_client_elevation(client0, 45.5, 3.5, &z, NULL);
+        ck_assert_double_eq(z, 0);
+        turtle_client_elevation(client0, 45.5, 2.5, &z, NULL);
+        ck_assert_double_eq(z, 0);
+        turtle_client_destroy(&client0);
+        ck_assert_int_eq(turtle_stack_clear(stack), TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(stack->tiles.size, 0);
 
-        /* Check the case of an outside initial position */
-        turtle_stepper_destroy(&stepper);
-        turtle_stepper_create(&stepper);
-        turtle_stepper_add_map(stepper, map, 0);
+        /* Disable the locks */
+        turtle_stack_lock_set(stack, NULL, NULL, &counter);
+        ck_assert_ptr_eq(stack->rwlock, NULL);
+        ck_assert_ptr_eq(stack->lock_context, NULL);
 
-        double position[3] = { 1., 2., 3. };
-        int layer;
-        turtle_stepper_position(stepper, 45., 90., 0., 0, position, &layer);
+        /* Catch errors and try some false cases */
+        turtle_error_handler_t * handler = turtle_error_handler_get();
+        turtle_error_handler_set(&catch_error);
+
+        enum turtle_return rc = turtle_client_create(&client0, stack);
+        ck_assert_int_eq(rc, TURTLE_RETURN_BAD_ADDRESS);
+        rc = turtle_stack_lock_set(stack, &count_lock, NULL, NULL);
+        ck_assert_int_eq(rc, TURTLE_RETURN_BAD_ADDRESS);
+
+        /* Restore the error handler and clean the memory */
+        turtle_error_handler_set(handler);
+        turtle_stack_destroy(&stack);
+}
+END_TEST
+
+
+START_TEST (test_stack_pin)
+{
+        /* Create a stack with room for a single unpinned map */
+        struct turtle_stack * stack;
+        turtle_stack_create(&stack, STACK_PATH, 1, NULL, NULL);
+        turtle_stack_rwlock_enable(stack);
+
+        /* Pin all tiles */
+        enum turtle_return rc = turtle_stack_pin(stack, 45, 47, 2, 4);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(stack->tiles.size, 4);
+        ck_assert_int_eq(stack->pinned_n, 4);
+        int i;
+        for (i = 0; i < 4; i++) {
+                ck_assert_ptr_ne(stack->pinned[i], NULL);
+                ck_assert_int_eq(stack->pinned[i]->pinned, 1);
+        }
+
+        /* Pinned maps are neither evicted nor booked by clients */
+        double z;
+        turtle_stack_elevation(stack, 45.5, 2.5, &z, NULL);
+        ck_assert_double_eq(z, 0);
+        turtle_stack_clear(stack);
+        ck_assert_int_eq(stack->tiles.size, 4);
+
+        struct turtle_client * client;
+        turtle_client_create(&client, stack);
+        turtle_client_elevation(client, 46.5, 3.5, &z, NULL);
+        ck_assert_double_eq(z, 0);
+        ck_assert_int_eq(client->size, 0);
+        turtle_client_destroy(&client);
+
+        /* Pin a tile twice. Upper bounds on tile edges are excluded */
+        rc = turtle_stack_pin(stack, 45, 46, 2, 3);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(stack->pinned[0]->pinned, 2);
+        ck_assert_int_eq(stack->pinned[1]->pinned, 1);
+
+        /* Unpin the tiles */
+        rc = turtle_stack_unpin(stack, 45, 47, 2, 4);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(stack->pinned_n, 1);
+        ck_assert_ptr_ne(stack->pinned[0], NULL);
+        ck_assert_ptr_eq(stack->pinned[1], NULL);
+        ck_assert_int_eq(stack->tiles.size, 2);
+
+        rc = turtle_stack_unpin(stack, 45.5, 45.5, 2.5, 2.5);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(stack->pinned_n, 0);
+        ck_assert_ptr_eq(stack->pinned[0], NULL);
+        ck_assert_int_eq(stack->tiles.size, 1);
+
+        /* Boxes outside of the stack are ignored */
+        rc = turtle_stack_pin(stack, 10, 20, 2, 4);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(stack->pinned_n, 0);
+
+        /* Catch errors and try some false cases */
+        turtle_error_handler_t * handler = turtle_error_handler_get();
+        turtle_error_handler_set(&catch_error);
+
+        rc = turtle_stack_pin(stack, 46, 45, 2, 4);
+        ck_assert_int_eq(rc, TURTLE_RETURN_DOMAIN_ERROR);
+        rc = turtle_stack_unpin(stack, 45, 46, NAN, 4);
+        ck_assert_int_eq(rc, TURTLE_RETURN_DOMAIN_ERROR);
+
+        /* Restore the error handler and clean the memory */
+        turtle_error_handler_set(handler);
+        turtle_stack_destroy(&stack);
+}
+END_TEST
+
+
+START_TEST (test_stack_pack)
+{
+#define PACK_PATH "tests/stack.pack"
+
+        /* Pack the stack tiles */
+        struct turtle_stack * stack;
+        turtle_stack_create(&stack, STACK_PATH, 0, NULL, NULL);
+        ck_assert_ptr_eq(stack->pack, NULL);
+        enum turtle_return rc = turtle_stack_dump(stack, PACK_PATH, 0);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        struct turtle_error_context error = { TURTLE_RETURN_SUCCESS };
+        struct turtle_map * map0;
+        turtle_stack_tile_load_(stack, 3, &map0, &error);
+        turtle_stack_destroy(&stack);
+
+        /* Load the packed tiles */
+        rc = turtle_stack_create(&stack, PACK_PATH, 0, NULL, NULL);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_ptr_ne(stack->pack, NULL);
+        ck_assert_int_eq(stack->pack->size, 4);
+        ck_assert_int_eq(stack->latitude_n, 2);
+        ck_assert_int_eq(stack->longitude_n, 2);
+        ck_assert_int_eq(turtle_stack_covers_(stack, 46.5, 3.5), 1);
+        ck_assert_int_eq(turtle_stack_covers_(stack, 47.5, 3.5), 0);
+
+        struct turtle_map * map1;
+        turtle_stack_tile_load_(stack, 3, &map1, &error);
+        ck_assert_int_eq(map1->meta.nx, map0->meta.nx);
+        ck_assert_int_eq(map1->meta.ny, map0->meta.ny);
+        ck_assert_double_eq(map1->meta.x0, map0->meta.x0);
+        ck_assert_double_eq(map1->meta.y0, map0->meta.y0);
+        ck_assert_str_eq(map1->meta.encoding, map0->meta.encoding);
+        ck_assert_ptr_eq(map1->meta.get_z, map0->meta.get_z);
+        ck_assert_int_eq(memcmp(map1->data, map0->data,
+            map0->meta.nx * map0->meta.ny * sizeof(*map0->data)), 0);
+        turtle_map_destroy(&map1);
+
+        double z;
+        int inside;
+        turtle_stack_elevation(stack, 45.5, 2.5, &z, &inside);
+        ck_assert_int_eq(inside, 1);
+        ck_assert_double_eq(z, 0);
+        ck_assert_int_eq(stack->tiles.size, 1);
+        turtle_stack_load(stack);
+        ck_assert_int_eq(stack->tiles.size, 4);
+
+        /* Repack with compression */
+        rc = turtle_stack_dump(stack, PACK_PATH, 6);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        turtle_stack_destroy(&stack);
+        turtle_stack_create(&stack, PACK_PATH, 0, NULL, NULL);
+        ck_assert_int_eq(stack->pack->tiles[0].compressed, 1);
+        turtle_stack_tile_load_(stack, 3, &map1, &error);
+        ck_assert_int_eq(memcmp(map1->data, map0->data,
+            map0->meta.nx * map0->meta.ny * sizeof(*map0->data)), 0);
+        turtle_map_destroy(&map1);
+        turtle_map_destroy(&map0);
+
+        rc = turtle_stack_pin(stack, 45, 47, 2, 4);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(stack->pinned_n, 4);
+
+        /* Catch errors and try some false cases */
+        turtle_error_handler_t * handler = turtle_error_handler_get();
+        turtle_error_handler_set(&catch_error);
+
+        rc = turtle_stack_dump(stack, PACK_PATH, 10);
+        ck_assert_int_eq(rc, TURTLE_RETURN_DOMAIN_ERROR);
+        rc = turtle_stack_dump(stack, "tests/nowhere/stack.pack", 0);
+        ck_assert_int_eq(rc, TURTLE_RETURN_PATH_ERROR);
+        turtle_stack_destroy(&stack);
+
+        /* Craft a pack with an overflowing grid size */
+        FILE * fid = fopen(PACK_PATH, "rb");
+        fseek(fid, 0, SEEK_END);
+        const long size = ftell(fid);
+        rewind(fid);
+        char * content = malloc(size);
+        ck_assert_int_eq(fread(content, size, 1, fid), 1);
+        fclose(fid);
+        int32_t grid[2];
+        memcpy(grid, content + 48, sizeof(grid));
+        const int32_t overflow[2] = { 0x10001, 0x10000 };
+        memcpy(content + 48, overflow, sizeof(overflow));
+        fid = fopen("tests/crafted.pack", "wb");
+        ck_assert_int_eq(fwrite(content, size, 1, fid), 1);
+        fclose(fid);
+        rc = turtle_stack_create(&stack, "tests/crafted.pack", 0, NULL, NULL);
+        ck_assert_int_eq(rc, TURTLE_RETURN_BAD_FORMAT);
+
+        /* Craft a pack with an oversized compressed tile, i.e. the size of
+         * the first index entry
+         */
+        memcpy(content + 48, grid, sizeof(grid));
+        const uint64_t oversized = 1ULL << 40;
+        memcpy(content + 64 + 80, &oversized, sizeof(oversized));
+        fid = fopen("tests/crafted.pack", "wb");
+        ck_assert_int_eq(fwrite(content, size, 1, fid), 1);
+        fclose(fid);
+        free(content);
+        rc = turtle_stack_create(&stack, "tests/crafted.pack", 0, NULL, NULL);
+        ck_assert_int_eq(rc, TURTLE_RETURN_BAD_FORMAT);
+
+        /* Restore the error handler and clean the memory */
+        turtle_error_handler_set(handler);
+        turtle_stack_destroy(&stack);
+}
+END_TEST
+
+
+START_TEST (test_stack_spill)
+{
+        /* Create a stack with a second tier cache of a single tile */
+        struct turtle_stack * stack;
+        turtle_stack_create(&stack, STACK_PATH, 1, NULL, NULL);
+        enum turtle_return rc = turtle_stack_spill_set(stack, "tests", 1);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_ptr_ne(stack->spill, NULL);
+        char path[1024];
+        sprintf(path, "%s/1.tile", stack->spill->root);
+
+        /* Evicted tiles are spilled */
+        double z;
+        turtle_stack_elevation(stack, 45.5, 2.5, &z, NULL);
+        ck_assert_int_eq(stack->spill->size, 0);
+        turtle_stack_elevation(stack, 46.5, 2.5, &z, NULL);
+        ck_assert_int_eq(stack->spill->size, 1);
+        ck_assert_int_eq(stack->spill->entries[0].stored, 1);
+        turtle_stack_elevation(stack, 45.5, 3.5, &z, NULL);
+        ck_assert_int_eq(stack->spill->size, 1);
+        ck_assert_int_eq(stack->spill->entries[0].stored, 0);
+        ck_assert_int_eq(stack->spill->entries[2].stored, 1);
+
+        /* Spilled tiles are reloaded */
+        const unsigned long stamp = stack->spill->entries[2].stamp;
+        int inside;
+        turtle_stack_elevation(stack, 46.5, 2.5, &z, &inside);
+        ck_assert_int_eq(inside, 1);
+        ck_assert_double_eq(z, 0);
+        ck_assert_int_gt(stack->spill->entries[2].stamp, stamp);
+        ck_assert_int_eq(stack->tiles.size, 1);
+        ck_assert_ptr_ne(((struct turtle_map *)stack->tiles.head)->meta.get_z,
+            NULL);
+        ck_assert_int_eq(stack->spill->entries[1].stored, 1);
+        ck_assert_int_eq(stack->spill->entries[2].stored, 0);
+
+        /* Spilled tiles are removed with the stack */
+        FILE * fid = fopen(path, "rb");
+        ck_assert_ptr_ne(fid, NULL);
+        fclose(fid);
+        turtle_stack_destroy(&stack);
+        fid = fopen(path, "rb");
+        ck_assert_ptr_eq(fid, NULL);
+
+        /* Catch errors and try some false cases */
+        turtle_error_handler_t * handler = turtle_error_handler_get();
+        turtle_error_handler_set(&catch_error);
+
+        turtle_stack_create(&stack, STACK_PATH, 1, NULL, NULL);
+        rc = turtle_stack_spill_set(stack, "tests/nowhere", 1);
+        ck_assert_int_eq(rc, TURTLE_RETURN_PATH_ERROR);
+        ck_assert_ptr_eq(stack->spill, NULL);
+
+        /* Restore the error handler and clean the memory */
+        turtle_error_handler_set(handler);
+        turtle_stack_destroy(&stack);
+}
+END_TEST
+
+
+/* Procedural tiles with a checkerboard coverage, for testing providers */
+static int provider_lookup(
+    void * context, int ix, int iy, struct turtle_map_info * info)
+{
+        if ((ix + iy) % 2 != 0) return 0;
+        info->nx = info->ny = 11;
+        info->x[0] = 2. + ix;
+        info->x[1] = info->x[0] + 1.;
+        info->y[0] = 45. + iy;
+        info->y[1] = info->y[0] + 1.;
+        info->z[0] = 0.;
+        info->z[1] = 2000.;
+        return 1;
+}
+
+static enum turtle_return provider_fill(void * context, int ix, int iy,
+    const struct turtle_map_info * info, double * elevation)
+{
+        __sync_fetch_and_add((int *)context, 1);
+        int i;
+        for (i = 0; i < info->nx * info->ny; i++) {
+                const double x = info->x[0] + (i % info->nx) * 0.1;
+                const double y = info->y[0] + (i / info->nx) * 0.1;
+                elevation[i] = 100. * x + 10. * y;
+        }
+        return TURTLE_RETURN_SUCCESS;
+}
+
+START_TEST (test_stack_provider)
+{
+        /* Check the provider consistency */
+        turtle_error_handler_t * handler = turtle_error_handler_get();
+        turtle_error_handler_set(&catch_error);
+        int calls = 0;
+        struct turtle_stack_provider provider = { 45., 1., 2, 2., 1., 3,
+                &provider_lookup, NULL, &calls };
+        struct turtle_stack * stack;
+        enum turtle_return rc =
+            turtle_stack_create_provider(&stack, &provider, 2);
+        ck_assert_int_eq(rc, TURTLE_RETURN_BAD_ADDRESS);
+        ck_assert_ptr_eq(stack, NULL);
+        provider.fill = &provider_fill;
+        provider.latitude_delta = 0.;
+        rc = turtle_stack_create_provider(&stack, &provider, 2);
+        ck_assert_int_eq(rc, TURTLE_RETURN_DOMAIN_ERROR);
+        provider.latitude_delta = 1.;
+        turtle_error_handler_set(handler);
+
+        /* Create a stack over procedural tiles */
+        rc = turtle_stack_create_provider(&stack, &provider, 2);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(turtle_stack_covers_(stack, 45.5, 2.5), 1);
+        ck_assert_int_eq(turtle_stack_covers_(stack, 45.5, 3.5), 0);
+        ck_assert_int_eq(turtle_stack_covers_(stack, 46.5, 3.5), 1);
+        ck_assert_int_eq(calls, 0);
+
+        double z;
+        int inside;
+        turtle_stack_elevation(stack, 45.55, 2.35, &z, &inside);
+        ck_assert_int_eq(inside, 1);
+        ck_assert_double_eq_tol(z, 690.5, 1E-01);
+        ck_assert_int_eq(calls, 1);
+        turtle_stack_elevation(stack, 45.55, 3.35, &z, &inside);
+        ck_assert_int_eq(inside, 0);
+        ck_assert_int_eq(calls, 1);
+
+        /* Check the bulk loading, within the stack size */
+        turtle_stack_load(stack);
+        ck_assert_int_eq(stack->tiles.size, 2);
+        ck_assert_int_eq(calls, 2);
+
+        /* Provided tiles can be packed */
+        rc = turtle_stack_dump(stack, "tests/provider.pack", 0);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(calls, 5);
+        turtle_stack_destroy(&stack);
+        turtle_stack_create(&stack, "tests/provider.pack", 0, NULL, NULL);
+        turtle_stack_elevation(stack, 46.55, 3.35, &z, &inside);
+        ck_assert_int_eq(inside, 1);
+        ck_assert_double_eq_tol(z, 800.5, 1E-01);
+        turtle_stack_destroy(&stack);
+}
+END_TEST
+
+
+START_TEST (test_stepper)
+{
+        /* Create the stepper */
+        struct turtle_stack * stack;
+        turtle_stack_create(&stack, STACK_PATH, 0, NULL, NULL);
+        struct turtle_map * map;
+        turtle_map_load(&map, MAP_PATH);
+        struct turtle_map * geoid;
+        turtle_map_load(&geoid, GEOID_PATH);
+        struct turtle_stepper * stepper;
+        turtle_stepper_create(&stepper);
+
+        /* Configure the stepper */
+        turtle_stepper_geoid_set(stepper, geoid);
+        turtle_stepper_add_flat(stepper, 10);
+        turtle_stepper_add_stack(stepper, stack, 0.);
+        turtle_stepper_add_map(stepper, map, 0.);
+        turtle_stepper_add_stack(stepper, stack, 0.);
+        turtle_stepper_add_map(stepper, map, 0.);
+
+        ck_assert_int_eq(stepper->data.size, 3);
+        struct turtle_stepper_layer * current_layer = stepper->layers.tail;
+        ck_assert_int_eq(current_layer->meta.size, 5);
+        ck_assert_int_eq(stepper->transforms.size, 2);
+
+        int i;
+        for (i = 0; i < 2; i++) {
+                /* Set the approximation range */
+                if (i) turtle_stepper_range_set(stepper, 100);
+
+                /* Get the initial position and direction in ECEF */
+                const double latitude = 45.5, longitude = 2.5;
+                const double azimuth = 0, elevation = 0;
+                const double height = -0.5, altitude_max = 1.5E+03;
+                double position[3], direction[3];
+                int layer;
+                turtle_stepper_position(
+                    stepper, latitude, longitude, height, 0, position, &layer);
+                turtle_ecef_from_horizontal(
+                    latitude, longitude, azimuth, elevation, direction);
+
+                /* Do some dummy stepping */
+                for (;;) {
+                        /* Update the step data */
+                        double altitude, ground_elevation, la, lo;
+                        turtle_stepper_step(stepper, position, NULL, &la, &lo,
+                            &altitude, &ground_elevation, NULL, &layer);
+                        if (altitude >= altitude_max) break;
+
+                        double altitude1, ground_elevation1, la1, lo1;
+                        double step_length;
+                        int layer1;
+                        turtle_stepper_step(stepper, position, NULL, &la1, &lo1,
+                            &altitude1, &ground_elevation1, &step_length,
+                            &layer1);
+                        ck_assert_double_eq(altitude1, altitude);
+                        ck_assert_double_eq(
+                            ground_elevation1, ground_elevation);
+                        ck_assert_double_eq(la1, la);
+                        ck_assert_double_eq(lo1, lo);
+                        ck_assert_double_eq(layer1, layer);
+
+                        /* Update the position */
+                        turtle_stepper_step(stepper, position, direction, &la,
+                            &lo, &altitude, &ground_elevation, NULL, &layer);
+                        if (altitude >= altitude_max) break;
+                }
+        }
+
+        /* Check the case of an outside initial position */
+        turtle_stepper_destroy(&stepper);
+        turtle_stepper_create(&stepper);
+        turtle_stepper_add_map(stepper, map, 0);
+
+        double position[3] = { 1., 2., 3. };
+        int layer;
+        turtle_stepper_position(stepper, 45., 90., 0., 0, position, &layer);
         ck_assert_double_eq(position[0], 1.);
         ck_assert_double_eq(position[1], 2.);
         ck_assert_double_eq(position[2], 3.);
@@ -860,125 +1852,1011 @@ START_TEST (test_stepper)
         /* Check the case of a single data layer */
         turtle_stepper_destroy(&stepper);
         turtle_stepper_create(&stepper);
-        turtle_stepper_add_stack(stepper, stack, 0);
-
-        const double latitude = 45.5, longitude = 2.5, height = -0.5;
-        double direction[3];
-        turtle_stepper_position(
-            stepper, latitude, longitude, height, 0, position, &layer);
-        turtle_ecef_from_horizontal(
-            latitude, longitude, 0, 0, direction);
+        turtle_stepper_add_stack(stepper, stack, 0);
+
+        const double latitude = 45.5, longitude = 2.5, height = -0.5;
+        double direction[3];
+        turtle_stepper_position(
+            stepper, latitude, longitude, height, 0, position, &layer);
+        turtle_ecef_from_horizontal(
+            latitude, longitude, 0, 0, direction);
+
+        /* Step out of the map */
+        const int nmax = 100000;
+        for (i = 0; i < nmax; i++) {
+                double altitude, ground_elevation, la, lo;
+                double step_length;
+                int index[2];
+
+                turtle_stepper_step(stepper, position, direction, &la,
+                    &lo, &altitude, &ground_elevation, &step_length, index);
+                if (index[0] < 0) break;
+        }
+        ck_assert_int_lt(i, nmax);
+
+        /* Check other geometries */
+        turtle_stepper_destroy(&stepper);
+        turtle_stepper_create(&stepper);
+        turtle_stepper_geoid_set(stepper, geoid);
+        turtle_stepper_add_layer(stepper);
+        turtle_stepper_add_flat(stepper, 0);
+
+        ck_assert_ptr_eq(turtle_stepper_geoid_get(stepper), geoid);
+        ck_assert_double_eq(turtle_stepper_range_get(stepper), 1.);
+        turtle_stepper_range_set(stepper, 10.);
+        ck_assert_double_eq(turtle_stepper_range_get(stepper), 10.);
+        ck_assert_double_eq(turtle_stepper_slope_get(stepper), 0.4);
+        turtle_stepper_slope_set(stepper, 1.);
+        ck_assert_double_eq(turtle_stepper_slope_get(stepper), 1.);
+        ck_assert_double_eq(turtle_stepper_resolution_get(stepper), 1E-02);
+        turtle_stepper_resolution_set(stepper, 1E-03);
+        ck_assert_double_eq(turtle_stepper_resolution_get(stepper), 1E-03);
+
+        turtle_stepper_position(
+            stepper, latitude, longitude, height, 0, position, &layer);
+
+        double altitude, ground_elevation[2], la, lo;
+        int index[2];
+        turtle_stepper_step(stepper, position, NULL, &la, &lo, &altitude,
+            ground_elevation, NULL, index);
+        ck_assert_double_eq(ground_elevation[0], -DBL_MAX);
+        ck_assert_double_eq_tol(ground_elevation[1] + height, altitude, 1E-08);
+        ck_assert_int_eq(index[0], 0);
+        ck_assert_int_eq(index[1], 0);
+
+        turtle_stepper_destroy(&stepper);
+        turtle_stepper_create(&stepper);
+        turtle_stepper_add_stack(stepper, stack, 0.);
+        turtle_stepper_geoid_set(stepper, geoid);
+        turtle_stepper_step(stepper, position, NULL, &la, &lo, &altitude,
+            ground_elevation, NULL, index);
+        ck_assert_double_eq_tol(ground_elevation[1] + height, altitude, 1E-08);
+
+        turtle_ecef_from_horizontal(latitude, longitude, 0, 0, direction);
+        for (i = 0; i < 3; i++) position[i] += direction[i] * 1E+06;
+        turtle_stepper_step(stepper, position, NULL, &la, &lo, &altitude,
+            ground_elevation, NULL, index);
+        ck_assert_int_eq(index[0], -1);
+        ck_assert_int_eq(index[1], -1);
+
+        turtle_stepper_position(stepper, 80, 0, height, 0, position, &layer);
+        ck_assert_int_eq(layer, -1);
+
+        /* Check the client layer */
+        turtle_stepper_destroy(&stepper);
+        turtle_stack_destroy(&stack);
+        turtle_stack_create(&stack, STACK_PATH, 1, &nothing, &nothing);
+        turtle_stepper_create(&stepper);
+        turtle_stepper_add_stack(stepper, stack, 0.);
+        turtle_stepper_range_set(stepper, 100);
+
+        turtle_stepper_position(
+            stepper, latitude, longitude, height, 0, position, &layer);
+        turtle_stepper_step(stepper, position, NULL, &la, &lo, &altitude,
+            ground_elevation, NULL, index);
+        ck_assert_double_eq(ground_elevation[0], -DBL_MAX);
+        ck_assert_double_eq_tol(ground_elevation[1] + height, altitude, 1E-08);
+
+        double altitude1, ground_elevation1[2], la1, lo1;
+        int index1[2];
+        turtle_stepper_step(stepper, position, NULL, &la1, &lo1, &altitude1,
+            ground_elevation1, NULL, index1);
+        ck_assert_double_eq(altitude1, altitude);
+        ck_assert_double_eq(ground_elevation1[0], ground_elevation[0]);
+        ck_assert_double_eq(ground_elevation1[1], ground_elevation[1]);
+        ck_assert_double_eq(la1, la);
+        ck_assert_double_eq(lo1, lo);
+        ck_assert_int_eq(index1[0], index[0]);
+        ck_assert_int_eq(index1[1], index[1]);
+
+        for (i = 0; i < 3; i++) position[i] += direction[i] * 10;
+        turtle_stepper_step(stepper, position, NULL, &la, &lo, &altitude,
+            ground_elevation, NULL, index);
+        ck_assert_double_eq(ground_elevation[0], -DBL_MAX);
+        ck_assert_double_eq(ground_elevation[1], 0);
+        ck_assert_int_eq(index[0], 0);
+        ck_assert_int_eq(index[1], 0);
+
+        for (i = 0; i < 3; i++) position[i] += direction[i] * 100;
+        turtle_stepper_step(stepper, position, NULL, &la, &lo, &altitude,
+            ground_elevation, NULL, index);
+        ck_assert_double_eq(ground_elevation[0], -DBL_MAX);
+        ck_assert_double_eq(ground_elevation[1], 0);
+        ck_assert_int_eq(index[0], 0);
+        ck_assert_int_eq(index[1], 0);
+
+        /* Clean the memory */
+        turtle_stepper_destroy(&stepper);
+        turtle_map_destroy(&geoid);
+        turtle_map_destroy(&map);
+        turtle_stack_destroy(&stack);
+}
+
+
+/* Sample of a stepper, for comparing two configurations */
+struct stepper_sample {
+        double latitude;
+        double longitude;
+        double altitude;
+        double elevation[2];
+        int index[2];
+};
+
+/* Create a pair of identical steppers with a map, optionally over a stack,
+ * over a flat ground. The second one is then configured by the caller
+ */
+static void stepper_pair_create(struct turtle_stepper * steppers[2],
+    double ground, struct turtle_stack * stack, struct turtle_map * map)
+{
+        int i;
+        for (i = 0; i < 2; i++) {
+                turtle_stepper_create(steppers + i);
+                turtle_stepper_add_flat(steppers[i], ground);
+                if (stack != NULL)
+                        turtle_stepper_add_stack(steppers[i], stack, 0.);
+                turtle_stepper_add_map(steppers[i], map, 0.);
+        }
+}
+
+/* Sample both steppers of a pair, at their respective position */
+static void stepper_pair_sample(struct turtle_stepper * steppers[2],
+    double * position0, double * position1, struct stepper_sample sample[2])
+{
+        double * position[2] = { position0, position1 };
+        int i;
+        for (i = 0; i < 2; i++) {
+                struct stepper_sample * si = sample + i;
+                turtle_stepper_step(steppers[i], position[i], NULL,
+                    &si->latitude, &si->longitude, &si->altitude,
+                    si->elevation, NULL, si->index);
+        }
+}
+
+
+/* Test the footprint index of stepper layers */
+START_TEST (test_stepper_footprint)
+{
+        /* Create two steppers with a map over a stack over a flat ground,
+         * with and without footprint index
+         */
+        struct turtle_stack * stack;
+        turtle_stack_create(&stack, STACK_PATH, 0, NULL, NULL);
+        struct turtle_map * map;
+        turtle_map_load(&map, MAP_PATH);
+        struct turtle_stepper * steppers[2];
+        stepper_pair_create(steppers, -10., stack, map);
+        int i;
+        ck_assert_double_eq(turtle_stepper_footprint_get(steppers[1]), 0.);
+        turtle_stepper_footprint_set(steppers[1], 1E-02);
+        ck_assert_double_eq(turtle_stepper_footprint_get(steppers[1]), 1E-02);
+
+        /* Check that the samples are identical, over and around the map */
+        for (i = 0; i < 441; i++) {
+                double latitude = 45.71 + (i / 21) * 0.005;
+                double longitude = 2.90 + (i % 21) * 0.005;
+                if (i == 440) {
+                        /* Check a location without any map nor stack */
+                        latitude = 30.;
+                        longitude = 30.;
+                }
+                double position[3];
+                turtle_ecef_from_geodetic(latitude, longitude, 500., position);
+
+                struct stepper_sample sample[2];
+                stepper_pair_sample(steppers, position, position, sample);
+                ck_assert_double_eq_tol(
+                    sample[1].latitude, sample[0].latitude, 1E-09);
+                ck_assert_double_eq_tol(
+                    sample[1].longitude, sample[0].longitude, 1E-09);
+                ck_assert_double_eq_tol(
+                    sample[1].altitude, sample[0].altitude, 1E-06);
+                ck_assert_double_eq_tol(
+                    sample[1].elevation[0], sample[0].elevation[0], 1E-06);
+                ck_assert_double_eq_tol(
+                    sample[1].elevation[1], sample[0].elevation[1], 1E-06);
+                ck_assert_int_eq(sample[1].index[0], sample[0].index[0]);
+                ck_assert_int_eq(sample[1].index[1], sample[0].index[1]);
+
+                int layer[2], j;
+                for (j = 0; j < 2; j++) {
+                        turtle_stepper_position(steppers[j], latitude,
+                            longitude, 0., 0, position, layer + j);
+                }
+                ck_assert_int_eq(layer[1], layer[0]);
+        }
+
+        /* Check the index */
+        struct turtle_stepper_layer * layer = steppers[1]->layers.tail;
+        struct turtle_stepper_footprint * footprint = layer->footprint;
+        ck_assert_ptr_nonnull(footprint);
+        ck_assert_int_eq(footprint->outside, 2);
+        ck_assert_int_eq(footprint->latitude_n, 201);
+        ck_assert_int_eq(footprint->longitude_n, 201);
+
+        /* Check the bounding volumes of the data */
+        struct turtle_stepper_data * data;
+        for (data = steppers[0]->data.head; data != NULL;
+            data = data->element.next) {
+                if (data->a.map == NULL) {
+                        ck_assert_int_eq(data->bounded, 0);
+                } else {
+                        ck_assert_int_eq(data->bounded, 1);
+                        ck_assert_double_gt(data->cone[3], 0.);
+                }
+        }
+
+        /* Check that adding data resets the index */
+        turtle_stepper_add_flat(steppers[1], 0.);
+        ck_assert_ptr_null(layer->footprint);
+
+        /* Check the geodetic coordinates of a sample rejected by all data */
+        struct turtle_stepper * stepper;
+        turtle_stepper_create(&stepper);
+        turtle_stepper_add_map(stepper, map, 0.);
+        double position[3], latitude, longitude, altitude, elevation[2];
+        int index[2];
+        turtle_ecef_from_geodetic(-30., 150., 500., position);
+        turtle_stepper_step(stepper, position, NULL, &latitude, &longitude,
+            &altitude, elevation, NULL, index);
+        ck_assert_double_eq_tol(latitude, -30., 1E-09);
+        ck_assert_double_eq_tol(longitude, 150., 1E-09);
+        ck_assert_double_eq_tol(altitude, 500., 1E-06);
+        ck_assert_int_eq(index[0], -1);
+        turtle_stepper_destroy(&stepper);
+
+        /* Clean the memory */
+        for (i = 0; i < 2; i++) turtle_stepper_destroy(steppers + i);
+        turtle_map_destroy(&map);
+        turtle_stack_destroy(&stack);
+}
+END_TEST
+
+
+START_TEST (test_stepper_frame)
+{
+        /* Create an ECEF stepper and a stepper in the map local frame */
+        struct turtle_map * map;
+        turtle_map_load(&map, MAP_PATH);
+        struct turtle_stepper * steppers[2];
+        stepper_pair_create(steppers, 0., NULL, map);
+        int i;
+        ck_assert_ptr_null(turtle_stepper_frame_get(steppers[1]));
+        const struct turtle_projection * projection =
+            turtle_map_projection(map);
+        turtle_stepper_frame_set(steppers[1], projection, NULL);
+        ck_assert_str_eq(turtle_projection_name(
+            turtle_stepper_frame_get(steppers[1])), "UTM 31N");
+        struct turtle_stepper_data * data = steppers[1]->data.tail;
+        ck_assert_int_eq(data->native, 1);
+
+        /* Check that the samples are consistent, over and around the map */
+        for (i = 0; i < 121; i++) {
+                const double x = 494500. + (i / 11) * 300.;
+                const double y = 5065500. + (i % 11) * 300.;
+                double latitude, longitude;
+                turtle_projection_unproject(
+                    projection, x, y, &latitude, &longitude);
+
+                double position[2][3];
+                int j;
+                for (j = 0; j < 2; j++) {
+                        turtle_stepper_position(steppers[j], latitude,
+                            longitude, 10., 0, position[j], NULL);
+                }
+                ck_assert_double_eq_tol(position[1][0], x, 1E-03);
+                ck_assert_double_eq_tol(position[1][1], y, 1E-03);
+
+                struct stepper_sample sample[2];
+                stepper_pair_sample(
+                    steppers, position[0], position[1], sample);
+                ck_assert_double_eq_tol(sample[1].latitude, latitude, 1E-07);
+                ck_assert_double_eq_tol(
+                    sample[1].longitude, longitude, 1E-07);
+                ck_assert_double_eq_tol(
+                    sample[1].altitude, sample[0].altitude, 1E-06);
+                ck_assert_double_eq_tol(
+                    sample[1].elevation[1], sample[0].elevation[1], 1E-06);
+                ck_assert_int_eq(sample[1].index[0], sample[0].index[0]);
+                ck_assert_int_eq(sample[1].index[1], sample[0].index[1]);
+        }
+
+        /* Check a curved frame */
+        const double origin[2] = { 496000., 5067000. };
+        turtle_stepper_frame_set(steppers[1], projection, origin);
+        double position[3], altitude;
+        turtle_stepper_position(
+            steppers[1], 45.80, 2.95, 100., 0, position, NULL);
+        turtle_stepper_step(steppers[1], position, NULL, NULL, NULL,
+            &altitude, NULL, NULL, NULL);
+        ck_assert_double_eq_tol(altitude, 100., 1E-06);
+        ck_assert_double_lt(position[2], 100.);
+
+        /* Check a step through the ground */
+        position[0] = origin[0] + 0.5;
+        position[1] = origin[1] + 0.5;
+        position[2] = 2000.;
+        const double direction[3] = { 0., 0., -1. };
+        int index[2] = { 1, 0 };
+        while (index[0] == 1) {
+                turtle_stepper_step(steppers[1], position, direction, NULL,
+                    NULL, &altitude, NULL, NULL, index);
+        }
+        ck_assert_int_eq(index[0], 0);
+        double elevation;
+        turtle_map_elevation(map, position[0], position[1], &elevation, NULL);
+        ck_assert_double_eq_tol(altitude, elevation, 1E-06);
+
+        /* Check the errors */
+        turtle_error_handler_t * handler = turtle_error_handler_get();
+        turtle_error_handler_set(&catch_error);
+        struct turtle_projection * none;
+        turtle_projection_create(&none, NULL);
+        ck_assert_int_eq(turtle_stepper_frame_set(steppers[1], none, NULL),
+            TURTLE_RETURN_BAD_PROJECTION);
+        turtle_error_handler_set(handler);
+        turtle_projection_destroy(&none);
+
+        /* Check that the ECEF frame is restored */
+        turtle_stepper_frame_set(steppers[1], NULL, NULL);
+        ck_assert_ptr_null(turtle_stepper_frame_get(steppers[1]));
+        ck_assert_int_eq(data->native, 0);
+
+        /* Clean the memory */
+        for (i = 0; i < 2; i++) turtle_stepper_destroy(steppers + i);
+        turtle_map_destroy(&map);
+}
+END_TEST
+
+
+START_TEST (test_stepper_precision)
+{
+        /* Create a double and a single precision stepper */
+        struct turtle_map * map;
+        turtle_map_load(&map, MAP_PATH);
+        struct turtle_stepper * steppers[2];
+        stepper_pair_create(steppers, 0., NULL, map);
+        int i;
+        ck_assert_int_eq(turtle_stepper_precision_get(steppers[1]),
+            TURTLE_STEPPER_PRECISION_DOUBLE);
+        turtle_stepper_precision_set(
+            steppers[1], TURTLE_STEPPER_PRECISION_SINGLE);
+        ck_assert_int_eq(turtle_stepper_precision_get(steppers[1]),
+            TURTLE_STEPPER_PRECISION_SINGLE);
+
+        /* Check the accuracy bound along a path, using local transforms */
+        double position[3];
+        turtle_ecef_from_geodetic(45.75, 2.95, 500., position);
+        const double direction[3] = { 0.6, 0., -0.8 };
+        const double range = turtle_stepper_range_get(steppers[1]);
+        for (i = 0; i < 1000; i++) {
+                double r[3];
+                int j;
+                for (j = 0; j < 3; j++)
+                        r[j] = position[j] + 0.1 * i * direction[j];
+                struct stepper_sample sample[2];
+                stepper_pair_sample(steppers, r, r, sample);
+                ck_assert_double_eq_tol(
+                    sample[1].latitude, sample[0].latitude, 5E-12 * range);
+                ck_assert_double_eq_tol(
+                    sample[1].longitude, sample[0].longitude, 5E-12 * range);
+                ck_assert_double_eq_tol(
+                    sample[1].altitude, sample[0].altitude, 5E-07 * range);
+                ck_assert_int_eq(sample[1].index[0], sample[0].index[0]);
+                if (sample[0].index[0] == 0) {
+                        ck_assert_double_eq_tol(sample[1].elevation[1],
+                            sample[0].elevation[1], 5E-07 * 1000.);
+                }
+        }
+
+        /* Clean the memory */
+        for (i = 0; i < 2; i++) turtle_stepper_destroy(steppers + i);
+        turtle_map_destroy(&map);
+}
+END_TEST
+
+
+START_TEST (test_stepper_slope)
+{
+        /* Check the automatic steps over a flat ground */
+        struct turtle_stepper * stepper;
+        turtle_stepper_create(&stepper);
+        turtle_stepper_add_flat(stepper, 0.);
+        turtle_stepper_slope_set(stepper, 0.);
+        double position[3], step;
+        turtle_ecef_from_geodetic(45.75, 2.95, 1000., position);
+        turtle_stepper_step(stepper, position, NULL, NULL, NULL, NULL, NULL,
+            &step, NULL);
+        ck_assert_double_eq_tol(step, 1000., 1E-06);
+
+        /* Check the slope bounds of a map */
+        struct turtle_map * map;
+        turtle_map_load(&map, MAP_PATH);
+        ck_assert_ptr_null(map->slopes);
+        double slope, reach;
+        const double x0 = 496000., y0 = 5067000.;
+        ck_assert_int_eq(turtle_map_slope_(map, x0, y0, &slope, &reach),
+            EXIT_SUCCESS);
+        ck_assert_ptr_nonnull(map->slopes);
+        ck_assert_double_eq_tol(slope, 100. * sqrt(2.), 1E-04);
+        ck_assert_double_eq_tol(reach, 160., 1E-06);
+        ck_assert_int_eq(turtle_map_slope_(map, 0., 0., &slope, &reach),
+            EXIT_FAILURE);
+
+        /* Check the automatic steps over the map */
+        turtle_stepper_add_map(stepper, map, 0.);
+        struct turtle_projection * projection;
+        turtle_projection_create(&projection, "UTM 31N");
+        double latitude, longitude;
+        turtle_projection_unproject(
+            projection, x0, y0, &latitude, &longitude);
+        turtle_projection_destroy(&projection);
+        turtle_stepper_position(
+            stepper, latitude, longitude, 500., 0, position, NULL);
+        double altitude, elevation[2];
+        turtle_stepper_step(stepper, position, NULL, NULL, NULL, &altitude,
+            elevation, &step, NULL);
+        const double s = 1.01 * 100. * sqrt(2.);
+        ck_assert_double_eq_tol(
+            step, (altitude - elevation[0]) / sqrt(1. + s * s), 1E-03);
+
+        /* Check that modifying the map invalidates the bounds */
+        turtle_map_fill(map, 0, 0, 0.);
+        ck_assert_ptr_null(map->slopes);
+
+        /* Check that views share the bounds of their parent */
+        turtle_map_destroy(&map);
+        struct turtle_map_info info = { 11, 11, { 0., 100. }, { 0., 100. },
+                { 0., 1000. } };
+        turtle_map_create(&map, &info, "UTM 31N");
+        int i, j;
+        for (i = 0; i < info.ny; i++) {
+                for (j = 0; j < info.nx; j++)
+                        turtle_map_fill(map, j, i, 10. * j);
+        }
+        struct turtle_map * view;
+        turtle_map_view(map, 2, 2, 5, 5, &view);
+        ck_assert_int_eq(turtle_map_slope_(view, 40., 40., &slope, &reach),
+            EXIT_SUCCESS);
+        ck_assert_ptr_null(view->slopes);
+        ck_assert_ptr_nonnull(map->slopes);
+        ck_assert_double_ge(slope, 1.);
+
+        /* Check that filling the parent invalidates the bounds of a view */
+        for (i = 0; i < info.ny; i++) {
+                for (j = 0; j < info.nx; j++)
+                        turtle_map_fill(map, j, i, 50.);
+        }
+        turtle_map_slope_(view, 40., 40., &slope, &reach);
+        ck_assert_double_eq_tol(slope, 0., 1E-06);
+
+        /* Check that filling a view invalidates the bounds of its parent */
+        turtle_map_fill(view, 2, 2, 150.);
+        ck_assert_ptr_null(map->slopes);
+        turtle_map_slope_(map, 40., 40., &slope, &reach);
+        ck_assert_double_ge(slope, 1.);
+        turtle_map_destroy(&view);
+
+        /* Clean the memory */
+        turtle_stepper_destroy(&stepper);
+        turtle_map_destroy(&map);
+}
+END_TEST
+
+/* Monitor of the tracks, recording the number of calls and the last layer */
+struct run_monitor {
+        int calls[64];
+        int layer[64];
+        int changes;
+        int stop;
+};
+
+static int monitor_run(void * context, int track, int thread,
+    const double * position, double step_length, const int * index)
+{
+        struct run_monitor * monitor = context;
+        if (index[0] != monitor->layer[track])
+                __sync_fetch_and_add(&monitor->changes, 1);
+        monitor->layer[track] = index[0];
+        monitor->calls[track]++;
+        return (monitor->stop > 0) && (monitor->calls[track] >= monitor->stop);
+}
+
+START_TEST (test_stepper_run)
+{
+        /* Create a stepper with a map over a shared stack over a flat
+         * ground
+         */
+        struct turtle_stack * stack;
+        turtle_stack_create(&stack, STACK_PATH, 2, NULL, NULL);
+        turtle_stack_rwlock_enable(stack);
+        struct turtle_map * map;
+        turtle_map_load(&map, MAP_PATH);
+        struct turtle_stepper * stepper;
+        turtle_stepper_create(&stepper);
+        turtle_stepper_add_flat(stepper, -10.);
+        turtle_stepper_add_stack(stepper, stack, 0.);
+        turtle_stepper_add_layer(stepper);
+        turtle_stepper_add_map(stepper, map, 0.);
+
+        /* Generate some downward tracks, over and around the map */
+        struct turtle_stepper_track tracks[2][64];
+        int i;
+        for (i = 0; i < 64; i++) {
+                const double latitude = 45.70 + (i / 8) * 0.01;
+                const double longitude = 2.88 + (i % 8) * 0.01;
+                struct turtle_stepper_track * track = tracks[0] + i;
+                turtle_ecef_from_geodetic(
+                    latitude, longitude, 1500., track->position);
+                turtle_ecef_from_horizontal(latitude, longitude,
+                    i * 5.625, -10., track->direction);
+                track->length = 5000.;
+        }
+        memcpy(tracks[1], tracks[0], sizeof(tracks[0]));
+
+        /* Check that the results do not depend on the number of threads */
+        struct run_monitor monitor[2];
+        memset(monitor, 0x0, sizeof(monitor));
+        ck_assert_int_eq(turtle_stepper_run(stepper, 64, tracks[0], 1,
+            &monitor_run, monitor, 0), TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(turtle_stepper_run(stepper, 64, tracks[1], 4,
+            &monitor_run, monitor + 1, 0), TURTLE_RETURN_SUCCESS);
+        for (i = 0; i < 64; i++) {
+                const struct turtle_stepper_track * t0 = tracks[0] + i;
+                const struct turtle_stepper_track * t1 = tracks[1] + i;
+                int j;
+                for (j = 0; j < 3; j++) {
+                        ck_assert_double_eq_tol(
+                            t1->position[j], t0->position[j], 1E-06);
+                }
+                ck_assert_double_eq_tol(t1->length, t0->length, 1E-06);
+                ck_assert_int_eq(t1->index[0], t0->index[0]);
+                ck_assert_int_eq(t1->index[1], t0->index[1]);
+                ck_assert_int_eq(t1->steps, t0->steps);
+                ck_assert_int_gt(t0->steps, 0);
+                ck_assert_int_eq(monitor[0].calls[i], t0->steps);
+                ck_assert_int_eq(monitor[1].calls[i], t1->steps);
+        }
+
+        /* Check a track against manual steps */
+        double position[3], direction[3], length = 0.;
+        memcpy(direction, tracks[1][0].direction, sizeof(direction));
+        turtle_ecef_from_geodetic(45.70, 2.88, 1500., position);
+        turtle_stepper_range_set(stepper, turtle_stepper_range_get(stepper));
+        int index[2], steps = 0;
+        for (;;) {
+                double step;
+                turtle_stepper_step(stepper, position, direction, NULL, NULL,
+                    NULL, NULL, &step, index);
+                length += step;
+                steps++;
+                if ((index[0] < 0) || (length >= 5000.)) break;
+        }
+        ck_assert_int_eq(steps, tracks[0][0].steps);
+        if (length > 5000.) {
+                for (i = 0; i < 3; i++)
+                        position[i] -= direction[i] * (length - 5000.);
+                length = 5000.;
+        }
+        for (i = 0; i < 3; i++) {
+                ck_assert_double_eq_tol(
+                    position[i], tracks[0][0].position[i], 1E-06);
+        }
+        ck_assert_double_eq_tol(length, tracks[0][0].length, 1E-06);
+
+        /* Check the monitoring of crossings only */
+        memcpy(tracks[1], tracks[0], sizeof(tracks[0]));
+        for (i = 0; i < 64; i++) {
+                turtle_ecef_from_geodetic(45.70 + (i / 8) * 0.01,
+                    2.88 + (i % 8) * 0.01, 1500., tracks[1][i].position);
+                tracks[1][i].length = 5000.;
+        }
+        memset(monitor, 0x0, sizeof(monitor));
+        turtle_stepper_run(stepper, 64, tracks[1], 3, &monitor_run, monitor,
+            1);
+        int calls = 0;
+        for (i = 0; i < 64; i++) calls += monitor[0].calls[i];
+        ck_assert_int_eq(calls, monitor[0].changes);
+
+        /* Check the stopping of tracks by the monitor */
+        for (i = 0; i < 64; i++) {
+                turtle_ecef_from_geodetic(45.70 + (i / 8) * 0.01,
+                    2.88 + (i % 8) * 0.01, 1500., tracks[1][i].position);
+                tracks[1][i].length = 0.;
+        }
+        memset(monitor, 0x0, sizeof(monitor));
+        monitor[0].stop = 3;
+        turtle_stepper_run(stepper, 64, tracks[1], 4, &monitor_run, monitor,
+            0);
+        for (i = 0; i < 64; i++) ck_assert_int_eq(tracks[1][i].steps, 3);
+
+        /* Check the error handling */
+        turtle_error_handler_t * handler = turtle_error_handler_get();
+        turtle_error_handler_set(&catch_error);
+        ck_assert_int_eq(turtle_stepper_run(stepper, 1, NULL, 1, NULL, NULL,
+            0), TURTLE_RETURN_BAD_ADDRESS);
+        tracks[1][63].length = 0.;
+        ck_assert_int_eq(turtle_stepper_run(stepper, 64, tracks[1], 4, NULL,
+            NULL, 0), TURTLE_RETURN_DOMAIN_ERROR);
+        ck_assert_int_eq(tracks[1][0].steps, 3);
+        turtle_error_handler_set(handler);
+
+        /* Check that tracks starting outside of all data are unchanged */
+        struct turtle_stepper * outside;
+        turtle_stepper_create(&outside);
+        turtle_stepper_add_map(outside, map, 0.);
+        struct turtle_stepper_track track;
+        turtle_ecef_from_geodetic(-30., 150., 500., track.position);
+        memcpy(track.direction, tracks[0][0].direction,
+            sizeof(track.direction));
+        track.length = 1000.;
+        track.steps = 7;
+        ck_assert_int_eq(turtle_stepper_run(outside, 1, &track, 1, NULL, NULL,
+            0), TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(track.index[0], -1);
+        ck_assert_double_eq(track.length, 1000.);
+        ck_assert_int_eq(track.steps, 7);
+        turtle_stepper_destroy(&outside);
+
+        /* Clean the memory */
+        turtle_stepper_destroy(&stepper);
+        turtle_map_destroy(&map);
+        turtle_stack_destroy(&stack);
+}
+END_TEST
+
+START_TEST (test_stepper_cursor)
+{
+        /* Create a stepper shared by two cursors, and a reference stepper
+         * per track
+         */
+        struct turtle_map * map;
+        turtle_map_load(&map, MAP_PATH);
+        struct turtle_stepper * stepper, * steppers[2];
+        struct turtle_stepper_cursor * cursors[2];
+        turtle_stepper_create(&stepper);
+        turtle_stepper_add_flat(stepper, 0.);
+        turtle_stepper_add_map(stepper, map, 0.);
+        turtle_stepper_range_set(stepper, 1E+03);
+        int i, j;
+        for (j = 0; j < 2; j++) {
+                turtle_stepper_create(steppers + j);
+                turtle_stepper_add_flat(steppers[j], 0.);
+                turtle_stepper_add_map(steppers[j], map, 0.);
+                turtle_stepper_range_set(steppers[j], 1E+03);
+                ck_assert_int_eq(turtle_stepper_cursor_create(stepper,
+                    cursors + j), TURTLE_RETURN_SUCCESS);
+                ck_assert_ptr_eq(cursors[j]->stepper, stepper);
+                ck_assert_int_eq(cursors[j]->saved, 0);
+        }
 
-        /* Step out of the map */
-        const int nmax = 100000;
-        for (i = 0; i < nmax; i++) {
-                double altitude, ground_elevation, la, lo;
-                double step_length;
-                int index[2];
+        /* Check that interleaved tracks match separate steppers */
+        double position[2][2][3], direction[2][3];
+        const double latitude[2] = { 45.72, 45.78 };
+        const double longitude[2] = { 2.90, 2.98 };
+        for (j = 0; j < 2; j++) {
+                turtle_ecef_from_geodetic(
+                    latitude[j], longitude[j], 1500., position[j][0]);
+                memcpy(position[j][1], position[j][0],
+                    sizeof(position[j][0]));
+                turtle_ecef_from_horizontal(latitude[j], longitude[j],
+                    90. * j, -10., direction[j]);
+        }
+        for (i = 0; i < 20; i++) {
+                for (j = 0; j < 2; j++) {
+                        double altitude[2], step[2];
+                        int index[2][2];
+                        turtle_stepper_cursor_step(cursors[j],
+                            position[j][0], direction[j], NULL, NULL,
+                            altitude, NULL, step, index[0]);
+                        ck_assert_ptr_eq(stepper->cursor, cursors[j]);
+                        turtle_stepper_step(steppers[j], position[j][1],
+                            direction[j], NULL, NULL, altitude + 1, NULL,
+                            step + 1, index[1]);
+                        int k;
+                        for (k = 0; k < 3; k++) {
+                                ck_assert_double_eq(position[j][0][k],
+                                    position[j][1][k]);
+                        }
+                        ck_assert_double_eq(altitude[0], altitude[1]);
+                        ck_assert_double_eq(step[0], step[1]);
+                        ck_assert_int_eq(index[0][0], index[1][0]);
+                        ck_assert_int_eq(index[0][1], index[1][1]);
+                }
+        }
 
-                turtle_stepper_step(stepper, position, direction, &la,
-                    &lo, &altitude, &ground_elevation, &step_length, index);
-                if (index[0] < 0) break;
+        /* Check that the local frame of a track is kept when switching */
+        struct turtle_stepper_transform * transform = stepper->transforms.tail;
+        double reference[3];
+        memcpy(reference, transform->reference_ecef, sizeof(reference));
+        ck_assert(reference[0] != DBL_MAX);
+        turtle_stepper_cursor_step(cursors[0], position[0][0], NULL, NULL,
+            NULL, NULL, NULL, NULL, NULL);
+        ck_assert_int_eq(cursors[1]->saved, 1);
+        ck_assert(transform->reference_ecef[0] != reference[0]);
+        turtle_stepper_cursor_step(cursors[1], position[1][0], NULL, NULL,
+            NULL, NULL, NULL, NULL, NULL);
+        for (i = 0; i < 3; i++) {
+                ck_assert_double_eq(
+                    transform->reference_ecef[i], reference[i]);
         }
-        ck_assert_int_lt(i, nmax);
 
-        /* Check other geometries */
+        /* Check that stepping without cursor resumes from a fresh state */
+        turtle_stepper_step(stepper, position[1][0], NULL, NULL, NULL, NULL,
+            NULL, NULL, NULL);
+        ck_assert_ptr_null(stepper->cursor);
+        ck_assert(transform->reference_ecef[0] != reference[0]);
+
+        /* Check that saved states are discarded when the settings change */
+        const unsigned int generation = stepper->generation;
+        ck_assert_int_eq(cursors[1]->generation, generation);
+        turtle_stepper_range_set(stepper, 1E+03);
+        ck_assert_int_eq(stepper->generation, generation + 1);
+        turtle_stepper_cursor_step(cursors[1], position[1][0], NULL, NULL,
+            NULL, NULL, NULL, NULL, NULL);
+        ck_assert(transform->reference_ecef[0] != reference[0]);
+
+        /* Clean the memory */
+        for (j = 0; j < 2; j++) {
+                turtle_stepper_cursor_destroy(cursors + j);
+                ck_assert_ptr_null(cursors[j]);
+                turtle_stepper_destroy(steppers + j);
+        }
+        ck_assert_ptr_null(stepper->cursor);
         turtle_stepper_destroy(&stepper);
+        turtle_map_destroy(&map);
+}
+END_TEST
+
+START_TEST (test_stepper_tuning)
+{
+        /* Create a stepper with a tight range, and enable the tuning */
+        struct turtle_map * map;
+        turtle_map_load(&map, MAP_PATH);
+        struct turtle_stepper * stepper;
         turtle_stepper_create(&stepper);
-        turtle_stepper_geoid_set(stepper, geoid);
-        turtle_stepper_add_layer(stepper);
-        turtle_stepper_add_flat(stepper, 0);
+        turtle_stepper_add_flat(stepper, 0.);
+        turtle_stepper_add_map(stepper, map, 0.);
+        turtle_stepper_range_set(stepper, 1E-02);
+        turtle_stepper_slope_set(stepper, 2.);
 
-        ck_assert_ptr_eq(turtle_stepper_geoid_get(stepper), geoid);
-        ck_assert_double_eq(turtle_stepper_range_get(stepper), 1.);
-        turtle_stepper_range_set(stepper, 10.);
-        ck_assert_double_eq(turtle_stepper_range_get(stepper), 10.);
-        ck_assert_double_eq(turtle_stepper_slope_get(stepper), 0.4);
-        turtle_stepper_slope_set(stepper, 1.);
-        ck_assert_double_eq(turtle_stepper_slope_get(stepper), 1.);
+        struct turtle_stepper_tuning tuning = { 1E-03, 0.1, { 1E-01, 1E+03 },
+                { 0.1, 0.9 }, { 1E-03, 1E-01 } };
+        ck_assert_int_eq(turtle_stepper_tuning_set(stepper, &tuning),
+            TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(stepper->tuning.enabled, 1);
+        ck_assert_double_eq(turtle_stepper_range_get(stepper), 1E-01);
+        ck_assert_double_eq(turtle_stepper_slope_get(stepper), 0.9);
         ck_assert_double_eq(turtle_stepper_resolution_get(stepper), 1E-02);
-        turtle_stepper_resolution_set(stepper, 1E-03);
-        ck_assert_double_eq(turtle_stepper_resolution_get(stepper), 1E-03);
-
-        turtle_stepper_position(
-            stepper, latitude, longitude, height, 0, position, &layer);
 
-        double altitude, ground_elevation[2], la, lo;
+        /* Step some tracks down to the topography */
+        struct turtle_stepper_track tracks[4];
+        int i;
+        for (i = 0; i < 4; i++) {
+                const double latitude = 45.72 + 0.02 * (i % 2);
+                const double longitude = 2.90 + 0.02 * (i % 2);
+                turtle_ecef_from_geodetic(
+                    latitude, longitude, 1500., tracks[i].position);
+                turtle_ecef_from_horizontal(latitude, longitude,
+                    90. * (i % 2), -10., tracks[i].direction);
+                tracks[i].length = 2E+03;
+        }
+        double position[3], altitude;
+        memcpy(position, tracks[0].position, sizeof(position));
         int index[2];
-        turtle_stepper_step(stepper, position, NULL, &la, &lo, &altitude,
-            ground_elevation, NULL, index);
-        ck_assert_double_eq(ground_elevation[0], -DBL_MAX);
-        ck_assert_double_eq_tol(ground_elevation[1] + height, altitude, 1E-08);
-        ck_assert_int_eq(index[0], 0);
-        ck_assert_int_eq(index[1], 0);
+        turtle_stepper_step(stepper, position, NULL, NULL, NULL, NULL, NULL,
+            NULL, index);
+        const int medium = index[0];
+        for (i = 0; (i < 100000) && (index[0] == medium); i++) {
+                turtle_stepper_step(stepper, position, tracks[0].direction,
+                    NULL, NULL, &altitude, NULL, NULL, index);
+        }
+        ck_assert_int_ne(index[0], medium);
+
+        /* Check the chosen settings */
+        struct turtle_stepper_tuning_report report;
+        turtle_stepper_tuning_report(stepper, &report);
+        ck_assert_int_eq(report.steps, i);
+        ck_assert_int_gt(report.rebuilds, 0);
+        ck_assert_double_gt(report.range, 1.);
+        ck_assert_double_le(report.range, tuning.range[1]);
+        ck_assert_double_le(report.error, 1.01 * tuning.tolerance);
+        ck_assert_double_ge(report.slope, tuning.slope[0]);
+        ck_assert_double_le(report.slope, tuning.slope[1]);
+        ck_assert_double_ge(report.resolution, tuning.resolution[0]);
+        ck_assert_double_le(report.resolution, tuning.resolution[1]);
+        ck_assert_double_eq(report.range, turtle_stepper_range_get(stepper));
+
+        /* Check that the linearisation error is within the tolerance */
+        double latitude, longitude, altitude0;
+        turtle_stepper_step(stepper, position, NULL, &latitude, &longitude,
+            &altitude, NULL, NULL, NULL);
+        turtle_ecef_to_geodetic(position, &latitude, &longitude, &altitude0);
+        ck_assert_double_eq_tol(altitude, altitude0, tuning.tolerance);
+
+        /* Check that fresh cursors, and plain steps following a cursor,
+         * start from the initial tuning
+         */
+        struct turtle_stepper_cursor * cursor;
+        turtle_stepper_cursor_create(stepper, &cursor);
+        turtle_stepper_cursor_step(cursor, tracks[1].position, NULL, NULL,
+            NULL, NULL, NULL, NULL, NULL);
+        ck_assert_double_eq(turtle_stepper_range_get(stepper), 1E-01);
+        ck_assert_double_eq(turtle_stepper_slope_get(stepper), 0.9);
+        ck_assert_double_eq(turtle_stepper_resolution_get(stepper), 1E-02);
+        turtle_stepper_range_set(stepper, 0.5);
+        turtle_stepper_step(stepper, position, NULL, NULL, NULL, NULL, NULL,
+            NULL, NULL);
+        ck_assert_double_eq(turtle_stepper_range_get(stepper), 0.5);
+        turtle_stepper_cursor_destroy(&cursor);
+        turtle_stepper_range_set(stepper, 1E-01);
+        turtle_stepper_tuning_report(stepper, &report);
+
+        /* Check that tracks start from the initial tuning, and that the
+         * statistics of all threads are gathered
+         */
+        const long steps = report.steps;
+        ck_assert_int_eq(turtle_stepper_run(stepper, 4, tracks, 2, NULL, NULL,
+            0), TURTLE_RETURN_SUCCESS);
+        turtle_stepper_tuning_report(stepper, &report);
+        int total = 0;
+        for (i = 0; i < 4; i++) total += tracks[i].steps;
+        ck_assert_int_eq(report.steps, steps + total);
+        ck_assert_double_eq(report.range, 1E-01);
+        ck_assert_double_eq(report.slope, 0.9);
+        ck_assert_double_eq(report.resolution, 1E-02);
+        for (i = 0; i < 2; i++) {
+                ck_assert_int_eq(tracks[i].steps, tracks[i + 2].steps);
+                int j;
+                for (j = 0; j < 3; j++) {
+                        ck_assert_double_eq(tracks[i].position[j],
+                            tracks[i + 2].position[j]);
+                }
+        }
 
-        turtle_stepper_destroy(&stepper);
-        turtle_stepper_create(&stepper);
-        turtle_stepper_add_stack(stepper, stack, 0.);
-        turtle_stepper_geoid_set(stepper, geoid);
-        turtle_stepper_step(stepper, position, NULL, &la, &lo, &altitude,
-            ground_elevation, NULL, index);
-        ck_assert_double_eq_tol(ground_elevation[1] + height, altitude, 1E-08);
+        /* Disable the tuning. The last settings are kept */
+        ck_assert_int_eq(turtle_stepper_tuning_set(stepper, NULL),
+            TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(stepper->tuning.enabled, 0);
+        ck_assert_double_eq(turtle_stepper_range_get(stepper), report.range);
 
-        turtle_ecef_from_horizontal(latitude, longitude, 0, 0, direction);
-        for (i = 0; i < 3; i++) position[i] += direction[i] * 1E+06;
-        turtle_stepper_step(stepper, position, NULL, &la, &lo, &altitude,
-            ground_elevation, NULL, index);
-        ck_assert_int_eq(index[0], -1);
-        ck_assert_int_eq(index[1], -1);
+        /* Catch errors and try some false cases */
+        turtle_error_handler_t * handler = turtle_error_handler_get();
+        turtle_error_handler_set(&catch_error);
 
-        turtle_stepper_position(stepper, 80, 0, height, 0, position, &layer);
-        ck_assert_int_eq(layer, -1);
+        tuning.range[0] = 2E+03;
+        ck_assert_int_eq(turtle_stepper_tuning_set(stepper, &tuning),
+            TURTLE_RETURN_DOMAIN_ERROR);
+        tuning.range[0] = 1E-01;
+        tuning.tolerance = 0.;
+        ck_assert_int_eq(turtle_stepper_tuning_set(stepper, &tuning),
+            TURTLE_RETURN_DOMAIN_ERROR);
+        ck_assert_int_eq(stepper->tuning.enabled, 0);
 
-        /* Check the client layer */
+        /* Restore the error handler and clean the memory */
+        turtle_error_handler_set(handler);
         turtle_stepper_destroy(&stepper);
-        turtle_stack_destroy(&stack);
-        turtle_stack_create(&stack, STACK_PATH, 1, &nothing, &nothing);
-        turtle_stepper_create(&stepper);
-        turtle_stepper_add_stack(stepper, stack, 0.);
-        turtle_stepper_range_set(stepper, 100);
+        turtle_map_destroy(&map);
+}
+END_TEST
 
-        turtle_stepper_position(
-            stepper, latitude, longitude, height, 0, position, &layer);
-        turtle_stepper_step(stepper, position, NULL, &la, &lo, &altitude,
-            ground_elevation, NULL, index);
-        ck_assert_double_eq(ground_elevation[0], -DBL_MAX);
-        ck_assert_double_eq_tol(ground_elevation[1] + height, altitude, 1E-08);
 
-        double altitude1, ground_elevation1[2], la1, lo1;
-        int index1[2];
-        turtle_stepper_step(stepper, position, NULL, &la1, &lo1, &altitude1,
-            ground_elevation1, NULL, index1);
-        ck_assert_double_eq(altitude1, altitude);
-        ck_assert_double_eq(ground_elevation1[0], ground_elevation[0]);
-        ck_assert_double_eq(ground_elevation1[1], ground_elevation[1]);
-        ck_assert_double_eq(la1, la);
-        ck_assert_double_eq(lo1, lo);
-        ck_assert_int_eq(index1[0], index[0]);
-        ck_assert_int_eq(index1[1], index[1]);
+/* Read back a trace file */
+static char * trace_read(const char * path, long * size)
+{
+        FILE * fid = fopen(path, "rb");
+        if (fid == NULL) return NULL;
+        fseek(fid, 0, SEEK_END);
+        *size = ftell(fid);
+        rewind(fid);
+        char * buffer = malloc(*size + 1);
+        *size = fread(buffer, 1, *size, fid);
+        buffer[*size] = 0x0;
+        fclose(fid);
+        return buffer;
+}
 
-        for (i = 0; i < 3; i++) position[i] += direction[i] * 10;
-        turtle_stepper_step(stepper, position, NULL, &la, &lo, &altitude,
-            ground_elevation, NULL, index);
-        ck_assert_double_eq(ground_elevation[0], -DBL_MAX);
-        ck_assert_double_eq(ground_elevation[1], 0);
-        ck_assert_int_eq(index[0], 0);
-        ck_assert_int_eq(index[1], 0);
 
-        for (i = 0; i < 3; i++) position[i] += direction[i] * 100;
-        turtle_stepper_step(stepper, position, NULL, &la, &lo, &altitude,
-            ground_elevation, NULL, index);
-        ck_assert_double_eq(ground_elevation[0], -DBL_MAX);
-        ck_assert_double_eq(ground_elevation[1], 0);
-        ck_assert_int_eq(index[0], 0);
-        ck_assert_int_eq(index[1], 0);
+START_TEST (test_trace)
+{
+        /* Record tile loads and lock events of a locked stack */
+        ck_assert_int_eq(turtle_trace_start(256), TURTLE_RETURN_SUCCESS);
+        struct turtle_stack * stack;
+        turtle_stack_create(&stack, STACK_PATH, 1, NULL, NULL);
+        turtle_stack_rwlock_enable(stack);
+        struct turtle_client * client;
+        turtle_client_create(&client, stack);
+        double z;
+        turtle_client_elevation(client, 45.5, 2.5, &z, NULL);
+        turtle_client_elevation(client, 46.5, 2.5, &z, NULL);
+        turtle_client_destroy(&client);
+        turtle_stack_destroy(&stack);
 
-        /* Clean the memory */
+        /* Record local transforms and bisections of a stepper */
+        struct turtle_map * map;
+        turtle_map_load(&map, MAP_PATH);
+        struct turtle_stepper * stepper;
+        turtle_stepper_create(&stepper);
+        turtle_stepper_add_flat(stepper, 0.);
+        turtle_stepper_add_map(stepper, map, 0.);
+        turtle_stepper_range_set(stepper, 1E+03);
+        double position[3], direction[3];
+        turtle_ecef_from_geodetic(45.72, 2.90, 1500., position);
+        turtle_ecef_from_horizontal(45.72, 2.90, 0., -90., direction);
+        int i, index[2];
+        turtle_stepper_step(stepper, position, NULL, NULL, NULL, NULL, NULL,
+            NULL, index);
+        const int medium = index[0];
+        for (i = 0; (i < 100) && (index[0] == medium); i++) {
+                turtle_stepper_step(stepper, position, direction, NULL, NULL,
+                    NULL, NULL, NULL, index);
+        }
+        ck_assert_int_ne(index[0], medium);
         turtle_stepper_destroy(&stepper);
-        turtle_map_destroy(&geoid);
         turtle_map_destroy(&map);
-        turtle_stack_destroy(&stack);
+
+        /* Check the exported traces */
+        turtle_trace_stop();
+        ck_assert_int_eq(turtle_trace_enabled_, 0);
+        ck_assert_int_eq(
+            turtle_trace_dump("tests/trace.json"), TURTLE_RETURN_SUCCESS);
+        long size;
+        char * trace = trace_read("tests/trace.json", &size);
+        ck_assert_ptr_ne(trace, NULL);
+        ck_assert_ptr_ne(strstr(trace, "\"traceEvents\""), NULL);
+        ck_assert_ptr_ne(strstr(trace, "\"tile_load\""), NULL);
+        ck_assert_ptr_ne(strstr(trace, "\"tile_evict\""), NULL);
+        ck_assert_ptr_ne(strstr(trace, "\"lock_wait\""), NULL);
+        ck_assert_ptr_ne(strstr(trace, "\"lock_hold\""), NULL);
+        ck_assert_ptr_ne(strstr(trace, "\"transform\""), NULL);
+        ck_assert_ptr_ne(strstr(trace, "\"bisection\""), NULL);
+        ck_assert_ptr_ne(strstr(trace, "46N_002E.png"), NULL);
+        free(trace);
+
+        ck_assert_int_eq(
+            turtle_trace_dump("tests/trace.raw"), TURTLE_RETURN_SUCCESS);
+        trace = trace_read("tests/trace.raw", &size);
+        ck_assert_int_gt(size, 15);
+        ck_assert_str_eq(trace, "TURTLE-TRACE-1");
+        free(trace);
+
+        /* Check that only the last events are kept */
+        ck_assert_int_eq(turtle_trace_start(2), TURTLE_RETURN_SUCCESS);
+        for (i = 0; i < 5; i++) {
+                char label[8];
+                sprintf(label, "event%d", i);
+                turtle_trace_(TURTLE_TRACE_TILE_LOAD, TURTLE_TRACE_INSTANT,
+                    label);
+        }
+        turtle_trace_dump("tests/trace.json");
+        trace = trace_read("tests/trace.json", &size);
+        ck_assert_ptr_eq(strstr(trace, "event2"), NULL);
+        ck_assert_ptr_ne(strstr(trace, "event3"), NULL);
+        ck_assert_ptr_ne(strstr(trace, "event4"), NULL);
+        free(trace);
+
+        /* Check that nothing is recorded once disabled */
+        ck_assert_int_eq(turtle_trace_start(0), TURTLE_RETURN_SUCCESS);
+        turtle_trace_(TURTLE_TRACE_TILE_LOAD, TURTLE_TRACE_INSTANT, "event");
+        turtle_trace_dump("tests/trace.json");
+        trace = trace_read("tests/trace.json", &size);
+        ck_assert_ptr_eq(strstr(trace, "tile_load"), NULL);
+        free(trace);
+
+        /* Catch errors and try some false cases */
+        turtle_error_handler_t * handler = turtle_error_handler_get();
+        turtle_error_handler_set(&catch_error);
+
+        ck_assert_int_eq(
+            turtle_trace_start(-1), TURTLE_RETURN_DOMAIN_ERROR);
+        ck_assert_int_eq(turtle_trace_dump("tests/nowhere/trace.json"),
+            TURTLE_RETURN_PATH_ERROR);
+
+        /* Restore the error handler and remove the trace files */
+        turtle_error_handler_set(handler);
+        remove("tests/trace.json");
+        remove("tests/trace.raw");
 }
+END_TEST
 
 
 #ifndef TURTLE_NO_GRD
@@ -1045,6 +2923,15 @@ END_TEST
 #endif
 
 
+/* Encode an integer in little endian, e.g. for zip or TIFF records */
+static unsigned char * zip_put(unsigned char * p, unsigned long v, int n)
+{
+        int i;
+        for (i = 0; i < n; i++, v >>= 8) *p++ = v & 0xFF;
+        return p;
+}
+
+
 #ifndef TURTLE_NO_HGT
 START_TEST (test_io_hgt)
 {
@@ -1077,6 +2964,59 @@ START_TEST (test_io_hgt)
                 }
         }
 
+        /* Zip the map, using raw deflate data */
+        const unsigned long size = 3601 * 3601 * sizeof(*map->data);
+        struct turtle_error_context error = { TURTLE_RETURN_SUCCESS };
+        void * deflated;
+        unsigned long deflated_size;
+        turtle_compress_(map->data, size, 6, &deflated, &deflated_size, &error);
+        ck_assert_int_eq(error.code, TURTLE_RETURN_SUCCESS);
+        deflated_size -= 6; /* Strip the zlib header and trailer */
+
+        const char * name = "N45E003.SRTMGL1.hgt";
+        const int n_name = strlen(name);
+        unsigned char header[46], * p;
+        fid = fopen("tests/N45E003.SRTMGL1.hgt.zip", "wb+");
+        memset(header, 0x0, sizeof(header));
+        p = zip_put(header, 0x04034b50, 4);
+        p = zip_put(p + 4, 8, 2);
+        p = zip_put(p + 8, deflated_size, 4);
+        p = zip_put(p, size, 4);
+        zip_put(p, n_name, 2);
+        fwrite(header, 1, 30, fid);
+        fwrite(name, 1, n_name, fid);
+        fwrite((char *)deflated + 2, 1, deflated_size, fid);
+        free(deflated);
+
+        const long directory = ftell(fid);
+        memset(header, 0x0, sizeof(header));
+        p = zip_put(header, 0x02014b50, 4);
+        p = zip_put(p + 6, 8, 2);
+        p = zip_put(p + 8, deflated_size, 4);
+        p = zip_put(p, size, 4);
+        zip_put(p, n_name, 2);
+        fwrite(header, 1, 46, fid);
+        fwrite(name, 1, n_name, fid);
+
+        const long end = ftell(fid);
+        memset(header, 0x0, sizeof(header));
+        p = zip_put(header, 0x06054b50, 4);
+        p = zip_put(p + 4, 1, 2);
+        p = zip_put(p, 1, 2);
+        p = zip_put(p, end - directory, 4);
+        zip_put(p, directory, 4);
+        fwrite(header, 1, 22, fid);
+        fclose(fid);
+
+        /* Read back the zipped map */
+        struct turtle_map * zipped;
+        enum turtle_return rc =
+            turtle_map_load(&zipped, "tests/N45E003.SRTMGL1.hgt.zip");
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(zipped->meta.nx, 3601);
+        ck_assert_int_eq(memcmp(zipped->data, map->data, size), 0);
+        turtle_map_destroy(&zipped);
+
         /* Check the writing to an HGT map */
         turtle_map_fill(map, 0, 0, 10);
         double z;
@@ -1144,6 +3084,266 @@ END_TEST
 #endif
 
 
+#ifndef TURTLE_NO_TIFF
+/* Write a tiled GeoTIFF, as a Cloud Optimised GeoTIFF. The elevation values
+ * are set to the row major index of nodes, from the top left corner
+ */
+static void write_tiled_tiff(const char * path, int nx, int ny, int tile,
+    double x0, double y0, double d)
+{
+        const int mx = (nx + tile - 1) / tile, my = (ny + tile - 1) / tile;
+        const long size = tile * tile * sizeof(int16_t);
+        const long offsets = 8 + 2 + 13 * 12 + 4;
+        const long counts = offsets + 4 * mx * my;
+        const long scale = counts + 4 * mx * my;
+        const long tiepoints = scale + 3 * sizeof(double);
+        const long data = tiepoints + 6 * sizeof(double);
+        const unsigned long entries[13][4] = { { 256, 3, 1, nx },
+                { 257, 3, 1, ny }, { 258, 3, 1, 16 }, { 259, 3, 1, 1 },
+                { 262, 3, 1, 1 }, { 277, 3, 1, 1 }, { 284, 3, 1, 1 },
+                { 322, 3, 1, tile }, { 323, 3, 1, tile },
+                { 324, 4, mx * my, offsets }, { 325, 4, mx * my, counts },
+                { 33550, 12, 3, scale }, { 33922, 12, 6, tiepoints } };
+
+        /* Header and image file directory */
+        FILE * fid = fopen(path, "wb");
+        unsigned char buffer[12], * p;
+        p = zip_put(buffer, 0x002A4949, 4);
+        zip_put(p, 8, 4);
+        fwrite(buffer, 1, 8, fid);
+        zip_put(buffer, 13, 2);
+        fwrite(buffer, 1, 2, fid);
+        int i;
+        for (i = 0; i < 13; i++) {
+                p = zip_put(buffer, entries[i][0], 2);
+                p = zip_put(p, entries[i][1], 2);
+                p = zip_put(p, entries[i][2], 4);
+                zip_put(p, entries[i][3], 4);
+                fwrite(buffer, 1, 12, fid);
+        }
+        zip_put(buffer, 0, 4);
+        fwrite(buffer, 1, 4, fid);
+
+        /* Tiles index and geo data */
+        for (i = 0; i < mx * my; i++) {
+                zip_put(buffer, data + i * size, 4);
+                fwrite(buffer, 1, 4, fid);
+        }
+        for (i = 0; i < mx * my; i++) {
+                zip_put(buffer, size, 4);
+                fwrite(buffer, 1, 4, fid);
+        }
+        const double geo[9] = { d, d, 0., 0., 0., 0., x0, y0, 0. };
+        fwrite(geo, sizeof(*geo), 9, fid);
+
+        /* Tiles data */
+        int tx, ty;
+        for (ty = 0; ty < my; ty++) {
+                for (tx = 0; tx < mx; tx++) {
+                        int k;
+                        for (k = 0; k < tile * tile; k++) {
+                                const int r = ty * tile + k / tile;
+                                const int c = tx * tile + k % tile;
+                                const int v =
+                                    ((r < ny) && (c < nx)) ? r * nx + c : 0;
+                                zip_put(buffer, v, 2);
+                                fwrite(buffer, 1, 2, fid);
+                        }
+                }
+        }
+        fclose(fid);
+}
+
+/* Serve local files over HTTP, supporting range requests */
+static void serve_files(int server)
+{
+        signal(SIGPIPE, SIG_IGN);
+        alarm(60); /* Do not outlive the test */
+        for (;;) {
+                const int fd = accept(server, NULL, NULL);
+                if (fd < 0) continue;
+
+                char request[4096], path[1024];
+                int n = 0;
+                while (n < sizeof(request) - 1) {
+                        const ssize_t m =
+                            recv(fd, request + n, sizeof(request) - 1 - n, 0);
+                        if (m <= 0) break;
+                        n += m;
+                        request[n] = 0x0;
+                        if (strstr(request, "\r\n\r\n") != NULL) break;
+                }
+                request[n] = 0x0;
+
+                FILE * stream = NULL;
+                if (sscanf(request, "GET /%1023s", path) == 1)
+                        stream = fopen(path, "rb");
+                if (stream == NULL) {
+                        const char * s =
+                            "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+                        send(fd, s, strlen(s), 0);
+                        close(fd);
+                        continue;
+                }
+
+                fseek(stream, 0, SEEK_END);
+                const unsigned long size = ftell(stream);
+                unsigned long first = 0, last = size - 1;
+                const char * range = strstr(request, "Range: bytes=");
+                if (range != NULL) {
+                        sscanf(range + 13, "%lu-%lu", &first, &last);
+                        if (last >= size) last = size - 1;
+                        n = sprintf(request,
+                            "HTTP/1.1 206 Partial Content\r\n"
+                            "Content-Range: bytes %lu-%lu/%lu\r\n"
+                            "Content-Length: %lu\r\n\r\n",
+                            first, last, size, last - first + 1);
+                } else {
+                        n = sprintf(request,
+                            "HTTP/1.1 200 OK\r\nContent-Length: %lu\r\n\r\n",
+                            size);
+                }
+                send(fd, request, n, 0);
+
+                fseek(stream, first, SEEK_SET);
+                unsigned long remaining = last - first + 1;
+                while (remaining > 0) {
+                        const size_t m = fread(request, 1,
+                            (remaining < sizeof(request)) ? remaining :
+                                                            sizeof(request),
+                            stream);
+                        if ((m == 0) || (send(fd, request, m, 0) != m)) break;
+                        remaining -= m;
+                }
+                fclose(stream);
+                close(fd);
+        }
+}
+
+START_TEST (test_io_remote)
+{
+        /* Generate a tiled GeoTIFF and read it back locally */
+        const int nx = 40, ny = 40;
+        write_tiled_tiff("tests/cog.tif", nx, ny, 16, 3., 45.975, 0.025);
+        struct turtle_map * map;
+        enum turtle_return rc = turtle_map_load(&map, "tests/cog.tif");
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        struct turtle_map_info info;
+        turtle_map_meta(map, &info, NULL);
+        ck_assert_int_eq(info.nx, nx);
+        ck_assert_int_eq(info.ny, ny);
+        ck_assert_double_eq_tol(info.y[0], 45., 1E-09);
+        int i;
+        for (i = 0; i < nx * ny; i++) {
+                double z;
+                turtle_map_node(map, i % nx, ny - 1 - i / nx, NULL, NULL, &z);
+                ck_assert_double_eq(z, i);
+        }
+
+        /* Serve the map from a local HTTP server */
+        const int server = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in address;
+        memset(&address, 0x0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ck_assert_int_eq(
+            bind(server, (struct sockaddr *)&address, sizeof(address)), 0);
+        ck_assert_int_eq(listen(server, 16), 0);
+        socklen_t length = sizeof(address);
+        getsockname(server, (struct sockaddr *)&address, &length);
+        const pid_t pid = fork();
+        if (pid == 0) {
+                serve_files(server);
+                _exit(0);
+        }
+        close(server);
+
+        /* Load the remote map, caching the fetched data */
+        char url[128];
+        const size_t size = nx * ny * sizeof(*map->data);
+        sprintf(url, "http://127.0.0.1:%d/tests/cog.tif",
+            ntohs(address.sin_port));
+        mkdir("tests/topography/cache", 0755);
+        turtle_remote_cache_set("tests/topography/cache");
+        struct turtle_map * remote;
+        rc = turtle_map_load(&remote, url);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(memcmp(remote->data, map->data, size), 0);
+        turtle_map_destroy(&remote);
+
+        /* Load the remote map with a stack, using a .url file */
+        mkdir("tests/topography/remote", 0755);
+        FILE * fid = fopen("tests/topography/remote/cog.url", "w");
+        fprintf(fid, "%s\n", url);
+        fclose(fid);
+        struct turtle_stack * stack;
+        rc = turtle_stack_create(
+            &stack, "tests/topography/remote", 0, NULL, NULL);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        double z0, z1;
+        int inside;
+        turtle_map_elevation(map, 3.52, 45.37, &z0, NULL);
+        turtle_stack_elevation(stack, 45.37, 3.52, &z1, &inside);
+        ck_assert_int_eq(inside, 1);
+        ck_assert_double_eq(z1, z0);
+        turtle_stack_destroy(&stack);
+
+        /* Load the remote map with a stack over its internal tiles. Stack
+         * tiles span 13 nodes intervals, i.e. the closest divisor of 39 to
+         * the internal tiles size
+         */
+        rc = turtle_stack_create(&stack, url, 0, NULL, NULL);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(stack->longitude_n, 3);
+        ck_assert_int_eq(stack->latitude_n, 3);
+        turtle_stack_elevation(stack, 45.37, 3.52, &z1, &inside);
+        ck_assert_int_eq(inside, 1);
+        ck_assert_double_eq_tol(z1, z0, 1E-09);
+        ck_assert_int_eq(stack->tiles.size, 1);
+        const struct turtle_map * tile = stack->tiles.head;
+        ck_assert_int_eq(tile->meta.nx, 14);
+        ck_assert_int_eq(tile->meta.ny, 14);
+        rc = turtle_stack_load(stack);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(stack->tiles.size, 9);
+        const double d = (info.x[1] - info.x[0]) / (nx - 1);
+        for (tile = stack->tiles.head; tile != NULL;
+             tile = tile->element.next) {
+                const int ix0 = (int)lround((tile->meta.x0 - info.x[0]) / d);
+                const int iy0 = (int)lround((tile->meta.y0 - info.y[0]) / d);
+                int j;
+                for (j = 0; j < 14 * 14; j++) {
+                        turtle_map_node(tile, j % 14, j / 14, NULL, NULL, &z1);
+                        turtle_map_node(map, ix0 + j % 14, iy0 + j / 14, NULL,
+                            NULL, &z0);
+                        ck_assert_double_eq(z1, z0);
+                }
+        }
+        turtle_stack_destroy(&stack);
+
+        /* Stop the server. The remote map is then read from the cache */
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        rc = turtle_map_load(&remote, url);
+        ck_assert_int_eq(rc, TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(memcmp(remote->data, map->data, size), 0);
+        turtle_map_destroy(&remote);
+
+        /* Without any cache, the remote map is missing */
+        turtle_error_handler_t * handler = turtle_error_handler_get();
+        turtle_error_handler_set(&catch_error);
+        turtle_remote_cache_set(NULL);
+        rc = turtle_map_load(&remote, url);
+        ck_assert_int_eq(rc, TURTLE_RETURN_PATH_ERROR);
+        turtle_error_handler_set(handler);
+
+        /* Clean the memory */
+        turtle_map_destroy(&map);
+}
+END_TEST
+#endif
+
+
 #ifndef TURTLE_NO_ASC
 START_TEST (test_io_asc)
 {
@@ -1213,17 +3413,132 @@ END_TEST
 #endif
 
 
+/* A raw custom format, i.e. the map meta data followed by its encoded
+ * elevation values
+ */
+static enum turtle_return raw_open(void * context, const char * path,
+    const char * mode, struct turtle_map_info * info, const char ** projection,
+    void ** handle)
+{
+        int * opened = context;
+        FILE * fid = fopen(path, mode);
+        if (fid == NULL) return TURTLE_RETURN_PATH_ERROR;
+        if (mode[0] == 'r') {
+                if (fread(info, sizeof(*info), 1, fid) != 1) {
+                        fclose(fid);
+                        return TURTLE_RETURN_BAD_FORMAT;
+                }
+                info->encoding = NULL;
+        } else
+                fwrite(info, sizeof(*info), 1, fid);
+        (*opened)++;
+        *handle = fid;
+        return TURTLE_RETURN_SUCCESS;
+}
+
+static enum turtle_return raw_read(
+    void * handle, const struct turtle_map_info * info, uint16_t * data)
+{
+        const size_t n = info->nx * info->ny;
+        return (fread(data, sizeof(*data), n, handle) == n) ?
+            TURTLE_RETURN_SUCCESS : TURTLE_RETURN_BAD_FORMAT;
+}
+
+static enum turtle_return raw_write(
+    void * handle, const struct turtle_map_info * info, const uint16_t * data)
+{
+        const size_t n = info->nx * info->ny;
+        fwrite(data, sizeof(*data), n, handle);
+        return TURTLE_RETURN_SUCCESS;
+}
+
+static void raw_close(void * handle) { fclose(handle); }
+
+START_TEST (test_io_register)
+{
+        /* Check the registration errors */
+        turtle_error_handler_t * handler = turtle_error_handler_get();
+        turtle_error_handler_set(&catch_error);
+        struct turtle_io_format format = { &raw_open, &raw_read, &raw_write,
+                &raw_close, NULL };
+        ck_assert_int_eq(turtle_io_register(NULL, &format),
+            TURTLE_RETURN_BAD_EXTENSION);
+        ck_assert_int_eq(turtle_io_register("toolongname", &format),
+            TURTLE_RETURN_BAD_EXTENSION);
+        format.read = NULL;
+        ck_assert_int_eq(
+            turtle_io_register("raw", &format), TURTLE_RETURN_BAD_ADDRESS);
+
+        /* Register the raw format */
+        int opened = 0;
+        format.read = &raw_read;
+        format.context = &opened;
+        ck_assert_int_eq(
+            turtle_io_register("raw", &format), TURTLE_RETURN_SUCCESS);
+
+        /* Dump a map and load it back */
+        struct turtle_map_info info = { 11, 21, { 45., 46. }, { 3., 5. },
+                { -10., 100. } };
+        struct turtle_map * map;
+        turtle_map_create(&map, &info, NULL);
+        int ix, iy;
+        for (iy = 0; iy < info.ny; iy++) {
+                for (ix = 0; ix < info.nx; ix++)
+                        turtle_map_fill(map, ix, iy, ix + iy);
+        }
+        ck_assert_int_eq(
+            turtle_map_dump(map, "tests/map.raw"), TURTLE_RETURN_SUCCESS);
+        turtle_map_destroy(&map);
+
+        ck_assert_int_eq(
+            turtle_map_load(&map, "tests/map.raw"), TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(opened, 2);
+        struct turtle_map_info info1;
+        const char * projection;
+        turtle_map_meta(map, &info1, &projection);
+        ck_assert_int_eq(info1.nx, info.nx);
+        ck_assert_int_eq(info1.ny, info.ny);
+        ck_assert_double_eq_tol(info1.x[1], info.x[1], 1E-09);
+        ck_assert_double_eq_tol(info1.y[1], info.y[1], 1E-09);
+        ck_assert_str_eq(info1.encoding, "raw");
+        ck_assert_ptr_null(projection);
+        for (iy = 0; iy < info.ny; iy++) {
+                for (ix = 0; ix < info.nx; ix++) {
+                        double z;
+                        turtle_map_node(map, ix, iy, NULL, NULL, &z);
+                        ck_assert_double_eq_tol(z, ix + iy, 1E-02);
+                }
+        }
+        turtle_map_destroy(&map);
+
+        /* Check that an unregistered format is no more available */
+        ck_assert_int_eq(
+            turtle_io_register("raw", NULL), TURTLE_RETURN_SUCCESS);
+        ck_assert_int_eq(turtle_map_load(&map, "tests/map.raw"),
+            TURTLE_RETURN_BAD_EXTENSION);
+        turtle_error_handler_set(handler);
+}
+END_TEST
+
+
 START_TEST (test_strfunc)
 {
 #define CHECK_API(FUNCTION)                                                    \
         ck_assert_ptr_nonnull(                                                 \
             turtle_error_function((turtle_function_t *)&FUNCTION))
 
+        CHECK_API(turtle_client_cache_get);
+        CHECK_API(turtle_client_cache_set);
         CHECK_API(turtle_client_clear);
         CHECK_API(turtle_client_create);
         CHECK_API(turtle_client_destroy);
         CHECK_API(turtle_client_elevation);
 
+        CHECK_API(turtle_ecef_frame_configure);
+        CHECK_API(turtle_ecef_frame_from_horizontal);
+        CHECK_API(turtle_ecef_frame_from_local);
+        CHECK_API(turtle_ecef_frame_to_horizontal);
+        CHECK_API(turtle_ecef_frame_to_local);
         CHECK_API(turtle_ecef_from_geodetic);
         CHECK_API(turtle_ecef_from_horizontal);
         CHECK_API(turtle_ecef_to_geodetic);
@@ -1233,7 +3548,10 @@ START_TEST (test_strfunc)
         CHECK_API(turtle_error_handler_get);
         CHECK_API(turtle_error_handler_set);
 
+        CHECK_API(turtle_io_register);
+
         CHECK_API(turtle_map_create);
+        CHECK_API(turtle_map_data_get);
         CHECK_API(turtle_map_destroy);
         CHECK_API(turtle_map_dump);
         CHECK_API(turtle_map_elevation);
@@ -1242,6 +3560,8 @@ START_TEST (test_strfunc)
         CHECK_API(turtle_map_meta);
         CHECK_API(turtle_map_node);
         CHECK_API(turtle_map_projection);
+        CHECK_API(turtle_map_view);
+        CHECK_API(turtle_map_window_stats);
 
         CHECK_API(turtle_projection_configure);
         CHECK_API(turtle_projection_create);
@@ -1250,24 +3570,47 @@ START_TEST (test_strfunc)
         CHECK_API(turtle_projection_project);
         CHECK_API(turtle_projection_unproject);
 
+        CHECK_API(turtle_remote_cache_set);
+
         CHECK_API(turtle_stack_clear);
         CHECK_API(turtle_stack_create);
+        CHECK_API(turtle_stack_create_provider);
         CHECK_API(turtle_stack_destroy);
+        CHECK_API(turtle_stack_dump);
         CHECK_API(turtle_stack_elevation);
         CHECK_API(turtle_stack_load);
+        CHECK_API(turtle_stack_lock_set);
+        CHECK_API(turtle_stack_pin);
+        CHECK_API(turtle_stack_rwlock_enable);
+        CHECK_API(turtle_stack_spill_set);
+        CHECK_API(turtle_stack_unpin);
 
         CHECK_API(turtle_stepper_add_flat);
         CHECK_API(turtle_stepper_add_layer);
         CHECK_API(turtle_stepper_add_map);
         CHECK_API(turtle_stepper_add_stack);
         CHECK_API(turtle_stepper_create);
+        CHECK_API(turtle_stepper_cursor_create);
+        CHECK_API(turtle_stepper_cursor_destroy);
+        CHECK_API(turtle_stepper_cursor_step);
         CHECK_API(turtle_stepper_destroy);
+        CHECK_API(turtle_stepper_footprint_get);
+        CHECK_API(turtle_stepper_footprint_set);
+        CHECK_API(turtle_stepper_frame_get);
+        CHECK_API(turtle_stepper_frame_set);
         CHECK_API(turtle_stepper_geoid_get);
         CHECK_API(turtle_stepper_geoid_set);
         CHECK_API(turtle_stepper_range_get);
         CHECK_API(turtle_stepper_range_set);
+        CHECK_API(turtle_stepper_run);
         CHECK_API(turtle_stepper_position);
+        CHECK_API(turtle_stepper_precision_get);
+        CHECK_API(turtle_stepper_precision_set);
         CHECK_API(turtle_stepper_step);
+        CHECK_API(turtle_stepper_tuning_set);
+        CHECK_API(turtle_trace_dump);
+        CHECK_API(turtle_trace_start);
+        CHECK_API(turtle_trace_stop);
 
         const char * s =
             turtle_error_function((turtle_function_t *)&nothing);
@@ -1296,11 +3639,29 @@ Suite * create_suite(void)
         suite_add_tcase(suite, tc_api);
         tcase_set_timeout(tc_api, timeout);
         tcase_add_test(tc_api, test_map);
+        tcase_add_test(tc_api, test_map_view);
+        tcase_add_test(tc_api, test_map_stats);
+        tcase_add_test(tc_api, test_map_data);
         tcase_add_test(tc_api, test_projection);
         tcase_add_test(tc_api, test_ecef);
         tcase_add_test(tc_api, test_stack);
+        tcase_add_test(tc_api, test_stack_coverage);
+        tcase_add_test(tc_api, test_stack_batch);
         tcase_add_test(tc_api, test_client);
+        tcase_add_test(tc_api, test_stack_lock);
+        tcase_add_test(tc_api, test_stack_pin);
+        tcase_add_test(tc_api, test_stack_pack);
+        tcase_add_test(tc_api, test_stack_spill);
+        tcase_add_test(tc_api, test_stack_provider);
         tcase_add_test(tc_api, test_stepper);
+        tcase_add_test(tc_api, test_stepper_footprint);
+        tcase_add_test(tc_api, test_stepper_frame);
+        tcase_add_test(tc_api, test_stepper_precision);
+        tcase_add_test(tc_api, test_stepper_slope);
+        tcase_add_test(tc_api, test_stepper_run);
+        tcase_add_test(tc_api, test_stepper_cursor);
+        tcase_add_test(tc_api, test_stepper_tuning);
+        tcase_add_test(tc_api, test_trace);
         tcase_add_test(tc_api, test_strfunc); 
 
         /* The I/O test case */
@@ -1315,10 +3676,12 @@ Suite * create_suite(void)
 #endif
 #ifndef TURTLE_NO_TIFF
         tcase_add_test(tc_io, test_io_tiff);
+        tcase_add_test(tc_io, test_io_remote);
 #endif
 #ifndef TURTLE_NO_ASC
         tcase_add_test(tc_io, test_io_asc);
 #endif
+        tcase_add_test(tc_io, test_io_register);
 
         return suite;
 }